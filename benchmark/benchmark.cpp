@@ -0,0 +1,679 @@
+/****************************************************************************
+  Benchmarks of the C++ core of leidenalg.
+
+  This times the construction of a Graph (from an igraph graph and streamed
+  using a GraphBuilder), Graph::collapse_graph, and for each type of partition
+  MutableVertexPartition::diff_move, MutableVertexPartition::move_node,
+  Optimiser::move_nodes and Optimiser::optimise_partition. The graphs are
+  generated stochastic block models and LFR-style benchmark graphs at several
+  scales, the Zachary karate club, and any edge lists given on the command
+  line.
+
+  Optimiser::move_nodes is timed for each number of threads given by
+  --threads, as benchmark move_nodes_<threads>_threads, so that the speedup
+  of moving nodes in parallel is the ratio of its times to those of
+  move_nodes_1_threads.
+
+  The results are written to stdout as CSV, with one line per benchmark, so
+  that they can be compared against an earlier baseline. All graphs and
+  random choices are determined by the seed, so that the same operations are
+  timed in each run.
+
+  Build this using
+
+    python setup.py build_ext --with-benchmark
+
+  which places the executable leiden_benchmark in the build directory, and see
+  leiden_benchmark --help for the options.
+*****************************************************************************/
+#include "GraphHelper.h"
+#include "Optimiser.h"
+#include "ModularityVertexPartition.h"
+#include "SignificanceVertexPartition.h"
+#include "SurpriseVertexPartition.h"
+#include "RBConfigurationVertexPartition.h"
+#include "RBERVertexPartition.h"
+#include "CPMVertexPartition.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using std::string;
+
+typedef std::mt19937_64 Random;
+
+// Zachary karate club
+static size_t const zachary_edges[][2] = {
+  {0, 1}, {0, 2}, {0, 3}, {0, 4}, {0, 5}, {0, 6}, {0, 7}, {0, 8}, {0, 10},
+  {0, 11}, {0, 12}, {0, 13}, {0, 17}, {0, 19}, {0, 21}, {0, 31}, {1, 2},
+  {1, 3}, {1, 7}, {1, 13}, {1, 17}, {1, 19}, {1, 21}, {1, 30}, {2, 3}, {2, 7},
+  {2, 27}, {2, 28}, {2, 32}, {2, 9}, {2, 8}, {2, 13}, {3, 7}, {3, 12},
+  {3, 13}, {4, 6}, {4, 10}, {5, 6}, {5, 10}, {5, 16}, {6, 16}, {8, 30},
+  {8, 32}, {8, 33}, {9, 33}, {13, 33}, {14, 32}, {14, 33}, {15, 32},
+  {15, 33}, {18, 32}, {18, 33}, {19, 33}, {20, 32}, {20, 33}, {22, 32},
+  {22, 33}, {23, 25}, {23, 27}, {23, 32}, {23, 33}, {23, 29}, {24, 25},
+  {24, 27}, {24, 31}, {25, 31}, {26, 29}, {26, 33}, {27, 33}, {28, 31},
+  {28, 33}, {29, 32}, {29, 33}, {30, 32}, {30, 33}, {31, 32}, {31, 33},
+  {32, 33}
+};
+
+struct EdgeList
+{
+  string name;
+  size_t n;
+  int is_directed;
+  vector<size_t> from;
+  vector<size_t> to;
+};
+
+struct Settings
+{
+  size_t max_nodes;
+  size_t repeat;
+  size_t operations;
+  unsigned long seed;
+  string filter;
+  vector<string> edgelists;
+  vector<size_t> threads;
+};
+
+/****************************************************************************
+  Graph generators
+*****************************************************************************/
+
+// Sample from a power law with exponent gamma on [x_min, x_max].
+static double power_law(double x_min, double x_max, double gamma, Random& rng)
+{
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double a = pow(x_min, 1.0 - gamma);
+  double b = pow(x_max, 1.0 - gamma);
+  return pow(a + (b - a)*uniform(rng), 1.0/(1.0 - gamma));
+}
+
+/****************************************************************************
+  Stochastic block model with n nodes in communities of (on average) 100 nodes.
+  Each node has an average degree of 10, of which a fraction mu = 0.2 connects
+  to other communities.
+*****************************************************************************/
+static EdgeList generate_sbm(size_t n, Random& rng)
+{
+  double const mu = 0.2;
+  size_t const avg_degree = 10;
+  size_t n_comms = std::max<size_t>(n/100, 1);
+
+  EdgeList edges;
+  std::ostringstream name;
+  name << "sbm_" << n;
+  edges.name = name.str();
+  edges.n = n;
+  edges.is_directed = false;
+
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::uniform_int_distribution<size_t> random_node(0, n - 1);
+  size_t m = n*avg_degree/2;
+  edges.from.reserve(m);
+  edges.to.reserve(m);
+  while (edges.from.size() < m)
+  {
+    size_t u = random_node(rng);
+    size_t v;
+    if (uniform(rng) < mu)
+      v = random_node(rng);
+    else
+    {
+      // Nodes are assigned to consecutive blocks
+      size_t c = u*n_comms/n;
+      size_t begin = (c*n + n_comms - 1)/n_comms;
+      size_t end = ((c + 1)*n + n_comms - 1)/n_comms;
+      std::uniform_int_distribution<size_t> random_member(begin, end - 1);
+      v = random_member(rng);
+    }
+    if (u == v)
+      continue;
+    edges.from.push_back(u);
+    edges.to.push_back(v);
+  }
+  return edges;
+}
+
+/****************************************************************************
+  LFR-style benchmark graph with n nodes. Degrees follow a power law with
+  exponent 2.5 between 5 and sqrt(10 n), and community sizes a power law with
+  exponent 1.5 between 20 and 1000 nodes. Each edge connects to another
+  community with probability mu = 0.3, and the other endpoint is chosen
+  proportional to its degree, similar to a Chung-Lu model.
+*****************************************************************************/
+static EdgeList generate_lfr(size_t n, Random& rng)
+{
+  double const mu = 0.3;
+
+  EdgeList edges;
+  std::ostringstream name;
+  name << "lfr_" << n;
+  edges.name = name.str();
+  edges.n = n;
+  edges.is_directed = false;
+
+  double max_degree = std::max(sqrt(10.0*n), 6.0);
+  vector<size_t> degree(n);
+  for (size_t v = 0; v < n; v++)
+    degree[v] = (size_t)power_law(5.0, max_degree, 2.5, rng);
+
+  // Communities of consecutive nodes
+  vector<size_t> comm_start;
+  for (size_t v = 0; v < n; )
+  {
+    comm_start.push_back(v);
+    v += (size_t)power_law(20.0, std::min(1000.0, std::max(20.0, n/2.0)), 1.5, rng);
+  }
+  comm_start.push_back(n);
+
+  // Each node is included once for each of its stubs, so that the stubs of
+  // each community are consecutive as well.
+  vector<size_t> stubs;
+  vector<size_t> stub_start(n + 1, 0);
+  for (size_t v = 0; v < n; v++)
+  {
+    stub_start[v] = stubs.size();
+    stubs.insert(stubs.end(), degree[v], v);
+  }
+  stub_start[n] = stubs.size();
+
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::uniform_int_distribution<size_t> random_stub(0, stubs.size() - 1);
+  for (size_t c = 0; c + 1 < comm_start.size(); c++)
+  {
+    size_t comm_begin = stub_start[comm_start[c]];
+    size_t comm_end = stub_start[comm_start[c + 1]];
+    std::uniform_int_distribution<size_t> random_comm_stub(comm_begin, comm_end - 1);
+    // Each stub creates half an edge on average
+    for (size_t s = comm_begin; s < comm_end; s++)
+    {
+      if (uniform(rng) < 0.5)
+        continue;
+      size_t u = stubs[s];
+      size_t v = (uniform(rng) < mu) ? stubs[random_stub(rng)] : stubs[random_comm_stub(rng)];
+      if (u == v)
+        continue;
+      edges.from.push_back(u);
+      edges.to.push_back(v);
+    }
+  }
+  return edges;
+}
+
+static EdgeList zachary()
+{
+  EdgeList edges;
+  edges.name = "zachary";
+  edges.n = 34;
+  edges.is_directed = false;
+  size_t m = sizeof(zachary_edges)/sizeof(zachary_edges[0]);
+  for (size_t e = 0; e < m; e++)
+  {
+    edges.from.push_back(zachary_edges[e][0]);
+    edges.to.push_back(zachary_edges[e][1]);
+  }
+  return edges;
+}
+
+/****************************************************************************
+  Read an undirected graph from a file with one edge "from to" per line. Empty
+  lines and lines starting with # or % are ignored.
+*****************************************************************************/
+static EdgeList read_edgelist(string const& filename)
+{
+  std::ifstream file(filename.c_str());
+  if (!file)
+    throw Exception("Could not open edge list file.");
+
+  EdgeList edges;
+  size_t slash = filename.find_last_of("/\\");
+  edges.name = (slash == string::npos) ? filename : filename.substr(slash + 1);
+  edges.n = 0;
+  edges.is_directed = false;
+
+  string line;
+  while (std::getline(file, line))
+  {
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == string::npos || line[start] == '#' || line[start] == '%')
+      continue;
+    std::istringstream fields(line);
+    size_t u, v;
+    if (!(fields >> u >> v))
+      throw Exception("Invalid edge in edge list file.");
+    edges.from.push_back(u);
+    edges.to.push_back(v);
+    edges.n = std::max(edges.n, std::max(u, v) + 1);
+  }
+  return edges;
+}
+
+static igraph_t* create_igraph(EdgeList const& edges)
+{
+  size_t m = edges.from.size();
+  igraph_vector_t igraph_edges;
+  igraph_vector_init(&igraph_edges, 2*m);
+  for (size_t e = 0; e < m; e++)
+  {
+    VECTOR(igraph_edges)[2*e] = edges.from[e];
+    VECTOR(igraph_edges)[2*e + 1] = edges.to[e];
+  }
+  igraph_t* graph = new igraph_t();
+  igraph_create(graph, &igraph_edges, edges.n, edges.is_directed);
+  igraph_vector_destroy(&igraph_edges);
+  return graph;
+}
+
+/****************************************************************************
+  Partitions
+*****************************************************************************/
+
+static char const* partition_types[] = {
+  "Modularity", "CPM", "RBER", "RBConfiguration", "Significance", "Surprise"
+};
+
+// CPM uses a fixed resolution parameter, the other resolution parameters are 1.
+static MutableVertexPartition* create_partition(string const& type, Graph* graph, vector<size_t> const& membership)
+{
+  if (type == "Modularity")
+    return new ModularityVertexPartition(graph, membership);
+  else if (type == "CPM")
+    return new CPMVertexPartition(graph, membership, 0.01);
+  else if (type == "RBER")
+    return new RBERVertexPartition(graph, membership, 1.0);
+  else if (type == "RBConfiguration")
+    return new RBConfigurationVertexPartition(graph, membership, 1.0);
+  else if (type == "Significance")
+    return new SignificanceVertexPartition(graph, membership);
+  else if (type == "Surprise")
+    return new SurpriseVertexPartition(graph, membership);
+  else
+    throw Exception("Unknown partition type.");
+}
+
+/****************************************************************************
+  Timing and reporting
+*****************************************************************************/
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Results of timed operations are accumulated in this variable, so that the
+// compiler cannot remove the operations.
+static volatile double sink = 0.0;
+
+struct Result
+{
+  string benchmark;
+  string partition;
+  size_t operations;
+  vector<double> seconds;
+  double quality;
+};
+
+static void print_header()
+{
+  printf("benchmark,graph,n,m,partition,repeats,operations,"
+         "min_seconds,median_seconds,ns_per_operation,quality\n");
+}
+
+static void report(Result& result, EdgeList const& edges, Graph* graph)
+{
+  std::sort(result.seconds.begin(), result.seconds.end());
+  double min_seconds = result.seconds.front();
+  double median_seconds = result.seconds[result.seconds.size()/2];
+  printf("%s,%s,%lu,%lu,%s,%lu,%lu,%.9f,%.9f,%.3f,",
+         result.benchmark.c_str(), edges.name.c_str(),
+         (unsigned long)graph->vcount(), (unsigned long)graph->ecount(),
+         result.partition.c_str(), (unsigned long)result.seconds.size(),
+         (unsigned long)result.operations, min_seconds, median_seconds,
+         1e9*min_seconds/std::max<size_t>(result.operations, 1));
+  if (!std::isnan(result.quality))
+    printf("%.10g", result.quality);
+  printf("\n");
+  fflush(stdout);
+}
+
+static bool selected(Settings const& settings, string const& benchmark)
+{
+  return settings.filter.empty() || benchmark.find(settings.filter) != string::npos;
+}
+
+/****************************************************************************
+  Benchmarks
+*****************************************************************************/
+
+static void benchmark_graph_construction(Settings const& settings, EdgeList const& edges, igraph_t* igraph, Graph* graph)
+{
+  Result result;
+  result.benchmark = "graph_construction";
+  result.partition = "";
+  result.operations = edges.from.size();
+  result.quality = NAN;
+  for (size_t r = 0; r < settings.repeat; r++)
+  {
+    Clock::time_point start = Clock::now();
+    Graph* G = new Graph(igraph);
+    result.seconds.push_back(seconds_since(start));
+    delete G;
+  }
+  report(result, edges, graph);
+}
+
+static void benchmark_graph_builder(Settings const& settings, EdgeList const& edges, Graph* graph)
+{
+  Result result;
+  result.benchmark = "graph_builder";
+  result.partition = "";
+  result.operations = edges.from.size();
+  result.quality = NAN;
+  for (size_t r = 0; r < settings.repeat; r++)
+  {
+    Clock::time_point start = Clock::now();
+    GraphBuilder builder(edges.n, edges.is_directed, false);
+    builder.count_edges(edges.from.data(), edges.to.data(), edges.from.size());
+    builder.add_edges(edges.from.data(), edges.to.data(), NULL, edges.from.size());
+    Graph* G = builder.get_graph();
+    result.seconds.push_back(seconds_since(start));
+    delete G;
+  }
+  report(result, edges, graph);
+}
+
+static void benchmark_collapse_graph(Settings const& settings, EdgeList const& edges, Graph* graph, vector<size_t> const& membership)
+{
+  Result result;
+  result.benchmark = "collapse_graph";
+  result.partition = "";
+  result.operations = graph->ecount();
+  result.quality = NAN;
+  ModularityVertexPartition partition(graph, membership);
+  for (size_t r = 0; r < settings.repeat; r++)
+  {
+    Clock::time_point start = Clock::now();
+    Graph* collapsed_graph = graph->collapse_graph(&partition);
+    result.seconds.push_back(seconds_since(start));
+    delete collapsed_graph;
+  }
+  report(result, edges, graph);
+}
+
+// Random nodes with at least one neighbour, and for each a random neighbour.
+static void random_moves(Settings const& settings, Graph* graph, Random& rng,
+                         vector<size_t>& nodes, vector<size_t>& neighbours)
+{
+  nodes.clear();
+  neighbours.clear();
+  if (graph->ecount() == 0)
+    return;
+  std::uniform_int_distribution<size_t> random_node(0, graph->vcount() - 1);
+  while (nodes.size() < settings.operations)
+  {
+    size_t v = random_node(rng);
+    NeighbourRange neighbours_v = graph->get_neighbours(v, IGRAPH_ALL);
+    if (neighbours_v.size() == 0)
+      continue;
+    std::uniform_int_distribution<size_t> random_neighbour(0, neighbours_v.size() - 1);
+    nodes.push_back(v);
+    neighbours.push_back(neighbours_v[random_neighbour(rng)].node);
+  }
+}
+
+static void benchmark_diff_move(Settings const& settings, EdgeList const& edges, Graph* graph,
+                                vector<size_t> const& membership, string const& type, Random& rng)
+{
+  vector<size_t> nodes, neighbours;
+  random_moves(settings, graph, rng, nodes, neighbours);
+
+  Result result;
+  result.benchmark = "diff_move";
+  result.partition = type;
+  result.operations = nodes.size();
+  MutableVertexPartition* partition = create_partition(type, graph, membership);
+  result.quality = partition->quality();
+  for (size_t r = 0; r < settings.repeat; r++)
+  {
+    double total = 0.0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < nodes.size(); i++)
+      total += partition->diff_move(nodes[i], partition->membership(neighbours[i]));
+    result.seconds.push_back(seconds_since(start));
+    sink = sink + total;
+  }
+  delete partition;
+  report(result, edges, graph);
+}
+
+static void benchmark_move_node(Settings const& settings, EdgeList const& edges, Graph* graph,
+                                vector<size_t> const& membership, string const& type, Random& rng)
+{
+  vector<size_t> nodes, neighbours;
+  random_moves(settings, graph, rng, nodes, neighbours);
+
+  Result result;
+  result.benchmark = "move_node";
+  result.partition = type;
+  result.operations = nodes.size();
+  result.quality = NAN;
+  for (size_t r = 0; r < settings.repeat; r++)
+  {
+    MutableVertexPartition* partition = create_partition(type, graph, membership);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < nodes.size(); i++)
+      partition->move_node(nodes[i], partition->membership(neighbours[i]));
+    result.seconds.push_back(seconds_since(start));
+    result.quality = partition->quality();
+    delete partition;
+  }
+  report(result, edges, graph);
+}
+
+static void benchmark_move_nodes(Settings const& settings, EdgeList const& edges, Graph* graph,
+                                 string const& type, size_t n_threads)
+{
+  std::ostringstream benchmark;
+  benchmark << "move_nodes_" << n_threads << "_threads";
+
+  Result result;
+  result.benchmark = benchmark.str();
+  result.partition = type;
+  result.operations = graph->vcount();
+  result.quality = NAN;
+  vector<size_t> singletons = range(graph->vcount());
+  for (size_t r = 0; r < settings.repeat; r++)
+  {
+    MutableVertexPartition* partition = create_partition(type, graph, singletons);
+    Optimiser optimiser;
+    optimiser.set_rng_seed(settings.seed + r);
+    optimiser.n_threads = n_threads;
+    Clock::time_point start = Clock::now();
+    optimiser.move_nodes(partition);
+    result.seconds.push_back(seconds_since(start));
+    result.quality = partition->quality();
+    delete partition;
+  }
+  report(result, edges, graph);
+}
+
+static void benchmark_optimise_partition(Settings const& settings, EdgeList const& edges, Graph* graph,
+                                         string const& type)
+{
+  Result result;
+  result.benchmark = "optimise_partition";
+  result.partition = type;
+  result.operations = graph->ecount();
+  result.quality = NAN;
+  vector<size_t> singletons = range(graph->vcount());
+  for (size_t r = 0; r < settings.repeat; r++)
+  {
+    MutableVertexPartition* partition = create_partition(type, graph, singletons);
+    Optimiser optimiser;
+    optimiser.set_rng_seed(settings.seed + r);
+    Clock::time_point start = Clock::now();
+    optimiser.optimise_partition(partition);
+    result.seconds.push_back(seconds_since(start));
+    result.quality = partition->quality();
+    delete partition;
+  }
+  report(result, edges, graph);
+}
+
+static void run_benchmarks(Settings const& settings, EdgeList const& edges)
+{
+  Random rng(settings.seed);
+  igraph_t* igraph = create_igraph(edges);
+  Graph* graph = new Graph(igraph);
+
+  if (selected(settings, "graph_construction"))
+    benchmark_graph_construction(settings, edges, igraph, graph);
+  if (selected(settings, "graph_builder"))
+    benchmark_graph_builder(settings, edges, graph);
+
+  // The communities for collapsing the graph and moving nodes
+  ModularityVertexPartition reference(graph);
+  Optimiser optimiser;
+  optimiser.set_rng_seed(settings.seed);
+  optimiser.optimise_partition(&reference);
+  vector<size_t> membership = reference.membership();
+
+  if (selected(settings, "collapse_graph"))
+    benchmark_collapse_graph(settings, edges, graph, membership);
+
+  size_t n_types = sizeof(partition_types)/sizeof(partition_types[0]);
+  for (size_t t = 0; t < n_types; t++)
+  {
+    string type = partition_types[t];
+    if (selected(settings, "diff_move"))
+      benchmark_diff_move(settings, edges, graph, membership, type, rng);
+    if (selected(settings, "move_node"))
+      benchmark_move_node(settings, edges, graph, membership, type, rng);
+    if (selected(settings, "move_nodes"))
+      for (size_t i = 0; i < settings.threads.size(); i++)
+        benchmark_move_nodes(settings, edges, graph, type, settings.threads[i]);
+    if (selected(settings, "optimise_partition"))
+      benchmark_optimise_partition(settings, edges, graph, type);
+  }
+
+  delete graph;
+  igraph_destroy(igraph);
+  delete igraph;
+}
+
+static void usage()
+{
+  printf("Usage: leiden_benchmark [options]\n"
+         "\n"
+         "  --max-nodes N    Largest generated graphs (default 100000)\n"
+         "  --repeat R       Number of times each benchmark is repeated (default 3)\n"
+         "  --operations K   Number of diff_move and move_node calls (default 100000)\n"
+         "  --seed S         Seed for the graphs and optimisation (default 0)\n"
+         "  --filter NAME    Only run benchmarks whose name contains NAME\n"
+         "  --threads LIST   Comma separated numbers of threads for move_nodes\n"
+         "                   (default 1 and the number of cores)\n"
+         "  --edgelist FILE  Also benchmark the graph in FILE, may be repeated\n"
+         "  --help           Show this message\n");
+}
+
+static char const* argument(int argc, char** argv, int& i)
+{
+  if (i + 1 >= argc)
+  {
+    usage();
+    exit(1);
+  }
+  return argv[++i];
+}
+
+static vector<size_t> thread_counts(char const* list)
+{
+  vector<size_t> threads;
+  std::istringstream stream(list);
+  string item;
+  while (std::getline(stream, item, ','))
+    threads.push_back(std::max<size_t>(strtoul(item.c_str(), NULL, 10), 1));
+  return threads;
+}
+
+int main(int argc, char** argv)
+{
+  Settings settings;
+  settings.max_nodes = 100000;
+  settings.repeat = 3;
+  settings.operations = 100000;
+  settings.seed = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string option = argv[i];
+    if (option == "--max-nodes")
+      settings.max_nodes = strtoul(argument(argc, argv, i), NULL, 10);
+    else if (option == "--repeat")
+      settings.repeat = std::max<size_t>(strtoul(argument(argc, argv, i), NULL, 10), 1);
+    else if (option == "--operations")
+      settings.operations = strtoul(argument(argc, argv, i), NULL, 10);
+    else if (option == "--seed")
+      settings.seed = strtoul(argument(argc, argv, i), NULL, 10);
+    else if (option == "--filter")
+      settings.filter = argument(argc, argv, i);
+    else if (option == "--edgelist")
+      settings.edgelists.push_back(argument(argc, argv, i));
+    else if (option == "--threads")
+      settings.threads = thread_counts(argument(argc, argv, i));
+    else if (option == "--help")
+    {
+      usage();
+      return 0;
+    }
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+  if (settings.threads.empty())
+  {
+    settings.threads.push_back(1);
+    size_t n_cores = std::thread::hardware_concurrency();
+    if (n_cores > 1)
+      settings.threads.push_back(n_cores);
+  }
+
+  try
+  {
+    print_header();
+
+    run_benchmarks(settings, zachary());
+
+    for (size_t n = 1000; n <= settings.max_nodes; n *= 10)
+    {
+      Random rng(settings.seed + n);
+      run_benchmarks(settings, generate_sbm(n, rng));
+      run_benchmarks(settings, generate_lfr(n, rng));
+    }
+
+    for (size_t i = 0; i < settings.edgelists.size(); i++)
+      run_benchmarks(settings, read_edgelist(settings.edgelists[i]));
+  }
+  catch (std::exception& e)
+  {
+    fprintf(stderr, "Error: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -16,9 +16,13 @@ class CPMVertexPartition : public LinearResolutionParameterVertexPartition
     virtual ~CPMVertexPartition();
     virtual CPMVertexPartition* create(Graph* graph);
     virtual CPMVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+    virtual CPMVertexPartition* clone();
 
     virtual double diff_move(size_t v, size_t new_comm);
+    virtual void diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs);
+    virtual int has_local_diff_move() { return true; };
     virtual double quality(double resolution_parameter);
+    virtual void quality_terms(double& E, double& F);
 
   protected:
   private:
@@ -6,6 +6,10 @@
 #include <set>
 #include <exception>
 #include <queue>
+#include <limits>
+#include <functional>
+#include <atomic>
+#include <stdint.h>
 
 //#ifdef DEBUG
 #include <iostream>
@@ -14,6 +18,7 @@
 //#endif
 
 class MutableVertexPartition;
+class GraphBuilder;
 
 using std::vector;
 using std::pair;
@@ -24,11 +29,14 @@ using std::make_pair;
 vector<size_t> range(size_t n);
 queue<size_t> queue_range(size_t n);
 
-bool orderCSize(const size_t* A, const size_t* B);
-
 double KL(double q, double p);
 double KLL(double q, double p);
 
+// Call worker(t) for t = 0, ..., n_threads - 1 concurrently, where the last
+// worker runs on the calling thread. Once all workers are done, the first
+// exception thrown by any of them (by order of t) is rethrown.
+void run_workers(size_t n_threads, std::function<void(size_t)> const& worker);
+
 template <class T> T sum(vector<T> vec)
 {
   T sum_of_elems = T();
@@ -64,6 +72,126 @@ inline size_t get_random_int(size_t from, size_t to, igraph_rng_t* rng)
 
 void shuffle(vector<size_t>& v, igraph_rng_t* rng);
 
+// Stable counting sort of the indices in order, according to key[idx] for
+// each index idx in order. The keys should be smaller than n_keys. This runs
+// in O(order.size() + n_keys) time.
+template <class T> void sort_by_key(vector<size_t>& order, vector<T> const& key, size_t n_keys)
+{
+  vector<size_t> start(n_keys + 1, 0);
+  for (vector<size_t>::iterator it = order.begin(); it != order.end(); it++)
+    start[key[*it] + 1] += 1;
+  for (size_t k = 0; k < n_keys; k++)
+    start[k + 1] += start[k];
+
+  vector<size_t> sorted(order.size());
+  for (vector<size_t>::iterator it = order.begin(); it != order.end(); it++)
+    sorted[start[key[*it]]++] = *it;
+  order.swap(sorted);
+};
+
+// The types used for the data that a Graph stores for every edge: its
+// endpoints, its weight and its entries in the adjacency. By default these
+// are size_t and double. Building with LEIDENALG_COMPACT_GRAPH stores them as
+// 32 bit integers and floats instead, which halves the memory per edge, at
+// the cost of limiting graphs to fewer than 2^32 nodes and edges, and of
+// storing weights in single precision. Everything else, such as strengths,
+// node sizes and the administration of partitions, remains size_t and double.
+#ifdef LEIDENALG_COMPACT_GRAPH
+  typedef uint32_t edge_index_t;
+  typedef float edge_weight_t;
+#else
+  typedef size_t edge_index_t;
+  typedef double edge_weight_t;
+#endif
+
+// A single entry in the adjacency of a node. The neighbour, the edge and its
+// weight are stored together, so that looping over the neighbours of a node
+// is a single scan over contiguous memory.
+struct Neighbour
+{
+  edge_index_t node;    // The neighbouring node
+  edge_index_t edge;    // The edge connecting to the neighbouring node
+  edge_weight_t weight; // The weight of that edge
+};
+
+// The part of a node that lies within a single slice of a multislice graph
+// (see Graph::set_slices). Each node of the original graph lies within a
+// single slice, but the nodes of a collapsed graph may span several slices.
+struct NodeSlice
+{
+  size_t slice;        // The slice
+  double strength_out; // The strength within the slice
+  double strength_in;
+  size_t size;         // The size of the node within the slice
+};
+
+// A range of neighbours, pointing directly into the adjacency of a Graph. It
+// remains valid as long as the graph exists and its edges are not changed.
+class NeighbourRange
+{
+  public:
+    NeighbourRange(Neighbour const* begin, Neighbour const* end)
+    {
+      this->_begin = begin;
+      this->_end = end;
+    }
+
+    inline Neighbour const* begin() const { return this->_begin; };
+    inline Neighbour const* end() const { return this->_end; };
+    inline size_t size() const { return this->_end - this->_begin; };
+    inline Neighbour const& operator[](size_t idx) const { return this->_begin[idx]; };
+
+  private:
+    Neighbour const* _begin;
+    Neighbour const* _end;
+};
+
+// The changes in weight between pairs of nodes after changing the edges of a
+// graph (see Graph::add_edges, Graph::delete_edges and Graph::set_edge_weights).
+// These can be applied to a partition of the graph, without recalculating its
+// administration (see MutableVertexPartition::apply_edge_changes).
+struct EdgeChanges
+{
+  vector<size_t> from;
+  vector<size_t> to;
+  vector<double> weight; // The difference in weight
+
+  inline void add(size_t v, size_t u, double w)
+  {
+    this->from.push_back(v);
+    this->to.push_back(u);
+    this->weight.push_back(w);
+  };
+
+  inline size_t size() const { return this->weight.size(); };
+
+  inline void clear()
+  {
+    this->from.clear();
+    this->to.clear();
+    this->weight.clear();
+  };
+};
+
+// A read-only memory mapped file (see Graph::load).
+class MappedFile
+{
+  public:
+    MappedFile(char const* filename);
+    ~MappedFile();
+
+    inline char const* data() const { return this->_data; };
+    inline size_t size() const { return this->_size; };
+
+  private:
+    char const* _data;
+    size_t _size;
+    #ifdef _WIN32
+    void* _file_handle;
+    void* _mapping_handle;
+    #endif
+};
+
 class Graph
 {
   public:
@@ -95,13 +223,41 @@ class Graph
     size_t possible_edges(size_t n);
 
     Graph* collapse_graph(MutableVertexPartition* partition);
+    // Collapse the graph into G, which should be a graph created by
+    // collapse_graph. The memory of G is reused, which avoids reallocating it
+    // for every aggregation level.
+    void collapse_graph(MutableVertexPartition* partition, Graph* G);
+
+    // The subgraph induced by nodes, which should be increasing, where node i
+    // of the subgraph is nodes[i]. The nodes keep their sizes, self weights
+    // and strengths, including the weight of the edges leaving the subgraph,
+    // and the subgraph keeps the total weight and density of this graph.
+    Graph* subgraph(vector<size_t> const& nodes);
+
+    // The same graph in which node i is node order[i] of this graph, which
+    // should contain each node once. The edges of nodes that are close in the
+    // order are then also stored close together (see rcm_order and
+    // degree_order).
+    Graph* permuted(vector<size_t> const& order);
+    // Orders of the nodes for permuted: the reverse Cuthill-McKee order, in
+    // which neighbours are close to each other, and the order of decreasing
+    // degree.
+    vector<size_t> rcm_order();
+    vector<size_t> degree_order();
+
+    // Change the edges of the graph in a batch, and record the changes in
+    // weight in changes. Any igraph graph is no longer used afterwards.
+    void add_edges(vector<size_t> const& from, vector<size_t> const& to, vector<double> const& weights, EdgeChanges& changes);
+    void delete_edges(vector<size_t> const& edges, EdgeChanges& changes);
+    void set_edge_weights(vector<size_t> const& edges, vector<double> const& weights, EdgeChanges& changes);
+
+    // The endpoints of the changed edges and all their neighbours
+    vector<size_t> affected_nodes(EdgeChanges const& changes);
 
     double weight_tofrom_community(size_t v, size_t comm, vector<size_t> const& membership, igraph_neimode_t mode);
     void cache_neigh_communities(size_t v, vector<size_t> const& membership, igraph_neimode_t mode);
     vector<size_t> const& get_neigh_comms(size_t v, vector<size_t> const& membership, igraph_neimode_t mode);
 
-    vector<size_t> const& get_neighbour_edges(size_t v, igraph_neimode_t mode);
-    vector<size_t> const& get_neighbours(size_t v, igraph_neimode_t mode);
     size_t get_random_neighbour(size_t v, igraph_neimode_t mode, igraph_rng_t* rng);
 
     pair<size_t, size_t> get_endpoints(size_t e);
@@ -111,33 +267,52 @@ class Graph
       return get_random_int(0, this->vcount() - 1, rng);
     };
 
+    // Get the underlying igraph graph. Graphs that are created by
+    // collapse_graph are not backed by an igraph graph, in which case this
+    // returns NULL.
     inline igraph_t* get_igraph() { return this->_graph; };
 
-    inline size_t vcount() { return igraph_vcount(this->_graph); };
-    inline size_t ecount() { return igraph_ecount(this->_graph); };
+    // Write the graph to a binary file, which can be loaded using load. The
+    // file contains the adjacency, weights, node sizes, strengths and self
+    // weights, so that nothing has to be recalculated when loading it.
+    void save(char const* filename);
+
+    // Load a graph from a binary file written by save. The file is memory
+    // mapped, and its data is used directly, without copying it, until the
+    // edges of the graph are changed. If validate is set, the adjacency is
+    // first checked to be consistent, which reads the entire file.
+    static Graph* load(char const* filename, int validate = true);
+
+    // The number of threads used for constructing graphs, including collapsed
+    // graphs. The result does not depend on the number of threads. The
+    // default is 1, and setting it to 0 uses all available cores.
+    static void set_n_threads(size_t n_threads);
+    static size_t n_threads();
+
+    inline size_t vcount() { return this->_n; };
+    inline size_t ecount() { return this->_m; };
     inline double total_weight() { return this->_total_weight; };
     inline size_t total_size() { return this->_total_size; };
-    inline int is_directed() { return igraph_is_directed(this->_graph); };
+    inline int is_directed() { return this->_is_directed; };
     inline double density() { return this->_density; };
     inline int correct_self_loops() { return this->_correct_self_loops; };
     inline int is_weighted() { return this->_is_weighted; };
 
-    // Get weight of edge based on attribute (or 1.0 if there is none).
+    // Get weight of edge based on attribute (or 1.0 if there is none). If all
+    // edges have a weight of 1.0, no weights are stored at all.
     inline double edge_weight(size_t e)
     {
       #ifdef DEBUG
-      if (e > this->_edge_weights.size())
+      if (e > this->ecount())
         throw Exception("Edges outside of range of edge weights.");
       #endif
-      return this->_edge_weights[e];
+      return this->_edge_weights != NULL ? this->_edge_weights[e] : 1.0;
     };
 
     inline vector<size_t> edge(size_t e)
     {
-      igraph_integer_t v1, v2;
-      igraph_edge(this->_graph, e, &v1, &v2);
       vector<size_t> edge(2);
-      edge[0] = v1; edge[1] = v2;
+      edge[0] = this->_edge_from[e]; edge[1] = this->_edge_to[e];
       return edge;
     }
 
@@ -149,14 +324,36 @@ class Graph
     inline double node_self_weight(size_t v)
     { return this->_node_self_weights[v]; };
 
+    // Get the neighbours of a node (together with the incident edges and
+    // their weights). For undirected graphs, the mode is ignored, and all
+    // neighbours are returned. Self loops are included twice for mode
+    // IGRAPH_ALL (or for undirected graphs), similar to igraph. Unlike
+    // igraph, IGRAPH_ALL gives the outgoing neighbours followed by the
+    // incoming ones for directed graphs (see init_neighbours).
+    inline NeighbourRange get_neighbours(size_t v, igraph_neimode_t mode)
+    {
+      Neighbour const* neighbours = this->_neighbours;
+      if (mode == IGRAPH_ALL || !this->is_directed())
+        return NeighbourRange(neighbours + this->_neighbours_offset[v],
+                              neighbours + this->_neighbours_offset[v + 1]);
+      else if (mode == IGRAPH_OUT)
+        return NeighbourRange(neighbours + this->_neighbours_offset[v],
+                              neighbours + this->_neighbours_in_offset[v]);
+      else if (mode == IGRAPH_IN)
+        return NeighbourRange(neighbours + this->_neighbours_in_offset[v],
+                              neighbours + this->_neighbours_offset[v + 1]);
+      else
+        throw Exception("Incorrect mode specified.");
+    };
+
     inline size_t degree(size_t v, igraph_neimode_t mode)
     {
-      if (mode == IGRAPH_IN)
-        return this->_degree_in[v];
+      if (mode == IGRAPH_ALL || !this->is_directed())
+        return this->_neighbours_offset[v + 1] - this->_neighbours_offset[v];
       else if (mode == IGRAPH_OUT)
-        return this->_degree_out[v];
-      else if (mode == IGRAPH_ALL)
-        return this->_degree_all[v];
+        return this->_neighbours_in_offset[v] - this->_neighbours_offset[v];
+      else if (mode == IGRAPH_IN)
+        return this->_neighbours_offset[v + 1] - this->_neighbours_in_offset[v];
       else
         throw Exception("Incorrect mode specified.");
     };
@@ -171,49 +368,175 @@ class Graph
         throw Exception("Incorrect mode specified.");
     };
 
+    // Divide the nodes into slices, for example the time slices of a temporal
+    // network. Edges between nodes in the same slice are intraslice edges,
+    // while all other edges couple the slices. The strengths and sizes within
+    // each slice are carried over to collapsed graphs, so that null models can
+    // be evaluated per slice (see MultisliceVertexPartition). The edges of a
+    // graph with slices can no longer be changed.
+    void set_slices(vector<size_t> const& slices);
+
+    // The number of slices, which is 0 if the nodes are not divided into
+    // slices.
+    inline size_t n_slices() { return this->_slice_total_weight.size(); };
+
+    // The total weight of the intraslice edges of slice s.
+    inline double slice_total_weight(size_t s)
+    { return this->_slice_total_weight[s]; };
+
+    // The slices spanned by node v.
+    inline NodeSlice const* node_slices(size_t v)
+    { return this->_node_slices.data() + this->_node_slices_offset[v]; };
+    inline size_t n_node_slices(size_t v)
+    { return this->_node_slices_offset[v + 1] - this->_node_slices_offset[v]; };
+
   protected:
 
     int _remove_graph;
 
   private:
+    friend class GraphBuilder;
+
     igraph_t* _graph;
 
-    // Utility variables to easily access the strength of each node
-    vector<double> _strength_in;
-    vector<double> _strength_out;
+    size_t _n;
+    size_t _m;
+    int _is_directed;
 
-    vector<size_t> _degree_in;
-    vector<size_t> _degree_out;
-    vector<size_t> _degree_all;
+    // The data of the graph is stored in these vectors, unless the graph is
+    // loaded from a file (see Graph::load). It should only be read through
+    // the pointers below.
+    struct Storage
+    {
+      vector<edge_index_t> edge_from;
+      vector<edge_index_t> edge_to;
+      vector<double> strength_in;
+      vector<double> strength_out;
+      vector<edge_weight_t> edge_weights; // Empty if all weights are 1.0
+      vector<size_t> node_sizes;
+      vector<double> node_self_weights;
+      vector<Neighbour> neighbours;
+      vector<size_t> neighbours_offset;
+      vector<size_t> neighbours_in_offset;
+    };
+    Storage _storage;
 
-    vector<double> _edge_weights; // Used for the weight of the edges.
-    vector<size_t> _node_sizes; // Used for the size of the nodes.
-    vector<double> _node_self_weights; // Used for the self weight of the nodes.
+    // A memory mapped file containing the data of the graph, or NULL if the
+    // data is stored in _storage.
+    MappedFile* _file;
 
-    void cache_neighbours(size_t v, igraph_neimode_t mode);
-    vector<size_t> _cached_neighs_from; size_t _current_node_cache_neigh_from;
-    vector<size_t> _cached_neighs_to;   size_t _current_node_cache_neigh_to;
-    vector<size_t> _cached_neighs_all;  size_t _current_node_cache_neigh_all;
+    // Endpoints of the edges. For undirected graphs _edge_from[e] is at
+    // least _edge_to[e], similar to igraph.
+    edge_index_t const* _edge_from;
+    edge_index_t const* _edge_to;
 
-    void cache_neighbour_edges(size_t v, igraph_neimode_t mode);
-    vector<size_t> _cached_neigh_edges_from; size_t _current_node_cache_neigh_edges_from;
-    vector<size_t> _cached_neigh_edges_to;   size_t _current_node_cache_neigh_edges_to;
-    vector<size_t> _cached_neigh_edges_all;  size_t _current_node_cache_neigh_edges_all;
+    // Utility variables to easily access the strength of each node
+    double const* _strength_in;
+    double const* _strength_out;
+
+    edge_weight_t const* _edge_weights; // Used for the weight of the edges, NULL if all weights are 1.0.
+    size_t const* _node_sizes; // Used for the size of the nodes.
+    double const* _node_self_weights; // Used for the self weight of the nodes.
+
+    // Adjacency of all nodes in compressed sparse row format. The neighbours
+    // of node v are stored in _neighbours[_neighbours_offset[v]] up until
+    // _neighbours[_neighbours_offset[v + 1]], with first the outgoing
+    // neighbours and then, starting at _neighbours_in_offset[v], the
+    // incoming neighbours.
+    Neighbour const* _neighbours;
+    size_t const* _neighbours_offset;
+    size_t const* _neighbours_in_offset;
 
     double _total_weight;
     size_t _total_size;
     int _is_weighted;
 
+    // The slices spanned by each node, stored similar to the adjacency, and
+    // the total intraslice weight of each slice. These are empty if the
+    // nodes are not divided into slices.
+    vector<NodeSlice> _node_slices;
+    vector<size_t> _node_slices_offset;
+    vector<double> _slice_total_weight;
+
     int _correct_self_loops;
     double _density;
 
-    void init_admin();
+    static std::atomic<size_t> _n_threads;
+
+    void init_graph(igraph_t* graph);
+    void init_admin(int self_weights = false);
+    void init_neighbours(double* total_weight = NULL);
+    void set_density();
     void init_weighted_neigh_selection();
     void set_defaults();
     void set_default_edge_weight();
     void set_default_node_size();
-    void set_self_weights();
+    void set_self_weight(size_t v);
+    void detach_igraph();
+    void store_merged_weight(double weight);
+    void collapse_slices(MutableVertexPartition* partition, Graph* G);
+    void init_pointers();
+    void store_edge_weights();
+    void drop_unit_edge_weights();
+    void release_file();
+    int has_consistent_adjacency();
+
+};
+
+// Builds a Graph from a stream of edges, without a copy of all edges in an
+// igraph graph. The edges need to be streamed twice: the first pass only
+// counts the edges of each node (count_edges) and the second pass stores them
+// (add_edges). Parallel edges are merged on the fly by summing their weights,
+// so that each node has at most a single self loop, as expected by
+// Graph::set_self_weight. Besides the graph itself, the streamed edges are
+// kept in memory only once, as 16 bytes per edge.
+class GraphBuilder
+{
+  public:
+    // The graph has at least n nodes, but more nodes are added if the edges
+    // refer to them.
+    GraphBuilder(size_t n, int is_directed, int correct_self_loops);
+
+    // First pass over the edges from[i] -> to[i].
+    void count_edges(size_t const* from, size_t const* to, size_t m);
+
+    // Second pass over exactly the same edges. If weights is NULL, all edges
+    // have a weight of 1.0.
+    void add_edges(size_t const* from, size_t const* to, double const* weights, size_t m);
+
+    // Perform both passes over a text file, with one edge "from to [weight]"
+    // per line. Empty lines and lines starting with # or % are ignored.
+    void read_file(char const* filename);
+
+    // Create the graph from the streamed edges. The edges are numbered by
+    // their endpoints, and for undirected graphs _edge_from[e] is at least
+    // _edge_to[e]. The builder cannot be used afterwards.
+    Graph* get_graph();
+    Graph* get_graph(vector<size_t> const& node_sizes);
+
+    inline size_t vcount() { return this->_n; };
+
+  private:
+    size_t _n;
+    size_t _m;
+    int _is_directed;
+    int _is_weighted;
+    int _correct_self_loops;
+
+    // Counting edges (0), adding edges (1) or done (2)
+    int _pass;
+
+    // During the first pass the number of edges of each node, afterwards the
+    // start of the edges of each node in _edges, and the position at which to
+    // store the next edge of each node.
+    vector<size_t> _offset;
+    vector<size_t> _pos;
+
+    // The other endpoint and weight of each edge, grouped by node.
+    vector< pair<size_t, double> > _edges;
 
+    void start_filling();
+    void read_file_pass(char const* filename, int fill);
 };
 
 // We need this ugly way to include the MutableVertexPartition
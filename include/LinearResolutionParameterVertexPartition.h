@@ -14,6 +14,16 @@ class LinearResolutionParameterVertexPartition : public ResolutionParameterVerte
     LinearResolutionParameterVertexPartition(Graph* graph);
     virtual ~LinearResolutionParameterVertexPartition();
 
+    // The quality is E - resolution_parameter*F, where E and F do not depend
+    // on the resolution parameter. By default these are determined from the
+    // quality for two resolution parameters, but derived classes may
+    // determine them in a single pass over the communities.
+    virtual void quality_terms(double& E, double& F);
+
+    // The qualities for all resolution parameters, using a single call to
+    // quality_terms.
+    virtual void qualities(vector<double> const& resolution_parameters, vector<double>& qualities);
+
   private:
 
 };
@@ -12,8 +12,11 @@ class ModularityVertexPartition : public MutableVertexPartition
     virtual ~ModularityVertexPartition();
     virtual ModularityVertexPartition* create(Graph* graph);
     virtual ModularityVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+    virtual ModularityVertexPartition* clone();
 
     virtual double diff_move(size_t v, size_t new_comm);
+    virtual void diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs);
+    virtual int has_local_diff_move() { return true; };
     virtual double quality();
 
   protected:
@@ -0,0 +1,67 @@
+#ifndef MULTISLICEVERTEXPARTITION_H
+#define MULTISLICEVERTEXPARTITION_H
+
+#include "LinearResolutionParameterVertexPartition.h"
+#include <unordered_map>
+
+// A partition of a graph whose nodes are divided into slices (see
+// Graph::set_slices), for example the time slices of a temporal network. The
+// null model is only evaluated within each slice, so that the edges that
+// couple the slices are only rewarded when they fall within a community,
+// without being part of any null model. This is the same quality as that of
+// a separate layer for each slice and an additional layer for the coupling
+// edges, but each node only has to be considered in a single graph.
+class MultisliceVertexPartition : public LinearResolutionParameterVertexPartition
+{
+  public:
+    MultisliceVertexPartition(Graph* graph, int null_model,
+          vector<size_t> const& membership, double resolution_parameter);
+    MultisliceVertexPartition(Graph* graph, int null_model,
+          vector<size_t> const& membership);
+    MultisliceVertexPartition(Graph* graph, int null_model,
+      double resolution_parameter);
+    MultisliceVertexPartition(Graph* graph, int null_model);
+    virtual ~MultisliceVertexPartition();
+    virtual MultisliceVertexPartition* create(Graph* graph);
+    virtual MultisliceVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+    virtual MultisliceVertexPartition* clone();
+
+    virtual double diff_move(size_t v, size_t new_comm);
+    virtual void diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs);
+    virtual double quality(double resolution_parameter);
+
+    inline int null_model() { return this->_null_model; };
+
+    static const int CONFIGURATION = 1; // Configuration null model within each slice (see RBConfigurationVertexPartition).
+    static const int CPM = 2;           // Constant null model within each slice (see CPMVertexPartition).
+
+  protected:
+    virtual void admin_initialised();
+    virtual void node_moved(size_t v, size_t old_comm, size_t new_comm);
+
+  private:
+    int _null_model;
+
+    // The strength and size of the part of a community that lies within a
+    // single slice, and the number of parts of nodes that it contains.
+    struct SliceTotals
+    {
+      double weight_out;
+      double weight_in;
+      size_t size;
+      size_t n_parts;
+    };
+
+    // The totals of all parts of communities that are not empty, keyed by
+    // comm*n_slices + slice, so that the administration is proportional to
+    // the number of such parts, rather than to the number of communities
+    // times the number of slices. These are only read when calculating
+    // differences, so that this may be done concurrently.
+    std::unordered_map<size_t, SliceTotals> _slice_totals;
+
+    void check_null_model();
+    SliceTotals slice_totals(size_t comm, size_t slice) const;
+    double null_model_diff(size_t v, size_t old_comm, size_t new_comm) const;
+};
+
+#endif // MULTISLICEVERTEXPARTITION_H
@@ -16,6 +16,20 @@ using std::pair;
 using std::sort;
 using std::reverse;
 
+/****************************************************************************
+  Caches the weight from and to the neighbouring communities of a single node
+  (see MutableVertexPartition::cache_neigh_communities). All modes are cached
+  at once for current_node. For undirected graphs the weight from and to a
+  community is the same, so that only the weight for IGRAPH_ALL is kept.
+*****************************************************************************/
+struct NeighbourCommunityCache
+{
+  size_t current_node;
+  vector<double> weight_from_community; vector<size_t> neigh_comms_from;
+  vector<double> weight_to_community;   vector<size_t> neigh_comms_to;
+  vector<double> weight_all_community;  vector<size_t> neigh_comms_all;
+};
+
 /****************************************************************************
 Contains a partition of graph.
 
@@ -50,6 +64,10 @@ class MutableVertexPartition
     MutableVertexPartition(Graph* graph);
     virtual MutableVertexPartition* create(Graph* graph);
     virtual MutableVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+    // A copy of this partition on the same graph, which copies the
+    // administration instead of recalculating it, as create would. The copy
+    // does not delete the graph, which should outlive the copy.
+    virtual MutableVertexPartition* clone();
 
     virtual ~MutableVertexPartition();
 
@@ -58,6 +76,8 @@ class MutableVertexPartition
 
     size_t csize(size_t comm);
     size_t cnodes(size_t comm);
+    // The nodes of community comm in increasing order, which takes time
+    // proportional to the number of nodes of comm (see _comm_first).
     vector<size_t> get_community(size_t comm);
     vector< vector<size_t> > get_communities();
     size_t n_communities();
@@ -71,6 +91,15 @@ class MutableVertexPartition
     {
       throw Exception("Function not implemented. This should be implented in a derived class, since the base class does not implement a specific method.");
     };
+    // Calculate diff_move(v, comms[i]) for all communities in comms at once,
+    // storing the result in diffs[i]. Derived classes may override this to
+    // avoid recalculating the terms that only depend on v for every community.
+    virtual void diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs);
+    // Whether diff_move only depends on the graph and on the two communities
+    // involved, and not on the rest of the partition. Such a partition gives
+    // the same differences on the subgraph of a community (see
+    // Graph::subgraph), which allows refining communities independently.
+    virtual int has_local_diff_move() { return false; };
 
     inline Graph* get_graph() { return this->graph; };
 
@@ -87,6 +116,23 @@ class MutableVertexPartition
 
     void from_partition(MutableVertexPartition* partition);
 
+    // The membership and administration of the partition as a compact binary
+    // state, which restore reads back without recalculating the
+    // administration, so that long optimisations can be resumed. A state can
+    // only be restored on a partition of the same graph.
+    string checkpoint();
+    void restore(string const& state);
+
+    // Use this partition for another graph, with each node in its own
+    // community or with the given membership. The memory of the
+    // administration is reused, which avoids creating a new partition for
+    // every aggregation level.
+    void reset(Graph* graph);
+    void reset(Graph* graph, vector<size_t> const& membership);
+
+    // Update the administration after changing the edges of the graph
+    void apply_edge_changes(EdgeChanges const& changes);
+
     inline double total_weight_in_comm(size_t comm) { return this->_total_weight_in_comm[comm]; };
     inline double total_weight_from_comm(size_t comm) { return this->_total_weight_from_comm[comm]; };
     inline double total_weight_to_comm(size_t comm) { return this->_total_weight_to_comm[comm]; };
@@ -99,14 +145,62 @@ class MutableVertexPartition
     vector<size_t> const& get_neigh_comms(size_t v, igraph_neimode_t);
     set<size_t> get_neigh_comms(size_t v, igraph_neimode_t mode, vector<size_t> const& constrained_membership);
 
+    // The weight from and to neighbouring communities is cached, which is not
+    // safe when multiple threads call diff_move, weight_to_comm, weight_from_comm
+    // or get_neigh_comms concurrently. For that purpose, set_n_caches creates a
+    // separate cache for each thread, after which each thread should call
+    // set_thread_cache with its own index (the calling thread uses cache 0 by
+    // default). This is only safe as long as the partition is not changed.
+    // Using a partition from a thread whose index has no cache throws an
+    // Exception.
+    virtual void set_n_caches(size_t n_caches);
+    static void set_thread_cache(size_t idx);
+
+    // The storage of the membership vector does not change while it is
+    // exported, for example by a view on it in Python: the membership is only
+    // changed in place, and reset fails. Each export_membership should be
+    // followed by a release_membership once the export ends.
+    inline void export_membership() { this->_membership_exports++; };
+    inline void release_membership() { this->_membership_exports--; };
+
     // By delegating the responsibility for deleting the graph to the partition,
     // we no longer have to worry about deleting this graph.
     int destructor_delete_graph;
 
   protected:
 
+    // Copy the administration of partition (see clone).
+    MutableVertexPartition(MutableVertexPartition const& partition);
+
     void init_admin();
 
+    // Called by reset after changing the graph, so that derived classes can
+    // update any administration that depends on the graph.
+    virtual void graph_changed() {};
+
+    // Called at the end of init_admin and move_node, so that derived classes
+    // can keep additional administration up to date. The constructors of
+    // this class call init_admin before the derived class is constructed, so
+    // a derived class should also initialise its administration in its own
+    // constructors.
+    virtual void admin_initialised() {};
+    virtual void node_moved(size_t v, size_t old_comm, size_t new_comm) {};
+
+    // The cached weight to and from all communities for node v, indexed by
+    // community, which only contains communities smaller than the number of
+    // nodes. Only valid until the partition is changed.
+    vector<double> const& weights_to_comms(size_t v);
+    vector<double> const& weights_from_comms(size_t v);
+
+    // Index of the cache used by the calling thread out of n_caches caches,
+    // see set_n_caches.
+    static inline size_t thread_cache(size_t n_caches)
+    {
+      if (_thread_cache >= n_caches)
+        throw Exception("Partition has no cache for the calling thread (see set_n_caches).");
+      return _thread_cache;
+    };
+
     vector<size_t> _membership; // Membership vector, i.e. \sigma_i = c means that node i is in community c
 
     Graph* graph;
@@ -136,11 +230,27 @@ class MutableVertexPartition
 
     vector<size_t> _empty_communities;
 
-    void cache_neigh_communities(size_t v, igraph_neimode_t mode);
-
-    size_t _current_node_cache_community_from; vector<double> _cached_weight_from_community; vector<size_t> _cached_neigh_comms_from;
-    size_t _current_node_cache_community_to;   vector<double> _cached_weight_to_community;   vector<size_t> _cached_neigh_comms_to;
-    size_t _current_node_cache_community_all;  vector<double> _cached_weight_all_community;  vector<size_t> _cached_neigh_comms_all;
+    // Number of exports of the membership, see export_membership.
+    size_t _membership_exports;
+
+    // Index of the nodes of each community as a doubly linked list, which
+    // starts at _comm_first[comm]. The next and previous node of v are
+    // _node_next[v] and _node_prev[v], and the end of a list is indicated by
+    // the number of nodes. The lists are updated in move_node, so that the
+    // nodes of a community can be listed without considering all nodes.
+    vector<size_t> _comm_first;
+    vector<size_t> _node_next;
+    vector<size_t> _node_prev;
+    void link_node(size_t v, size_t comm);
+    void unlink_node(size_t v, size_t comm);
+    void link_all_nodes();
+
+    void cache_neigh_communities(size_t v);
+
+    vector<NeighbourCommunityCache> _caches;
+    static thread_local size_t _thread_cache;
+    inline NeighbourCommunityCache& cache() { return this->_caches[thread_cache(this->_caches.size())]; };
+    void init_caches();
 
     void clean_mem();
     void init_graph_admin();
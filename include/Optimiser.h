@@ -2,14 +2,237 @@
 #define OPTIMISER_H
 #include "GraphHelper.h"
 #include "MutableVertexPartition.h"
+#include "ResolutionParameterVertexPartition.h"
 #include <set>
 #include <map>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
 
 #include <iostream>
 using std::cerr;
 using std::endl;
 using std::set;
 using std::map;
+using std::pair;
+
+/****************************************************************************
+Counters of the work done while moving or merging nodes (see Optimiser::stats).
+****************************************************************************/
+struct MoveStats
+{
+  size_t node_visits;      // Number of times a node was considered for moving
+  size_t moves;            // Number of nodes that were moved
+  size_t diff_moves;       // Number of diff_move evaluations, over all layers
+  size_t queue_insertions; // Number of nodes added to the queue again after
+                           // moving a neighbour
+  size_t skipped_insertions; // Number of nodes not added to the queue again,
+                             // because they were frozen (see NodeQueue)
+  size_t candidates;       // Total number of candidate communities
+  size_t max_candidates;   // Largest number of candidates for a single node
+  double improvement;      // Improvement in quality
+
+  MoveStats()
+  {
+    this->node_visits = 0;
+    this->moves = 0;
+    this->diff_moves = 0;
+    this->queue_insertions = 0;
+    this->skipped_insertions = 0;
+    this->candidates = 0;
+    this->max_candidates = 0;
+    this->improvement = 0.0;
+  };
+
+  inline void add(MoveStats const& other)
+  {
+    this->node_visits += other.node_visits;
+    this->moves += other.moves;
+    this->diff_moves += other.diff_moves;
+    this->queue_insertions += other.queue_insertions;
+    this->skipped_insertions += other.skipped_insertions;
+    this->candidates += other.candidates;
+    this->max_candidates = std::max(this->max_candidates, other.max_candidates);
+    this->improvement += other.improvement;
+  };
+};
+
+/****************************************************************************
+Statistics of a single aggregation level of Optimiser::optimise_partition.
+The times are wall times in seconds. The number of edges is summed over all
+layers, and the quality gain of the level is move.improvement.
+****************************************************************************/
+struct LevelStats
+{
+  size_t iteration;     // Iteration of optimise_partition
+  size_t n_nodes;       // Number of (aggregate) nodes at this level
+  size_t n_edges;       // Number of edges at this level
+  double move_time;     // Moving nodes
+  double refine_time;   // Refining the partition
+  double collapse_time; // The remainder: collapsing the graph and creating
+                        // its partition
+  MoveStats move;
+  MoveStats refine;
+};
+
+/****************************************************************************
+Progress and cancellation of Optimiser::optimise_partition, which may be
+shared with another thread while the optimisation runs (see
+Optimiser::set_control). The optimiser updates the progress, which can be read
+at any time, and stops as soon as possible after cancel() is called, keeping
+the partitions found so far, as when it runs out of time.
+****************************************************************************/
+struct OptimiserControl
+{
+  std::atomic<int> cancelled;         // Whether the optimisation should stop
+  std::atomic<size_t> iteration;      // Current iteration of optimise_partition
+  std::atomic<size_t> level;          // Current aggregation level within the iteration
+  std::atomic<size_t> nodes_processed; // Approximate number of nodes considered
+                                       // for moving so far, over all levels
+  std::atomic<double> quality;        // Quality after moving the nodes of the
+                                      // last level that was finished
+
+  OptimiserControl()
+  {
+    this->cancelled = false;
+    this->iteration = 0;
+    this->level = 0;
+    this->nodes_processed = 0;
+    this->quality = 0.0;
+  };
+
+  inline void cancel() { this->cancelled = true; };
+};
+
+/****************************************************************************
+Scratch space for collecting the candidate communities of a node.
+
+This replaces a set of communities, without allocating memory for every
+node that is considered. A community is only added once, which is tracked
+using a marker per community, and clear() only resets the markers of the
+communities that were actually added.
+****************************************************************************/
+class CandidateCommunities
+{
+  public:
+    inline void insert(size_t comm)
+    {
+      if (comm >= this->_is_candidate.size())
+        this->_is_candidate.resize(comm + 1, false);
+      if (!this->_is_candidate[comm])
+      {
+        this->_is_candidate[comm] = true;
+        this->_comms.push_back(comm);
+      }
+    };
+
+    inline void insert(vector<size_t>::const_iterator begin, vector<size_t>::const_iterator end)
+    {
+      for (vector<size_t>::const_iterator it = begin; it != end; it++)
+        this->insert(*it);
+    };
+
+    // Sort the candidates, so that they are considered in increasing order
+    // and ties are always broken in the same way.
+    inline void sort() { std::sort(this->_comms.begin(), this->_comms.end()); };
+
+    inline void clear()
+    {
+      for (vector<size_t>::const_iterator it = this->_comms.begin(); it != this->_comms.end(); it++)
+        this->_is_candidate[*it] = false;
+      this->_comms.clear();
+    };
+
+    inline size_t size() const { return this->_comms.size(); };
+    inline size_t operator[](size_t i) const { return this->_comms[i]; };
+    inline vector<size_t> const& comms() const { return this->_comms; };
+    inline vector<size_t>::const_iterator begin() const { return this->_comms.begin(); };
+    inline vector<size_t>::const_iterator end() const { return this->_comms.end(); };
+
+    // Improvement of moving a node to each of the candidates (see
+    // Optimiser::diff_move_all), and the scratch space for a single layer.
+    vector<double> improv;
+    vector<double> layer_diff;
+
+    // Work done by the thread using these candidates, which is collected by
+    // Optimiser::collect_work.
+    MoveStats work;
+
+  private:
+    vector<char> _is_candidate;
+    vector<size_t> _comms;
+};
+
+/****************************************************************************
+Queue of the nodes that are still to be visited while moving nodes, in one
+of the orders of Optimiser::visit_order.
+
+Each node is queued at most once: push() ignores nodes that are already in
+the queue. The order in which pop() returns the nodes depends on the order:
+  FIFO_ORDER    -- In the order in which they were pushed.
+  GAIN_ORDER    -- Largest gain first, where the gain is the improvement of
+                   the move of the neighbour that pushed the node, and in the
+                   order in which they were pushed for equal gains.
+  DEGREE_ORDER  -- Highest degree first, where degrees are bucketed by
+                   powers of two, and in the order in which they were pushed
+                   within a bucket. High degree nodes thus settle first, and
+                   their many neighbours follow, instead of high degree nodes
+                   being visited again after each move of a neighbour.
+  BOUNDED_ORDER -- In the order in which they were pushed, but a node is
+                   frozen after max_unproductive_visits visits in which it
+                   did not move, after which it is no longer pushed.
+****************************************************************************/
+class NodeQueue
+{
+  public:
+    NodeQueue(int order, Graph* graph, size_t max_unproductive_visits);
+
+    // Push node v, which was pushed because of a move with the given gain.
+    // Returns whether v was actually added.
+    int push(size_t v, double gain);
+    size_t pop();
+    // Register that v was visited without moving it.
+    void unproductive_visit(size_t v);
+
+    inline int empty() const { return this->_size == 0; };
+    inline size_t size() const { return this->_size; };
+    inline int is_frozen(size_t v) const
+    {
+      return this->_max_unproductive_visits > 0 &&
+             this->_unproductive_visits[v] >= this->_max_unproductive_visits;
+    };
+
+  private:
+    int _order;
+    Graph* _graph;
+    size_t _max_unproductive_visits; // 0 if nodes are never frozen
+    size_t _size;
+    vector<char> _is_queued;
+    vector<size_t> _unproductive_visits;
+
+    // A single bucket for FIFO_ORDER and BOUNDED_ORDER, one bucket per
+    // degree class for DEGREE_ORDER, of which all above _first_bucket are
+    // empty.
+    vector< queue<size_t> > _buckets;
+    size_t _first_bucket;
+
+    struct GainEntry
+    {
+      double gain;
+      size_t seq;
+      size_t node;
+      // Lower priority, so that the largest gain and then the earliest push
+      // is on top of the heap.
+      inline bool operator<(GainEntry const& other) const
+      {
+        if (this->gain != other.gain)
+          return this->gain < other.gain;
+        return this->seq > other.seq;
+      };
+    };
+    std::priority_queue<GainEntry> _gain_queue;
+    size_t _seq;
+};
 
 /****************************************************************************
 Class for doing community detection using the Leiden algorithm.
@@ -25,6 +248,7 @@ class Optimiser
   public:
     Optimiser();
     double optimise_partition(MutableVertexPartition* partition);
+    double optimise_partition(MutableVertexPartition* partition, int n_iterations);
     template <class T> T* find_partition(Graph* graph);
     template <class T> T* find_partition(Graph* graph, double resolution_parameter);
 
@@ -34,10 +258,33 @@ class Optimiser
     // layer weights this may be necessary.
     double optimise_partition(vector<MutableVertexPartition*> partitions, vector<double> layer_weights);
 
+    // Iterate optimise_partition until n_iterations iterations are done, until
+    // the relative improvement is no more than tolerance, or until max_time
+    // seconds have passed, whichever comes first.
+    double optimise_partition(MutableVertexPartition* partition, int n_iterations, double max_time, double tolerance);
+    double optimise_partition(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int n_iterations, double max_time, double tolerance);
+
+    // Optimise independent copies of a partition concurrently on the same graph
+    // and keep the best one, optionally also providing all resulting memberships.
+    double optimise_partition_multistart(MutableVertexPartition* partition, size_t n_starts, int n_iterations);
+    double optimise_partition_multistart(MutableVertexPartition* partition, size_t n_starts, int n_iterations, vector< vector<size_t> >& memberships);
+
+    // Construct a resolution profile by bisectioning on the resolution parameter,
+    // optimising independent resolution values concurrently on the same graph.
+    vector<ResolutionParameterVertexPartition*> resolution_profile(
+        ResolutionParameterVertexPartition* partition,
+        double resolution_min, double resolution_max,
+        double min_diff_bisect_value, double min_diff_resolution,
+        int linear_bisection, int number_iterations);
+
     double move_nodes(MutableVertexPartition* partition);
     double move_nodes(MutableVertexPartition* partition, int consider_comms);
     double move_nodes(vector<MutableVertexPartition*> partitions, vector<double> layer_weights);
     double move_nodes(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, int consider_empty_community);
+    // Only consider the given nodes initially (e.g. the nodes affected by
+    // changing the edges of the graph, see Graph::affected_nodes).
+    double move_nodes(MutableVertexPartition* partition, vector<size_t> const& nodes);
+    double move_nodes(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, int consider_empty_community, vector<size_t> const& nodes);
 
     double merge_nodes(MutableVertexPartition* partition);
     double merge_nodes(MutableVertexPartition* partition, int consider_comms);
@@ -56,6 +303,34 @@ class Optimiser
 
     inline void set_rng_seed(size_t seed) { igraph_rng_seed(&rng, seed); };
 
+    // Statistics of each aggregation level of the last call to
+    // optimise_partition. The counters are always collected, since their
+    // cost is negligible compared to diff_move.
+    inline vector<LevelStats> const& stats() const { return this->_stats; };
+
+    // The aggregation hierarchy of the last iteration of optimise_partition,
+    // if record_hierarchy is set. Level k maps the nodes of the graph of
+    // aggregation level k to the nodes of the graph of level k + 1, where
+    // level 0 is the graph itself, and the last level maps the nodes of the
+    // last graph to the communities of the partitions. Hence, composing the
+    // first k + 1 levels gives the (refined) communities that are aggregated
+    // at level k, and composing all levels gives the membership.
+    inline vector< vector<uint32_t> > const& hierarchy() const { return this->_hierarchy; };
+
+    // Whether the last call to optimise_partition stopped because it ran out
+    // of time.
+    inline int timed_out() const { return this->_timed_out; };
+
+    // Report the progress of optimise_partition to control, and stop once it
+    // is cancelled (see OptimiserControl). The control is not owned by the
+    // optimiser, and should remain valid while optimising; NULL removes it.
+    inline void set_control(OptimiserControl* control) { this->_control = control; this->_cancelled = false; };
+    inline OptimiserControl* control() const { return this->_control; };
+
+    // Whether the last call to optimise_partition stopped because it was
+    // cancelled.
+    inline int cancelled() const { return this->_cancelled; };
+
     virtual ~Optimiser();
 
     int consider_comms;  // Indicates how communities will be considered for improvement. Should be one of the parameters below
@@ -64,6 +339,12 @@ class Optimiser
     int optimise_routine; // What routine to use for optimisation
     int refine_routine; // What routine to use for optimisation
     int consider_empty_community; // Determine whether to consider moving nodes to an empty community
+    int n_threads; // Number of threads to use for moving nodes (1 means moving nodes serially)
+    int max_levels; // Maximum number of aggregation levels in optimise_partition (0 means no maximum)
+    int visit_order; // Order in which nodes are visited when moving nodes (see NodeQueue). Should be one of the orders below
+    size_t max_unproductive_visits; // Number of visits without moving after which a node is frozen (only for NodeQueue::BOUNDED_ORDER)
+    int relabel_nodes; // Order in which nodes are relabelled for locality before optimising in optimise_partition. Should be one of the orders below
+    int record_hierarchy; // Record the aggregation hierarchy in optimise_partition (see hierarchy)
 
     static const int ALL_COMMS = 1;       // Consider all communities for improvement.
     static const int ALL_NEIGH_COMMS = 2; // Consider all neighbour communities for improvement.
@@ -73,11 +354,107 @@ class Optimiser
     static const int MOVE_NODES = 10;  // Use move node routine
     static const int MERGE_NODES = 11; // Use merge node routine
 
+    static const int FIFO_ORDER = 20;    // Visit nodes in the order in which they were queued.
+    static const int GAIN_ORDER = 21;    // Visit nodes queued by the largest improvement first.
+    static const int DEGREE_ORDER = 22;  // Visit nodes of the highest degree first.
+    static const int BOUNDED_ORDER = 23; // Freeze nodes after a number of unproductive visits.
+
+    static const int NO_RELABEL = 30;     // Keep the original labels of the nodes.
+    static const int RCM_RELABEL = 31;    // Relabel nodes in reverse Cuthill-McKee order (see Graph::rcm_order).
+    static const int DEGREE_RELABEL = 32; // Relabel nodes in order of decreasing degree (see Graph::degree_order).
+
   protected:
 
   private:
     void print_settings();
 
+    double move_nodes_parallel(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, int consider_empty_community, vector<size_t> const& nodes);
+    double refine_parallel(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, MutableVertexPartition* constrained_partition);
+
+    void diff_move_all(vector<MutableVertexPartition*> const& partitions, vector<double> const& layer_weights, size_t v, CandidateCommunities& comms);
+
+    double optimise_partition_multistart(MutableVertexPartition* partition, size_t n_starts, int n_iterations, vector< vector<size_t> >* memberships);
+
+    void copy_settings(Optimiser& optimiser);
+
+    vector<MutableVertexPartition*> relabelled_partitions(vector<MutableVertexPartition*> const& partitions, vector<size_t>& order);
+    void renumber_by_first_node(vector<MutableVertexPartition*> const& partitions);
+
+    void optimise_resolutions(ResolutionParameterVertexPartition* partition,
+                              vector<double> const& resolutions,
+                              vector<MutableVertexPartition*> const& start,
+                              int number_iterations,
+                              vector<ResolutionParameterVertexPartition*>& found);
+
+    // Return the work done since the last call and reset the counters.
+    MoveStats collect_work();
+
+    // Append the aggregate node of each node of an aggregation level to the
+    // hierarchy, which is its community in the given partition.
+    void record_level(MutableVertexPartition* partition);
+
+    // Graphs and partitions of aggregation levels that are no longer used,
+    // which are reused by later levels (see level_graph and level_partition).
+    // There is a separate pool of partitions for each layer, since their type
+    // and parameters should be those of the partition of the layer.
+    vector<Graph*> _graph_pool;
+    vector< vector<MutableVertexPartition*> > _partition_pool;
+    Graph* level_graph(Graph* graph, MutableVertexPartition* partition);
+    MutableVertexPartition* level_partition(size_t layer, MutableVertexPartition* partition, Graph* graph, vector<size_t> const* membership);
+    void clear_partition_pool();
+
+    // Whether the deadline of optimise_partition has passed, or whether it
+    // was cancelled. Within the loops over nodes we use check_deadline, which
+    // only reads the clock and the control every 64 nodes, and then also
+    // counts the nodes that were processed.
+    inline int past_deadline()
+    {
+      if (this->_has_deadline && !this->_timed_out)
+        this->_timed_out = (std::chrono::steady_clock::now() >= this->_deadline);
+      if (this->_control != NULL && !this->_cancelled)
+        this->_cancelled = this->_control->cancelled.load(std::memory_order_relaxed);
+      return (this->_has_deadline && this->_timed_out) || this->_cancelled;
+    };
+    inline int check_deadline()
+    {
+      if (!this->_has_deadline && this->_control == NULL)
+        return false;
+      if ((this->_has_deadline && this->_timed_out) || this->_cancelled)
+        return true;
+      if ((++this->_deadline_checks % 64) == 0)
+      {
+        if (this->_control != NULL)
+          this->_control->nodes_processed.fetch_add(64, std::memory_order_relaxed);
+        return this->past_deadline();
+      }
+      return false;
+    };
+    void report_progress(vector<MutableVertexPartition*> const& partitions, vector<double> const& layer_weights, size_t level);
+
+    // Candidate communities for each thread, reused for all nodes
+    vector<CandidateCommunities> _candidates;
+
+    // Work done on the calling thread, and the statistics of optimise_partition
+    MoveStats _work;
+    vector<LevelStats> _stats;
+    vector< vector<uint32_t> > _hierarchy;
+
+    // The deadline of optimise_partition, if any
+    int _has_deadline;
+    int _timed_out;
+    size_t _deadline_checks;
+    std::chrono::steady_clock::time_point _deadline;
+
+    // The control of optimise_partition, if any
+    OptimiserControl* _control;
+    int _cancelled;
+
+    // Let an optimiser moving nodes on behalf of this one stop at the same
+    // deadline, and when we are cancelled.
+    void copy_deadline(Optimiser& optimiser);
+    // Neighbour communities of a node (possibly with duplicates) for RAND_NEIGH_COMM
+    vector<size_t> _neigh_comms_incl_dupes;
+
     igraph_rng_t rng;
 };
 
@@ -26,6 +26,11 @@ class ResolutionParameterVertexPartition : public MutableVertexPartition
       throw Exception("Function not implemented. This should be implented in a derived class, since the base class does not implement a specific method.");
     };
 
+    // The quality for each of the resolution parameters, stored in
+    // qualities[i]. Derived classes may override this to determine the
+    // qualities at once.
+    virtual void qualities(vector<double> const& resolution_parameters, vector<double>& qualities);
+
   private:
 
 };
@@ -12,11 +12,31 @@ class SignificanceVertexPartition : public MutableVertexPartition
     virtual ~SignificanceVertexPartition();
     virtual SignificanceVertexPartition* create(Graph* graph);
     virtual SignificanceVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+    virtual SignificanceVertexPartition* clone();
 
     virtual double diff_move(size_t v, size_t new_comm);
+    virtual void diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs);
     virtual double quality();
+
+    virtual void set_n_caches(size_t n_caches);
   protected:
+    virtual void graph_changed();
   private:
+    // Memoized N_c KLL(p_c, p) of each community c, together with the size
+    // and the internal weight of c for which it was calculated, so that it is
+    // only recalculated after c has changed. All memoized values are for the
+    // given density p of the graph. There is one memo per cache.
+    struct CommunityKLL
+    {
+      double density;
+      vector<size_t> csize;
+      vector<double> weight_in;
+      vector<double> NKLL;
+    };
+    vector<CommunityKLL> _comm_kll;
+
+    void init_comm_kll(size_t n_caches);
+    double comm_NKLL(size_t comm);
 };
 
 #endif // SIGNIFICANCEVERTEXPARTITION_H
@@ -15,11 +15,30 @@ class SurpriseVertexPartition: public MutableVertexPartition
     virtual ~SurpriseVertexPartition();
     virtual SurpriseVertexPartition* create(Graph* graph);
     virtual SurpriseVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+    virtual SurpriseVertexPartition* clone();
 
     virtual double diff_move(size_t v, size_t new_comm);
+    virtual void diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs);
     virtual double quality();
+
+    virtual void set_n_caches(size_t n_caches);
   protected:
   private:
+    // Memoized KLL(q, s) of the current partition, together with the internal
+    // weight, the possible internal edges and the total weight for which it
+    // was calculated, so that it is only recalculated after the partition (or
+    // the graph) has changed. There is one memo per cache.
+    struct PartitionKLL
+    {
+      double m;
+      double mc;
+      size_t nc2;
+      double KLL;
+    };
+    vector<PartitionKLL> _partition_kll;
+
+    void init_partition_kll(size_t n_caches);
+    double partition_KLL(double mc, size_t nc2, double m, size_t n2);
 };
 
 #endif // SURPRISEVERTEXPARTITION_H
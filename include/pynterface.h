@@ -32,8 +32,17 @@ extern "C"
       {"_new_SignificanceVertexPartition",                          (PyCFunction)_new_SignificanceVertexPartition,                          METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_SurpriseVertexPartition",                              (PyCFunction)_new_SurpriseVertexPartition,                              METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_CPMVertexPartition",                                   (PyCFunction)_new_CPMVertexPartition,                                   METH_VARARGS | METH_KEYWORDS, ""},
+      {"_new_MultisliceVertexPartition",                            (PyCFunction)_new_MultisliceVertexPartition,                            METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_RBERVertexPartition",                                  (PyCFunction)_new_RBERVertexPartition,                                  METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_RBConfigurationVertexPartition",                       (PyCFunction)_new_RBConfigurationVertexPartition,                       METH_VARARGS | METH_KEYWORDS, ""},
+      {"_new_VertexPartition_from_file",                            (PyCFunction)_new_VertexPartition_from_file,                            METH_VARARGS | METH_KEYWORDS, ""},
+      {"_new_VertexPartition_from_builder",                         (PyCFunction)_new_VertexPartition_from_builder,                         METH_VARARGS | METH_KEYWORDS, ""},
+      {"_new_GraphBuilder",                                         (PyCFunction)_new_GraphBuilder,                                         METH_VARARGS | METH_KEYWORDS, ""},
+      {"_GraphBuilder_count_edges",                                 (PyCFunction)_GraphBuilder_count_edges,                                 METH_VARARGS | METH_KEYWORDS, ""},
+      {"_GraphBuilder_add_edges",                                   (PyCFunction)_GraphBuilder_add_edges,                                   METH_VARARGS | METH_KEYWORDS, ""},
+      {"_GraphBuilder_read_file",                                   (PyCFunction)_GraphBuilder_read_file,                                   METH_VARARGS | METH_KEYWORDS, ""},
+      {"_save_graph",                                               (PyCFunction)_save_graph,                                               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_set_graph_n_threads",                                      (PyCFunction)_set_graph_n_threads,                                      METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_MutableVertexPartition_diff_move",                         (PyCFunction)_MutableVertexPartition_diff_move,                         METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_move_node",                         (PyCFunction)_MutableVertexPartition_move_node,                         METH_VARARGS | METH_KEYWORDS, ""},
@@ -51,19 +60,31 @@ extern "C"
       {"_MutableVertexPartition_weight_to_comm",                    (PyCFunction)_MutableVertexPartition_weight_to_comm,                    METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_weight_from_comm",                  (PyCFunction)_MutableVertexPartition_weight_from_comm,                  METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_get_membership",                    (PyCFunction)_MutableVertexPartition_get_membership,                    METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_get_membership_view",               (PyCFunction)_MutableVertexPartition_get_membership_view,               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_get_community",                     (PyCFunction)_MutableVertexPartition_get_community,                     METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_set_membership",                    (PyCFunction)_MutableVertexPartition_set_membership,                    METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_clone",                             (PyCFunction)_MutableVertexPartition_clone,                             METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_checkpoint",                        (PyCFunction)_MutableVertexPartition_checkpoint,                        METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_restore",                           (PyCFunction)_MutableVertexPartition_restore,                           METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MultisliceVertexPartition_get_slices",                     (PyCFunction)_MultisliceVertexPartition_get_slices,                     METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_add_edges",                         (PyCFunction)_MutableVertexPartition_add_edges,                         METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_delete_edges",                      (PyCFunction)_MutableVertexPartition_delete_edges,                      METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_set_edge_weights",                  (PyCFunction)_MutableVertexPartition_set_edge_weights,                  METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_get_resolution",        (PyCFunction)_ResolutionParameterVertexPartition_get_resolution,        METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_set_resolution",        (PyCFunction)_ResolutionParameterVertexPartition_set_resolution,        METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_quality",               (PyCFunction)_ResolutionParameterVertexPartition_quality,               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_ResolutionParameterVertexPartition_qualities",             (PyCFunction)_ResolutionParameterVertexPartition_qualities,             METH_VARARGS | METH_KEYWORDS, ""},
 
 
       {"_new_Optimiser",                            (PyCFunction)_new_Optimiser,                            METH_NOARGS,                  ""},
       {"_Optimiser_optimise_partition",             (PyCFunction)_Optimiser_optimise_partition,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_optimise_partition_multiplex",   (PyCFunction)_Optimiser_optimise_partition_multiplex,   METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_optimise_partition_multistart",  (PyCFunction)_Optimiser_optimise_partition_multistart,  METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_move_nodes",                     (PyCFunction)_Optimiser_move_nodes,                     METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_move_nodes_constrained",         (PyCFunction)_Optimiser_move_nodes_constrained,         METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_merge_nodes",                    (PyCFunction)_Optimiser_merge_nodes,                    METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_merge_nodes_constrained",        (PyCFunction)_Optimiser_merge_nodes_constrained,        METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_resolution_profile",             (PyCFunction)_Optimiser_resolution_profile,             METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_set_consider_comms",             (PyCFunction)_Optimiser_set_consider_comms,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_refine_consider_comms",      (PyCFunction)_Optimiser_set_refine_consider_comms,      METH_VARARGS | METH_KEYWORDS, ""},
@@ -71,6 +92,12 @@ extern "C"
       {"_Optimiser_set_refine_routine",             (PyCFunction)_Optimiser_set_refine_routine,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_consider_empty_community",   (PyCFunction)_Optimiser_set_consider_empty_community,   METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_refine_partition",           (PyCFunction)_Optimiser_set_refine_partition,           METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_n_threads",                  (PyCFunction)_Optimiser_set_n_threads,                  METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_max_levels",                 (PyCFunction)_Optimiser_set_max_levels,                 METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_visit_order",                (PyCFunction)_Optimiser_set_visit_order,                METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_max_unproductive_visits",    (PyCFunction)_Optimiser_set_max_unproductive_visits,    METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_relabel_nodes",              (PyCFunction)_Optimiser_set_relabel_nodes,              METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_record_hierarchy",           (PyCFunction)_Optimiser_set_record_hierarchy,           METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_get_consider_comms",             (PyCFunction)_Optimiser_get_consider_comms,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_refine_consider_comms",      (PyCFunction)_Optimiser_get_refine_consider_comms,      METH_VARARGS | METH_KEYWORDS, ""},
@@ -78,9 +105,22 @@ extern "C"
       {"_Optimiser_get_refine_routine",             (PyCFunction)_Optimiser_get_refine_routine,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_consider_empty_community",   (PyCFunction)_Optimiser_get_consider_empty_community,   METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_refine_partition",           (PyCFunction)_Optimiser_get_refine_partition,           METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_n_threads",                  (PyCFunction)_Optimiser_get_n_threads,                  METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_max_levels",                 (PyCFunction)_Optimiser_get_max_levels,                 METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_visit_order",                (PyCFunction)_Optimiser_get_visit_order,                METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_max_unproductive_visits",    (PyCFunction)_Optimiser_get_max_unproductive_visits,    METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_relabel_nodes",              (PyCFunction)_Optimiser_get_relabel_nodes,              METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_record_hierarchy",           (PyCFunction)_Optimiser_get_record_hierarchy,           METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_timed_out",                  (PyCFunction)_Optimiser_get_timed_out,                  METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_stats",                      (PyCFunction)_Optimiser_get_stats,                      METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_hierarchy",                  (PyCFunction)_Optimiser_get_hierarchy,                  METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_set_rng_seed",                   (PyCFunction)_Optimiser_set_rng_seed,                   METH_VARARGS | METH_KEYWORDS, ""},
 
+      {"_new_OptimiserControl",                     (PyCFunction)_new_OptimiserControl,                     METH_NOARGS,                  ""},
+      {"_OptimiserControl_cancel",                  (PyCFunction)_OptimiserControl_cancel,                  METH_VARARGS | METH_KEYWORDS, ""},
+      {"_OptimiserControl_get_progress",            (PyCFunction)_OptimiserControl_get_progress,            METH_VARARGS | METH_KEYWORDS, ""},
+
       {NULL}
   };
 
@@ -145,8 +185,28 @@ extern "C"
       PyModule_AddIntConstant(module, "MOVE_NODES", Optimiser::MOVE_NODES);
       PyModule_AddIntConstant(module, "MERGE_NODES", Optimiser::MERGE_NODES);
 
+      PyModule_AddIntConstant(module, "FIFO_ORDER", Optimiser::FIFO_ORDER);
+      PyModule_AddIntConstant(module, "GAIN_ORDER", Optimiser::GAIN_ORDER);
+      PyModule_AddIntConstant(module, "DEGREE_ORDER", Optimiser::DEGREE_ORDER);
+      PyModule_AddIntConstant(module, "BOUNDED_ORDER", Optimiser::BOUNDED_ORDER);
+
+      PyModule_AddIntConstant(module, "NO_RELABEL", Optimiser::NO_RELABEL);
+      PyModule_AddIntConstant(module, "RCM_RELABEL", Optimiser::RCM_RELABEL);
+      PyModule_AddIntConstant(module, "DEGREE_RELABEL", Optimiser::DEGREE_RELABEL);
+
       if (module == NULL)
           INITERROR;
+
+  #if PY_MAJOR_VERSION >= 3
+      if (init_MembershipBuffer_type() < 0) {
+          Py_DECREF(module);
+          INITERROR;
+      }
+      if (init_HierarchyBuffer_type() < 0) {
+          Py_DECREF(module);
+          INITERROR;
+      }
+  #endif
       struct module_state *st = GETSTATE(module);
 
       st->error = PyErr_NewException("leidenalg.Error", NULL, NULL);
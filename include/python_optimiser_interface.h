@@ -26,6 +26,19 @@
 PyObject* capsule_Optimiser(Optimiser* optimiser);
 Optimiser* decapsule_Optimiser(PyObject* py_optimiser);
 void del_Optimiser(PyObject* py_optimiser);
+PyObject* capsule_OptimiserControl(OptimiserControl* control);
+OptimiserControl* decapsule_OptimiserControl(PyObject* py_control);
+void del_OptimiserControl(PyObject* py_control);
+
+// The aggregation hierarchy of an optimiser (see Optimiser::hierarchy)
+typedef vector< vector<uint32_t> > Hierarchy;
+PyObject* capsule_Hierarchy(Hierarchy* hierarchy);
+Hierarchy* decapsule_Hierarchy(PyObject* py_hierarchy);
+void del_Hierarchy(PyObject* py_hierarchy);
+
+#if PY_MAJOR_VERSION >= 3
+int init_HierarchyBuffer_type();
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -34,10 +47,16 @@ extern "C"
   PyObject* _new_Optimiser(PyObject *self, PyObject *args);
   PyObject* _Optimiser_optimise_partition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_optimise_partition_multiplex(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_optimise_partition_multistart(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_move_nodes(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_move_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_merge_nodes(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_merge_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_resolution_profile(PyObject *self, PyObject *args, PyObject *keywds);
+
+  PyObject* _new_OptimiserControl(PyObject *self, PyObject *args);
+  PyObject* _OptimiserControl_cancel(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _OptimiserControl_get_progress(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _Optimiser_set_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_refine_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
@@ -45,6 +64,12 @@ extern "C"
   PyObject* _Optimiser_set_refine_routine(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_consider_empty_community(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_refine_partition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_n_threads(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_max_levels(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_visit_order(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_max_unproductive_visits(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_relabel_nodes(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_record_hierarchy(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_rng_seed(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _Optimiser_get_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
@@ -53,6 +78,15 @@ extern "C"
   PyObject* _Optimiser_get_refine_routine(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_get_consider_empty_community(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_get_refine_partition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_n_threads(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_max_levels(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_visit_order(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_max_unproductive_visits(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_relabel_nodes(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_record_hierarchy(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_timed_out(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_stats(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_hierarchy(PyObject *self, PyObject *args, PyObject *keywds);
 
 #ifdef __cplusplus
 }
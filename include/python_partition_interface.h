@@ -14,9 +14,12 @@
 #include "RBConfigurationVertexPartition.h"
 #include "RBERVertexPartition.h"
 #include "CPMVertexPartition.h"
+#include "MultisliceVertexPartition.h"
 #include "Optimiser.h"
 
 #include <sstream>
+#include <cstring>
+#include <stdint.h>
 
 #ifdef DEBUG
 #include <iostream>
@@ -33,11 +36,58 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, int ch
 Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, PyObject* py_node_sizes);
 Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, PyObject* py_node_sizes, int check_positive_weight);
 
+bool read_indices_from_py(PyObject* py_obj, vector<size_t>& result, const char* negative_error, const char* type_error);
+void read_weights_from_py(PyObject* py_weights, vector<double>& weights, int check_positive_weight);
+void read_node_sizes_from_py(PyObject* py_node_sizes, vector<size_t>& node_sizes);
+
 PyObject* capsule_MutableVertexPartition(MutableVertexPartition* partition);
 MutableVertexPartition* decapsule_MutableVertexPartition(PyObject* py_partition);
 
 void del_MutableVertexPartition(PyObject *self);
 
+PyObject* capsule_GraphBuilder(GraphBuilder* builder);
+GraphBuilder* decapsule_GraphBuilder(PyObject* py_builder);
+void del_GraphBuilder(PyObject* py_builder);
+
+PyObject* apply_edge_changes_to_py(MutableVertexPartition* partition, EdgeChanges const& changes);
+
+/****************************************************************************
+  Call f() while the GIL is released, so f should not use any Python objects.
+  If f throws, a ValueError with error_prefix followed by the error message is
+  set and false is returned.
+****************************************************************************/
+template <class F> bool call_without_gil(F const& f, char const* error_prefix = "")
+{
+  int failed = false;
+  string error;
+  Py_BEGIN_ALLOW_THREADS
+  try
+  {
+    f();
+  }
+  catch (std::exception& e)
+  {
+    failed = true;
+    error = e.what();
+  }
+  catch (...)
+  {
+    failed = true;
+    error = "Unknown error.";
+  }
+  Py_END_ALLOW_THREADS
+  if (failed)
+  {
+    string s = error_prefix + error;
+    PyErr_SetString(PyExc_ValueError, s.c_str());
+  }
+  return !failed;
+}
+
+#if PY_MAJOR_VERSION >= 3
+int init_MembershipBuffer_type();
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -46,8 +96,19 @@ extern "C"
   PyObject* _new_SignificanceVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_SurpriseVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_CPMVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _new_MultisliceVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_RBERVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_RBConfigurationVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _new_VertexPartition_from_file(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _new_VertexPartition_from_builder(PyObject *self, PyObject *args, PyObject *keywds);
+
+  PyObject* _new_GraphBuilder(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _GraphBuilder_count_edges(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _GraphBuilder_add_edges(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _GraphBuilder_read_file(PyObject *self, PyObject *args, PyObject *keywds);
+
+  PyObject* _save_graph(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _set_graph_n_threads(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_diff_move(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_move_node(PyObject *self, PyObject *args, PyObject *keywds);
@@ -69,11 +130,23 @@ extern "C"
   PyObject* _MutableVertexPartition_weight_from_comm(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_get_membership(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_get_community(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_get_membership_view(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_set_membership(PyObject *self, PyObject *args, PyObject *keywds);
 
+  PyObject* _MutableVertexPartition_clone(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_checkpoint(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_restore(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MultisliceVertexPartition_get_slices(PyObject *self, PyObject *args, PyObject *keywds);
+
+  PyObject* _MutableVertexPartition_add_edges(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_delete_edges(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_set_edge_weights(PyObject *self, PyObject *args, PyObject *keywds);
+
   PyObject* _ResolutionParameterVertexPartition_get_resolution(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _ResolutionParameterVertexPartition_set_resolution(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _ResolutionParameterVertexPartition_quality(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _ResolutionParameterVertexPartition_qualities(PyObject *self, PyObject *args, PyObject *keywds);
 
 #ifdef __cplusplus
 }
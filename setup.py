@@ -337,6 +337,8 @@ class BuildConfiguration(object):
         self.use_pkgconfig = True
         self._has_pkgconfig = None
         self.wait = True
+        self.with_benchmark = False
+        self.define_macros = []
         
     @property
     def has_pkgconfig(self):
@@ -403,6 +405,10 @@ class BuildConfiguration(object):
                 # Run the original build_ext command
                 build_ext.run(self)
 
+                # Build the benchmark executable using the same configuration
+                if buildcfg.with_benchmark:
+                    buildcfg.build_benchmark(self, ext)
+
         return custom_build_ext
 
     def configure(self, ext):
@@ -413,6 +419,30 @@ class BuildConfiguration(object):
         ext.extra_compile_args += self.extra_compile_args
         ext.extra_link_args += self.extra_link_args
         ext.extra_objects += self.extra_objects
+        ext.define_macros += self.define_macros
+
+    def build_benchmark(self, build_ext_cmd, ext):
+        """Compiles the C++ core of the given Extension object, without the
+        Python interface, together with the benchmarks into the executable
+        ``leiden_benchmark`` in the build directory."""
+        sources = [source for source in ext.sources
+                   if not os.path.basename(source).startswith(("python_", "pynterface"))]
+        sources.append(os.path.join("benchmark", "benchmark.cpp"))
+
+        compiler = build_ext_cmd.compiler
+        objects = compiler.compile(sources,
+                output_dir=os.path.join(build_ext_cmd.build_temp, "benchmark"),
+                include_dirs=ext.include_dirs,
+                macros=ext.define_macros,
+                extra_postargs=ext.extra_compile_args)
+        output_dir = os.path.dirname(build_ext_cmd.build_temp)
+        compiler.link_executable(objects + ext.extra_objects, "leiden_benchmark",
+                output_dir=output_dir,
+                libraries=ext.libraries,
+                library_dirs=ext.library_dirs,
+                extra_postargs=ext.extra_link_args,
+                target_lang="c++")
+        print("Built benchmark executable in %s" % output_dir)
 
     def detect_from_pkgconfig(self):
         """Detects the igraph include directory, library directory and the
@@ -489,6 +519,12 @@ class BuildConfiguration(object):
             elif option == "--no-wait":
                 opts_to_remove.append(idx)
                 self.wait = False                
+            elif option == "--with-benchmark":
+                opts_to_remove.append(idx)
+                self.with_benchmark = True
+            elif option == "--compact-graph":
+                opts_to_remove.append(idx)
+                self.define_macros.append(("LEIDENALG_COMPACT_GRAPH", None))
             elif option.startswith("--c-core-version"):
                 opts_to_remove.append(idx)
                 if option == "--c-core-version":
@@ -598,9 +634,19 @@ class BuildConfiguration(object):
 buildcfg = BuildConfiguration();
 buildcfg.process_args_from_command_line();
 
+# The C++ code requires C++11 (for threads)
+if os.name != 'nt':
+  extra_compile_args = ['-std=c++11', '-pthread'];
+  extra_link_args = ['-pthread'];
+else:
+  extra_compile_args = [];
+  extra_link_args = [];
+
 leiden_ext = Extension('leidenalg._c_leiden',
                     sources = glob.glob(os.path.join('src', '*.cpp')),
-                    include_dirs=['include']);
+                    include_dirs=['include'],
+                    extra_compile_args=extra_compile_args,
+                    extra_link_args=extra_link_args);
 
 cmdclass = versioneer.get_cmdclass()
 cmdclass.update(build_ext=buildcfg.build_ext)
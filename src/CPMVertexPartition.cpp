@@ -34,6 +34,11 @@ CPMVertexPartition* CPMVertexPartition::create(Graph* graph, vector<size_t> cons
   return new CPMVertexPartition(graph, membership, this->resolution_parameter);
 }
 
+CPMVertexPartition* CPMVertexPartition::clone()
+{
+  return new CPMVertexPartition(*this);
+}
+
 /********************************************************************************
   RBER implementation of a vertex partition
   (which includes a resolution parameter).
@@ -119,6 +124,50 @@ double CPMVertexPartition::diff_move(size_t v, size_t new_comm)
   return diff;
 }
 
+/********************************************************************************
+  Difference in quality if we move a node to each of the communities in
+  comms (see diff_move).
+ ********************************************************************************/
+void CPMVertexPartition::diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs)
+{
+  #ifdef DEBUG
+    cerr << "void CPMVertexPartition::diff_move_all(" << v << ", " << comms.size() << " communities)" << endl;
+  #endif
+  size_t n_comms = comms.size();
+  diffs.resize(n_comms);
+  size_t old_comm = this->membership(v);
+
+  vector<double> const& weight_to = this->weights_to_comms(v);
+  vector<double> const& weight_from = this->weights_from_comms(v);
+  size_t n_cached = weight_to.size();
+  size_t n_csize = this->_csize.size();
+
+  // Terms that only depend on the node and its current community
+  double w_to_old = old_comm < n_cached ? weight_to[old_comm] : 0.0;
+  double w_from_old = old_comm < n_cached ? weight_from[old_comm] : 0.0;
+  size_t nsize = this->graph->node_size(v);
+  size_t csize_old = this->csize(old_comm);
+  double self_weight = this->graph->node_self_weight(v);
+  // Subtracting one is only necessary when not correcting for self loops
+  double self_loop_correction = this->graph->correct_self_loops() ? 0.0 : 1.0;
+  double scale = this->resolution_parameter;
+  double possible_edge_difference_old = nsize*(2.0*csize_old - nsize - self_loop_correction);
+  double diff_old = w_to_old + w_from_old -
+      self_weight - scale*possible_edge_difference_old;
+
+  for (size_t i = 0; i < n_comms; i++)
+  {
+    size_t new_comm = comms[i];
+    double w_to_new = new_comm < n_cached ? weight_to[new_comm] : 0.0;
+    double w_from_new = new_comm < n_cached ? weight_from[new_comm] : 0.0;
+    size_t csize_new = new_comm < n_csize ? this->_csize[new_comm] : 0;
+    double possible_edge_difference_new = nsize*(2.0*csize_new + nsize - self_loop_correction);
+    double diff_new = w_to_new + w_from_new + self_weight -
+        scale*possible_edge_difference_new;
+    diffs[i] = new_comm != old_comm ? diff_new - diff_old : 0.0;
+  }
+}
+
 double CPMVertexPartition::quality(double resolution_parameter)
 {
   #ifdef DEBUG
@@ -143,3 +192,22 @@ double CPMVertexPartition::quality(double resolution_parameter)
   return (2.0 - this->graph->is_directed())*mod;
 }
 
+
+/****************************************************************************
+  The terms of the quality (see quality), which are both summed over all
+  communities at once.
+*****************************************************************************/
+void CPMVertexPartition::quality_terms(double& E, double& F)
+{
+  double w = 0.0;
+  double possible_edges = 0.0;
+  size_t nb_comms = this->n_communities();
+  for (size_t c = 0; c < nb_comms; c++)
+  {
+    w += this->total_weight_in_comm(c);
+    possible_edges += this->graph->possible_edges(this->csize(c));
+  }
+  double scale = 2.0 - this->graph->is_directed();
+  E = scale*w;
+  F = scale*possible_edges;
+}
@@ -1,4 +1,19 @@
 #include "GraphHelper.h"
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <thread>
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
 
 #ifdef DEBUG
   using std::cerr;
@@ -21,20 +36,6 @@ queue<size_t> queue_range(size_t n)
   return range_vec;
 }
 
-bool orderCSize(const size_t* A, const size_t* B)
-{
-
-  if (A[1] == B[1])
-  {
-    if (A[2] == B[2])
-      return A[0] < B[0];
-    else
-      return A[2] > B[2];
-  }
-  else
-    return A[1] > B[1];
-}
-
 void shuffle(vector<size_t>& v, igraph_rng_t* rng)
 {
   size_t n = v.size();
@@ -72,26 +73,124 @@ double KLL(double q, double p)
   return KL;
 }
 
+void run_workers(size_t n_threads, std::function<void(size_t)> const& worker)
+{
+  vector<std::exception_ptr> thread_error(n_threads);
+  auto run = [&worker, &thread_error](size_t t)
+  {
+    try
+    {
+      worker(t);
+    }
+    catch (...)
+    {
+      thread_error[t] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < n_threads; t++)
+  {
+    if (t + 1 < n_threads)
+    {
+      // If no thread can be started, the other workers should take over the
+      // work of worker t, for example through a shared counter.
+      try
+      {
+        threads.push_back(std::thread(run, t));
+      }
+      catch (...)
+      {
+        thread_error[t] = std::current_exception();
+      }
+    }
+    else
+      run(t);
+  }
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  for (size_t t = 0; t < n_threads; t++)
+    if (thread_error[t])
+      std::rethrow_exception(thread_error[t]);
+}
+
+/****************************************************************************
+  Call f(task) for all tasks 0, ..., n_tasks - 1, which are divided over at
+  most Graph::n_threads() threads, each taking a range of consecutive tasks.
+  The tasks should therefore be independent of each other.
+*****************************************************************************/
+template <class F> void parallel_for(size_t n_tasks, F const& f)
+{
+  size_t n_threads = Graph::n_threads();
+  if (n_threads > n_tasks)
+    n_threads = n_tasks;
+
+  run_workers(n_threads, [&f, n_tasks, n_threads](size_t t)
+  {
+    size_t last = (t + 1)*n_tasks/n_threads;
+    for (size_t task = t*n_tasks/n_threads; task < last; task++)
+      f(task);
+  });
+}
+
+/****************************************************************************
+  Call f(block, begin, end) for the consecutive blocks of GRAPH_BLOCK_SIZE
+  indices that make up 0, ..., n - 1, where the last block may be smaller,
+  using parallel_for. Any sums should be accumulated per block, and summed
+  over the blocks in order afterwards, so that the result does not depend on
+  the number of threads.
+*****************************************************************************/
+static const size_t GRAPH_BLOCK_SIZE = 1 << 16;
+
+inline size_t n_blocks(size_t n)
+{
+  return (n + GRAPH_BLOCK_SIZE - 1)/GRAPH_BLOCK_SIZE;
+}
+
+template <class F> void for_each_block(size_t n, F const& f)
+{
+  parallel_for(n_blocks(n), [&f, n](size_t block)
+  {
+    size_t end = (block + 1)*GRAPH_BLOCK_SIZE;
+    f(block, block*GRAPH_BLOCK_SIZE, end < n ? end : n);
+  });
+}
+
+std::atomic<size_t> Graph::_n_threads(1);
+
+void Graph::set_n_threads(size_t n_threads)
+{
+  Graph::_n_threads.store(n_threads, std::memory_order_relaxed);
+}
+
+size_t Graph::n_threads()
+{
+  size_t n_threads = Graph::_n_threads.load(std::memory_order_relaxed);
+  if (n_threads > 0)
+    return n_threads;
+  size_t n_cores = std::thread::hardware_concurrency();
+  return n_cores > 0 ? n_cores : 1;
+}
+
 Graph::Graph(igraph_t* graph,
   vector<double> const& edge_weights,
   vector<size_t> const& node_sizes,
   vector<double> const& node_self_weights, int correct_self_loops)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
 
   if (edge_weights.size() != this->ecount())
     throw Exception("Edge weights vector inconsistent length with the edge count of the graph.");
-  this->_edge_weights = edge_weights;
+  this->_storage.edge_weights.assign(edge_weights.begin(), edge_weights.end());
   this->_is_weighted = true;
 
   if (node_sizes.size() != this->vcount())
     throw Exception("Node size vector inconsistent length with the vertex count of the graph.");
-  this->_node_sizes = node_sizes;
+  this->_storage.node_sizes = node_sizes;
 
   if (node_self_weights.size() != this->vcount())
     throw Exception("Node self weights vector inconsistent length with the vertex count of the graph.");
-  this->_node_self_weights = node_self_weights;
+  this->_storage.node_self_weights = node_self_weights;
 
   this->_correct_self_loops = correct_self_loops;
   this->init_admin();
@@ -102,21 +201,20 @@ Graph::Graph(igraph_t* graph,
   vector<size_t> const& node_sizes,
   vector<double> const& node_self_weights)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
 
   if (edge_weights.size() != this->ecount())
     throw Exception("Edge weights vector inconsistent length with the edge count of the graph.");
-  this->_edge_weights = edge_weights;
+  this->_storage.edge_weights.assign(edge_weights.begin(), edge_weights.end());
   this->_is_weighted = true;
 
   if (node_sizes.size() != this->vcount())
     throw Exception("Node size vector inconsistent length with the vertex count of the graph.");
-  this->_node_sizes = node_sizes;
+  this->_storage.node_sizes = node_sizes;
 
   this->_correct_self_loops = this->has_self_loops();
 
-  this->_node_self_weights = node_self_weights;
+  this->_storage.node_self_weights = node_self_weights;
   this->init_admin();
 }
 
@@ -124,170 +222,175 @@ Graph::Graph(igraph_t* graph,
   vector<double> const& edge_weights,
   vector<size_t> const& node_sizes, int correct_self_loops)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
 
   if (edge_weights.size() != this->ecount())
     throw Exception("Edge weights vector inconsistent length with the edge count of the graph.");
-  this->_edge_weights = edge_weights;
+  this->_storage.edge_weights.assign(edge_weights.begin(), edge_weights.end());
   this->_is_weighted = true;
 
   if (node_sizes.size() != this->vcount())
     throw Exception("Node size vector inconsistent length with the vertex count of the graph.");
-  this->_node_sizes = node_sizes;
+  this->_storage.node_sizes = node_sizes;
 
   this->_correct_self_loops = correct_self_loops;
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph(igraph_t* graph,
   vector<double> const& edge_weights,
   vector<size_t> const& node_sizes)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
   if (edge_weights.size() != this->ecount())
     throw Exception("Edge weights vector inconsistent length with the edge count of the graph.");
-  this->_edge_weights = edge_weights;
+  this->_storage.edge_weights.assign(edge_weights.begin(), edge_weights.end());
   this->_is_weighted = true;
 
   if (node_sizes.size() != this->vcount())
     throw Exception("Node size vector inconsistent length with the vertex count of the graph.");
-  this->_node_sizes = node_sizes;
+  this->_storage.node_sizes = node_sizes;
 
   this->_correct_self_loops = this->has_self_loops();
 
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph(igraph_t* graph, vector<double> const& edge_weights, int correct_self_loops)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
   this->_correct_self_loops = correct_self_loops;
   if (edge_weights.size() != this->ecount())
     throw Exception("Edge weights vector inconsistent length with the edge count of the graph.");
-  this->_edge_weights = edge_weights;
+  this->_storage.edge_weights.assign(edge_weights.begin(), edge_weights.end());
   this->_is_weighted = true;
   this->set_default_node_size();
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph(igraph_t* graph, vector<double> const& edge_weights)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
   if (edge_weights.size() != this->ecount())
     throw Exception("Edge weights vector inconsistent length with the edge count of the graph.");
-  this->_edge_weights = edge_weights;
+  this->_storage.edge_weights.assign(edge_weights.begin(), edge_weights.end());
   this->_is_weighted = true;
 
   this->_correct_self_loops = this->has_self_loops();
 
   this->set_default_node_size();
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph(igraph_t* graph, vector<size_t> const& node_sizes, int correct_self_loops)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
   this->_correct_self_loops = correct_self_loops;
 
   if (node_sizes.size() != this->vcount())
     throw Exception("Node size vector inconsistent length with the vertex count of the graph.");
-  this->_node_sizes = node_sizes;
+  this->_storage.node_sizes = node_sizes;
 
   this->set_default_edge_weight();
   this->_is_weighted = false;
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph(igraph_t* graph, vector<size_t> const& node_sizes)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
   this->set_defaults();
   this->_is_weighted = false;
 
   if (node_sizes.size() != this->vcount())
     throw Exception("Node size vector inconsistent length with the vertex count of the graph.");
 
-  this->_node_sizes = node_sizes;
+  this->_storage.node_sizes = node_sizes;
 
   this->_correct_self_loops = this->has_self_loops();
 
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph(igraph_t* graph, int correct_self_loops)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
   this->_correct_self_loops = correct_self_loops;
   this->set_defaults();
   this->_is_weighted = false;
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph(igraph_t* graph)
 {
-  this->_graph = graph;
-  this->_remove_graph = false;
+  this->init_graph(graph);
   this->set_defaults();
   this->_is_weighted = false;
 
   this->_correct_self_loops = this->has_self_loops();
 
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::Graph()
 {
-  this->_graph = new igraph_t();
-  this->_remove_graph = true;
+  this->_graph = NULL;
+  this->_remove_graph = false;
+  this->_file = NULL;
+  this->_n = 0;
+  this->_m = 0;
+  this->_is_directed = false;
   this->set_defaults();
   this->_is_weighted = false;
   this->_correct_self_loops = false;
-  this->init_admin();
-  this->set_self_weights();
+  this->init_admin(true);
 }
 
 Graph::~Graph()
 {
-  if (this->_remove_graph)
+  if (this->_remove_graph && this->_graph != NULL)
   {
     igraph_destroy(this->_graph);
     delete this->_graph;
   }
+  delete this->_file;
 }
 
-int Graph::has_self_loops()
+/****************************************************************************
+  Copies the structure of an igraph graph, so that the graph itself is no
+  longer needed for any of the operations on the Graph.
+*****************************************************************************/
+void Graph::init_graph(igraph_t* graph)
 {
-  size_t m = this->ecount();
-  igraph_vector_bool_t loop;
-  igraph_vector_bool_init(&loop, m);
-  igraph_is_loop(this->_graph, &loop, igraph_ess_all(IGRAPH_EDGEORDER_ID));
+  this->_graph = graph;
+  this->_remove_graph = false;
+  this->_file = NULL;
 
-  int has_self_loops = false;
-  for (size_t idx = 0; idx < m; idx++)
+  this->_n = igraph_vcount(graph);
+  this->_m = igraph_ecount(graph);
+  this->_is_directed = igraph_is_directed(graph);
+
+  this->_storage.edge_from.resize(this->_m);
+  this->_storage.edge_to.resize(this->_m);
+  Storage& storage = this->_storage;
+  for_each_block(this->_m, [&storage, graph](size_t block, size_t begin, size_t end)
   {
-    if (VECTOR(loop)[idx])
+    for (size_t e = begin; e < end; e++)
     {
-      has_self_loops = true;
-      break;
+      storage.edge_from[e] = (size_t) VECTOR(graph->from)[e];
+      storage.edge_to[e] = (size_t) VECTOR(graph->to)[e];
     }
-  }
-  igraph_vector_bool_destroy(&loop);
-  return has_self_loops;
+  });
+  this->init_pointers();
+}
+
+int Graph::has_self_loops()
+{
+  size_t m = this->ecount();
+  for (size_t e = 0; e < m; e++)
+    if (this->_edge_from[e] == this->_edge_to[e])
+      return true;
+  return false;
 }
 
 size_t Graph::possible_edges()
@@ -314,11 +417,8 @@ void Graph::set_defaults()
 
 void Graph::set_default_edge_weight()
 {
-  size_t m = this->ecount();
-
-  // Set default edge weight of 1.0
-  this->_edge_weights.clear(); this->_edge_weights.resize(m);
-  fill(this->_edge_weights.begin(), this->_edge_weights.end(), 1.0);
+  // The default edge weight of 1.0 is not stored (see edge_weight)
+  this->_storage.edge_weights.clear();
   this->_is_weighted = false;
 }
 
@@ -327,116 +427,97 @@ void Graph::set_default_node_size()
   size_t n = this->vcount();
 
   // Set default node size of 1
-  this->_node_sizes.clear(); this->_node_sizes.resize(n);
-  fill(this->_node_sizes.begin(), this->_node_sizes.end(), 1);
+  this->_storage.node_sizes.clear(); this->_storage.node_sizes.resize(n);
+  fill(this->_storage.node_sizes.begin(), this->_storage.node_sizes.end(), 1);
 }
 
-void Graph::set_self_weights()
+void Graph::set_self_weight(size_t v)
 {
-  size_t n = this->vcount();
-
-  // Set default self_weights of the total weight of any possible self-loops
-  this->_node_self_weights.clear(); this->_node_self_weights.resize(n);
-  for (size_t v = 0; v < n; v++)
+  this->_storage.node_self_weights[v] = 0.0;
+  // There should be only one self loop
+  NeighbourRange neighbours = this->get_neighbours(v, IGRAPH_OUT);
+  for (Neighbour const* it = neighbours.begin(); it != neighbours.end(); it++)
   {
-    #ifdef DEBUG
-      cerr << "\t" << "Size node " << v << ": " << this->node_size(v) << endl;
-    #endif
-    double self_weight = 0.0;
-    // There should be only one self loop
-    igraph_integer_t eid;
-    // Get edge id for self loop
-    igraph_get_eid(this->_graph, &eid, v, v, this->is_directed(), false);
-    if (eid >= 0)
-      self_weight = this->edge_weight(eid);
-
-    this->_node_self_weights[v] = self_weight;
-    #ifdef DEBUG
-      cerr << "\t" << "Self weight node " << v << ": " << self_weight << endl;
-    #endif
+    if (it->node == v)
+    {
+      this->_storage.node_self_weights[v] = it->weight;
+      break;
+    }
   }
 }
 
-void Graph::init_admin()
+/****************************************************************************
+  Determine the adjacency, strengths, total weight, total size and density
+  of the graph, and the self weights of all nodes if self_weights is true.
+  Besides building the adjacency (see init_neighbours), this takes a single
+  sweep over the nodes, which is divided over multiple threads.
+*****************************************************************************/
+void Graph::init_admin(int self_weights)
 {
+  #ifdef DEBUG
+    cerr << "void Graph::init_admin(" << self_weights << ")" << endl;
+  #endif
+  this->drop_unit_edge_weights();
+  this->init_pointers();
 
-  size_t m = this->ecount();
+  size_t n = this->vcount();
 
-  // Determine total weight in the graph.
-  this->_total_weight = 0.0;
-  for (size_t e = 0; e < m; e++)
-    this->_total_weight += this->edge_weight(e);
+  // Determine total weight in the graph while counting the degrees.
+  this->init_neighbours(&this->_total_weight);
 
   // Make sure to multiply by 2 for undirected graphs
   //if (!this->is_directed())
   //  this->_total_weight *= 2.0;
 
-  size_t n = this->vcount();
+  // Calculate strength IN and OUT from the adjacency, and set the default
+  // self weights of the total weight of any possible self-loops.
+  this->_storage.strength_in.resize(n);
+  this->_storage.strength_out.resize(n);
+  if (self_weights)
+    this->_storage.node_self_weights.resize(n);
+  vector<size_t> block_size(n_blocks(n), 0);
+  for_each_block(n, [this, self_weights, &block_size](size_t block, size_t begin, size_t end)
+  {
+    for (size_t v = begin; v < end; v++)
+    {
+      block_size[block] += this->node_size(v);
+
+      double strength_in = 0.0;
+      NeighbourRange neighbours = this->get_neighbours(v, IGRAPH_IN);
+      for (Neighbour const* it = neighbours.begin(); it != neighbours.end(); it++)
+        strength_in += it->weight;
+      this->_storage.strength_in[v] = strength_in;
+
+      double strength_out = 0.0;
+      neighbours = this->get_neighbours(v, IGRAPH_OUT);
+      for (Neighbour const* it = neighbours.begin(); it != neighbours.end(); it++)
+        strength_out += it->weight;
+      this->_storage.strength_out[v] = strength_out;
+
+      if (self_weights)
+        this->set_self_weight(v);
+    }
+  });
 
   this->_total_size = 0;
-  for (size_t v = 0; v < n; v++)
-    this->_total_size += this->node_size(v);
-
-  igraph_vector_t weights;
-  igraph_vector_t res;
-
-  // Strength IN
-  igraph_vector_init(&res, n);
-  // Copy weights to an igraph_vector_t
-  igraph_vector_init_copy(&weights, &this->_edge_weights[0], this->ecount());
-  // Calculcate strength
-  igraph_strength(this->_graph, &res, igraph_vss_all(), IGRAPH_IN, true, &weights);
-  igraph_vector_destroy(&weights);
-
-  // Assign to strength vector
-  this->_strength_in.clear();
-  this->_strength_in.resize(n);
-  for (size_t v = 0; v < n; v++)
-    this->_strength_in[v] = VECTOR(res)[v];
-  igraph_vector_destroy(&res);
-
-  // Strength OUT
-  igraph_vector_init(&res, n);
-  // Copy weights to an igraph_vector_t
-  igraph_vector_init_copy(&weights, &this->_edge_weights[0], this->ecount());
-  // Calculcate strength
-  igraph_strength(this->_graph, &res, igraph_vss_all(), IGRAPH_OUT, true, &weights);
-  igraph_vector_destroy(&weights);
-
-  // Assign to strength vector
-  this->_strength_out.clear();
-  this->_strength_out.resize(n);
-  for (size_t v = 0; v < n; v++)
-    this->_strength_out[v] = VECTOR(res)[v];
-  igraph_vector_destroy(&res);
-
-  // Degree IN
-  igraph_vector_init(&res, n);
-  igraph_degree(this->_graph, &res, igraph_vss_all(), IGRAPH_IN, true);
-  this->_degree_in.clear();
-  this->_degree_in.resize(n);
-  for (size_t v = 0; v < n; v++)
-    this->_degree_in[v] = VECTOR(res)[v];
-  igraph_vector_destroy(&res);
-
-  // Degree OUT
-  igraph_vector_init(&res, n);
-  igraph_degree(this->_graph, &res, igraph_vss_all(), IGRAPH_OUT, true);
-  this->_degree_out.clear();
-  this->_degree_out.resize(n);
-  for (size_t v = 0; v < n; v++)
-    this->_degree_out[v] = VECTOR(res)[v];
-  igraph_vector_destroy(&res);
-
-  // Degree ALL
-  igraph_vector_init(&res, n);
-  igraph_degree(this->_graph, &res, igraph_vss_all(), IGRAPH_ALL, true);
-  this->_degree_all.clear();
-  this->_degree_all.resize(n);
-  for (size_t v = 0; v < n; v++)
-    this->_degree_all[v] = VECTOR(res)[v];
-  igraph_vector_destroy(&res);
+  for (size_t block = 0; block < block_size.size(); block++)
+    this->_total_size += block_size[block];
+
+  this->init_pointers();
+  this->set_density();
+
+  #ifdef DEBUG
+    for (size_t v = 0; v < n; v++)
+    {
+      cerr << "\t" << "Size node " << v << ": " << this->node_size(v) << endl;
+      cerr << "\t" << "Self weight node " << v << ": " << this->node_self_weight(v) << endl;
+    }
+    cerr << "exit Graph::init_admin(" << self_weights << ")" << endl << endl;
+  #endif
+}
 
+void Graph::set_density()
+{
   // Calculate density;
   double w = this->total_weight();
   size_t n_size = this->total_size();
@@ -454,246 +535,549 @@ void Graph::init_admin()
     this->_density = w/normalise;
   else
     this->_density = 2*w/normalise;
-
-  this->_current_node_cache_neigh_edges_from = n + 1;
-  this->_current_node_cache_neigh_edges_to = n + 1;
-  this->_current_node_cache_neigh_edges_all = n + 1;
-
-  this->_current_node_cache_neigh_from = n + 1;
-  this->_current_node_cache_neigh_to = n + 1;
-  this->_current_node_cache_neigh_all = n + 1;
 }
 
-void Graph::cache_neighbour_edges(size_t v, igraph_neimode_t mode)
+/****************************************************************************
+  The order of the neighbours of a node, by neighbour. Multiple edges are
+  kept in order of edge by sorting stably.
+*****************************************************************************/
+inline bool neighbour_less(Neighbour const& a, Neighbour const& b)
 {
-  #ifdef DEBUG
-    cerr << "void Graph::cache_neighbour_edges(" << v << ", " << mode << ");" << endl;
-  #endif
-  size_t degree = this->degree(v, mode);
-  #ifdef DEBUG
-    cerr << "Degree: " << degree << endl;
-  #endif
+  return a.node < b.node;
+}
 
-  igraph_vector_t incident_edges;
-  igraph_vector_init(&incident_edges, degree);
-  igraph_incident(this->_graph, &incident_edges, v, mode);
+/****************************************************************************
+  Builds the adjacency of all nodes in compressed sparse row format.
+
+  For each node, first the outgoing neighbours are stored, followed by the
+  incoming neighbours, both sorted by neighbour (and edge for multiple
+  edges), so that both are a contiguous part of all neighbours. For
+  IGRAPH_OUT and IGRAPH_IN this is the order as returned by igraph_neighbors
+  and igraph_incident, but for IGRAPH_ALL in directed graphs, igraph merges
+  both in order of neighbour instead. Nothing relies on the latter order: the
+  neighbours are only used as a set, or to choose a random neighbour. For
+  undirected graphs this simply results in all neighbours of a node, where a
+  self loop is included twice.
+
+  All passes are divided over multiple threads, without any locking. The
+  edges are first bucketed by the range of nodes containing their source
+  (and target), after which a single thread builds the neighbours of all
+  nodes in a range. If total_weight is not NULL, it is set to the total
+  weight of all edges, which is determined while counting the edges in a
+  bucket.
+*****************************************************************************/
+void Graph::init_neighbours(double* total_weight)
+{
+  size_t n = this->vcount();
+  size_t m = this->ecount();
+  if (n > std::numeric_limits<edge_index_t>::max() || m > std::numeric_limits<edge_index_t>::max())
+    throw Exception("Graph has too many nodes or edges for the index type of edges.");
+
+  Storage& storage = this->_storage;
+  storage.neighbours.resize(2*m);
+  storage.neighbours_offset.resize(n + 1);
+  storage.neighbours_in_offset.resize(n);
+
+  // Unit weights are not stored (see edge_weight)
+  edge_weight_t const* weights = storage.edge_weights.empty() ? NULL : storage.edge_weights.data();
+
+  // The nodes are divided in ranges of range_size nodes, each of which is
+  // handled by a single thread.
+  size_t n_ranges = std::min(Graph::n_threads(), std::max(n_blocks(n), (size_t)1));
+  size_t range_size = n > 0 ? (n + n_ranges - 1)/n_ranges : 1;
+  n_ranges = n > 0 ? (n + range_size - 1)/range_size : 1;
+
+  // Count the edges from and to the nodes of each range, per block of edges,
+  // while determining the total weight per block.
+  size_t n_edge_blocks = n_blocks(m);
+  vector<size_t> out_start(n_edge_blocks*n_ranges, 0);
+  vector<size_t> in_start(n_edge_blocks*n_ranges, 0);
+  vector<double> block_weight(n_edge_blocks, 0.0);
+  for_each_block(m, [&storage, weights, n_ranges, range_size, &out_start, &in_start, &block_weight](size_t block, size_t begin, size_t end)
+  {
+    size_t* out_count = &out_start[block*n_ranges];
+    size_t* in_count = &in_start[block*n_ranges];
+    for (size_t e = begin; e < end; e++)
+    {
+      out_count[storage.edge_from[e]/range_size] += 1;
+      in_count[storage.edge_to[e]/range_size] += 1;
+      block_weight[block] += weights != NULL ? weights[e] : 1.0;
+    }
+  });
+  if (total_weight != NULL)
+  {
+    *total_weight = 0.0;
+    for (size_t block = 0; block < n_edge_blocks; block++)
+      *total_weight += block_weight[block];
+  }
 
-  vector<size_t>* _cached_neigh_edges = NULL;
-  switch (mode)
+  // Bucket the edges by the range of their source (and target), where the
+  // edges of each range are ordered by edge. The buckets of all ranges are
+  // stored consecutively, and within a bucket all blocks of edges follow
+  // each other. The counts are replaced by the start of each block within
+  // its bucket.
+  vector<size_t> out_range_start(n_ranges + 1, 0);
+  vector<size_t> in_range_start(n_ranges + 1, 0);
+  for (size_t r = 0; r < n_ranges; r++)
   {
-    case IGRAPH_IN:
-      this->_current_node_cache_neigh_edges_from = v;
-      _cached_neigh_edges = &(this->_cached_neigh_edges_from);
-      break;
-    case IGRAPH_OUT:
-      this->_current_node_cache_neigh_edges_to = v;
-      _cached_neigh_edges = &(this->_cached_neigh_edges_to);
-      break;
-    case IGRAPH_ALL:
-      this->_current_node_cache_neigh_edges_all = v;
-      _cached_neigh_edges = &(this->_cached_neigh_edges_all);
-      break;
+    size_t out_pos = out_range_start[r];
+    size_t in_pos = in_range_start[r];
+    for (size_t block = 0; block < n_edge_blocks; block++)
+    {
+      size_t idx = block*n_ranges + r;
+      size_t out_count = out_start[idx];
+      size_t in_count = in_start[idx];
+      out_start[idx] = out_pos;
+      in_start[idx] = in_pos;
+      out_pos += out_count;
+      in_pos += in_count;
+    }
+    out_range_start[r + 1] = out_pos;
+    in_range_start[r + 1] = in_pos;
   }
-  _cached_neigh_edges->assign(igraph_vector_e_ptr(&incident_edges, 0),
-                              igraph_vector_e_ptr(&incident_edges, degree));
-  #ifdef DEBUG
-    cerr << "Number of edges: " << _cached_neigh_edges->size() << endl;
-  #endif
+  vector<edge_index_t> out_edges(m);
+  vector<edge_index_t> in_edges(m);
+  for_each_block(m, [&storage, n_ranges, range_size, &out_start, &in_start, &out_edges, &in_edges](size_t block, size_t begin, size_t end)
+  {
+    size_t* out_pos = &out_start[block*n_ranges];
+    size_t* in_pos = &in_start[block*n_ranges];
+    for (size_t e = begin; e < end; e++)
+    {
+      out_edges[out_pos[storage.edge_from[e]/range_size]++] = e;
+      in_edges[in_pos[storage.edge_to[e]/range_size]++] = e;
+    }
+  });
 
+  // Build the neighbours of the nodes of each range from its buckets. The
+  // neighbours of a range start after those of all previous ranges, which
+  // together contain an entry for each edge in their buckets.
+  parallel_for(n_ranges, [this, &storage, weights, n, range_size, &out_range_start, &in_range_start, &out_edges, &in_edges](size_t r)
+  {
+    size_t v_begin = r*range_size;
+    size_t v_end = std::min(v_begin + range_size, n);
+
+    // Determine where the neighbours of each node start
+    vector<size_t> out_pos(v_end - v_begin, 0);
+    vector<size_t> in_pos(v_end - v_begin, 0);
+    for (size_t idx = out_range_start[r]; idx < out_range_start[r + 1]; idx++)
+      out_pos[storage.edge_from[out_edges[idx]] - v_begin] += 1;
+    for (size_t idx = in_range_start[r]; idx < in_range_start[r + 1]; idx++)
+      in_pos[storage.edge_to[in_edges[idx]] - v_begin] += 1;
+    size_t offset = out_range_start[r] + in_range_start[r];
+    for (size_t v = v_begin; v < v_end; v++)
+    {
+      storage.neighbours_offset[v] = offset;
+      storage.neighbours_in_offset[v] = offset + out_pos[v - v_begin];
+      offset = storage.neighbours_in_offset[v] + in_pos[v - v_begin];
+      out_pos[v - v_begin] = storage.neighbours_offset[v];
+      in_pos[v - v_begin] = storage.neighbours_in_offset[v];
+    }
 
-  igraph_vector_destroy(&incident_edges);
-  #ifdef DEBUG
-    cerr << "exit void Graph::cache_neighbour_edges(" << v << ", " << mode << ");" << endl;
-  #endif
+    // Fill the neighbours in order of edge, and sort them by neighbour
+    Neighbour* neighbours = storage.neighbours.data();
+    for (size_t idx = out_range_start[r]; idx < out_range_start[r + 1]; idx++)
+    {
+      size_t e = out_edges[idx];
+      Neighbour& neighbour = neighbours[out_pos[storage.edge_from[e] - v_begin]++];
+      neighbour.node = storage.edge_to[e];
+      neighbour.edge = e;
+      neighbour.weight = weights != NULL ? weights[e] : 1.0;
+    }
+    for (size_t idx = in_range_start[r]; idx < in_range_start[r + 1]; idx++)
+    {
+      size_t e = in_edges[idx];
+      Neighbour& neighbour = neighbours[in_pos[storage.edge_to[e] - v_begin]++];
+      neighbour.node = storage.edge_from[e];
+      neighbour.edge = e;
+      neighbour.weight = weights != NULL ? weights[e] : 1.0;
+    }
+    // The positions now point to the end of the neighbours of each node
+    for (size_t v = v_begin; v < v_end; v++)
+    {
+      std::stable_sort(neighbours + storage.neighbours_offset[v],
+                       neighbours + out_pos[v - v_begin], neighbour_less);
+      std::stable_sort(neighbours + storage.neighbours_in_offset[v],
+                       neighbours + in_pos[v - v_begin], neighbour_less);
+    }
+  });
+  storage.neighbours_offset[n] = 2*m;
+
+  this->init_pointers();
 }
 
-vector<size_t> const& Graph::get_neighbour_edges(size_t v, igraph_neimode_t mode)
+/****************************************************************************
+  Point to the data of the graph in _storage, unless it is loaded from a file.
+  This should be done whenever any of the vectors in _storage is resized.
+*****************************************************************************/
+void Graph::init_pointers()
 {
-  switch (mode)
-  {
-    case IGRAPH_IN:
-      if (this->_current_node_cache_neigh_edges_from != v)
-      {
-        cache_neighbour_edges(v, mode);
-        this->_current_node_cache_neigh_edges_from = v;
-      }
-      return this->_cached_neigh_edges_from;
-    case IGRAPH_OUT:
-      if (this->_current_node_cache_neigh_edges_to != v)
-      {
-        cache_neighbour_edges(v, mode);
-        this->_current_node_cache_neigh_edges_to = v;
-      }
-      return this->_cached_neigh_edges_to;
-    case IGRAPH_ALL:
-      if (this->_current_node_cache_neigh_edges_all != v)
-      {
-        cache_neighbour_edges(v, mode);
-        this->_current_node_cache_neigh_edges_all = v;
-      }
-      return this->_cached_neigh_edges_all;
-  }
-  throw Exception("Incorrect model for getting neighbour edges.");
+  if (this->_file != NULL)
+    return;
+  this->_edge_from = this->_storage.edge_from.data();
+  this->_edge_to = this->_storage.edge_to.data();
+  this->_strength_in = this->_storage.strength_in.data();
+  this->_strength_out = this->_storage.strength_out.data();
+  this->_edge_weights = this->_storage.edge_weights.empty() ? NULL : this->_storage.edge_weights.data();
+  this->_node_sizes = this->_storage.node_sizes.data();
+  this->_node_self_weights = this->_storage.node_self_weights.data();
+  this->_neighbours = this->_storage.neighbours.data();
+  this->_neighbours_offset = this->_storage.neighbours_offset.data();
+  this->_neighbours_in_offset = this->_storage.neighbours_in_offset.data();
 }
 
-pair<size_t, size_t> Graph::get_endpoints(size_t e)
+/****************************************************************************
+  Copy the data of a graph that is loaded from a file to _storage, so that it
+  can be changed, and close the file. This does nothing for other graphs.
+*****************************************************************************/
+void Graph::release_file()
+{
+  if (this->_file == NULL)
+    return;
+  size_t n = this->vcount();
+  size_t m = this->ecount();
+  this->_storage.edge_from.assign(this->_edge_from, this->_edge_from + m);
+  this->_storage.edge_to.assign(this->_edge_to, this->_edge_to + m);
+  this->_storage.strength_in.assign(this->_strength_in, this->_strength_in + n);
+  this->_storage.strength_out.assign(this->_strength_out, this->_strength_out + n);
+  if (this->_edge_weights != NULL)
+    this->_storage.edge_weights.assign(this->_edge_weights, this->_edge_weights + m);
+  else
+    this->_storage.edge_weights.clear();
+  this->_storage.node_sizes.assign(this->_node_sizes, this->_node_sizes + n);
+  this->_storage.node_self_weights.assign(this->_node_self_weights, this->_node_self_weights + n);
+  this->_storage.neighbours.assign(this->_neighbours, this->_neighbours + this->_neighbours_offset[n]);
+  this->_storage.neighbours_offset.assign(this->_neighbours_offset, this->_neighbours_offset + n + 1);
+  this->_storage.neighbours_in_offset.assign(this->_neighbours_in_offset, this->_neighbours_in_offset + n);
+  delete this->_file;
+  this->_file = NULL;
+  this->init_pointers();
+}
+
+/****************************************************************************
+  Store the weights of all edges explicitly, so that they can be changed.
+  This should be done before changing the weights in _storage, after which
+  init_admin drops them again if they are all 1.0.
+*****************************************************************************/
+void Graph::store_edge_weights()
 {
-  igraph_integer_t from, to;
-  igraph_edge(this->_graph, e,&from, &to);
-  return make_pair<size_t, size_t>((size_t)from, (size_t)to);
+  if (this->_storage.edge_weights.empty())
+    this->_storage.edge_weights.assign(this->ecount(), 1.0);
+  this->init_pointers();
 }
 
-void Graph::cache_neighbours(size_t v, igraph_neimode_t mode)
+/****************************************************************************
+  Unweighted graphs do not store their weights, so that they use less memory
+  per edge, and edge_weight simply returns 1.0.
+*****************************************************************************/
+void Graph::drop_unit_edge_weights()
 {
-  #ifdef DEBUG
-    cerr << "void Graph::cache_neighbours(" << v << ", " << mode << ");" << endl;
-  #endif
-  size_t degree = this->degree(v, mode);
-  #ifdef DEBUG
-    cerr << "Degree: " << degree << endl;
-  #endif
+  if (this->_file != NULL)
+    return;
+  for (size_t e = 0; e < this->_storage.edge_weights.size(); e++)
+    if (this->_storage.edge_weights[e] != 1.0)
+      return;
+  vector<edge_weight_t>().swap(this->_storage.edge_weights);
+}
+
+pair<size_t, size_t> Graph::get_endpoints(size_t e)
+{
+  return make_pair(this->_edge_from[e], this->_edge_to[e]);
+}
 
-  igraph_vector_t neighbours;
-  igraph_vector_init(&neighbours, degree);
-  igraph_neighbors(this->_graph, &neighbours, v, mode);
+/****************************************************************************
+  Add edges from[i] -> to[i] with weight weights[i] to the graph, which are
+  numbered after the existing edges, similar to igraph.
 
-  vector<size_t>* _cached_neighs = NULL;
-  switch (mode)
+  Rebuilding the adjacency takes O(n + m) time. The changes in weight are
+  appended to changes, so that partitions of this graph can be updated using
+  MutableVertexPartition::apply_edge_changes. Whether self loops are corrected
+  for is not changed, so that the possible edges of a community remain the same.
+*****************************************************************************/
+void Graph::add_edges(vector<size_t> const& from, vector<size_t> const& to, vector<double> const& weights, EdgeChanges& changes)
+{
+  if (this->n_slices() > 0)
+    throw Exception("Cannot change the edges of a graph with slices.");
+  size_t n_new = from.size();
+  if (to.size() != n_new || weights.size() != n_new)
+    throw Exception("Number of endpoints and weights of edges to add should be equal.");
+  size_t n = this->vcount();
+  for (size_t i = 0; i < n_new; i++)
   {
-    case IGRAPH_IN:
-      this->_current_node_cache_neigh_from = v;
-      _cached_neighs = &(this->_cached_neighs_from);
-      break;
-    case IGRAPH_OUT:
-      this->_current_node_cache_neigh_to = v;
-      _cached_neighs = &(this->_cached_neighs_to);
-      break;
-    case IGRAPH_ALL:
-      this->_current_node_cache_neigh_all = v;
-      _cached_neighs = &(this->_cached_neighs_all);
-      break;
+    if (from[i] >= n || to[i] >= n)
+      throw Exception("Cannot add edges with endpoints outside of range of nodes.");
+    if (weights[i] != weights[i])
+      throw Exception("Cannot accept NaN weights.");
   }
-  _cached_neighs->assign(igraph_vector_e_ptr(&neighbours, 0),igraph_vector_e_ptr(&neighbours, degree));
-  igraph_vector_destroy(&neighbours);
 
-  #ifdef DEBUG
-    cerr << "Number of edges: " << _cached_neighs->size() << endl;
-  #endif
+  this->release_file();
+  this->store_edge_weights();
+  for (size_t i = 0; i < n_new; i++)
+  {
+    size_t v = from[i];
+    size_t u = to[i];
+    // For undirected graphs the first endpoint is the largest, similar to igraph.
+    if (!this->is_directed() && v < u)
+      std::swap(v, u);
+    this->_storage.edge_from.push_back(v);
+    this->_storage.edge_to.push_back(u);
+    this->_storage.edge_weights.push_back(weights[i]);
+    if (weights[i] != 1.0)
+      this->_is_weighted = true;
+    changes.add(v, u, this->_storage.edge_weights.back());
+  }
+  this->_m += n_new;
 
-  #ifdef DEBUG
-    cerr << "exit void Graph::cache_neighbours(" << v << ", " << mode << ");" << endl;
-  #endif
+  this->detach_igraph();
+  this->init_admin();
+  for (size_t i = 0; i < n_new; i++)
+    if (from[i] == to[i])
+      this->set_self_weight(from[i]);
 }
 
-vector< size_t > const& Graph::get_neighbours(size_t v, igraph_neimode_t mode)
+/****************************************************************************
+  Delete the edges from the graph. The remaining edges keep their order, but
+  are renumbered, similar to igraph.
+
+  Rebuilding the adjacency takes O(n + m) time. The changes in weight are
+  appended to changes, see add_edges.
+*****************************************************************************/
+void Graph::delete_edges(vector<size_t> const& edges, EdgeChanges& changes)
 {
-  switch (mode)
+  if (this->n_slices() > 0)
+    throw Exception("Cannot change the edges of a graph with slices.");
+  size_t m = this->ecount();
+  vector<int> is_deleted(m, false);
+  for (vector<size_t>::const_iterator it = edges.begin(); it != edges.end(); it++)
   {
-    case IGRAPH_IN:
-      if (this->_current_node_cache_neigh_from != v)
-      {
-        cache_neighbours(v, mode);
-        this -> _current_node_cache_neigh_from = v;
-      }
-      #ifdef DEBUG
-        cerr << "Returning " << this->_cached_neighs_from.size() << " incoming neighbours" << endl;
-      #endif
-      return this->_cached_neighs_from;
-    case IGRAPH_OUT:
-      if (this->_current_node_cache_neigh_to != v)
-      {
-        cache_neighbours(v, mode);
-        this -> _current_node_cache_neigh_to = v;
-      }
-      #ifdef DEBUG
-        cerr << "Returning " << this->_cached_neighs_to.size() << " incoming neighbours" << endl;
-      #endif
-      return this->_cached_neighs_to;
-    case IGRAPH_ALL:
-      if (this->_current_node_cache_neigh_all != v)
-      {
-        cache_neighbours(v, mode);
-        this->_current_node_cache_neigh_all = v;
-      }
-      #ifdef DEBUG
-        cerr << "Returning " << this->_cached_neighs_all.size() << " incoming neighbours" << endl;
-      #endif
-      return this->_cached_neighs_all;
+    if (*it >= m)
+      throw Exception("Cannot delete edges outside of range of edges.");
+    is_deleted[*it] = true;
   }
-  throw Exception("Invalid mode for getting neighbours.");
-}
-
-/********************************************************************************
- * This should return a random neighbour in O(1)
- ********************************************************************************/
-size_t Graph::get_random_neighbour(size_t v, igraph_neimode_t mode, igraph_rng_t* rng)
-{
-  size_t node=v;
-  size_t rand_neigh = -1;
-
-  if (this->degree(v, mode) <= 0)
-    throw Exception("Cannot select a random neighbour for an isolated node.");
 
-  if (igraph_is_directed(this->_graph) && mode != IGRAPH_ALL)
+  this->release_file();
+  this->store_edge_weights();
+  vector<size_t> self_loops;
+  size_t m_new = 0;
+  for (size_t e = 0; e < m; e++)
   {
-    if (mode == IGRAPH_OUT)
+    size_t v = this->_storage.edge_from[e];
+    size_t u = this->_storage.edge_to[e];
+    if (is_deleted[e])
     {
-      // Get indices of where neighbours are
-      size_t cum_degree_this_node = (size_t) VECTOR(this->_graph->os)[node];
-      size_t cum_degree_next_node = (size_t) VECTOR(this->_graph->os)[node+1];
-      // Get a random index from them
-      size_t rand_neigh_idx = get_random_int(cum_degree_this_node, cum_degree_next_node - 1, rng);
-      // Return the neighbour at that index
-      #ifdef DEBUG
-        cerr << "Degree: " << this->degree(node, mode) << " diff in cumulative: " << cum_degree_next_node - cum_degree_this_node << endl;
-      #endif
-      rand_neigh = VECTOR(this->_graph->to)[ (size_t)VECTOR(this->_graph->oi)[rand_neigh_idx] ];
-    }
-    else if (mode == IGRAPH_IN)
-    {
-      // Get indices of where neighbours are
-      size_t cum_degree_this_node = (size_t) VECTOR(this->_graph->is)[node];
-      size_t cum_degree_next_node = (size_t) VECTOR(this->_graph->is)[node+1];
-      // Get a random index from them
-      size_t rand_neigh_idx = get_random_int(cum_degree_this_node, cum_degree_next_node - 1, rng);
-      #ifdef DEBUG
-        cerr << "Degree: " << this->degree(node, mode) << " diff in cumulative: " << cum_degree_next_node - cum_degree_this_node << endl;
-      #endif
-      // Return the neighbour at that index
-      rand_neigh = VECTOR(this->_graph->from)[ (size_t)VECTOR(this->_graph->ii)[rand_neigh_idx] ];
+      changes.add(v, u, -this->_storage.edge_weights[e]);
+      if (v == u)
+        self_loops.push_back(v);
+      continue;
     }
+    this->_storage.edge_from[m_new] = v;
+    this->_storage.edge_to[m_new] = u;
+    this->_storage.edge_weights[m_new] = this->_storage.edge_weights[e];
+    m_new++;
   }
-  else
-  {
-    // both in- and out- neighbors in a directed graph.
-    size_t cum_outdegree_this_node = (size_t)VECTOR(this->_graph->os)[node];
-    size_t cum_indegree_this_node  = (size_t)VECTOR(this->_graph->is)[node];
+  this->_storage.edge_from.resize(m_new);
+  this->_storage.edge_to.resize(m_new);
+  this->_storage.edge_weights.resize(m_new);
+  this->_m = m_new;
 
-    size_t cum_outdegree_next_node = (size_t)VECTOR(this->_graph->os)[node+1];
-    size_t cum_indegree_next_node  = (size_t)VECTOR(this->_graph->is)[node+1];
+  this->detach_igraph();
+  this->init_admin();
+  for (vector<size_t>::iterator it = self_loops.begin(); it != self_loops.end(); it++)
+    this->set_self_weight(*it);
+}
 
-    size_t total_outdegree = cum_outdegree_next_node - cum_outdegree_this_node;
-    size_t total_indegree = cum_indegree_next_node - cum_indegree_this_node;
+/****************************************************************************
+  Set the weight of the edges to the new weights.
 
-    size_t rand_idx = get_random_int(0, total_outdegree + total_indegree - 1, rng);
+  The adjacency does not change, so that this only takes time proportional to
+  the degrees of the endpoints. The changes in weight are appended to changes,
+  see add_edges.
+*****************************************************************************/
+void Graph::set_edge_weights(vector<size_t> const& edges, vector<double> const& weights, EdgeChanges& changes)
+{
+  if (this->n_slices() > 0)
+    throw Exception("Cannot change the edges of a graph with slices.");
+  size_t n_changed = edges.size();
+  if (weights.size() != n_changed)
+    throw Exception("Number of edges and weights should be equal.");
+  size_t m = this->ecount();
+  for (size_t i = 0; i < n_changed; i++)
+  {
+    if (edges[i] >= m)
+      throw Exception("Cannot set weight of edges outside of range of edges.");
+    if (weights[i] != weights[i])
+      throw Exception("Cannot accept NaN weights.");
+  }
 
-    #ifdef DEBUG
-      cerr << "Degree: " << this->degree(node, mode) << " diff in cumulative: " << total_outdegree + total_indegree << endl;
-    #endif
-    // From among in or out neighbours?
-    if (rand_idx < total_outdegree)
-    { // From among outgoing neighbours
-      size_t rand_neigh_idx = cum_outdegree_this_node + rand_idx;
-      rand_neigh = VECTOR(this->_graph->to)[ (size_t)VECTOR(this->_graph->oi)[rand_neigh_idx] ];
-    }
-    else
-    { // From among incoming neighbours
-      size_t rand_neigh_idx = cum_indegree_this_node + rand_idx - total_outdegree;
-      rand_neigh = VECTOR(this->_graph->from)[ (size_t)VECTOR(this->_graph->ii)[rand_neigh_idx] ];
+  this->release_file();
+  this->store_edge_weights();
+  for (size_t i = 0; i < n_changed; i++)
+  {
+    size_t e = edges[i];
+    size_t v = this->_storage.edge_from[e];
+    size_t u = this->_storage.edge_to[e];
+    double old_weight = this->_storage.edge_weights[e];
+    this->_storage.edge_weights[e] = weights[i];
+    double w = this->_storage.edge_weights[e] - old_weight;
+    if (weights[i] != 1.0)
+      this->_is_weighted = true;
+    changes.add(v, u, w);
+
+    // Update the weight in the adjacency of both endpoints
+    Neighbour* neighbours = &this->_storage.neighbours[0];
+    for (size_t idx = this->_storage.neighbours_offset[v]; idx < this->_storage.neighbours_offset[v + 1]; idx++)
+      if (neighbours[idx].edge == e)
+        neighbours[idx].weight = weights[i];
+    if (u != v)
+      for (size_t idx = this->_storage.neighbours_offset[u]; idx < this->_storage.neighbours_offset[u + 1]; idx++)
+        if (neighbours[idx].edge == e)
+          neighbours[idx].weight = weights[i];
+
+    // Update the strengths in the same way as in init_admin
+    this->_storage.strength_out[v] += w;
+    this->_storage.strength_in[u] += w;
+    if (!this->is_directed())
+    {
+      this->_storage.strength_in[v] += w;
+      this->_storage.strength_out[u] += w;
     }
+    this->_total_weight += w;
+    if (v == u)
+      this->set_self_weight(v);
   }
 
-  return rand_neigh;
+  this->detach_igraph();
+  this->set_density();
+}
+
+/****************************************************************************
+  The endpoints of all changed edges and their neighbours, in increasing
+  order. These are the nodes that should be reconsidered after changing the
+  edges, see Optimiser::move_nodes.
+*****************************************************************************/
+vector<size_t> Graph::affected_nodes(EdgeChanges const& changes)
+{
+  size_t n = this->vcount();
+  vector<int> is_affected(n, false);
+  vector<size_t> nodes;
+  for (size_t i = 0; i < changes.size(); i++)
+  {
+    size_t endpoints[2] = {changes.from[i], changes.to[i]};
+    for (size_t j = 0; j < 2; j++)
+    {
+      size_t v = endpoints[j];
+      if (!is_affected[v])
+      {
+        is_affected[v] = true;
+        nodes.push_back(v);
+      }
+      NeighbourRange neighbours = this->get_neighbours(v, IGRAPH_ALL);
+      for (Neighbour const* it = neighbours.begin(); it != neighbours.end(); it++)
+      {
+        if (!is_affected[it->node])
+        {
+          is_affected[it->node] = true;
+          nodes.push_back(it->node);
+        }
+      }
+    }
+  }
+  sort(nodes.begin(), nodes.end());
+  return nodes;
+}
+
+/****************************************************************************
+  After changing the edges, the igraph graph no longer corresponds to this
+  graph, so that it is no longer used (and deleted if we own it).
+*****************************************************************************/
+void Graph::detach_igraph()
+{
+  if (this->_remove_graph && this->_graph != NULL)
+  {
+    igraph_destroy(this->_graph);
+    delete this->_graph;
+  }
+  this->_graph = NULL;
+  this->_remove_graph = false;
+}
+
+/********************************************************************************
+ * This should return a random neighbour in O(1)
+ ********************************************************************************/
+size_t Graph::get_random_neighbour(size_t v, igraph_neimode_t mode, igraph_rng_t* rng)
+{
+  NeighbourRange neighbours = this->get_neighbours(v, mode);
+  size_t degree = neighbours.size();
+
+  if (degree <= 0)
+    throw Exception("Cannot select a random neighbour for an isolated node.");
+
+  // Get a random index among the neighbours
+  size_t rand_idx = get_random_int(0, degree - 1, rng);
+  #ifdef DEBUG
+    cerr << "Degree: " << degree << " random index: " << rand_idx << endl;
+  #endif
+
+  return neighbours[rand_idx].node;
+}
+
+/****************************************************************************
+  Divide the nodes into slices. Each node lies within a single slice, and
+  its strengths within that slice only count the intraslice edges, i.e. the
+  edges to other nodes of the same slice. The total weight of a slice
+  similarly only includes its intraslice edges.
+*****************************************************************************/
+void Graph::set_slices(vector<size_t> const& slices)
+{
+  #ifdef DEBUG
+    cerr << "void Graph::set_slices(vector<size_t> const& slices)" << endl;
+  #endif
+  size_t n = this->vcount();
+  if (slices.size() != n)
+    throw Exception("Slices vector inconsistent length with the vertex count of the graph.");
+
+  size_t n_slices = 1;
+  for (size_t v = 0; v < n; v++)
+    if (slices[v] >= n_slices)
+      n_slices = slices[v] + 1;
+
+  this->_node_slices.resize(n);
+  this->_node_slices_offset.resize(n + 1);
+  for (size_t v = 0; v < n; v++)
+  {
+    NodeSlice& node_slice = this->_node_slices[v];
+    node_slice.slice = slices[v];
+    node_slice.strength_out = 0.0;
+    node_slice.strength_in = 0.0;
+    node_slice.size = this->node_size(v);
+    this->_node_slices_offset[v] = v;
+  }
+  this->_node_slices_offset[n] = n;
+
+  for (size_t v = 0; v < n; v++)
+  {
+    NodeSlice& node_slice = this->_node_slices[v];
+    NeighbourRange neighbours = this->get_neighbours(v, IGRAPH_IN);
+    for (Neighbour const* it = neighbours.begin(); it != neighbours.end(); it++)
+      if (slices[it->node] == slices[v])
+        node_slice.strength_in += it->weight;
+
+    neighbours = this->get_neighbours(v, IGRAPH_OUT);
+    for (Neighbour const* it = neighbours.begin(); it != neighbours.end(); it++)
+      if (slices[it->node] == slices[v])
+        node_slice.strength_out += it->weight;
+  }
+
+  this->_slice_total_weight.assign(n_slices, 0.0);
+  size_t m = this->ecount();
+  for (size_t e = 0; e < m; e++)
+  {
+    size_t v = this->_edge_from[e];
+    if (slices[v] == slices[this->_edge_to[e]])
+      this->_slice_total_weight[slices[v]] += this->edge_weight(e);
+  }
+  #ifdef DEBUG
+    cerr << "exit Graph::set_slices(vector<size_t> const& slices)" << endl << endl;
+  #endif
 }
 
 /****************************************************************************
@@ -705,86 +1089,961 @@ size_t Graph::get_random_neighbour(size_t v, igraph_neimode_t mode, igraph_rng_t
   weight of its self loop) is the internal weight of a community. The size
   of a node in the new graph is simply the size of the community in the old
   graph.
+
+  The edges are grouped by the communities of their endpoints using two
+  counting sorts, so that this takes O(n + m) time. The node sizes and
+  strengths of the collapsed graph are obtained by summing those of the
+  nodes in each community, rather than being recalculated.
 *****************************************************************************/
 Graph* Graph::collapse_graph(MutableVertexPartition* partition)
+{
+  Graph* G = new Graph();
+  this->collapse_graph(partition, G);
+  return G;
+}
+
+void Graph::collapse_graph(MutableVertexPartition* partition, Graph* G)
 {
   #ifdef DEBUG
-    cerr << "Graph* Graph::collapse_graph(vector<size_t> membership)" << endl;
+    cerr << "void Graph::collapse_graph(MutableVertexPartition* partition, Graph* G)" << endl;
   #endif
+  if (G->_graph != NULL || G->_file != NULL)
+    throw Exception("Can only collapse into a graph created by collapse_graph.");
+
+  size_t n = this->vcount();
   size_t m = this->ecount();
+  size_t n_collapsed = partition->n_communities();
 
   #ifdef DEBUG
     cerr << "Current graph has " << this->vcount() << " nodes and " << this->ecount() << " edges." << endl;
     cerr << "Collapsing to graph with " << partition->n_communities() << " nodes." << endl;
   #endif
 
-  vector< map<size_t, double> > collapsed_edge_weights(partition->n_communities());
-
-  igraph_integer_t v, u;
-  for (size_t e = 0; e < m; e++)
+  // Determine the communities of the endpoints of all edges. For undirected
+  // graphs we keep the largest community as the source, similar to igraph.
+  vector<size_t> from_comm(m);
+  vector<size_t> to_comm(m);
+  for_each_block(m, [this, partition, &from_comm, &to_comm](size_t block, size_t begin, size_t end)
   {
+    for (size_t e = begin; e < end; e++)
+    {
+      size_t v_comm = partition->membership(this->_edge_from[e]);
+      size_t u_comm = partition->membership(this->_edge_to[e]);
+      if (!this->is_directed() && v_comm < u_comm)
+      {
+        size_t tmp = v_comm;
+        v_comm = u_comm;
+        u_comm = tmp;
+      }
+      from_comm[e] = v_comm;
+      to_comm[e] = u_comm;
+    }
+  });
+
+  // Sort edges by (from_comm, to_comm)
+  vector<size_t> order = range(m);
+  sort_by_key(order, to_comm, n_collapsed);
+  sort_by_key(order, from_comm, n_collapsed);
+
+  // Clearing the vectors of G keeps their capacity, so that they are only
+  // reallocated if G has to grow.
+  G->_n = n_collapsed;
+  G->_m = 0;
+  G->_is_directed = this->_is_directed;
+  G->_correct_self_loops = this->_correct_self_loops;
+  G->_is_weighted = true;
+  G->_total_weight = 0.0;
+  G->_storage.edge_from.clear();
+  G->_storage.edge_to.clear();
+  G->_storage.edge_weights.clear();
+  G->_storage.node_self_weights.assign(n_collapsed, 0.0);
+
+  // Merge all edges between the same pair of communities. The weight of the
+  // last merged edge is summed in double precision, and only stored once all
+  // its edges have been added.
+  double merged_weight = 0.0;
+  for (size_t idx = 0; idx < m; idx++)
+  {
+    size_t e = order[idx];
+    size_t v_comm = from_comm[e];
+    size_t u_comm = to_comm[e];
     double w = this->edge_weight(e);
-    igraph_edge(this->_graph, e, &v, &u);
-    size_t v_comm = partition->membership((size_t)v);
-    size_t u_comm = partition->membership((size_t)u);
-    if (collapsed_edge_weights[v_comm].count(u_comm) > 0)
-      collapsed_edge_weights[v_comm][u_comm] += w;
+    if (G->_m > 0 && G->_storage.edge_from[G->_m - 1] == v_comm && G->_storage.edge_to[G->_m - 1] == u_comm)
+      merged_weight += w;
     else
-      collapsed_edge_weights[v_comm][u_comm] = w;
+    {
+      G->store_merged_weight(merged_weight);
+      G->_storage.edge_from.push_back(v_comm);
+      G->_storage.edge_to.push_back(u_comm);
+      G->_storage.edge_weights.push_back(w);
+      G->_m += 1;
+      merged_weight = w;
+    }
+    G->_total_weight += w;
   }
+  G->store_merged_weight(merged_weight);
 
-  // Now create vector for edges, first determined the number of edges
-  size_t m_collapsed = 0;
-  size_t n_collapsed = partition->n_communities();
-
-  for (vector< map<size_t, double> >::iterator itr = collapsed_edge_weights.begin();
-       itr != collapsed_edge_weights.end(); itr++)
+  // Carry node sizes and strengths over to the collapsed graph
+  G->_storage.node_sizes.assign(n_collapsed, 0);
+  G->_storage.strength_in.assign(n_collapsed, 0.0);
+  G->_storage.strength_out.assign(n_collapsed, 0.0);
+  for (size_t v = 0; v < n; v++)
   {
-      m_collapsed += itr->size();
+    size_t v_comm = partition->membership(v);
+    G->_storage.node_sizes[v_comm] += this->_node_sizes[v];
+    G->_storage.strength_in[v_comm] += this->_strength_in[v];
+    G->_storage.strength_out[v_comm] += this->_strength_out[v];
   }
+  G->_total_size = this->_total_size;
 
-  igraph_vector_t edges;
-  vector<double> collapsed_weights(m_collapsed, 0.0);
-  double total_collapsed_weight = 0.0;
+  this->collapse_slices(partition, G);
 
-  igraph_vector_init(&edges, 2*m_collapsed); // Vector or edges with edges (edge[0], edge[1]), (edge[2], edge[3]), etc...
+  G->init_neighbours();
+  G->set_density();
 
-  size_t e_idx = 0;
-  for (size_t v = 0; v < n_collapsed; v++)
+  #ifdef DEBUG
+    cerr << "exit Graph::collapse_graph(MutableVertexPartition* partition, Graph* G)" << endl << endl;
+  #endif
+}
+
+/****************************************************************************
+  Creates the subgraph induced by nodes (see the header). The edges are
+  numbered in order of their first endpoint in the subgraph, and then in the
+  order of the adjacency. Since the strengths of the nodes and the total
+  weight are those of this graph, partitions of the subgraph for which
+  MutableVertexPartition::has_local_diff_move holds give the same
+  differences in quality as partitions of this graph.
+*****************************************************************************/
+Graph* Graph::subgraph(vector<size_t> const& nodes)
+{
+  #ifdef DEBUG
+    cerr << "Graph* Graph::subgraph(" << nodes.size() << " nodes)" << endl;
+  #endif
+  if (this->n_slices() > 0)
+    throw Exception("Cannot take a subgraph of a graph with slices.");
+
+  size_t n = this->vcount();
+  size_t n_sub = nodes.size();
+  Graph* G = new Graph();
+  G->_n = n_sub;
+  G->_m = 0;
+  G->_is_directed = this->_is_directed;
+  G->_correct_self_loops = this->_correct_self_loops;
+  G->_is_weighted = this->_is_weighted;
+  G->_total_weight = this->_total_weight;
+  G->_total_size = this->_total_size;
+  G->_density = this->_density;
+  G->_storage.node_sizes.resize(n_sub);
+  G->_storage.node_self_weights.resize(n_sub);
+  G->_storage.strength_in.resize(n_sub);
+  G->_storage.strength_out.resize(n_sub);
+
+  for (size_t i = 0; i < n_sub; i++)
   {
-    for (map<size_t, double>::iterator itr = collapsed_edge_weights[v].begin();
-         itr != collapsed_edge_weights[v].end(); itr++)
+    size_t v = nodes[i];
+    if (v >= n || (i > 0 && nodes[i - 1] >= v))
+      throw Exception("Nodes of subgraph should be increasing and within range of nodes.");
+    G->_storage.node_sizes[i] = this->_node_sizes[v];
+    G->_storage.node_self_weights[i] = this->_node_self_weights[v];
+    G->_storage.strength_in[i] = this->_strength_in[v];
+    G->_storage.strength_out[i] = this->_strength_out[v];
+
+    // The outgoing neighbours contain each edge once, also for undirected
+    // graphs, for which v is then the largest endpoint, similar to igraph.
+    for (size_t idx = this->_neighbours_offset[v]; idx < this->_neighbours_in_offset[v]; idx++)
     {
-      size_t u = itr->first;
-      double w = itr->second;
-      VECTOR(edges)[2*e_idx] = v;
-      VECTOR(edges)[2*e_idx+1] = u;
-      collapsed_weights[e_idx] = w;
-      total_collapsed_weight += w;
-      if (e_idx >= m_collapsed)
-        throw Exception("Maximum number of possible edges exceeded.");
-      // next edge
-      e_idx += 1;
+      Neighbour const& neighbour = this->_neighbours[idx];
+      vector<size_t>::const_iterator it = std::lower_bound(nodes.begin(), nodes.end(), (size_t)neighbour.node);
+      if (it == nodes.end() || *it != neighbour.node)
+        continue;
+      G->_storage.edge_from.push_back(i);
+      G->_storage.edge_to.push_back(it - nodes.begin());
+      if (this->_edge_weights != NULL)
+        G->_storage.edge_weights.push_back(neighbour.weight);
+      G->_m += 1;
     }
   }
 
-  // Create graph based on edges
-  igraph_t* graph = new igraph_t();
-  igraph_create(graph, &edges, n_collapsed, this->is_directed());
-  igraph_vector_destroy(&edges);
+  G->init_neighbours();
+
+  #ifdef DEBUG
+    cerr << "exit Graph::subgraph(" << nodes.size() << " nodes)" << endl << endl;
+  #endif
+  return G;
+}
 
-  if ((size_t) igraph_vcount(graph) != partition->n_communities())
-    throw Exception("Something went wrong with collapsing the graph.");
+/****************************************************************************
+  Creates the permuted graph (see the header). The edges are numbered in
+  the new order of their first endpoint, and then in the order of the
+  adjacency. All other properties of the nodes and of the graph are those of
+  this graph, so that partitions of the permuted graph have the same quality
+  as the correspondingly permuted partitions of this graph.
+*****************************************************************************/
+Graph* Graph::permuted(vector<size_t> const& order)
+{
+  #ifdef DEBUG
+    cerr << "Graph* Graph::permuted(" << order.size() << " nodes)" << endl;
+  #endif
+  if (this->n_slices() > 0)
+    throw Exception("Cannot permute a graph with slices.");
 
-  // Calculate new node sizes
-  vector<size_t> csizes(n_collapsed, 0);
-  for (size_t c = 0; c < partition->n_communities(); c++)
-    csizes[c] = partition->csize(c);
+  size_t n = this->vcount();
+  size_t m = this->ecount();
+  if (order.size() != n)
+    throw Exception("Order of nodes should contain each node once.");
+  vector<size_t> new_id(n, n);
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t v = order[i];
+    if (v >= n || new_id[v] != n)
+      throw Exception("Order of nodes should contain each node once.");
+    new_id[v] = i;
+  }
+
+  Graph* G = new Graph();
+  G->_n = n;
+  G->_m = m;
+  G->_is_directed = this->_is_directed;
+  G->_correct_self_loops = this->_correct_self_loops;
+  G->_is_weighted = this->_is_weighted;
+  G->_total_weight = this->_total_weight;
+  G->_total_size = this->_total_size;
+  G->_density = this->_density;
+  Storage& storage = G->_storage;
+  storage.node_sizes.resize(n);
+  storage.node_self_weights.resize(n);
+  storage.strength_in.resize(n);
+  storage.strength_out.resize(n);
+  storage.edge_from.resize(m);
+  storage.edge_to.resize(m);
+  if (this->_edge_weights != NULL)
+    storage.edge_weights.resize(m);
+
+  // The first edge of each node, whose outgoing neighbours contain each edge
+  // once, also for undirected graphs (see subgraph).
+  vector<size_t> first_edge(n + 1, 0);
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t v = order[i];
+    first_edge[i + 1] = first_edge[i] + (this->_neighbours_in_offset[v] - this->_neighbours_offset[v]);
+  }
+
+  for_each_block(n, [this, G, &order, &new_id, &first_edge](size_t block, size_t begin, size_t end)
+  {
+    Storage& storage = G->_storage;
+    for (size_t i = begin; i < end; i++)
+    {
+      size_t v = order[i];
+      storage.node_sizes[i] = this->_node_sizes[v];
+      storage.node_self_weights[i] = this->_node_self_weights[v];
+      storage.strength_in[i] = this->_strength_in[v];
+      storage.strength_out[i] = this->_strength_out[v];
+      size_t e = first_edge[i];
+      for (size_t idx = this->_neighbours_offset[v]; idx < this->_neighbours_in_offset[v]; idx++, e++)
+      {
+        Neighbour const& neighbour = this->_neighbours[idx];
+        size_t u = new_id[neighbour.node];
+        // Keep the largest endpoint first for undirected graphs
+        if (!this->_is_directed && u > i)
+        {
+          storage.edge_from[e] = u;
+          storage.edge_to[e] = i;
+        }
+        else
+        {
+          storage.edge_from[e] = i;
+          storage.edge_to[e] = u;
+        }
+        if (this->_edge_weights != NULL)
+          storage.edge_weights[e] = neighbour.weight;
+      }
+    }
+  });
+
+  G->init_neighbours();
 
-  Graph* G = new Graph(graph, collapsed_weights, csizes, this->_correct_self_loops);
-  G->_remove_graph = true;
   #ifdef DEBUG
-    cerr << "exit Graph::collapse_graph(vector<size_t> membership)" << endl << endl;
+    cerr << "exit Graph::permuted(" << order.size() << " nodes)" << endl << endl;
+  #endif
+  return G;
+}
+
+/****************************************************************************
+  The reverse Cuthill-McKee order: a breadth-first search from a node of the
+  lowest degree, which visits the neighbours of each node in order of
+  increasing degree, and which is repeated for each component, after which
+  the order is reversed.
+*****************************************************************************/
+vector<size_t> Graph::rcm_order()
+{
+  size_t n = this->vcount();
+  vector<size_t> start = this->degree_order();
+  std::reverse(start.begin(), start.end());
+
+  vector<size_t> order;
+  order.reserve(n);
+  vector<char> is_visited(n, false);
+  vector< pair<size_t, size_t> > neighbours;
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t s = start[i];
+    if (is_visited[s])
+      continue;
+    is_visited[s] = true;
+    order.push_back(s);
+    for (size_t head = order.size() - 1; head < order.size(); head++)
+    {
+      size_t v = order[head];
+      neighbours.clear();
+      NeighbourRange neighs = this->get_neighbours(v, IGRAPH_ALL);
+      for (Neighbour const* it_neigh = neighs.begin(); it_neigh != neighs.end(); it_neigh++)
+      {
+        size_t u = it_neigh->node;
+        if (!is_visited[u])
+        {
+          is_visited[u] = true;
+          neighbours.push_back(std::make_pair(this->degree(u, IGRAPH_ALL), u));
+        }
+      }
+      std::sort(neighbours.begin(), neighbours.end());
+      for (size_t j = 0; j < neighbours.size(); j++)
+        order.push_back(neighbours[j].second);
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+/****************************************************************************
+  The nodes in order of decreasing degree, and of increasing node for equal
+  degrees, using a counting sort.
+*****************************************************************************/
+vector<size_t> Graph::degree_order()
+{
+  size_t n = this->vcount();
+  size_t max_degree = 0;
+  for (size_t v = 0; v < n; v++)
+    max_degree = std::max(max_degree, this->degree(v, IGRAPH_ALL));
+  vector<size_t> start(max_degree + 2, 0);
+  for (size_t v = 0; v < n; v++)
+    start[max_degree - this->degree(v, IGRAPH_ALL) + 1] += 1;
+  for (size_t k = 1; k < start.size(); k++)
+    start[k] += start[k - 1];
+  vector<size_t> order(n);
+  for (size_t v = 0; v < n; v++)
+    order[start[max_degree - this->degree(v, IGRAPH_ALL)]++] = v;
+  return order;
+}
+
+/****************************************************************************
+  Set the weight of the last edge of a graph that is being collapsed into,
+  and use it as the self weight if it is a self loop (see collapse_graph).
+*****************************************************************************/
+void Graph::store_merged_weight(double weight)
+{
+  if (this->_m == 0)
+    return;
+  size_t e = this->_m - 1;
+  this->_storage.edge_weights[e] = weight;
+  if (this->_storage.edge_from[e] == this->_storage.edge_to[e])
+    this->_storage.node_self_weights[this->_storage.edge_from[e]] = this->_storage.edge_weights[e];
+}
+
+/****************************************************************************
+  Carry the slices over to the collapsed graph G, by merging the parts of all
+  nodes in a community that lie within the same slice.
+*****************************************************************************/
+void Graph::collapse_slices(MutableVertexPartition* partition, Graph* G)
+{
+  size_t n_collapsed = G->vcount();
+  size_t n_slices = this->n_slices();
+  G->_slice_total_weight = this->_slice_total_weight;
+  G->_node_slices.clear();
+  G->_node_slices_offset.clear();
+  if (n_slices == 0)
+    return;
+
+  // Sort the parts of the nodes by (community, slice)
+  size_t n_parts = this->_node_slices.size();
+  vector<size_t> part_comm(n_parts);
+  vector<size_t> part_slice(n_parts);
+  for (size_t v = 0; v < this->vcount(); v++)
+    for (size_t i = this->_node_slices_offset[v]; i < this->_node_slices_offset[v + 1]; i++)
+    {
+      part_comm[i] = partition->membership(v);
+      part_slice[i] = this->_node_slices[i].slice;
+    }
+  vector<size_t> order = range(n_parts);
+  sort_by_key(order, part_slice, n_slices);
+  sort_by_key(order, part_comm, n_collapsed);
+
+  G->_node_slices_offset.assign(n_collapsed + 1, 0);
+  for (size_t idx = 0; idx < n_parts; idx++)
+  {
+    size_t i = order[idx];
+    size_t comm = part_comm[i];
+    NodeSlice const& part = this->_node_slices[i];
+    if (G->_node_slices_offset[comm + 1] > 0 && G->_node_slices.back().slice == part.slice)
+    {
+      NodeSlice& merged = G->_node_slices.back();
+      merged.strength_out += part.strength_out;
+      merged.strength_in += part.strength_in;
+      merged.size += part.size;
+    }
+    else
+    {
+      G->_node_slices.push_back(part);
+      G->_node_slices_offset[comm + 1] += 1;
+    }
+  }
+  for (size_t c = 0; c < n_collapsed; c++)
+    G->_node_slices_offset[c + 1] += G->_node_slices_offset[c];
+}
+
+/****************************************************************************
+  Binary graph files.
+
+  A file starts with a GraphFileHeader, followed by these arrays, in this
+  order:
+
+    neighbours_offset     n + 1 integers
+    neighbours_in_offset  n integers
+    neighbours            2m Neighbour entries
+    edge_from             m edge_index_t integers
+    edge_to               m edge_index_t integers
+    edge_weights          m edge_weight_t numbers, padded to 8 bytes
+    node_sizes            n integers
+    node_self_weights     n doubles
+    strength_in           n doubles
+    strength_out          n doubles
+
+  All integers and doubles are 8 bytes in native byte order, so that all
+  arrays are aligned and can be used directly from a memory mapped file.
+  Builds with LEIDENALG_COMPACT_GRAPH store the edges with 32 bit integers
+  and floats (see edge_index_t), which is recorded as a separate version, so
+  that files cannot be loaded by a build with a different layout.
+*****************************************************************************/
+static const char GRAPH_FILE_MAGIC[8] = {'L', 'E', 'I', 'D', 'E', 'N', 'G', 'R'};
+static const uint64_t GRAPH_FILE_BYTE_ORDER = 0x0102030405060708ULL;
+#ifdef LEIDENALG_COMPACT_GRAPH
+static const uint64_t GRAPH_FILE_VERSION = 2;
+#else
+static const uint64_t GRAPH_FILE_VERSION = 1;
+#endif
+
+struct GraphFileHeader
+{
+  char magic[8];
+  uint64_t byte_order;
+  uint64_t version;
+  uint64_t n;
+  uint64_t m;
+  uint64_t is_directed;
+  uint64_t is_weighted;
+  uint64_t correct_self_loops;
+  uint64_t total_size;
+  double total_weight;
+};
+
+// The size of the edge weights in a file, including the padding that keeps
+// the arrays after them aligned.
+static size_t graph_file_weights_size(size_t m)
+{
+  return (m*sizeof(edge_weight_t) + 7)/8*8;
+}
+
+static size_t graph_file_size(size_t n, size_t m)
+{
+  return sizeof(GraphFileHeader)
+       + (2*n + 1)*sizeof(size_t) + 2*m*sizeof(Neighbour)
+       + 2*m*sizeof(edge_index_t) + graph_file_weights_size(m)
+       + n*sizeof(size_t) + 3*n*sizeof(double);
+}
+
+static void write_array(FILE* file, void const* data, size_t size)
+{
+  if (size > 0 && fwrite(data, 1, size, file) != size)
+  {
+    fclose(file);
+    throw Exception("Could not write graph to file.");
+  }
+}
+
+/****************************************************************************
+  Write the graph to a binary file (see above), which can be loaded using
+  Graph::load.
+*****************************************************************************/
+void Graph::save(char const* filename)
+{
+  if (this->n_slices() > 0)
+    throw Exception("Cannot save a graph with slices.");
+  if (sizeof(size_t) != sizeof(uint64_t))
+    throw Exception("Binary graph files require 64 bit integers.");
+
+  size_t n = this->vcount();
+  size_t m = this->ecount();
+
+  GraphFileHeader header;
+  memcpy(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic));
+  header.byte_order = GRAPH_FILE_BYTE_ORDER;
+  header.version = GRAPH_FILE_VERSION;
+  header.n = n;
+  header.m = m;
+  header.is_directed = this->is_directed();
+  header.is_weighted = this->is_weighted();
+  header.correct_self_loops = this->correct_self_loops();
+  header.total_size = this->total_size();
+  header.total_weight = this->total_weight();
+
+  FILE* file = fopen(filename, "wb");
+  if (file == NULL)
+    throw Exception("Could not open file to write graph.");
+  write_array(file, &header, sizeof(header));
+  write_array(file, this->_neighbours_offset, (n + 1)*sizeof(size_t));
+  write_array(file, this->_neighbours_in_offset, n*sizeof(size_t));
+  write_array(file, this->_neighbours, 2*m*sizeof(Neighbour));
+  write_array(file, this->_edge_from, m*sizeof(edge_index_t));
+  write_array(file, this->_edge_to, m*sizeof(edge_index_t));
+  if (this->_edge_weights != NULL)
+    write_array(file, this->_edge_weights, m*sizeof(edge_weight_t));
+  else
+  {
+    // Unit weights are not stored in memory, but they are in the file
+    vector<edge_weight_t> weights(std::min(m, (size_t)4096), 1.0);
+    for (size_t e = 0; e < m; e += weights.size())
+      write_array(file, weights.data(), std::min(weights.size(), m - e)*sizeof(edge_weight_t));
+  }
+  char padding[8] = {0};
+  write_array(file, padding, graph_file_weights_size(m) - m*sizeof(edge_weight_t));
+  write_array(file, this->_node_sizes, n*sizeof(size_t));
+  write_array(file, this->_node_self_weights, n*sizeof(double));
+  write_array(file, this->_strength_in, n*sizeof(double));
+  write_array(file, this->_strength_out, n*sizeof(double));
+  if (fclose(file) != 0)
+    throw Exception("Could not write graph to file.");
+}
+
+/****************************************************************************
+  Load a graph from a binary file written by Graph::save. The file is memory
+  mapped, and the graph refers directly to its data, so that loading takes
+  constant time, and pages of the file are only read when they are used. The
+  graph is not backed by an igraph graph.
+
+  When the edges of the graph are changed, the data is first copied from the
+  file (see release_file).
+
+  The offsets, neighbours and endpoints of the file are used as indices
+  without any further checks, so that a corrupted file could otherwise read
+  out of bounds. If validate is set, we therefore check them first (see
+  has_consistent_adjacency), which takes O(n + m) time.
+*****************************************************************************/
+Graph* Graph::load(char const* filename, int validate)
+{
+  if (sizeof(size_t) != sizeof(uint64_t))
+    throw Exception("Binary graph files require 64 bit integers.");
+
+  MappedFile* file = new MappedFile(filename);
+  GraphFileHeader header;
+  const char* error = NULL;
+  if (file->size() < sizeof(header))
+    error = "File is not a binary graph file.";
+  else
+  {
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic)) != 0)
+      error = "File is not a binary graph file.";
+    else if (header.byte_order != GRAPH_FILE_BYTE_ORDER)
+      error = "Binary graph file was written with a different byte order.";
+    else if (header.version != GRAPH_FILE_VERSION)
+      error = "Unsupported version of binary graph file.";
+    // Bound n and m first, so that computing the size cannot overflow
+    else if (header.n > file->size()/8 || header.m > file->size()/8 ||
+             file->size() != graph_file_size(header.n, header.m))
+      error = "Binary graph file has an incorrect size.";
+  }
+  if (error != NULL)
+  {
+    delete file;
+    throw Exception(error);
+  }
+
+  size_t n = header.n;
+  size_t m = header.m;
+
+  Graph* G = new Graph();
+  G->_file = file;
+  G->_n = n;
+  G->_m = m;
+  G->_is_directed = header.is_directed;
+  G->_is_weighted = header.is_weighted;
+  G->_correct_self_loops = header.correct_self_loops;
+  G->_total_size = header.total_size;
+  G->_total_weight = header.total_weight;
+
+  char const* data = file->data() + sizeof(header);
+  G->_neighbours_offset = (size_t const*)data;      data += (n + 1)*sizeof(size_t);
+  G->_neighbours_in_offset = (size_t const*)data;   data += n*sizeof(size_t);
+  G->_neighbours = (Neighbour const*)data;          data += 2*m*sizeof(Neighbour);
+  G->_edge_from = (edge_index_t const*)data;        data += m*sizeof(edge_index_t);
+  G->_edge_to = (edge_index_t const*)data;          data += m*sizeof(edge_index_t);
+  G->_edge_weights = (edge_weight_t const*)data;    data += graph_file_weights_size(m);
+  G->_node_sizes = (size_t const*)data;             data += n*sizeof(size_t);
+  G->_node_self_weights = (double const*)data;      data += n*sizeof(double);
+  G->_strength_in = (double const*)data;            data += n*sizeof(double);
+  G->_strength_out = (double const*)data;
+
+  if (G->_neighbours_offset[n] != 2*m || (validate && !G->has_consistent_adjacency()))
+  {
+    delete G;
+    throw Exception("Binary graph file has an inconsistent adjacency.");
+  }
+
+  G->set_density();
+  return G;
+}
+
+/****************************************************************************
+  Check that the adjacency of a loaded graph is consistent, so that it can be
+  used without reading out of bounds: the neighbours of each node should lie
+  within all neighbours, with its incoming neighbours after its outgoing
+  neighbours, and each neighbour should refer to an edge between the node and
+  that neighbour, in the right direction.
+*****************************************************************************/
+int Graph::has_consistent_adjacency()
+{
+  size_t n = this->vcount();
+  size_t m = this->ecount();
+  if (this->_neighbours_offset[0] != 0)
+    return false;
+  for (size_t e = 0; e < m; e++)
+    if (this->_edge_from[e] >= n || this->_edge_to[e] >= n)
+      return false;
+  for (size_t v = 0; v < n; v++)
+  {
+    size_t begin = this->_neighbours_offset[v];
+    size_t in_begin = this->_neighbours_in_offset[v];
+    size_t end = this->_neighbours_offset[v + 1];
+    if (in_begin < begin || end < in_begin || end > 2*m)
+      return false;
+    for (size_t idx = begin; idx < end; idx++)
+    {
+      Neighbour const& neighbour = this->_neighbours[idx];
+      if (neighbour.edge >= m)
+        return false;
+      size_t from = this->_edge_from[neighbour.edge];
+      size_t to = this->_edge_to[neighbour.edge];
+      if (idx < in_begin ? (from != v || to != neighbour.node) : (to != v || from != neighbour.node))
+        return false;
+    }
+  }
+  return true;
+}
+
+MappedFile::MappedFile(char const* filename)
+{
+  this->_data = NULL;
+  this->_size = 0;
+  #ifdef _WIN32
+    this->_file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (this->_file_handle == INVALID_HANDLE_VALUE)
+      throw Exception("Could not open file.");
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(this->_file_handle, &size))
+    {
+      CloseHandle(this->_file_handle);
+      throw Exception("Could not determine size of file.");
+    }
+    this->_size = (size_t)size.QuadPart;
+    this->_mapping_handle = NULL;
+    if (this->_size > 0)
+    {
+      this->_mapping_handle = CreateFileMappingA(this->_file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (this->_mapping_handle != NULL)
+        this->_data = (char const*)MapViewOfFile(this->_mapping_handle, FILE_MAP_READ, 0, 0, 0);
+      if (this->_data == NULL)
+      {
+        if (this->_mapping_handle != NULL)
+          CloseHandle(this->_mapping_handle);
+        CloseHandle(this->_file_handle);
+        throw Exception("Could not map file into memory.");
+      }
+    }
+  #else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+      throw Exception("Could not open file.");
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+      close(fd);
+      throw Exception("Could not determine size of file.");
+    }
+    this->_size = (size_t)st.st_size;
+    if (this->_size > 0)
+    {
+      void* data = mmap(NULL, this->_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED)
+      {
+        close(fd);
+        throw Exception("Could not map file into memory.");
+      }
+      this->_data = (char const*)data;
+    }
+    // The mapping remains valid after closing the file
+    close(fd);
   #endif
+}
+
+MappedFile::~MappedFile()
+{
+  #ifdef _WIN32
+    if (this->_data != NULL)
+      UnmapViewOfFile(this->_data);
+    if (this->_mapping_handle != NULL)
+      CloseHandle(this->_mapping_handle);
+    CloseHandle(this->_file_handle);
+  #else
+    if (this->_data != NULL)
+      munmap((void*)this->_data, this->_size);
+  #endif
+}
+
+GraphBuilder::GraphBuilder(size_t n, int is_directed, int correct_self_loops)
+{
+  this->_n = n;
+  this->_m = 0;
+  this->_is_directed = is_directed;
+  this->_is_weighted = false;
+  this->_correct_self_loops = correct_self_loops;
+  this->_pass = 0;
+  this->_offset.resize(n, 0);
+}
+
+/****************************************************************************
+  Count the number of edges of each node. For undirected graphs, an edge is
+  stored with its largest endpoint, so that parallel edges end up together.
+*****************************************************************************/
+void GraphBuilder::count_edges(size_t const* from, size_t const* to, size_t m)
+{
+  if (this->_pass != 0)
+    throw Exception("Edges can only be counted before adding them.");
+  for (size_t i = 0; i < m; i++)
+  {
+    size_t v = from[i];
+    size_t u = to[i];
+    if (!this->_is_directed && u > v)
+      v = u;
+    if (u >= this->_n)
+      this->_n = u + 1;
+    if (v >= this->_n)
+      this->_n = v + 1;
+    if (this->_offset.size() < this->_n)
+      this->_offset.resize(this->_n, 0);
+    this->_offset[v] += 1;
+  }
+  this->_m += m;
+}
+
+void GraphBuilder::start_filling()
+{
+  size_t n = this->_n;
+  this->_offset.resize(n + 1, 0);
+  size_t offset = 0;
+  for (size_t v = 0; v <= n; v++)
+  {
+    size_t count = this->_offset[v];
+    this->_offset[v] = offset;
+    offset += count;
+  }
+  this->_pos.assign(this->_offset.begin(), this->_offset.end() - 1);
+  this->_edges.resize(this->_m);
+  this->_pass = 1;
+}
+
+void GraphBuilder::add_edges(size_t const* from, size_t const* to, double const* weights, size_t m)
+{
+  if (this->_pass == 2)
+    throw Exception("Graph was already created from the edges.");
+  if (this->_pass == 0)
+    this->start_filling();
+  if (weights != NULL)
+    this->_is_weighted = true;
+  for (size_t i = 0; i < m; i++)
+  {
+    size_t v = from[i];
+    size_t u = to[i];
+    if (!this->_is_directed && u > v)
+      std::swap(u, v);
+    if (u >= this->_n || v >= this->_n || this->_pos[v] == this->_offset[v + 1])
+      throw Exception("Edges in the second pass differ from the edges in the first pass.");
+    pair<size_t, double>& edge = this->_edges[this->_pos[v]++];
+    edge.first = u;
+    edge.second = (weights != NULL) ? weights[i] : 1.0;
+  }
+}
+
+Graph* GraphBuilder::get_graph()
+{
+  if (this->_pass == 0)
+    this->start_filling();
+  vector<size_t> node_sizes(this->_n, 1);
+  return this->get_graph(node_sizes);
+}
+
+/****************************************************************************
+  Merge the parallel edges of each node in place, and move the remaining
+  edges to a new graph. Edges are sorted by endpoint and weight before
+  merging, so that the resulting weights do not depend on the order in which
+  the edges were streamed.
+*****************************************************************************/
+Graph* GraphBuilder::get_graph(vector<size_t> const& node_sizes)
+{
+  if (this->_pass == 2)
+    throw Exception("Graph was already created from the edges.");
+  if (this->_pass == 0)
+    this->start_filling();
+  size_t n = this->_n;
+  if (node_sizes.size() != n)
+    throw Exception("Node size vector inconsistent length with the vertex count of the graph.");
+  for (size_t v = 0; v < n; v++)
+    if (this->_pos[v] != this->_offset[v + 1])
+      throw Exception("Edges in the second pass differ from the edges in the first pass.");
+
+  size_t m = 0;
+  for (size_t v = 0; v < n; v++)
+  {
+    size_t begin = this->_offset[v];
+    size_t end = this->_offset[v + 1];
+    this->_offset[v] = m;
+    std::sort(this->_edges.begin() + begin, this->_edges.begin() + end);
+    for (size_t i = begin; i < end; i++)
+    {
+      if (m > this->_offset[v] && this->_edges[m - 1].first == this->_edges[i].first)
+        this->_edges[m - 1].second += this->_edges[i].second;
+      else
+        this->_edges[m++] = this->_edges[i];
+    }
+  }
+  this->_offset[n] = m;
+
+  Graph* G = new Graph();
+  G->_n = n;
+  G->_m = m;
+  G->_is_directed = this->_is_directed;
+  G->_is_weighted = this->_is_weighted;
+  G->_correct_self_loops = this->_correct_self_loops;
+
+  G->_storage.edge_from.resize(m);
+  G->_storage.edge_to.resize(m);
+  G->_storage.edge_weights.resize(m);
+  for (size_t v = 0; v < n; v++)
+  {
+    for (size_t e = this->_offset[v]; e < this->_offset[v + 1]; e++)
+    {
+      G->_storage.edge_from[e] = v;
+      G->_storage.edge_to[e] = this->_edges[e].first;
+      G->_storage.edge_weights[e] = this->_edges[e].second;
+    }
+  }
+
+  // Release the memory of the builder before building the adjacency
+  vector< pair<size_t, double> >().swap(this->_edges);
+  vector<size_t>().swap(this->_offset);
+  vector<size_t>().swap(this->_pos);
+  this->_pass = 2;
+
+  G->_storage.node_sizes = node_sizes;
+  G->init_admin(true);
   return G;
 }
+
+void GraphBuilder::read_file(char const* filename)
+{
+  this->read_file_pass(filename, false);
+  this->read_file_pass(filename, true);
+}
+
+static void flush_edges(GraphBuilder* builder, int fill,
+  vector<size_t>& from, vector<size_t>& to, vector<double>& weights, int has_weights)
+{
+  if (fill)
+    builder->add_edges(from.data(), to.data(), has_weights ? weights.data() : NULL, from.size());
+  else
+    builder->count_edges(from.data(), to.data(), from.size());
+  from.clear();
+  to.clear();
+  weights.clear();
+}
+
+/****************************************************************************
+  Read the edges from a text file in chunks, so that the file is never in
+  memory completely, and either count them or add them to the builder.
+*****************************************************************************/
+void GraphBuilder::read_file_pass(char const* filename, int fill)
+{
+  FILE* file = fopen(filename, "r");
+  if (file == NULL)
+    throw Exception("Could not open edge list file.");
+
+  size_t const chunk_size = 1 << 16;
+  vector<size_t> from, to;
+  vector<double> weights;
+  from.reserve(chunk_size);
+  to.reserve(chunk_size);
+  weights.reserve(chunk_size);
+  int has_weights = false;
+
+  char line[4096];
+  try
+  {
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+      if (strchr(line, '\n') == NULL && !feof(file))
+        throw Exception("Line too long in edge list file.");
+
+      char* p = line;
+      while (*p == ' ' || *p == '\t')
+        p++;
+      if (*p == '#' || *p == '%' || *p == '\n' || *p == '\r' || *p == '\0')
+        continue;
+
+      char* end = NULL;
+      if (!isdigit((unsigned char)*p))
+        throw Exception("Invalid edge in edge list file.");
+      size_t v = (size_t)strtoull(p, &end, 10);
+      p = end;
+      while (*p == ' ' || *p == '\t')
+        p++;
+      if (!isdigit((unsigned char)*p))
+        throw Exception("Invalid edge in edge list file.");
+      size_t u = (size_t)strtoull(p, &end, 10);
+      p = end;
+      while (*p == ' ' || *p == '\t')
+        p++;
+      double w = 1.0;
+      if (*p != '\n' && *p != '\r' && *p != '\0')
+      {
+        w = strtod(p, &end);
+        if (end == p)
+          throw Exception("Invalid weight in edge list file.");
+        has_weights = true;
+      }
+
+      from.push_back(v);
+      to.push_back(u);
+      weights.push_back(w);
+      if (from.size() == chunk_size)
+        flush_edges(this, fill, from, to, weights, has_weights);
+    }
+    if (ferror(file))
+      throw Exception("Could not read edge list file.");
+    flush_edges(this, fill, from, to, weights, has_weights);
+  }
+  catch (std::exception& e)
+  {
+    fclose(file);
+    throw;
+  }
+  fclose(file);
+}
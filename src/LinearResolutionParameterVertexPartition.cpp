@@ -23,3 +23,19 @@ LinearResolutionParameterVertexPartition::LinearResolutionParameterVertexPartiti
 
 LinearResolutionParameterVertexPartition::~LinearResolutionParameterVertexPartition()
 { }
+
+void LinearResolutionParameterVertexPartition::quality_terms(double& E, double& F)
+{
+  E = this->quality(0.0);
+  F = E - this->quality(1.0);
+}
+
+void LinearResolutionParameterVertexPartition::qualities(vector<double> const& resolution_parameters, vector<double>& qualities)
+{
+  double E, F;
+  this->quality_terms(E, F);
+  size_t n_res = resolution_parameters.size();
+  qualities.resize(n_res);
+  for (size_t i = 0; i < n_res; i++)
+    qualities[i] = E - resolution_parameters[i]*F;
+}
@@ -29,6 +29,11 @@ ModularityVertexPartition* ModularityVertexPartition::create(Graph* graph, vecto
   return new ModularityVertexPartition(graph, membership);
 }
 
+ModularityVertexPartition* ModularityVertexPartition::clone()
+{
+  return new ModularityVertexPartition(*this);
+}
+
 /*****************************************************************************
   Returns the difference in modularity if we move a node to a new community
 *****************************************************************************/
@@ -119,6 +124,58 @@ double ModularityVertexPartition::diff_move(size_t v, size_t new_comm)
   return diff/m;
 }
 
+/*****************************************************************************
+  Returns the difference in modularity if we move a node to each of the
+  communities in comms (see diff_move).
+*****************************************************************************/
+void ModularityVertexPartition::diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs)
+{
+  #ifdef DEBUG
+    cerr << "void ModularityVertexPartition::diff_move_all(" << v << ", " << comms.size() << " communities)" << endl;
+  #endif
+  size_t n_comms = comms.size();
+  diffs.resize(n_comms);
+  size_t old_comm = this->_membership[v];
+  double total_weight = this->graph->total_weight()*(2.0 - this->graph->is_directed());
+  if (total_weight == 0.0)
+  {
+    diffs.assign(n_comms, 0.0);
+    return;
+  }
+  double m;
+  if (this->graph->is_directed())
+    m = this->graph->total_weight();
+  else
+    m = 2*this->graph->total_weight();
+
+  vector<double> const& weight_to = this->weights_to_comms(v);
+  vector<double> const& weight_from = this->weights_from_comms(v);
+  size_t n_cached = weight_to.size();
+
+  // Terms that only depend on the node and its current community
+  double w_to_old = old_comm < n_cached ? weight_to[old_comm] : 0.0;
+  double w_from_old = old_comm < n_cached ? weight_from[old_comm] : 0.0;
+  double k_out = this->graph->strength(v, IGRAPH_OUT);
+  double k_in = this->graph->strength(v, IGRAPH_IN);
+  double self_weight = this->graph->node_self_weight(v);
+  double K_out_old = this->total_weight_from_comm(old_comm);
+  double K_in_old = this->total_weight_to_comm(old_comm);
+  double diff_old = (w_to_old - k_out*K_in_old/total_weight) + \
+             (w_from_old - k_in*K_out_old/total_weight);
+
+  for (size_t i = 0; i < n_comms; i++)
+  {
+    size_t new_comm = comms[i];
+    double w_to_new = new_comm < n_cached ? weight_to[new_comm] : 0.0;
+    double w_from_new = new_comm < n_cached ? weight_from[new_comm] : 0.0;
+    double K_out_new = this->total_weight_from_comm(new_comm) + k_out;
+    double K_in_new = this->total_weight_to_comm(new_comm) + k_in;
+    double diff_new = (w_to_new + self_weight - k_out*K_in_new/total_weight) + \
+               (w_from_new + self_weight - k_in*K_out_new/total_weight);
+    diffs[i] = new_comm != old_comm ? (diff_new - diff_old)/m : 0.0;
+  }
+}
+
 
 /*****************************************************************************
   Give the modularity of the partition.
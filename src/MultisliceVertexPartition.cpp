@@ -0,0 +1,257 @@
+#include "MultisliceVertexPartition.h"
+
+MultisliceVertexPartition::MultisliceVertexPartition(Graph* graph, int null_model,
+      vector<size_t> const& membership, double resolution_parameter) :
+        LinearResolutionParameterVertexPartition(graph,
+        membership, resolution_parameter)
+{
+  this->_null_model = null_model;
+  this->check_null_model();
+  this->admin_initialised();
+}
+
+MultisliceVertexPartition::MultisliceVertexPartition(Graph* graph, int null_model,
+      vector<size_t> const& membership) :
+        LinearResolutionParameterVertexPartition(graph,
+        membership)
+{
+  this->_null_model = null_model;
+  this->check_null_model();
+  this->admin_initialised();
+}
+
+MultisliceVertexPartition::MultisliceVertexPartition(Graph* graph, int null_model,
+      double resolution_parameter) :
+        LinearResolutionParameterVertexPartition(graph, resolution_parameter)
+{
+  this->_null_model = null_model;
+  this->check_null_model();
+  this->admin_initialised();
+}
+
+MultisliceVertexPartition::MultisliceVertexPartition(Graph* graph, int null_model) :
+        LinearResolutionParameterVertexPartition(graph)
+{
+  this->_null_model = null_model;
+  this->check_null_model();
+  this->admin_initialised();
+}
+
+MultisliceVertexPartition::~MultisliceVertexPartition()
+{ }
+
+MultisliceVertexPartition* MultisliceVertexPartition::create(Graph* graph)
+{
+  return new MultisliceVertexPartition(graph, this->_null_model, this->resolution_parameter);
+}
+
+MultisliceVertexPartition* MultisliceVertexPartition::create(Graph* graph, vector<size_t> const& membership)
+{
+  return new MultisliceVertexPartition(graph, this->_null_model, membership, this->resolution_parameter);
+}
+
+MultisliceVertexPartition* MultisliceVertexPartition::clone()
+{
+  return new MultisliceVertexPartition(*this);
+}
+
+void MultisliceVertexPartition::check_null_model()
+{
+  if (this->_null_model != CONFIGURATION && this->_null_model != CPM)
+    throw Exception("Unknown null model for multislice partition.");
+  if (this->graph->n_slices() == 0)
+    throw Exception("Multislice partition requires a graph with slices.");
+}
+
+/*****************************************************************************
+  Determine the totals of all parts of communities within a single slice.
+*****************************************************************************/
+void MultisliceVertexPartition::admin_initialised()
+{
+  #ifdef DEBUG
+    cerr << "void MultisliceVertexPartition::admin_initialised()" << endl;
+  #endif
+  this->_slice_totals.clear();
+  size_t n_slices = this->graph->n_slices();
+  size_t n = this->graph->vcount();
+  for (size_t v = 0; v < n; v++)
+  {
+    NodeSlice const* parts = this->graph->node_slices(v);
+    size_t n_parts = this->graph->n_node_slices(v);
+    for (size_t i = 0; i < n_parts; i++)
+    {
+      SliceTotals& totals = this->_slice_totals[this->_membership[v]*n_slices + parts[i].slice];
+      totals.weight_out += parts[i].strength_out;
+      totals.weight_in += parts[i].strength_in;
+      totals.size += parts[i].size;
+      totals.n_parts += 1;
+    }
+  }
+}
+
+/*****************************************************************************
+  Move the parts of node v within each slice from old_comm to new_comm.
+*****************************************************************************/
+void MultisliceVertexPartition::node_moved(size_t v, size_t old_comm, size_t new_comm)
+{
+  size_t n_slices = this->graph->n_slices();
+  NodeSlice const* parts = this->graph->node_slices(v);
+  size_t n_parts = this->graph->n_node_slices(v);
+  for (size_t i = 0; i < n_parts; i++)
+  {
+    std::unordered_map<size_t, SliceTotals>::iterator it =
+        this->_slice_totals.find(old_comm*n_slices + parts[i].slice);
+    SliceTotals& old_totals = it->second;
+    old_totals.weight_out -= parts[i].strength_out;
+    old_totals.weight_in -= parts[i].strength_in;
+    old_totals.size -= parts[i].size;
+    old_totals.n_parts -= 1;
+    if (old_totals.n_parts == 0)
+      this->_slice_totals.erase(it);
+
+    SliceTotals& new_totals = this->_slice_totals[new_comm*n_slices + parts[i].slice];
+    new_totals.weight_out += parts[i].strength_out;
+    new_totals.weight_in += parts[i].strength_in;
+    new_totals.size += parts[i].size;
+    new_totals.n_parts += 1;
+  }
+}
+
+MultisliceVertexPartition::SliceTotals MultisliceVertexPartition::slice_totals(size_t comm, size_t slice) const
+{
+  std::unordered_map<size_t, SliceTotals>::const_iterator it =
+      this->_slice_totals.find(comm*this->graph->n_slices() + slice);
+  if (it != this->_slice_totals.end())
+    return it->second;
+  SliceTotals empty = {0.0, 0.0, 0, 0};
+  return empty;
+}
+
+/*****************************************************************************
+  The difference in the null model, without the resolution parameter, if we
+  move node v from old_comm to new_comm, summed over the slices that v
+  spans. This only depends on the parts of old_comm and new_comm within these
+  slices.
+*****************************************************************************/
+double MultisliceVertexPartition::null_model_diff(size_t v, size_t old_comm, size_t new_comm) const
+{
+  NodeSlice const* parts = this->graph->node_slices(v);
+  size_t n_parts = this->graph->n_node_slices(v);
+  // Subtracting one is only necessary when not correcting for self loops
+  double self_loop_correction = this->graph->correct_self_loops() ? 0.0 : 1.0;
+  double diff = 0.0;
+  for (size_t i = 0; i < n_parts; i++)
+  {
+    NodeSlice const& part = parts[i];
+    SliceTotals old_totals = this->slice_totals(old_comm, part.slice);
+    SliceTotals new_totals = this->slice_totals(new_comm, part.slice);
+    if (this->_null_model == CONFIGURATION)
+    {
+      double total_weight = this->graph->slice_total_weight(part.slice)*(2.0 - this->graph->is_directed());
+      if (total_weight == 0.0)
+        continue;
+      double K_in_new = new_totals.weight_in + part.strength_in;
+      double K_out_new = new_totals.weight_out + part.strength_out;
+      diff += (part.strength_out*(K_in_new - old_totals.weight_in) +
+               part.strength_in*(K_out_new - old_totals.weight_out))/total_weight;
+    }
+    else
+    {
+      double nsize = part.size;
+      diff += nsize*(2.0*new_totals.size + nsize - self_loop_correction) -
+              nsize*(2.0*old_totals.size - nsize - self_loop_correction);
+    }
+  }
+  return diff;
+}
+
+/*****************************************************************************
+  Returns the difference in quality if we move a node to a new community
+*****************************************************************************/
+double MultisliceVertexPartition::diff_move(size_t v, size_t new_comm)
+{
+  #ifdef DEBUG
+    cerr << "double MultisliceVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+  #endif
+  size_t old_comm = this->_membership[v];
+  double diff = 0.0;
+  if (new_comm != old_comm)
+  {
+    double w_to_old = this->weight_to_comm(v, old_comm);
+    double w_from_old = this->weight_from_comm(v, old_comm);
+    double w_to_new = this->weight_to_comm(v, new_comm);
+    double w_from_new = this->weight_from_comm(v, new_comm);
+    double self_weight = this->graph->node_self_weight(v);
+    diff = (w_to_new + w_from_new + 2.0*self_weight) - (w_to_old + w_from_old) -
+        this->resolution_parameter*this->null_model_diff(v, old_comm, new_comm);
+  }
+  #ifdef DEBUG
+    cerr << "exit MultisliceVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+    cerr << "return " << diff << endl << endl;
+  #endif
+  return diff;
+}
+
+/*****************************************************************************
+  Returns the difference in quality if we move a node to each of the
+  communities in comms (see diff_move).
+*****************************************************************************/
+void MultisliceVertexPartition::diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs)
+{
+  size_t n_comms = comms.size();
+  diffs.resize(n_comms);
+  size_t old_comm = this->_membership[v];
+
+  vector<double> const& weight_to = this->weights_to_comms(v);
+  vector<double> const& weight_from = this->weights_from_comms(v);
+  size_t n_cached = weight_to.size();
+
+  double w_to_old = old_comm < n_cached ? weight_to[old_comm] : 0.0;
+  double w_from_old = old_comm < n_cached ? weight_from[old_comm] : 0.0;
+  double self_weight = this->graph->node_self_weight(v);
+
+  for (size_t i = 0; i < n_comms; i++)
+  {
+    size_t new_comm = comms[i];
+    if (new_comm == old_comm)
+    {
+      diffs[i] = 0.0;
+      continue;
+    }
+    double w_to_new = new_comm < n_cached ? weight_to[new_comm] : 0.0;
+    double w_from_new = new_comm < n_cached ? weight_from[new_comm] : 0.0;
+    diffs[i] = (w_to_new + w_from_new + 2.0*self_weight) - (w_to_old + w_from_old) -
+        this->resolution_parameter*this->null_model_diff(v, old_comm, new_comm);
+  }
+}
+
+/*****************************************************************************
+  Give the quality of the partition, which sums the null model over all
+  parts of communities within a single slice.
+******************************************************************************/
+double MultisliceVertexPartition::quality(double resolution_parameter)
+{
+  #ifdef DEBUG
+    cerr << "double MultisliceVertexPartition::quality()" << endl;
+  #endif
+  size_t n_slices = this->graph->n_slices();
+  double mod = this->total_weight_in_all_comms();
+  for (std::unordered_map<size_t, SliceTotals>::const_iterator it = this->_slice_totals.begin();
+       it != this->_slice_totals.end(); it++)
+  {
+    SliceTotals const& totals = it->second;
+    if (this->_null_model == CONFIGURATION)
+    {
+      double total_weight = this->graph->slice_total_weight(it->first % n_slices);
+      if (total_weight > 0.0)
+        mod -= resolution_parameter*totals.weight_out*totals.weight_in/((this->graph->is_directed() ? 1.0 : 4.0)*total_weight);
+    }
+    else
+      mod -= resolution_parameter*this->graph->possible_edges(totals.size);
+  }
+  #ifdef DEBUG
+    cerr << "exit double MultisliceVertexPartition::quality()" << endl;
+    cerr << "return " << mod << endl << endl;
+  #endif
+  return (2.0 - this->graph->is_directed())*mod;
+}
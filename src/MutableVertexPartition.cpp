@@ -1,10 +1,13 @@
 #include "MutableVertexPartition.h"
+#include <cstring>
 
 #ifdef DEBUG
   using std::cerr;
   using std::endl;
 #endif
 
+thread_local size_t MutableVertexPartition::_thread_cache = 0;
+
 /****************************************************************************
   Create a new vertex partition.
 
@@ -38,6 +41,7 @@ MutableVertexPartition::MutableVertexPartition(Graph* graph,
     throw Exception("Membership vector has incorrect size.");
   }
   this->_membership = membership;
+  this->_membership_exports = 0;
   this->init_admin();
 }
 
@@ -46,9 +50,37 @@ MutableVertexPartition::MutableVertexPartition(Graph* graph)
   this->destructor_delete_graph = false;
   this->graph = graph;
   this->_membership = range(graph->vcount());
+  this->_membership_exports = 0;
   this->init_admin();
 }
 
+/****************************************************************************
+  Copy the administration of another partition, which takes time proportional
+  to the number of nodes, instead of recalculating it from all edges. Only
+  the caches are not copied, since they are only valid for a single node.
+*****************************************************************************/
+MutableVertexPartition::MutableVertexPartition(MutableVertexPartition const& partition)
+{
+  this->destructor_delete_graph = false;
+  this->graph = partition.graph;
+  this->_membership = partition._membership;
+  this->_membership_exports = 0;
+  this->_csize = partition._csize;
+  this->_cnodes = partition._cnodes;
+  this->_total_weight_in_comm = partition._total_weight_in_comm;
+  this->_total_weight_to_comm = partition._total_weight_to_comm;
+  this->_total_weight_from_comm = partition._total_weight_from_comm;
+  this->_total_weight_in_all_comms = partition._total_weight_in_all_comms;
+  this->_total_possible_edges_in_all_comms = partition._total_possible_edges_in_all_comms;
+  this->_n_communities = partition._n_communities;
+  this->_empty_communities = partition._empty_communities;
+  this->_comm_first = partition._comm_first;
+  this->_node_next = partition._node_next;
+  this->_node_prev = partition._node_prev;
+  this->_caches.resize(1);
+  this->init_caches();
+}
+
 MutableVertexPartition* MutableVertexPartition::create(Graph* graph)
 {
   return new MutableVertexPartition(graph);
@@ -60,6 +92,11 @@ MutableVertexPartition* MutableVertexPartition::create(Graph* graph, vector<size
 }
 
 
+MutableVertexPartition* MutableVertexPartition::clone()
+{
+  return new MutableVertexPartition(*this);
+}
+
 MutableVertexPartition::~MutableVertexPartition()
 {
   this->clean_mem();
@@ -92,12 +129,50 @@ vector<size_t> MutableVertexPartition::get_community(size_t comm)
 {
   vector<size_t> community;
   community.reserve(this->_cnodes[comm]);
-  for (int i = 0; i < this->graph->vcount(); i++)
-    if (this->_membership[i] == comm)
-      community.push_back(i);
+  size_t n = this->graph->vcount();
+  for (size_t v = this->_comm_first[comm]; v != n; v = this->_node_next[v])
+    community.push_back(v);
+  sort(community.begin(), community.end());
   return community;
 }
 
+/****************************************************************************
+  Add node v to the front of the list of the nodes of comm, or remove it from
+  that list (see _comm_first).
+*****************************************************************************/
+void MutableVertexPartition::link_node(size_t v, size_t comm)
+{
+  size_t first = this->_comm_first[comm];
+  this->_node_prev[v] = this->graph->vcount();
+  this->_node_next[v] = first;
+  if (first != this->graph->vcount())
+    this->_node_prev[first] = v;
+  this->_comm_first[comm] = v;
+}
+
+void MutableVertexPartition::unlink_node(size_t v, size_t comm)
+{
+  size_t prev = this->_node_prev[v];
+  size_t next = this->_node_next[v];
+  if (prev != this->graph->vcount())
+    this->_node_next[prev] = next;
+  else
+    this->_comm_first[comm] = next;
+  if (next != this->graph->vcount())
+    this->_node_prev[next] = prev;
+}
+
+// Link the nodes of each community in increasing order
+void MutableVertexPartition::link_all_nodes()
+{
+  size_t n = this->graph->vcount();
+  this->_comm_first.assign(this->_n_communities, n);
+  this->_node_next.resize(n);
+  this->_node_prev.resize(n);
+  for (size_t v = n; v-- > 0; )
+    this->link_node(v, this->_membership[v]);
+}
+
 vector< vector<size_t> > MutableVertexPartition::get_communities()
 {
   vector< vector<size_t> > communities(this->_n_communities);
@@ -144,10 +219,13 @@ void MutableVertexPartition::init_admin()
   this->_csize.resize(this->_n_communities);
   this->_cnodes.clear();
   this->_cnodes.resize(this->_n_communities);
+  this->_empty_communities.clear();
+
+  this->link_all_nodes();
 
-  this->_current_node_cache_community_from = n + 1; this->_cached_weight_from_community.resize(n, 0);
-  this->_current_node_cache_community_to = n + 1;   this->_cached_weight_to_community.resize(n, 0);
-  this->_current_node_cache_community_all = n + 1;  this->_cached_weight_all_community.resize(n, 0);
+  if (this->_caches.empty())
+    this->_caches.resize(1);
+  this->init_caches();
 
   this->_total_weight_in_all_comms = 0.0;
   for (size_t v = 0; v < n; v++)
@@ -157,6 +235,9 @@ void MutableVertexPartition::init_admin()
     this->_csize[v_comm] += this->graph->node_size(v);
     // Update the community size
     this->_cnodes[v_comm] += 1;
+    // The weight from and to a community is the strength of its nodes
+    this->_total_weight_from_comm[v_comm] += this->graph->strength(v, IGRAPH_OUT);
+    this->_total_weight_to_comm[v_comm] += this->graph->strength(v, IGRAPH_IN);
   }
 
   size_t m = graph->ecount();
@@ -171,27 +252,6 @@ void MutableVertexPartition::init_admin()
 
     // Get the weight of the edge
     double w = this->graph->edge_weight(e);
-    // Add weight to the outgoing weight of community of v
-    this->_total_weight_from_comm[v_comm] += w;
-    #ifdef DEBUG
-      cerr << "\t" << "Add (" << v << ", " << u << ") weight " << w << " to from_comm " << v_comm <<  "." << endl;
-    #endif
-    // Add weight to the incoming weight of community of u
-    this->_total_weight_to_comm[u_comm] += w;
-    #ifdef DEBUG
-      cerr << "\t" << "Add (" << v << ", " << u << ") weight " << w << " to to_comm " << u_comm << "." << endl;
-    #endif
-    if (!this->graph->is_directed())
-    {
-      #ifdef DEBUG
-        cerr << "\t" << "Add (" << u << ", " << v << ") weight " << w << " to from_comm " << u_comm <<  "." << endl;
-      #endif
-      this->_total_weight_from_comm[u_comm] += w;
-      #ifdef DEBUG
-        cerr << "\t" << "Add (" << u << ", " << v << ") weight " << w << " to to_comm " << v_comm << "." << endl;
-      #endif
-      this->_total_weight_to_comm[v_comm] += w;
-    }
     // If it is an edge within a community
     if (v_comm == u_comm)
     {
@@ -222,6 +282,8 @@ void MutableVertexPartition::init_admin()
       this->_empty_communities.push_back(c);
   }
 
+  this->admin_initialised();
+
   #ifdef DEBUG
     cerr << "exit MutableVertexPartition::init_admin()" << endl << endl;
   #endif
@@ -236,6 +298,37 @@ void MutableVertexPartition::update_n_communities()
       this->_n_communities = this->_membership[i] + 1;
 }
 
+/****************************************************************************
+  Sort order stably by decreasing key[order[i]], which is at most max_key,
+  using a counting sort.
+*****************************************************************************/
+static void counting_sort_decreasing(vector<size_t>& order, vector<size_t> const& key, size_t max_key)
+{
+  vector<size_t> start(max_key + 2, 0);
+  for (size_t i = 0; i < order.size(); i++)
+    start[max_key - key[order[i]] + 1] += 1;
+  for (size_t k = 1; k < start.size(); k++)
+    start[k] += start[k - 1];
+  vector<size_t> sorted(order.size());
+  for (size_t i = 0; i < order.size(); i++)
+    sorted[start[max_key - key[order[i]]]++] = order[i];
+  order.swap(sorted);
+}
+
+/****************************************************************************
+  Renumber the values of the communities in values, so that new community c
+  gets the value of old_comm[c], or empty if old_comm[c] is nb_comms, i.e. if
+  there was no such community.
+*****************************************************************************/
+template <class T> static void permute_communities(vector<T>& values, vector<size_t> const& old_comm, size_t new_nb_comms, size_t nb_comms, T empty = T())
+{
+  vector<T> new_values(new_nb_comms, empty);
+  for (size_t c = 0; c < new_nb_comms; c++)
+    if (old_comm[c] != nb_comms)
+      new_values[c] = values[old_comm[c]];
+  values.swap(new_values);
+}
+
 /****************************************************************************
  Renumber the communities so that they are numbered 0,...,q-1 where q is
  the number of communities. This also removes any empty communities, as they
@@ -264,35 +357,35 @@ vector<size_t> MutableVertexPartition::renumber_communities(vector<MutableVertex
       }
     }
   #endif
-  // First sort the communities by size
-  // Csizes
-  // first - community
-  // second - csize
-  // third - number of nodes (may be aggregate nodes), to account for communities with zero weight.
-  vector<size_t*> csizes;
-  for (size_t i = 0; i < nb_comms; i++)
+  // Sort the communities by decreasing size (summed over all layers), then
+  // by decreasing number of nodes (which may be aggregate nodes), to account
+  // for communities with zero size, and then by increasing community. Both
+  // are stable counting sorts, so that the last sort determines the first
+  // criterion, and a tie is broken by the previous order.
+  vector<size_t> csize(nb_comms, 0);
+  vector<size_t> cnodes(nb_comms, 0);
+  size_t max_csize = 0;
+  for (size_t c = 0; c < nb_comms; c++)
   {
-      size_t csize = 0;
-      for (size_t layer = 0; layer < nb_layers; layer++)
-        csize += partitions[layer]->csize(i);
-
-      size_t* row = new size_t[3];
-      row[0] = i;
-      row[1] = csize;
-      row[2] = partitions[0]->cnodes(i);
-      csizes.push_back(row);
+    for (size_t layer = 0; layer < nb_layers; layer++)
+      csize[c] += partitions[layer]->csize(c);
+    cnodes[c] = partitions[0]->cnodes(c);
+    max_csize = std::max(max_csize, csize[c]);
   }
-  sort(csizes.begin(), csizes.end(), orderCSize);
+  vector<size_t> order = range(nb_comms);
+  counting_sort_decreasing(order, cnodes, n);
+  // Node sizes may be large, in which case counting is too expensive
+  if (max_csize <= nb_layers*n + nb_comms)
+    counting_sort_decreasing(order, csize, max_csize);
+  else
+    std::stable_sort(order.begin(), order.end(),
+        [&csize](size_t a, size_t b) { return csize[a] > csize[b]; });
 
   // Then use the sort order to assign new communities,
   // such that the largest community gets the lowest index.
   vector<size_t> new_comm_id(nb_comms, 0);
   for (size_t i = 0; i < nb_comms; i++)
-  {
-    size_t comm = csizes[i][0];
-    new_comm_id[comm] = i;
-    delete[] csizes[i];
-  }
+    new_comm_id[order[i]] = i;
 
   vector<size_t> membership(n, 0);
   for (size_t i = 0; i < n; i++)
@@ -308,7 +401,49 @@ vector<size_t> MutableVertexPartition::renumber_communities(vector<MutableVertex
 *****************************************************************************/
 void MutableVertexPartition::renumber_communities(vector<size_t> const& membership)
 {
-  this->set_membership(membership);
+  size_t n = this->graph->vcount();
+  size_t nb_comms = this->_n_communities;
+
+  // Check whether membership only renumbers the communities, i.e. whether
+  // each community has a single new number, which differs between
+  // communities. Otherwise, we set the membership as usual.
+  vector<size_t> new_comm(nb_comms, n);
+  vector<size_t> old_comm(n, nb_comms);
+  size_t new_nb_comms = 0;
+  for (size_t v = 0; v < n; v++)
+  {
+    size_t comm = this->_membership[v];
+    size_t new_c = membership[v];
+    if (new_c >= n || (new_comm[comm] != n && new_comm[comm] != new_c) ||
+        (old_comm[new_c] != nb_comms && old_comm[new_c] != comm))
+    {
+      this->set_membership(membership);
+      return;
+    }
+    new_comm[comm] = new_c;
+    old_comm[new_c] = comm;
+    if (new_c >= new_nb_comms)
+      new_nb_comms = new_c + 1;
+  }
+
+  // Then we only have to renumber the administration of the communities,
+  // instead of initialising it from the graph again.
+  permute_communities(this->_csize, old_comm, new_nb_comms, nb_comms);
+  permute_communities(this->_cnodes, old_comm, new_nb_comms, nb_comms);
+  permute_communities(this->_total_weight_in_comm, old_comm, new_nb_comms, nb_comms);
+  permute_communities(this->_total_weight_from_comm, old_comm, new_nb_comms, nb_comms);
+  permute_communities(this->_total_weight_to_comm, old_comm, new_nb_comms, nb_comms);
+  permute_communities(this->_comm_first, old_comm, new_nb_comms, nb_comms, n);
+  this->_n_communities = new_nb_comms;
+  std::copy(membership.begin(), membership.begin() + n, this->_membership.begin());
+  this->_empty_communities.clear();
+  for (size_t c = 0; c < new_nb_comms; c++)
+    if (this->_cnodes[c] == 0)
+      this->_empty_communities.push_back(c);
+
+  // The cached communities of neighbours are no longer valid
+  this->init_caches();
+  this->admin_initialised();
 }
 
 size_t MutableVertexPartition::get_empty_community()
@@ -357,6 +492,7 @@ size_t MutableVertexPartition::add_empty_community()
   this->_total_weight_in_comm.resize(this->_n_communities);   this->_total_weight_in_comm[new_comm] = 0;
   this->_total_weight_from_comm.resize(this->_n_communities); this->_total_weight_from_comm[new_comm] = 0;
   this->_total_weight_to_comm.resize(this->_n_communities);   this->_total_weight_to_comm[new_comm] = 0;
+  this->_comm_first.resize(this->_n_communities);             this->_comm_first[new_comm] = this->graph->vcount();
 
   this->_empty_communities.push_back(new_comm);
   #ifdef DEBUG
@@ -462,6 +598,20 @@ void MutableVertexPartition::move_node(size_t v,size_t new_comm)
   // Add to new community
   this->_cnodes[new_comm] += 1;
   this->_csize[new_comm] += this->graph->node_size(v);
+  if (new_comm != old_comm)
+  {
+    this->unlink_node(v, old_comm);
+    this->link_node(v, new_comm);
+  }
+
+  // Move the strength of the node, which is the weight of all its outgoing
+  // (and incoming) links. This does not depend on the links themselves, so
+  // that this remains correct for a partition of the subgraph of a
+  // community (see Graph::subgraph), which lacks the links leaving it.
+  this->_total_weight_from_comm[old_comm] -= this->graph->strength(v, IGRAPH_OUT);
+  this->_total_weight_from_comm[new_comm] += this->graph->strength(v, IGRAPH_OUT);
+  this->_total_weight_to_comm[old_comm] -= this->graph->strength(v, IGRAPH_IN);
+  this->_total_weight_to_comm[new_comm] += this->graph->strength(v, IGRAPH_IN);
 
   // Switch outgoing links
   #ifdef DEBUG
@@ -475,8 +625,7 @@ void MutableVertexPartition::move_node(size_t v,size_t new_comm)
     igraph_neimode_t mode = modes[mode_i];
 
     // Loop over all incident edges
-    vector<size_t> const& neighbours = this->graph->get_neighbours(v, mode);
-    vector<size_t> const& neighbour_edges = this->graph->get_neighbour_edges(v, mode);
+    NeighbourRange neighbours = this->graph->get_neighbours(v, mode);
 
     size_t degree = neighbours.size();
 
@@ -491,40 +640,11 @@ void MutableVertexPartition::move_node(size_t v,size_t new_comm)
 
     for (size_t idx = 0; idx < degree; idx++)
     {
-      size_t u = neighbours[idx];
-      size_t e = neighbour_edges[idx];
+      size_t u = neighbours[idx].node;
 
       size_t u_comm = this->_membership[u];
       // Get the weight of the edge
-      double w = this->graph->edge_weight(e);
-      if (mode == IGRAPH_OUT)
-      {
-        // Remove the weight from the outgoing weights of the old community
-        this->_total_weight_from_comm[old_comm] -= w;
-        // Add the weight to the outgoing weights of the new community
-        this->_total_weight_from_comm[new_comm] += w;
-        #ifdef DEBUG
-          cerr << "\t" << "Moving link (" << v << "-" << u << ") "
-               << "outgoing weight " << w
-               << " from " << old_comm << " to " << new_comm
-               << "." << endl;
-        #endif
-      }
-      else if (mode == IGRAPH_IN)
-      {
-        // Remove the weight from the outgoing weights of the old community
-        this->_total_weight_to_comm[old_comm] -= w;
-        // Add the weight to the outgoing weights of the new community
-        this->_total_weight_to_comm[new_comm] += w;
-        #ifdef DEBUG
-          cerr << "\t" << "Moving link (" << v << "-" << u << ") "
-               << "incoming weight " << w
-               << " from " << old_comm << " to " << new_comm
-               << "." << endl;
-        #endif
-      }
-      else
-        throw Exception("Incorrect mode for updating the admin.");
+      double w = neighbours[idx].weight;
       // Get internal weight (if it is an internal edge)
       double int_weight = w/(this->graph->is_directed() ? 1.0 : 2.0)/( u == v ? 2.0 : 1.0);
       // If it is an internal edge in the old community
@@ -564,6 +684,15 @@ void MutableVertexPartition::move_node(size_t v,size_t new_comm)
   #endif
   // Update the membership vector
   this->_membership[v] = new_comm;
+  this->node_moved(v, old_comm, new_comm);
+
+  // The cached weights of the neighbours of v are no longer valid
+  size_t n = this->graph->vcount();
+  for (vector<NeighbourCommunityCache>::iterator it = this->_caches.begin();
+       it != this->_caches.end(); it++)
+  {
+    it->current_node = n + 1;
+  }
   #ifdef DEBUG
     cerr << "exit MutableVertexPartition::move_node(" << v << ", " << new_comm << ")" << endl << endl;
   #endif
@@ -617,6 +746,43 @@ void MutableVertexPartition::from_coarse_partition(vector<size_t> const& coarse_
 }
 
 
+/****************************************************************************
+ Use the partition for another graph. The vectors of the administration are
+ only cleared, so that they keep their capacity.
+****************************************************************************/
+void MutableVertexPartition::reset(Graph* graph)
+{
+  if (this->destructor_delete_graph)
+    throw Exception("Cannot reset a partition that deletes its graph.");
+  if (this->_membership_exports > 0)
+    throw Exception("Cannot reset a partition whose membership is exported.");
+  this->graph = graph;
+  size_t n = graph->vcount();
+  this->_membership.resize(n);
+  for (size_t v = 0; v < n; v++)
+    this->_membership[v] = v;
+  this->_empty_communities.clear();
+  this->clean_mem();
+  this->init_admin();
+  this->graph_changed();
+}
+
+void MutableVertexPartition::reset(Graph* graph, vector<size_t> const& membership)
+{
+  if (this->destructor_delete_graph)
+    throw Exception("Cannot reset a partition that deletes its graph.");
+  if (this->_membership_exports > 0)
+    throw Exception("Cannot reset a partition whose membership is exported.");
+  if (membership.size() != graph->vcount())
+    throw Exception("Membership vector has incorrect size.");
+  this->graph = graph;
+  this->_membership.assign(membership.begin(), membership.end());
+  this->_empty_communities.clear();
+  this->clean_mem();
+  this->init_admin();
+  this->graph_changed();
+}
+
 /****************************************************************************
  Read new partition from another partition.
 ****************************************************************************/
@@ -630,6 +796,200 @@ void MutableVertexPartition::from_partition(MutableVertexPartition* partition)
   this->init_admin();
 }
 
+/****************************************************************************
+  Partition states (see checkpoint).
+
+  A state starts with a PartitionStateHeader, followed by these arrays, in
+  this order:
+
+    membership              n integers
+    csize                   n_communities integers
+    cnodes                  n_communities integers
+    total_weight_in_comm    n_communities doubles
+    total_weight_to_comm    n_communities doubles
+    total_weight_from_comm  n_communities doubles
+    empty_communities       n_empty integers
+
+  All integers and doubles are 8 bytes in native byte order, similar to
+  binary graph files (see Graph::save). The number of edges and the total
+  weight of the graph are recorded, so that a state is not restored on a
+  different graph by accident.
+*****************************************************************************/
+static const char PARTITION_STATE_MAGIC[8] = {'L', 'E', 'I', 'D', 'E', 'N', 'P', 'S'};
+static const uint64_t PARTITION_STATE_BYTE_ORDER = 0x0102030405060708ULL;
+static const uint64_t PARTITION_STATE_VERSION = 1;
+
+struct PartitionStateHeader
+{
+  char magic[8];
+  uint64_t byte_order;
+  uint64_t version;
+  uint64_t n;
+  uint64_t m;
+  uint64_t n_communities;
+  uint64_t n_empty;
+  uint64_t total_possible_edges_in_all_comms;
+  double total_weight_in_all_comms;
+  double graph_total_weight;
+};
+
+template <class T> void append_state_array(string& state, vector<T> const& values)
+{
+  if (!values.empty())
+    state.append((char const*)values.data(), values.size()*sizeof(T));
+}
+
+template <class T> void read_state_array(char const*& data, vector<T>& values, size_t size)
+{
+  values.resize(size);
+  if (size > 0)
+    memcpy(values.data(), data, size*sizeof(T));
+  data += size*sizeof(T);
+}
+
+/****************************************************************************
+ Write the membership and the administration to a binary state (see above),
+ which can be read back using restore.
+*****************************************************************************/
+string MutableVertexPartition::checkpoint()
+{
+  if (sizeof(size_t) != sizeof(uint64_t))
+    throw Exception("Partition states require 64 bit integers.");
+
+  PartitionStateHeader header;
+  memcpy(header.magic, PARTITION_STATE_MAGIC, sizeof(header.magic));
+  header.byte_order = PARTITION_STATE_BYTE_ORDER;
+  header.version = PARTITION_STATE_VERSION;
+  header.n = this->graph->vcount();
+  header.m = this->graph->ecount();
+  header.n_communities = this->_n_communities;
+  header.n_empty = this->_empty_communities.size();
+  header.total_possible_edges_in_all_comms = this->_total_possible_edges_in_all_comms;
+  header.total_weight_in_all_comms = this->_total_weight_in_all_comms;
+  header.graph_total_weight = this->graph->total_weight();
+
+  string state;
+  state.reserve(sizeof(header) + (header.n + 5*header.n_communities + header.n_empty)*8);
+  state.append((char const*)&header, sizeof(header));
+  append_state_array(state, this->_membership);
+  append_state_array(state, this->_csize);
+  append_state_array(state, this->_cnodes);
+  append_state_array(state, this->_total_weight_in_comm);
+  append_state_array(state, this->_total_weight_to_comm);
+  append_state_array(state, this->_total_weight_from_comm);
+  append_state_array(state, this->_empty_communities);
+  return state;
+}
+
+/****************************************************************************
+ Read the membership and the administration from a state written by
+ checkpoint, for a partition of the same graph. Only the index of the nodes
+ of each community is rebuilt from the membership, which does not require
+ considering the edges.
+*****************************************************************************/
+void MutableVertexPartition::restore(string const& state)
+{
+  if (sizeof(size_t) != sizeof(uint64_t))
+    throw Exception("Partition states require 64 bit integers.");
+
+  PartitionStateHeader header;
+  if (state.size() < sizeof(header))
+    throw Exception("Not a partition state.");
+  memcpy(&header, state.data(), sizeof(header));
+  if (memcmp(header.magic, PARTITION_STATE_MAGIC, sizeof(header.magic)) != 0)
+    throw Exception("Not a partition state.");
+  if (header.byte_order != PARTITION_STATE_BYTE_ORDER)
+    throw Exception("Partition state was written with a different byte order.");
+  if (header.version != PARTITION_STATE_VERSION)
+    throw Exception("Unsupported version of partition state.");
+
+  size_t n = this->graph->vcount();
+  if (header.n != n || header.m != this->graph->ecount() ||
+      header.graph_total_weight != this->graph->total_weight())
+    throw Exception("Partition state is for a different graph.");
+  if (header.n_communities > state.size()/40 || header.n_empty > header.n_communities ||
+      state.size() != sizeof(header) + (n + 5*header.n_communities + header.n_empty)*8)
+    throw Exception("Partition state has an incorrect size.");
+
+  size_t nb_comms = header.n_communities;
+  char const* data = state.data() + sizeof(header);
+  vector<size_t> membership;
+  read_state_array(data, membership, n);
+  vector<size_t> empty_communities;
+  data += 5*nb_comms*8;
+  read_state_array(data, empty_communities, header.n_empty);
+  for (size_t v = 0; v < n; v++)
+    if (membership[v] >= nb_comms)
+      throw Exception("Partition state has an incorrect membership.");
+  for (size_t i = 0; i < header.n_empty; i++)
+    if (empty_communities[i] >= nb_comms)
+      throw Exception("Partition state has an incorrect empty community.");
+
+  // Only change the partition once the state is known to be valid. The
+  // membership is copied, so that it keeps its storage, to which views on the
+  // membership may point.
+  std::copy(membership.begin(), membership.end(), this->_membership.begin());
+  this->_empty_communities.swap(empty_communities);
+  data = state.data() + sizeof(header) + n*8;
+  read_state_array(data, this->_csize, nb_comms);
+  read_state_array(data, this->_cnodes, nb_comms);
+  read_state_array(data, this->_total_weight_in_comm, nb_comms);
+  read_state_array(data, this->_total_weight_to_comm, nb_comms);
+  read_state_array(data, this->_total_weight_from_comm, nb_comms);
+  this->_n_communities = nb_comms;
+  this->_total_weight_in_all_comms = header.total_weight_in_all_comms;
+  this->_total_possible_edges_in_all_comms = header.total_possible_edges_in_all_comms;
+
+  this->link_all_nodes();
+  this->init_caches();
+  this->admin_initialised();
+}
+
+/****************************************************************************
+ Update the administration after the edges of the graph have changed (see
+ Graph::add_edges, Graph::delete_edges and Graph::set_edge_weights), in the
+ same way as init_admin does for each edge. This takes time proportional to
+ the number of changes, instead of O(n + m).
+
+ This should be done for every partition of the graph, for exactly the
+ changes that were made to the graph since the administration was last
+ (re)initialised.
+*****************************************************************************/
+void MutableVertexPartition::apply_edge_changes(EdgeChanges const& changes)
+{
+  size_t n_changes = changes.size();
+  for (size_t i = 0; i < n_changes; i++)
+  {
+    size_t v = changes.from[i];
+    size_t u = changes.to[i];
+    double w = changes.weight[i];
+
+    size_t v_comm = this->_membership[v];
+    size_t u_comm = this->_membership[u];
+
+    this->_total_weight_from_comm[v_comm] += w;
+    this->_total_weight_to_comm[u_comm] += w;
+    if (!this->graph->is_directed())
+    {
+      this->_total_weight_from_comm[u_comm] += w;
+      this->_total_weight_to_comm[v_comm] += w;
+    }
+    if (v_comm == u_comm)
+    {
+      this->_total_weight_in_comm[v_comm] += w;
+      this->_total_weight_in_all_comms += w;
+    }
+  }
+
+  // The cached weights of the neighbours are no longer valid
+  size_t n = this->graph->vcount();
+  for (vector<NeighbourCommunityCache>::iterator it = this->_caches.begin();
+       it != this->_caches.end(); it++)
+  {
+    it->current_node = n + 1;
+  }
+}
+
 /****************************************************************************
  Calculate what is the total weight going from a node to a community.
 
@@ -639,14 +999,9 @@ void MutableVertexPartition::from_partition(MutableVertexPartition* partition)
 *****************************************************************************/
 double MutableVertexPartition::weight_to_comm(size_t v, size_t comm)
 {
-  if (this->_current_node_cache_community_to != v)
-  {
-    this->cache_neigh_communities(v, IGRAPH_OUT);
-    this->_current_node_cache_community_to = v;
-  }
-
-  if (comm < this->_cached_weight_to_community.size())
-    return this->_cached_weight_to_community[comm];
+  vector<double> const& weight_to_community = this->weights_to_comms(v);
+  if (comm < weight_to_community.size())
+    return weight_to_community[comm];
   else
     return 0.0;
 }
@@ -660,128 +1015,201 @@ double MutableVertexPartition::weight_to_comm(size_t v, size_t comm)
 *****************************************************************************/
 double MutableVertexPartition::weight_from_comm(size_t v, size_t comm)
 {
-  if (this->_current_node_cache_community_from != v)
-  {
-    this->cache_neigh_communities(v, IGRAPH_IN);
-    this->_current_node_cache_community_from = v;
-  }
-
-  if (comm < this->_cached_weight_from_community.size())
-    return this->_cached_weight_from_community[comm];
+  vector<double> const& weight_from_community = this->weights_from_comms(v);
+  if (comm < weight_from_community.size())
+    return weight_from_community[comm];
   else
     return 0.0;
 }
 
-void MutableVertexPartition::cache_neigh_communities(size_t v, igraph_neimode_t mode)
+vector<double> const& MutableVertexPartition::weights_to_comms(size_t v)
 {
-  // TODO: We can probably calculate at once the IN, OUT and ALL
-  // rather than this being called multiple times.
+  NeighbourCommunityCache& cache = this->cache();
+  if (cache.current_node != v)
+    this->cache_neigh_communities(v);
+  return this->graph->is_directed() ? cache.weight_to_community : cache.weight_all_community;
+}
 
-  // Weight between vertex and community
-  #ifdef DEBUG
-    cerr << "double MutableVertexPartition::cache_neigh_communities(" << v << ", " << mode << ")." << endl;
-  #endif
-  vector<double>* _cached_weight_tofrom_community = NULL;
-  vector<size_t>* _cached_neighs = NULL;
-  switch (mode)
+vector<double> const& MutableVertexPartition::weights_from_comms(size_t v)
+{
+  NeighbourCommunityCache& cache = this->cache();
+  if (cache.current_node != v)
+    this->cache_neigh_communities(v);
+  return this->graph->is_directed() ? cache.weight_from_community : cache.weight_all_community;
+}
+
+/****************************************************************************
+ Calculate the difference in quality when moving node v to each of the
+ communities in comms.
+
+    Parameters:
+      v      -- The node which to move.
+      comms  -- The communities to consider.
+      diffs  -- The difference in quality for each community (output).
+*****************************************************************************/
+void MutableVertexPartition::diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs)
+{
+  size_t n_comms = comms.size();
+  diffs.resize(n_comms);
+  for (size_t i = 0; i < n_comms; i++)
+    diffs[i] = this->diff_move(v, comms[i]);
+}
+
+/****************************************************************************
+ Prepare the caches of the neighbouring communities, after the
+ administration has been (re)initialised.
+*****************************************************************************/
+void MutableVertexPartition::init_caches()
+{
+  size_t n = this->graph->vcount();
+  // The weight from and to communities is only kept separately for directed graphs
+  size_t n_directed = this->graph->is_directed() ? n : 0;
+  for (vector<NeighbourCommunityCache>::iterator it = this->_caches.begin();
+       it != this->_caches.end(); it++)
   {
-    case IGRAPH_IN:
-      _cached_weight_tofrom_community = &(this->_cached_weight_from_community);
-      _cached_neighs = &(this->_cached_neigh_comms_from);
-      break;
-    case IGRAPH_OUT:
-      _cached_weight_tofrom_community = &(this->_cached_weight_to_community);
-      _cached_neighs = &(this->_cached_neigh_comms_to);
-      break;
-    case IGRAPH_ALL:
-      _cached_weight_tofrom_community = &(this->_cached_weight_all_community);
-      _cached_neighs = &(this->_cached_neigh_comms_all);
-      break;
+    it->current_node = n + 1;
+    it->weight_from_community.assign(n_directed, 0); it->neigh_comms_from.clear();
+    it->weight_to_community.assign(n_directed, 0);   it->neigh_comms_to.clear();
+    it->weight_all_community.assign(n, 0);           it->neigh_comms_all.clear();
   }
+}
 
-  // Reset cached communities
-  for (vector<size_t>::iterator it = _cached_neighs->begin();
-       it != _cached_neighs->end();
+void MutableVertexPartition::set_n_caches(size_t n_caches)
+{
+  if (n_caches < 1)
+    n_caches = 1;
+  this->_caches.resize(n_caches);
+  this->init_caches();
+}
+
+void MutableVertexPartition::set_thread_cache(size_t idx)
+{
+  _thread_cache = idx;
+}
+
+// Reset the weights of the cached neighbouring communities
+inline void reset_neigh_communities(vector<double>& weight_community, vector<size_t>& neigh_comms)
+{
+  for (vector<size_t>::iterator it = neigh_comms.begin();
+       it != neigh_comms.end();
        it++)
-       (*_cached_weight_tofrom_community)[*it] = 0;
+       weight_community[*it] = 0;
+  neigh_comms.clear();
+}
+
+// Add weight w to the weight of community comm
+inline void add_neigh_community(vector<double>& weight_community, vector<size_t>& neigh_comms, size_t comm, double w)
+{
+  double prev_w = weight_community[comm];
+  weight_community[comm] += w;
+  // REMARK: Notice in the rare case of negative weights, being exactly equal
+  // for a certain community, that this community may then potentially be added multiple
+  // times to the neigh_comms. However, I don' believe this causes any further issue,
+  // so that's why I leave this here as is.
+  if (prev_w == 0 && weight_community[comm] != 0)
+    neigh_comms.push_back(comm);
+}
 
-  // Loop over all incident edges
-  vector<size_t> const& neighbours = this->graph->get_neighbours(v, mode);
-  vector<size_t> const& neighbour_edges = this->graph->get_neighbour_edges(v, mode);
+/****************************************************************************
+ Cache the weight from and to the neighbouring communities of node v, and
+ which communities are neighbouring, for IGRAPH_IN, IGRAPH_OUT and IGRAPH_ALL
+ in a single pass over the neighbours of v.
+
+ The neighbours of v are stored with the outgoing neighbours first, followed
+ by the incoming neighbours, which together form all neighbours. For
+ undirected graphs all modes are identical, and only IGRAPH_ALL is cached.
+*****************************************************************************/
+void MutableVertexPartition::cache_neigh_communities(size_t v)
+{
+  #ifdef DEBUG
+    cerr << "double MutableVertexPartition::cache_neigh_communities(" << v << ")." << endl;
+  #endif
+  NeighbourCommunityCache& cache = this->cache();
 
-  size_t degree = neighbours.size();
+  reset_neigh_communities(cache.weight_all_community, cache.neigh_comms_all);
 
-  // Reset cached neighbours
-  _cached_neighs->clear();
-  _cached_neighs->reserve(degree);
-  for (size_t idx = 0; idx < degree; idx++)
+  if (this->graph->is_directed())
   {
-    size_t u = neighbours[idx];
-    size_t e = neighbour_edges[idx];
+    reset_neigh_communities(cache.weight_to_community, cache.neigh_comms_to);
+    reset_neigh_communities(cache.weight_from_community, cache.neigh_comms_from);
 
-    // If it is an edge to the requested community
-    #ifdef DEBUG
-      size_t u_comm = this->_membership[u];
-    #endif
-    size_t comm = this->_membership[u];
-    // Get the weight of the edge
-    double w = this->graph->edge_weight(e);
-    // Self loops appear twice here if the graph is undirected, so divide by 2.0 in that case.
-    if (u == v && !this->graph->is_directed())
+    NeighbourRange out_neighbours = this->graph->get_neighbours(v, IGRAPH_OUT);
+    for (Neighbour const* it_neigh = out_neighbours.begin(); it_neigh != out_neighbours.end(); it_neigh++)
+    {
+      size_t comm = this->_membership[it_neigh->node];
+      double w = it_neigh->weight;
+      #ifdef DEBUG
+        cerr << "\t" << "Edge (" << v << "->" << it_neigh->node << "), Comm " << comm << " weight: " << w << "." << endl;
+      #endif
+      add_neigh_community(cache.weight_to_community, cache.neigh_comms_to, comm, w);
+      add_neigh_community(cache.weight_all_community, cache.neigh_comms_all, comm, w);
+    }
+
+    NeighbourRange in_neighbours = this->graph->get_neighbours(v, IGRAPH_IN);
+    for (Neighbour const* it_neigh = in_neighbours.begin(); it_neigh != in_neighbours.end(); it_neigh++)
+    {
+      size_t comm = this->_membership[it_neigh->node];
+      double w = it_neigh->weight;
+      #ifdef DEBUG
+        cerr << "\t" << "Edge (" << v << "<-" << it_neigh->node << "), Comm " << comm << " weight: " << w << "." << endl;
+      #endif
+      add_neigh_community(cache.weight_from_community, cache.neigh_comms_from, comm, w);
+      add_neigh_community(cache.weight_all_community, cache.neigh_comms_all, comm, w);
+    }
+  }
+  else
+  {
+    NeighbourRange neighbours = this->graph->get_neighbours(v, IGRAPH_ALL);
+    for (Neighbour const* it_neigh = neighbours.begin(); it_neigh != neighbours.end(); it_neigh++)
+    {
+      size_t u = it_neigh->node;
+      size_t comm = this->_membership[u];
+      double w = it_neigh->weight;
+      // Self loops appear twice here if the graph is undirected, so divide by 2.0 in that case.
+      if (u == v)
         w /= 2.0;
-    #ifdef DEBUG
-      cerr << "\t" << "Edge (" << v << "-" << u << "), Comm (" << comm << "-" << u_comm << ") weight: " << w << "." << endl;
-    #endif
-    (*_cached_weight_tofrom_community)[comm] += w;
-    // REMARK: Notice in the rare case of negative weights, being exactly equal
-    // for a certain community, that this community may then potentially be added multiple
-    // times to the _cached_neighs. However, I don' believe this causes any further issue,
-    // so that's why I leave this here as is.
-    if ((*_cached_weight_tofrom_community)[comm] != 0)
-      _cached_neighs->push_back(comm);
+      #ifdef DEBUG
+        cerr << "\t" << "Edge (" << v << "-" << u << "), Comm " << comm << " weight: " << w << "." << endl;
+      #endif
+      add_neigh_community(cache.weight_all_community, cache.neigh_comms_all, comm, w);
+    }
   }
+
+  cache.current_node = v;
   #ifdef DEBUG
-    cerr << "exit Graph::cache_neigh_communities(" << v << ", " << mode << ")." << endl;
+    cerr << "exit Graph::cache_neigh_communities(" << v << ")." << endl;
   #endif
 }
 
 vector<size_t> const& MutableVertexPartition::get_neigh_comms(size_t v, igraph_neimode_t mode)
 {
+  NeighbourCommunityCache& cache = this->cache();
+  if (cache.current_node != v)
+    this->cache_neigh_communities(v);
+
+  if (!this->graph->is_directed())
+    return cache.neigh_comms_all;
+
   switch (mode)
   {
     case IGRAPH_IN:
-      if (this->_current_node_cache_community_from != v)
-      {
-        cache_neigh_communities(v, mode);
-        this->_current_node_cache_community_from = v;
-      }
-      return this->_cached_neigh_comms_from;
+      return cache.neigh_comms_from;
     case IGRAPH_OUT:
-      if (this->_current_node_cache_community_to != v)
-      {
-        cache_neigh_communities(v, mode);
-        this->_current_node_cache_community_to = v;
-      }
-      return this->_cached_neigh_comms_to;
+      return cache.neigh_comms_to;
     case IGRAPH_ALL:
-      if (this->_current_node_cache_community_all != v)
-      {
-        cache_neigh_communities(v, mode);
-        this->_current_node_cache_community_all = v;
-      }
-      return this->_cached_neigh_comms_all;
+      return cache.neigh_comms_all;
   }
   throw Exception("Problem obtaining neighbour communities, invalid mode.");
 }
 
 set<size_t> MutableVertexPartition::get_neigh_comms(size_t v, igraph_neimode_t mode, vector<size_t> const& constrained_membership)
 {
-  size_t degree = this->graph->degree(v, mode);
-  vector<size_t> const& neigh = this->graph->get_neighbours(v, mode);
+  NeighbourRange neigh = this->graph->get_neighbours(v, mode);
+  size_t degree = neigh.size();
   set<size_t> neigh_comms;
   for (size_t i=0; i < degree; i++)
   {
-    size_t u = neigh[i];
+    size_t u = neigh[i].node;
     if (constrained_membership[v] == constrained_membership[u])
       neigh_comms.insert( this->membership(u) );
   }
@@ -1,4 +1,17 @@
 #include "Optimiser.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cmath>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
 
 /****************************************************************************
   Create a new Optimiser object
@@ -19,6 +32,20 @@
         RAND_COMM       -- Consider a random commmunity for improvement.
         RAND_NEIGH_COMM -- Consider a random community among the neighbours
                            for improvement.
+    visit_order
+                 -- Order in which nodes are visited when moving nodes:
+        FIFO_ORDER      -- In the order in which they were queued.
+        GAIN_ORDER      -- Nodes queued by the largest improvement first.
+        DEGREE_ORDER    -- Nodes of the highest degree first.
+        BOUNDED_ORDER   -- In the order in which they were queued, but nodes
+                           are frozen after max_unproductive_visits visits
+                           without moving.
+    relabel_nodes
+                 -- Order in which nodes are relabelled before optimising:
+        NO_RELABEL      -- Keep the original labels.
+        RCM_RELABEL     -- Reverse Cuthill-McKee order, so that neighbours
+                           have close labels.
+        DEGREE_RELABEL  -- Order of decreasing degree.
 ****************************************************************************/
 Optimiser::Optimiser()
 {
@@ -28,6 +55,18 @@ Optimiser::Optimiser()
   this->refine_routine = Optimiser::MERGE_NODES;
   this->refine_partition = true;
   this->consider_empty_community = true;
+  this->n_threads = 1;
+  this->max_levels = 0;
+  this->visit_order = Optimiser::FIFO_ORDER;
+  this->max_unproductive_visits = 3;
+  this->relabel_nodes = Optimiser::NO_RELABEL;
+  this->record_hierarchy = false;
+  this->_candidates.resize(1);
+  this->_has_deadline = false;
+  this->_timed_out = false;
+  this->_deadline_checks = 0;
+  this->_control = NULL;
+  this->_cancelled = false;
 
   igraph_rng_init(&rng, &igraph_rngtype_mt19937);
   igraph_rng_seed(&rng, rand());
@@ -36,6 +75,57 @@ Optimiser::Optimiser()
 Optimiser::~Optimiser()
 {
   igraph_rng_destroy(&rng);
+  this->clear_partition_pool();
+  for (size_t i = 0; i < this->_graph_pool.size(); i++)
+    delete this->_graph_pool[i];
+}
+
+/*****************************************************************************
+  Collapse graph according to partition, reusing a graph of a previous
+  aggregation level if there is one.
+******************************************************************************/
+Graph* Optimiser::level_graph(Graph* graph, MutableVertexPartition* partition)
+{
+  if (this->_graph_pool.empty())
+    return graph->collapse_graph(partition);
+  Graph* G = this->_graph_pool.back();
+  this->_graph_pool.pop_back();
+  graph->collapse_graph(partition, G);
+  return G;
+}
+
+/*****************************************************************************
+  Create a partition of graph of the same type as partition, which is in the
+  given layer, with the given membership (or each node in its own community if
+  membership is NULL). A partition of a previous aggregation level of the same
+  layer is reused if there is one.
+******************************************************************************/
+MutableVertexPartition* Optimiser::level_partition(size_t layer, MutableVertexPartition* partition, Graph* graph, vector<size_t> const* membership)
+{
+  vector<MutableVertexPartition*>& pool = this->_partition_pool[layer];
+  if (pool.empty())
+  {
+    if (membership == NULL)
+      return partition->create(graph);
+    return partition->create(graph, *membership);
+  }
+  MutableVertexPartition* new_partition = pool.back();
+  pool.pop_back();
+  if (membership == NULL)
+    new_partition->reset(graph);
+  else
+    new_partition->reset(graph, *membership);
+  return new_partition;
+}
+
+void Optimiser::clear_partition_pool()
+{
+  for (size_t layer = 0; layer < this->_partition_pool.size(); layer++)
+  {
+    for (size_t i = 0; i < this->_partition_pool[layer].size(); i++)
+      delete this->_partition_pool[layer][i];
+    this->_partition_pool[layer].clear();
+  }
 }
 
 void Optimiser::print_settings()
@@ -44,6 +134,140 @@ void Optimiser::print_settings()
   cerr << "Refine partition:\t" << this->refine_partition << endl;
 }
 
+/*****************************************************************************
+  Create an empty queue for the nodes of graph, visiting them in the given
+  order (see Optimiser::visit_order).
+******************************************************************************/
+NodeQueue::NodeQueue(int order, Graph* graph, size_t max_unproductive_visits)
+{
+  if (order != Optimiser::FIFO_ORDER && order != Optimiser::GAIN_ORDER &&
+      order != Optimiser::DEGREE_ORDER && order != Optimiser::BOUNDED_ORDER)
+    throw Exception("Unknown order for visiting nodes.");
+  size_t n = graph->vcount();
+  this->_order = order;
+  this->_graph = graph;
+  this->_max_unproductive_visits = (order == Optimiser::BOUNDED_ORDER) ? max_unproductive_visits : 0;
+  this->_size = 0;
+  this->_is_queued.assign(n, false);
+  if (this->_max_unproductive_visits > 0)
+    this->_unproductive_visits.assign(n, 0);
+  this->_buckets.resize(1);
+  this->_first_bucket = 0;
+  this->_seq = 0;
+}
+
+int NodeQueue::push(size_t v, double gain)
+{
+  if (this->_is_queued[v] || this->is_frozen(v))
+    return false;
+  this->_is_queued[v] = true;
+  this->_size += 1;
+  if (this->_order == Optimiser::GAIN_ORDER)
+  {
+    GainEntry entry = {gain, this->_seq++, v};
+    this->_gain_queue.push(entry);
+  }
+  else if (this->_order == Optimiser::DEGREE_ORDER)
+  {
+    // Bucket b contains the degrees from 2^b - 1 up to 2^(b + 1) - 1.
+    size_t bucket = 0;
+    for (size_t k = this->_graph->degree(v, IGRAPH_ALL) + 1; k > 1; k >>= 1)
+      bucket++;
+    if (bucket >= this->_buckets.size())
+      this->_buckets.resize(bucket + 1);
+    this->_buckets[bucket].push(v);
+    if (bucket > this->_first_bucket)
+      this->_first_bucket = bucket;
+  }
+  else
+    this->_buckets[0].push(v);
+  return true;
+}
+
+size_t NodeQueue::pop()
+{
+  if (this->_size == 0)
+    throw Exception("Cannot pop from an empty queue of nodes.");
+  size_t v;
+  if (this->_order == Optimiser::GAIN_ORDER)
+  {
+    v = this->_gain_queue.top().node;
+    this->_gain_queue.pop();
+  }
+  else
+  {
+    while (this->_buckets[this->_first_bucket].empty())
+      this->_first_bucket--;
+    queue<size_t>& bucket = this->_buckets[this->_first_bucket];
+    v = bucket.front();
+    bucket.pop();
+  }
+  this->_is_queued[v] = false;
+  this->_size -= 1;
+  return v;
+}
+
+void NodeQueue::unproductive_visit(size_t v)
+{
+  if (this->_max_unproductive_visits > 0)
+    this->_unproductive_visits[v] += 1;
+}
+
+/*****************************************************************************
+  Calculate the improvement of moving node v to each of the candidate
+  communities, summed over all layers using the layer weights. The result is
+  stored in comms.improv. Each layer calculates all differences at once, so
+  that there is only a single virtual call per layer.
+******************************************************************************/
+void Optimiser::diff_move_all(vector<MutableVertexPartition*> const& partitions, vector<double> const& layer_weights, size_t v, CandidateCommunities& comms)
+{
+  size_t n_comms = comms.size();
+  comms.improv.assign(n_comms, 0.0);
+  comms.work.node_visits += 1;
+  comms.work.candidates += n_comms;
+  comms.work.max_candidates = std::max(comms.work.max_candidates, n_comms);
+  comms.work.diff_moves += n_comms*partitions.size();
+  for (size_t layer = 0; layer < partitions.size(); layer++)
+  {
+    partitions[layer]->diff_move_all(v, comms.comms(), comms.layer_diff);
+    // Make sure to multiply it by the weight per layer
+    double layer_weight = layer_weights[layer];
+    for (size_t i = 0; i < n_comms; i++)
+      comms.improv[i] += layer_weight*comms.layer_diff[i];
+  }
+}
+
+/*****************************************************************************
+  Return the work done since the last call, on the calling thread and on the
+  threads of move_nodes_parallel, and reset all counters.
+******************************************************************************/
+MoveStats Optimiser::collect_work()
+{
+  MoveStats work = this->_work;
+  for (size_t t = 0; t < this->_candidates.size(); t++)
+  {
+    work.add(this->_candidates[t].work);
+    this->_candidates[t].work = MoveStats();
+  }
+  this->_work = MoveStats();
+  return work;
+}
+
+/*****************************************************************************
+  Add the communities of the neighbours of v that are in the same constrained
+  community as v to the candidate communities.
+******************************************************************************/
+void insert_constrained_neigh_comms(CandidateCommunities& comms, MutableVertexPartition* partition, size_t v, vector<size_t> const& constrained_membership)
+{
+  NeighbourRange neigh = partition->get_graph()->get_neighbours(v, IGRAPH_ALL);
+  for (Neighbour const* it_neigh = neigh.begin(); it_neigh != neigh.end(); it_neigh++)
+  {
+    size_t u = it_neigh->node;
+    if (constrained_membership[v] == constrained_membership[u])
+      comms.insert( partition->membership(u) );
+  }
+}
+
 /*****************************************************************************
   optimise the provided partition.
 *****************************************************************************/
@@ -55,6 +279,323 @@ double Optimiser::optimise_partition(MutableVertexPartition* partition)
   return this->optimise_partition(partitions, layer_weights);
 }
 
+/*****************************************************************************
+  optimise the provided partition for n_iterations iterations. If n_iterations
+  is negative, iterate until an iteration in which there was no improvement.
+*****************************************************************************/
+double Optimiser::optimise_partition(MutableVertexPartition* partition, int n_iterations)
+{
+  return this->optimise_partition(partition, n_iterations, 0.0, 0.0);
+}
+
+double Optimiser::optimise_partition(MutableVertexPartition* partition, int n_iterations, double max_time, double tolerance)
+{
+  vector<MutableVertexPartition*> partitions(1);
+  partitions[0] = partition;
+  vector<double> layer_weights(1, 1.0);
+  return this->optimise_partition(partitions, layer_weights, n_iterations, max_time, tolerance);
+}
+
+/*****************************************************************************
+  optimise the provided partitions for n_iterations iterations.
+
+  Parameters:
+    n_iterations -- The maximum number of iterations. If negative, there is no
+                    maximum.
+    max_time     -- The maximum wall time in seconds. If zero or negative,
+                    there is no maximum.
+    tolerance    -- If n_iterations is negative or tolerance is positive, stop
+                    after an iteration in which the improvement was at most
+                    tolerance times the absolute quality. Hence, if
+                    n_iterations is negative and tolerance is zero, we iterate
+                    until an iteration in which there was no improvement.
+
+  The deadline is also checked while moving nodes and while refining, after
+  which the graph is not aggregated any further. Because nodes are only moved
+  if this improves the quality, the partitions are then the best found so
+  far. Whether we ran out of time is available from timed_out(). Similarly,
+  if a control is set (see set_control), we report the progress to it after
+  each level, and stop in the same way once it is cancelled, which is
+  available from cancelled().
+
+  If relabel_nodes is set, we optimise partitions of relabelled copies of the
+  graphs instead (see relabelled_partitions), whose memberships are set on
+  the provided partitions in terms of the original labels afterwards, as is
+  the first level of the hierarchy.
+*****************************************************************************/
+double Optimiser::optimise_partition(vector<MutableVertexPartition*> original_partitions, vector<double> layer_weights, int n_iterations, double max_time, double tolerance)
+{
+  this->_has_deadline = (max_time > 0);
+  this->_timed_out = false;
+  this->_cancelled = false;
+  this->_deadline_checks = 0;
+  if (this->_has_deadline)
+    this->_deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(max_time));
+
+  vector<size_t> order;
+  vector<MutableVertexPartition*> relabelled = this->relabelled_partitions(original_partitions, order);
+  vector<MutableVertexPartition*> const& partitions = relabelled.empty() ? original_partitions : relabelled;
+
+  double improv = 0.0;
+  int itr = 0;
+  int continue_iteration = itr < n_iterations || n_iterations < 0;
+  vector<LevelStats> stats;
+  try
+  {
+    while (continue_iteration)
+    {
+      if (this->_control != NULL)
+        this->_control->iteration = itr;
+      double improv_inc = this->optimise_partition(partitions, layer_weights);
+      improv += improv_inc;
+      for (size_t level = 0; level < this->_stats.size(); level++)
+      {
+        stats.push_back(this->_stats[level]);
+        stats.back().iteration = itr;
+      }
+      itr++;
+      continue_iteration = itr < n_iterations || n_iterations < 0;
+      if (n_iterations < 0 || tolerance > 0)
+      {
+        double q = 0.0;
+        for (size_t layer = 0; layer < partitions.size(); layer++)
+          q += partitions[layer]->quality()*layer_weights[layer];
+        continue_iteration = continue_iteration && (improv_inc > tolerance*fabs(q));
+      }
+      if (this->past_deadline())
+        continue_iteration = false;
+    }
+  }
+  catch (...)
+  {
+    this->_has_deadline = false;
+    for (size_t layer = 0; layer < relabelled.size(); layer++)
+      delete relabelled[layer];
+    throw;
+  }
+  this->_has_deadline = false;
+  this->_stats = stats;
+
+  if (!relabelled.empty())
+  {
+    size_t n = order.size();
+    vector<size_t> membership(n);
+    for (size_t layer = 0; layer < relabelled.size(); layer++)
+    {
+      for (size_t i = 0; i < n; i++)
+        membership[order[i]] = relabelled[layer]->membership(i);
+      original_partitions[layer]->set_membership(membership);
+      delete relabelled[layer];
+    }
+    if (!this->_hierarchy.empty())
+    {
+      vector<uint32_t> level(n);
+      for (size_t i = 0; i < n; i++)
+        level[order[i]] = this->_hierarchy[0][i];
+      this->_hierarchy[0].swap(level);
+    }
+  }
+  return improv;
+}
+
+/*****************************************************************************
+  Create partitions of relabelled copies of the graphs of partitions, in which
+  node i is node order[i] of the original graphs, in the order of
+  relabel_nodes, and with the same membership. The order is determined from
+  the graph of the first layer, after which nodes that are neighbours, or of
+  a similar degree, are stored close together, so that their memberships and
+  edges are also close in memory when moving nodes.
+
+  Returns the partitions, which also delete their graphs, or no partitions if
+  nodes are not relabelled, which is also the case if a graph has slices.
+*****************************************************************************/
+vector<MutableVertexPartition*> Optimiser::relabelled_partitions(vector<MutableVertexPartition*> const& partitions, vector<size_t>& order)
+{
+  vector<MutableVertexPartition*> relabelled;
+  if (this->relabel_nodes == Optimiser::NO_RELABEL || partitions.empty())
+    return relabelled;
+  if (this->relabel_nodes != Optimiser::RCM_RELABEL && this->relabel_nodes != Optimiser::DEGREE_RELABEL)
+    throw Exception("Unknown order for relabelling nodes.");
+  size_t nb_layers = partitions.size();
+  size_t n = partitions[0]->get_graph()->vcount();
+  for (size_t layer = 0; layer < nb_layers; layer++)
+  {
+    Graph* graph = partitions[layer]->get_graph();
+    if (graph->n_slices() > 0)
+      return relabelled;
+    if (graph->vcount() != n)
+      throw Exception("Number of nodes are not equal for all graphs.");
+  }
+
+  if (this->relabel_nodes == Optimiser::RCM_RELABEL)
+    order = partitions[0]->get_graph()->rcm_order();
+  else
+    order = partitions[0]->get_graph()->degree_order();
+
+  vector<size_t> membership(n);
+  for (size_t layer = 0; layer < nb_layers; layer++)
+  {
+    for (size_t i = 0; i < n; i++)
+      membership[i] = partitions[layer]->membership(order[i]);
+    Graph* graph = partitions[layer]->get_graph()->permuted(order);
+    MutableVertexPartition* partition = partitions[layer]->create(graph, membership);
+    partition->destructor_delete_graph = true;
+    relabelled.push_back(partition);
+  }
+  return relabelled;
+}
+
+/*****************************************************************************
+  Renumber the communities of partitions in the order of their first node, so
+  that the nodes of a graph that is collapsed according to them follow the
+  order of the nodes of their graph, as for relabelled nodes (see
+  relabelled_partitions). We only renumber the communities for the first
+  graph, and use that membership for all other graphs, similar to
+  move_nodes.
+*****************************************************************************/
+void Optimiser::renumber_by_first_node(vector<MutableVertexPartition*> const& partitions)
+{
+  size_t n = partitions[0]->get_graph()->vcount();
+  size_t nb_comms = partitions[0]->n_communities();
+  vector<size_t> new_comm(nb_comms, nb_comms);
+  vector<size_t> membership(n);
+  size_t next_comm = 0;
+  for (size_t v = 0; v < n; v++)
+  {
+    size_t comm = partitions[0]->membership(v);
+    if (new_comm[comm] == nb_comms)
+      new_comm[comm] = next_comm++;
+    membership[v] = new_comm[comm];
+  }
+  for (size_t layer = 0; layer < partitions.size(); layer++)
+    partitions[layer]->renumber_communities(membership);
+}
+
+/*****************************************************************************
+  Optimise n_starts independent copies of the provided partition, each
+  starting from its current membership, and set the partition to the copy of
+  the highest quality.
+
+  Parameters:
+    partition    -- The partition to optimise.
+    n_starts     -- The number of independent starts.
+    n_iterations -- The number of iterations for each start (see
+                    optimise_partition).
+    memberships  -- If provided, the resulting membership of each start.
+
+  The starts are optimised concurrently using n_threads threads, which all
+  share the graph of the partition. Each start uses its own optimiser with the
+  same settings as this one, seeded from our random number generator in a
+  fixed order, and ties are broken in favour of the earliest start, so that the
+  result does not depend on the number of threads.
+
+  Returns the improvement in the quality of the partition.
+*****************************************************************************/
+double Optimiser::optimise_partition_multistart(MutableVertexPartition* partition, size_t n_starts, int n_iterations)
+{
+  return this->optimise_partition_multistart(partition, n_starts, n_iterations, NULL);
+}
+
+double Optimiser::optimise_partition_multistart(MutableVertexPartition* partition, size_t n_starts, int n_iterations, vector< vector<size_t> >& memberships)
+{
+  return this->optimise_partition_multistart(partition, n_starts, n_iterations, &memberships);
+}
+
+double Optimiser::optimise_partition_multistart(MutableVertexPartition* partition, size_t n_starts, int n_iterations, vector< vector<size_t> >* memberships)
+{
+  #ifdef DEBUG
+    cerr << "double Optimiser::optimise_partition_multistart(" << partition << ", " << n_starts << ", " << n_iterations << ")" << endl;
+  #endif
+  if (memberships != NULL)
+  {
+    memberships->clear();
+    memberships->resize(n_starts);
+  }
+  if (n_starts < 1)
+    return 0.0;
+
+  double quality = partition->quality();
+
+  // Seed in a fixed order, so that it does not depend on the threads
+  vector<size_t> seeds(n_starts);
+  for (size_t i = 0; i < n_starts; i++)
+    seeds[i] = get_random_int(0, 0x7FFFFFFF, &rng);
+
+  size_t n_threads = this->n_threads;
+  if (n_threads > n_starts)
+    n_threads = n_starts;
+  if (n_threads < 1)
+    n_threads = 1;
+
+  // The best partition found by each thread, and for which start
+  vector<MutableVertexPartition*> best(n_threads, NULL);
+  vector<double> best_quality(n_threads, 0.0);
+  vector<size_t> best_start(n_threads, 0);
+
+  std::atomic<size_t> next_idx(0);
+  try
+  {
+    run_workers(n_threads, [&](size_t t)
+    {
+      for (size_t idx = next_idx++; idx < n_starts; idx = next_idx++)
+      {
+        Optimiser optimiser;
+        this->copy_settings(optimiser);
+        optimiser.set_rng_seed(seeds[idx]);
+
+        MutableVertexPartition* new_partition = partition->clone();
+        try
+        {
+          optimiser.optimise_partition(new_partition, n_iterations);
+        }
+        catch (...)
+        {
+          delete new_partition;
+          throw;
+        }
+        double q = new_partition->quality();
+        if (memberships != NULL)
+          (*memberships)[idx] = new_partition->membership();
+
+        if (best[t] == NULL || q > best_quality[t] || (q == best_quality[t] && idx < best_start[t]))
+        {
+          delete best[t];
+          best[t] = new_partition;
+          best_quality[t] = q;
+          best_start[t] = idx;
+        }
+        else
+          delete new_partition;
+      }
+    });
+  }
+  catch (...)
+  {
+    for (size_t t = 0; t < n_threads; t++)
+      delete best[t];
+    throw;
+  }
+
+  size_t best_t = 0;
+  for (size_t t = 1; t < n_threads; t++)
+  {
+    if (best[t] != NULL &&
+        (best[best_t] == NULL || best_quality[t] > best_quality[best_t] ||
+         (best_quality[t] == best_quality[best_t] && best_start[t] < best_start[best_t])))
+      best_t = t;
+  }
+  partition->set_membership(best[best_t]->membership());
+
+  for (size_t t = 0; t < n_threads; t++)
+    delete best[t];
+
+  #ifdef DEBUG
+    cerr << "exit Optimiser::optimise_partition_multistart(...)" << endl;
+    cerr << "Best start " << best_start[best_t] << " of " << n_starts << " with quality " << best_quality[best_t] << endl;
+  #endif
+  return partition->quality() - quality;
+}
+
 /*****************************************************************************
   optimise the providede partitions simultaneously. We here use the sum
   of the difference of the moves as the overall quality function, each partition
@@ -91,6 +632,8 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
   for (size_t layer = 0; layer < nb_layers; layer++)
     if (graphs[layer]->vcount() != n)
       throw Exception("Number of nodes are not equal for all graphs.");
+  if (this->record_hierarchy && n > std::numeric_limits<uint32_t>::max())
+    throw Exception("Graph has too many nodes to record the hierarchy.");
 
   // Initialize the vector of the collapsed graphs for all layers
   vector<Graph*> collapsed_graphs(nb_layers);
@@ -110,8 +653,23 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
   int aggregate_further = true;
   // As long as there remains improvement iterate
   double improv = 0.0;
+  this->_stats.clear();
+  this->_hierarchy.clear();
+  this->collect_work();
+  this->clear_partition_pool();
+  this->_partition_pool.resize(nb_layers);
+  int nb_levels = 0;
   do
   {
+    nb_levels++;
+    LevelStats level;
+    level.iteration = 0;
+    level.n_nodes = collapsed_graphs[0]->vcount();
+    level.n_edges = 0;
+    for (size_t layer = 0; layer < nb_layers; layer++)
+      level.n_edges += collapsed_graphs[layer]->ecount();
+    level.refine_time = 0.0;
+    Clock::time_point level_start = Clock::now();
 
     // Optimise partition for collapsed graph
     #ifdef DEBUG
@@ -124,6 +682,8 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       improv += this->move_nodes(collapsed_partitions, layer_weights);
     else if (this->optimise_routine == Optimiser::MERGE_NODES)
       improv += this->merge_nodes(collapsed_partitions, layer_weights);
+    level.move_time = seconds_since(level_start);
+    level.move = this->collect_work();
 
     #ifdef DEBUG
       cerr << "Found " << collapsed_partitions[0]->n_communities() << " communities, improved " << improv << endl;
@@ -157,6 +717,18 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
         cerr << "Number of communities: " << partitions[0]->n_communities() << endl;
     #endif
 
+    if (this->_control != NULL)
+      this->report_progress(partitions, layer_weights, nb_levels - 1);
+
+    // If we ran out of time, we keep the partition found so far, without
+    // refining or aggregating any further.
+    if (this->past_deadline())
+    {
+      level.collapse_time = 0.0;
+      this->_stats.push_back(level);
+      break;
+    }
+
     // Collapse graph (i.e. community graph)
     // If we do refine the partition, we separate communities in slightly more
     // fine-grained parts for which we collapse the graph.
@@ -176,20 +748,44 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       #endif
       for (size_t layer = 0; layer < nb_layers; layer++)
       {
-        sub_collapsed_partitions[layer] = collapsed_partitions[layer]->create(collapsed_graphs[layer]);
+        sub_collapsed_partitions[layer] = this->level_partition(layer, collapsed_partitions[layer], collapsed_graphs[layer], NULL);
       }
 
       // Then move around nodes but restrict movement to within original communities.
       #ifdef DEBUG
         cerr << "\tStarting refinement with " << sub_collapsed_partitions[0]->n_communities() << " communities." << endl;
       #endif
-      if (this->refine_routine == Optimiser::MOVE_NODES)
+      Clock::time_point refine_start = Clock::now();
+      int refine_in_parallel = (this->n_threads > 1);
+      for (size_t layer = 0; layer < nb_layers; layer++)
+        refine_in_parallel = refine_in_parallel && sub_collapsed_partitions[layer]->has_local_diff_move();
+      if (refine_in_parallel)
+        this->refine_parallel(sub_collapsed_partitions, layer_weights, refine_consider_comms, collapsed_partitions[0]);
+      else if (this->refine_routine == Optimiser::MOVE_NODES)
         this->move_nodes_constrained(sub_collapsed_partitions, layer_weights, refine_consider_comms, collapsed_partitions[0]);
       else if (this->refine_routine == Optimiser::MERGE_NODES)
         this->merge_nodes_constrained(sub_collapsed_partitions, layer_weights, refine_consider_comms, collapsed_partitions[0]);
       #ifdef DEBUG
         cerr << "\tAfter applying refinement found " << sub_collapsed_partitions[0]->n_communities() << " communities." << endl;
       #endif
+      if (this->relabel_nodes != Optimiser::NO_RELABEL)
+        this->renumber_by_first_node(sub_collapsed_partitions);
+      level.refine_time = seconds_since(refine_start);
+      level.refine = this->collect_work();
+
+      // Collapsing the graph is relatively expensive, and pointless if we
+      // ran out of time.
+      if (this->past_deadline())
+      {
+        for (size_t layer = 0; layer < nb_layers; layer++)
+          this->_partition_pool[layer].push_back(sub_collapsed_partitions[layer]);
+        level.collapse_time = 0.0;
+        this->_stats.push_back(level);
+        break;
+      }
+
+      if (this->record_hierarchy)
+        this->record_level(sub_collapsed_partitions[0]);
 
       // Determine new aggregate node per individual node
       for (size_t v = 0; v < n; v++)
@@ -201,7 +797,7 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       // Collapse graph based on sub collapsed partition
       for (size_t layer = 0; layer < nb_layers; layer++)
       {
-        new_collapsed_graphs[layer] = collapsed_graphs[layer]->collapse_graph(sub_collapsed_partitions[layer]);
+        new_collapsed_graphs[layer] = this->level_graph(collapsed_graphs[layer], sub_collapsed_partitions[layer]);
       }
 
       // Determine the membership for the collapsed graph
@@ -228,17 +824,19 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       // Create new collapsed partition
       for (size_t layer = 0; layer < nb_layers; layer++)
       {
-        delete sub_collapsed_partitions[layer];
-        new_collapsed_partitions[layer] = collapsed_partitions[layer]->create(new_collapsed_graphs[layer], new_collapsed_membership);
+        this->_partition_pool[layer].push_back(sub_collapsed_partitions[layer]);
+        new_collapsed_partitions[layer] = this->level_partition(layer, collapsed_partitions[layer], new_collapsed_graphs[layer], &new_collapsed_membership);
       }
     }
     else
     {
+      if (this->record_hierarchy)
+        this->record_level(collapsed_partitions[0]);
       for (size_t layer = 0; layer < nb_layers; layer++)
       {
-        new_collapsed_graphs[layer] = collapsed_graphs[layer]->collapse_graph(collapsed_partitions[layer]);
+        new_collapsed_graphs[layer] = this->level_graph(collapsed_graphs[layer], collapsed_partitions[layer]);
         // Create collapsed partition (i.e. default partition of each node in its own community).
-        new_collapsed_partitions[layer] = collapsed_partitions[layer]->create(new_collapsed_graphs[layer]);
+        new_collapsed_partitions[layer] = this->level_partition(layer, collapsed_partitions[layer], new_collapsed_graphs[layer], NULL);
         #ifdef DEBUG
           cerr << "Layer " << layer << endl;
           cerr << "Old collapsed graph " << collapsed_graphs[layer] << ", vcount is " << collapsed_graphs[layer]->vcount() << endl;
@@ -248,25 +846,30 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
     }
 
     aggregate_further = (new_collapsed_graphs[0]->vcount() < collapsed_graphs[0]->vcount()) &&
-                        (collapsed_graphs[0]->vcount() > collapsed_partitions[0]->n_communities());
+                        (collapsed_graphs[0]->vcount() > collapsed_partitions[0]->n_communities()) &&
+                        (this->max_levels <= 0 || nb_levels < this->max_levels);
 
     #ifdef DEBUG
       cerr << "Aggregate further " << aggregate_further << endl;
     #endif
 
-    // Delete the previous collapsed partition and graph
+    // Keep the previous collapsed partition and graph for reuse
     for (size_t layer = 0; layer < nb_layers; layer++)
     {
       if (collapsed_partitions[layer] != partitions[layer])
-        delete collapsed_partitions[layer];
+        this->_partition_pool[layer].push_back(collapsed_partitions[layer]);
       if (collapsed_graphs[layer] != graphs[layer])
-        delete collapsed_graphs[layer];
+        this->_graph_pool.push_back(collapsed_graphs[layer]);
     }
 
     // and set them to the new one.
     collapsed_partitions = new_collapsed_partitions;
     collapsed_graphs = new_collapsed_graphs;
 
+    // The remaining time is spent on aggregating
+    level.collapse_time = seconds_since(level_start) - level.move_time - level.refine_time;
+    this->_stats.push_back(level);
+
     #ifdef DEBUG
       for (size_t layer = 0; layer < nb_layers; layer++)
       {
@@ -295,16 +898,20 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
     #endif // DEBUG
 
   } while (aggregate_further);
+  size_t n_last = collapsed_graphs[0]->vcount();
 
-  // Clean up memory after use.
+  // Clean up memory after use. The graphs are kept for the next call, but
+  // the partitions are deleted, since the next call may use partitions of
+  // another type.
   for (size_t layer = 0; layer < nb_layers; layer++)
   {
     if (collapsed_partitions[layer] != partitions[layer])
-      delete collapsed_partitions[layer];
+      this->_partition_pool[layer].push_back(collapsed_partitions[layer]);
 
     if (collapsed_graphs[layer] != graphs[layer])
-      delete collapsed_graphs[layer];
+      this->_graph_pool.push_back(collapsed_graphs[layer]);
   }
+  this->clear_partition_pool();
 
   // Make sure the resulting communities are called 0,...,r-1
   // where r is the number of communities.
@@ -318,9 +925,316 @@ double Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
     partitions[layer]->renumber_communities(membership);
     q += partitions[layer]->quality()*layer_weights[layer];
   }
+
+  // The last level of the hierarchy maps each node of the last graph to the
+  // community of any of the nodes of the graph that it contains.
+  if (this->record_hierarchy)
+  {
+    vector<size_t> node = range(n);
+    for (size_t k = 0; k < this->_hierarchy.size(); k++)
+    {
+      vector<uint32_t> const& level = this->_hierarchy[k];
+      for (size_t v = 0; v < n; v++)
+        node[v] = level[node[v]];
+    }
+    this->_hierarchy.push_back(vector<uint32_t>(n_last));
+    vector<uint32_t>& level = this->_hierarchy.back();
+    for (size_t v = 0; v < n; v++)
+      level[node[v]] = membership[v];
+  }
   return improv;
 }
 
+/*****************************************************************************
+  Construct a resolution profile by bisectioning on the resolution parameter.
+
+  Parameters:
+    partition             -- The partition that determines the quality
+                             function and the graph. Its membership is the
+                             starting point for both ends of the range.
+    resolution_min        -- The lowest resolution value to scan.
+    resolution_max        -- The highest resolution value to scan.
+    min_diff_bisect_value -- An interval is only bisected if the bisect values
+                             (i.e. the total internal weight) of its ends differ
+                             by more than this,
+    min_diff_resolution   -- and if the resolution values of its ends differ by
+                             more than this. If both ends are positive, the
+                             logarithmic difference is used, unless
+                             linear_bisection is set.
+    linear_bisection      -- Always bisect on a linear scale.
+    number_iterations     -- The number of iterations of optimise_partition for
+                             each resolution value. If zero or negative,
+                             iterate until there is no further improvement.
+
+  The new resolution values of all intervals that are bisected in the same
+  round are independent, and are optimised concurrently using n_threads
+  threads, which all share the same graph. Each value is optimised starting
+  from the membership of whichever end of its interval has the highest quality
+  for the new resolution value. Each value uses its own optimiser with the same
+  settings as this one, seeded from our random number generator in a fixed
+  order, so that the profile does not depend on the number of threads.
+
+  Returns new partitions (which should be deleted by the caller) in increasing
+  order of their resolution parameter, only keeping the resolution values at
+  which the bisect value changes. The partition for each resolution value is
+  the best partition in the profile for that resolution value.
+******************************************************************************/
+vector<ResolutionParameterVertexPartition*> Optimiser::resolution_profile(
+    ResolutionParameterVertexPartition* partition,
+    double resolution_min, double resolution_max,
+    double min_diff_bisect_value, double min_diff_resolution,
+    int linear_bisection, int number_iterations)
+{
+  #ifdef DEBUG
+    cerr << "vector<ResolutionParameterVertexPartition*> Optimiser::resolution_profile(...)" << endl;
+  #endif
+
+  // All partitions that were found, of which the profile refers to some
+  vector<ResolutionParameterVertexPartition*> found;
+  // The index in found of the best partition for each resolution value
+  map<double, size_t> profile;
+
+  // The resolution values to scan, and the partition to start from
+  vector<double> scan_res;
+  vector<MutableVertexPartition*> scan_start;
+  scan_res.push_back(resolution_min); scan_start.push_back(partition);
+  if (resolution_max != resolution_min)
+  {
+    scan_res.push_back(resolution_max); scan_start.push_back(partition);
+  }
+
+  vector< pair<double, double> > ranges(1, pair<double, double>(resolution_min, resolution_max));
+  vector< pair<double, double> > next_ranges;
+  while (!scan_res.empty())
+  {
+    size_t first = found.size();
+    this->optimise_resolutions(partition, scan_res, scan_start, number_iterations, found);
+
+    // The quality of the partitions that are compared below, for all
+    // resolution values that they are compared for, which is determined at
+    // once for each partition (see qualities).
+    vector<double> compare_res;
+    map<double, size_t> res_index;
+    for (map<double, size_t>::iterator it = profile.begin(); it != profile.end(); it++)
+    {
+      res_index[it->first] = compare_res.size();
+      compare_res.push_back(it->first);
+    }
+    for (size_t i = 0; i < scan_res.size(); i++)
+    {
+      if (res_index.count(scan_res[i]) == 0)
+      {
+        res_index[scan_res[i]] = compare_res.size();
+        compare_res.push_back(scan_res[i]);
+      }
+    }
+    vector< vector<double> > found_quality(found.size());
+    for (map<double, size_t>::iterator it = profile.begin(); it != profile.end(); it++)
+      if (found_quality[it->second].empty())
+        found[it->second]->qualities(compare_res, found_quality[it->second]);
+    for (size_t idx = first; idx < found.size(); idx++)
+      found[idx]->qualities(compare_res, found_quality[idx]);
+
+    for (size_t i = 0; i < scan_res.size(); i++)
+    {
+      size_t idx = first + i;
+      // Because of stochastic differences the bisect values may not be
+      // monotonic, so use the new partition wherever it is better,
+      double new_res = scan_res[i];
+      size_t new_res_idx = res_index[new_res];
+      size_t best_idx = idx;
+      double best_quality = found_quality[idx][new_res_idx];
+      for (map<double, size_t>::iterator it = profile.begin(); it != profile.end(); it++)
+      {
+        size_t res_idx = res_index[it->first];
+        if (found_quality[idx][res_idx] > found_quality[it->second][res_idx])
+          it->second = idx;
+        // and use the best partition for the new resolution value.
+        else if (found_quality[it->second][new_res_idx] > best_quality)
+        {
+          best_idx = it->second;
+          best_quality = found_quality[it->second][new_res_idx];
+        }
+      }
+      profile[new_res] = best_idx;
+    }
+
+    // Delete the partitions that are no longer in the profile
+    vector<int> in_profile(found.size(), false);
+    for (map<double, size_t>::iterator it = profile.begin(); it != profile.end(); it++)
+      in_profile[it->second] = true;
+    for (size_t idx = 0; idx < found.size(); idx++)
+    {
+      if (!in_profile[idx] && found[idx] != NULL)
+      {
+        delete found[idx];
+        found[idx] = NULL;
+      }
+    }
+
+    // Determine which intervals should be bisected further
+    scan_res.clear();
+    scan_start.clear();
+    next_ranges.clear();
+    for (size_t r = 0; r < ranges.size(); r++)
+    {
+      double res_lo = ranges[r].first;
+      double res_hi = ranges[r].second;
+      ResolutionParameterVertexPartition* partition_lo = found[profile[res_lo]];
+      ResolutionParameterVertexPartition* partition_hi = found[profile[res_hi]];
+      double diff_bisect_value = fabs(partition_lo->total_weight_in_all_comms() -
+                                      partition_hi->total_weight_in_all_comms());
+      int log_bisection = res_lo > 0 && res_hi > 0 && !linear_bisection;
+      double diff_resolution = log_bisection ? log(res_hi/res_lo) : fabs(res_hi - res_lo);
+      if (diff_bisect_value > min_diff_bisect_value && diff_resolution > min_diff_resolution)
+      {
+        double new_res = log_bisection ? sqrt(res_hi*res_lo) : (res_lo + res_hi)/2.0;
+        next_ranges.push_back(pair<double, double>(res_lo, new_res));
+        next_ranges.push_back(pair<double, double>(new_res, res_hi));
+        if (profile.count(new_res) == 0)
+        {
+          scan_res.push_back(new_res);
+          // Start from the end of the interval that is best for new_res
+          if (partition_hi->quality(new_res) > partition_lo->quality(new_res))
+            scan_start.push_back(partition_hi);
+          else
+            scan_start.push_back(partition_lo);
+        }
+      }
+    }
+    ranges.swap(next_ranges);
+  }
+
+  // Only keep the resolution values for which the bisect value changes
+  vector<ResolutionParameterVertexPartition*> result;
+  double prev_bisect_value = 0.0;
+  for (map<double, size_t>::iterator it = profile.begin(); it != profile.end(); it++)
+  {
+    ResolutionParameterVertexPartition* best = found[it->second];
+    double bisect_value = best->total_weight_in_all_comms();
+    if (it != profile.begin() && bisect_value == prev_bisect_value)
+      continue;
+    prev_bisect_value = bisect_value;
+
+    ResolutionParameterVertexPartition* step_partition =
+      (ResolutionParameterVertexPartition*) best->clone();
+    step_partition->resolution_parameter = it->first;
+    result.push_back(step_partition);
+  }
+
+  for (size_t idx = 0; idx < found.size(); idx++)
+    delete found[idx];
+
+  #ifdef DEBUG
+    cerr << "exit Optimiser::resolution_profile(...)" << endl;
+    cerr << "return profile of " << result.size() << " resolution values." << endl;
+  #endif
+  return result;
+}
+
+/*****************************************************************************
+  Use the same settings for optimiser, which is used by a single thread.
+******************************************************************************/
+void Optimiser::copy_settings(Optimiser& optimiser)
+{
+  optimiser.consider_comms = this->consider_comms;
+  optimiser.refine_partition = this->refine_partition;
+  optimiser.refine_consider_comms = this->refine_consider_comms;
+  optimiser.optimise_routine = this->optimise_routine;
+  optimiser.refine_routine = this->refine_routine;
+  optimiser.consider_empty_community = this->consider_empty_community;
+  optimiser.max_levels = this->max_levels;
+  optimiser.visit_order = this->visit_order;
+  optimiser.max_unproductive_visits = this->max_unproductive_visits;
+  optimiser.relabel_nodes = this->relabel_nodes;
+  optimiser.n_threads = 1;
+}
+
+void Optimiser::copy_deadline(Optimiser& optimiser)
+{
+  optimiser._has_deadline = this->_has_deadline;
+  optimiser._deadline = this->_deadline;
+  optimiser._control = this->_control;
+}
+
+void Optimiser::record_level(MutableVertexPartition* partition)
+{
+  size_t n = partition->get_graph()->vcount();
+  this->_hierarchy.push_back(vector<uint32_t>(n));
+  vector<uint32_t>& level = this->_hierarchy.back();
+  for (size_t v = 0; v < n; v++)
+    level[v] = partition->membership(v);
+}
+
+/*****************************************************************************
+  Report the progress after moving the nodes of the given level to the
+  control, in terms of the quality of the partitions of the original graphs.
+******************************************************************************/
+void Optimiser::report_progress(vector<MutableVertexPartition*> const& partitions, vector<double> const& layer_weights, size_t level)
+{
+  double q = 0.0;
+  for (size_t layer = 0; layer < partitions.size(); layer++)
+    q += partitions[layer]->quality()*layer_weights[layer];
+  this->_control->level = level;
+  this->_control->quality = q;
+}
+
+/*****************************************************************************
+  Optimise a new partition for each of the resolution values, starting from
+  the membership of the corresponding partition in start, and append them to
+  found. The resolution values are optimised concurrently, see
+  resolution_profile.
+******************************************************************************/
+void Optimiser::optimise_resolutions(ResolutionParameterVertexPartition* partition,
+                                     vector<double> const& resolutions,
+                                     vector<MutableVertexPartition*> const& start,
+                                     int number_iterations,
+                                     vector<ResolutionParameterVertexPartition*>& found)
+{
+  size_t n_points = resolutions.size();
+  size_t first = found.size();
+  found.resize(first + n_points, NULL);
+
+  // Seed in a fixed order, so that it does not depend on the threads
+  vector<size_t> seeds(n_points);
+  for (size_t i = 0; i < n_points; i++)
+    seeds[i] = get_random_int(0, 0x7FFFFFFF, &rng);
+
+  size_t n_threads = this->n_threads;
+  if (n_threads > n_points)
+    n_threads = n_points;
+  if (n_threads < 1)
+    n_threads = 1;
+
+  std::atomic<size_t> next_idx(0);
+  try
+  {
+    run_workers(n_threads, [&](size_t t)
+    {
+      for (size_t idx = next_idx++; idx < n_points; idx = next_idx++)
+      {
+        Optimiser optimiser;
+        this->copy_settings(optimiser);
+        optimiser.set_rng_seed(seeds[idx]);
+
+        ResolutionParameterVertexPartition* new_partition =
+          (ResolutionParameterVertexPartition*) start[idx]->clone();
+        new_partition->resolution_parameter = resolutions[idx];
+        found[first + idx] = new_partition;
+
+        optimiser.optimise_partition(new_partition, number_iterations > 0 ? number_iterations : -1);
+      }
+    });
+  }
+  catch (...)
+  {
+    for (size_t idx = 0; idx < found.size(); idx++)
+      delete found[idx];
+    found.clear();
+    throw;
+  }
+}
+
 /*****************************************************************************
     Move nodes to other communities depending on how other communities are
     considered, see consider_comms parameter of the class.
@@ -341,6 +1255,14 @@ double Optimiser::move_nodes(MutableVertexPartition* partition, int consider_com
   return this->move_nodes(partitions, layer_weights, consider_comms, this->consider_empty_community);
 }
 
+double Optimiser::move_nodes(MutableVertexPartition* partition, vector<size_t> const& nodes)
+{
+  vector<MutableVertexPartition*> partitions(1);
+  partitions[0] = partition;
+  vector<double> layer_weights(1, 1.0);
+  return this->move_nodes(partitions, layer_weights, this->consider_comms, this->consider_empty_community, nodes);
+}
+
 double Optimiser::merge_nodes(MutableVertexPartition* partition)
 {
   return this->merge_nodes(partition, this->consider_comms);
@@ -392,6 +1314,8 @@ double Optimiser::merge_nodes_constrained(MutableVertexPartition* partition, int
   Parameters:
     partitions -- The partitions to optimise.
     layer_weights -- The weights used for the different layers.
+    nodes -- The nodes that are initially considered (all nodes by default).
+             Other nodes are only considered after a neighbour has moved.
 ******************************************************************************/
 double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<double> layer_weights)
 {
@@ -399,6 +1323,13 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
 }
 
 double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, int consider_empty_community)
+{
+  if (partitions.size() == 0)
+    return -1.0;
+  return this->move_nodes(partitions, layer_weights, consider_comms, consider_empty_community, range(partitions[0]->get_graph()->vcount()));
+}
+
+double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, int consider_empty_community, vector<size_t> const& nodes)
 {
   #ifdef DEBUG
     cerr << "double Optimiser::move_nodes_multiplex(vector<MutableVertexPartition*> partitions, vector<double> weights)" << endl;
@@ -407,6 +1338,8 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
   size_t nb_layers = partitions.size();
   if (nb_layers == 0)
     return -1.0;
+  if (this->n_threads > 1)
+    return this->move_nodes_parallel(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
   // Get graphs
   vector<Graph*> graphs(nb_layers);
   for (size_t layer = 0; layer < nb_layers; layer++)
@@ -426,16 +1359,19 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
   // Establish vertex order
   // We normally initialize the normal vertex order
   // of considering node 0,1,...
-  queue<size_t> vertex_order;
-  vector<int> is_node_stable(n, false);
+  NodeQueue vertex_order(this->visit_order, graphs[0], this->max_unproductive_visits);
   // But if we use a random order, we shuffle this order.
-  vector<size_t> nodes = range(n);
-  shuffle(nodes, &rng);
-  for (vector<size_t>::iterator it_node = nodes.begin();
-       it_node != nodes.end();
+  vector<size_t> order = nodes;
+  shuffle(order, &rng);
+  for (vector<size_t>::iterator it_node = order.begin();
+       it_node != order.end();
        it_node++)
   {
-    vertex_order.push(*it_node);
+    if (*it_node >= n)
+      throw Exception("Node to consider outside of range of nodes.");
+    // Nodes that are considered initially are visited before any nodes that
+    // are queued again because of a move.
+    vertex_order.push(*it_node, std::numeric_limits<double>::infinity());
   }
 
   // Initialize the degree vector
@@ -447,11 +1383,12 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
   //       aggregating/collapsing the graph.
 
   // As long as the queue is not empty
-  while(!vertex_order.empty())
+  while(!vertex_order.empty() && !this->check_deadline())
   {
-    size_t v = vertex_order.front(); vertex_order.pop();
+    size_t v = vertex_order.pop();
 
-    set<size_t> comms;
+    CandidateCommunities& comms = this->_candidates[0];
+    comms.clear();
     Graph* graph = NULL;
     MutableVertexPartition* partition = NULL;
     // What is the current community of the node (this should be the same for all layers)
@@ -500,21 +1437,13 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
 
     size_t max_comm = v_comm;
     double max_improv = 0.0;
-    for (set<size_t>::iterator comm_it = comms.begin();
-         comm_it!= comms.end();
-         comm_it++)
-    {
-      size_t comm = *comm_it;
-      double possible_improv = 0.0;
-
-      // Consider the improvement of moving to a community for all layers
-      for (size_t layer = 0; layer < nb_layers; layer++)
-      {
-        graph = graphs[layer];
-        partition = partitions[layer];
-        // Make sure to multiply it by the weight per layer
-        possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-      }
+    comms.sort();
+    // Consider the improvement of moving to each community for all layers
+    this->diff_move_all(partitions, layer_weights, v, comms);
+    for (size_t i = 0; i < comms.size(); i++)
+    {
+      size_t comm = comms[i];
+      double possible_improv = comms.improv[i];
 
       if (possible_improv > max_improv)
       {
@@ -551,6 +1480,7 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
           {
             possible_improv += layer_weights[layer_2]*partitions[layer_2]->diff_move(v, comm);
           }
+          this->_work.diff_moves += nb_layers;
           #ifdef DEBUG
             cerr << "Improvement to empty community: " << possible_improv << ", maximum improvement: " << max_improv << endl;
           #endif
@@ -563,13 +1493,14 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
       }
     }
 
-    is_node_stable[v] = true;
-
     // If we actually plan to move the node
-    if (max_comm != v_comm)
+    if (max_comm == v_comm)
+      vertex_order.unproductive_visit(v);
+    else
     {
         // Keep track of improvement
         total_improv += max_improv;
+        this->_work.moves += 1;
 
         #ifdef DEBUG
           // If we are debugging, calculate quality function
@@ -608,18 +1539,22 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
           }
         #endif
 
-        // Mark neighbours as unstable (if not in new community)
-        vector<size_t> const& neighs = graph->get_neighbours(v, IGRAPH_ALL);
-        for (vector<size_t>::const_iterator it_neigh = neighs.begin();
+        // Mark neighbours as unstable (if not in new community), as seen in the last layer
+        graph = graphs[nb_layers - 1];
+        partition = partitions[nb_layers - 1];
+        NeighbourRange neighs = graph->get_neighbours(v, IGRAPH_ALL);
+        for (Neighbour const* it_neigh = neighs.begin();
              it_neigh != neighs.end(); it_neigh++)
         {
-          size_t u = *it_neigh;
-          // If the neighbour was stable and is not in the new community, we
-          // should mark it as unstable, and add it to the queue
-          if (is_node_stable[u] && partition->membership(v) != max_comm)
+          size_t u = it_neigh->node;
+          // If the neighbour is not in the new community, we should add it to
+          // the queue, unless it is already queued or frozen.
+          if (partition->membership(u) != max_comm)
           {
-            vertex_order.push(u);
-            is_node_stable[u] = false;
+            if (vertex_order.push(u, max_improv))
+              this->_work.queue_insertions += 1;
+            else if (vertex_order.is_frozen(u))
+              this->_work.skipped_insertions += 1;
           }
         }
         // Keep track of number of moves
@@ -636,6 +1571,418 @@ double Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
       cerr << "Renumbered communities for layer " << layer << " for " << partitions[layer]->n_communities() << " communities." << endl;
     #endif DEBUG
   }
+  this->_work.improvement += total_improv;
+  return total_improv;
+}
+
+// Minimum, initial and maximum number of nodes per thread in each batch of
+// move_nodes_parallel.
+static const size_t MOVE_BATCH_MIN = 8;
+static const size_t MOVE_BATCH_START = 64;
+static const size_t MOVE_BATCH_MAX = 1024;
+
+/*****************************************************************************
+  Move nodes to neighbouring communities using multiple threads (see
+  n_threads), otherwise identical to move_nodes.
+
+  Nodes are taken from the queue in batches. For all nodes in a batch, the
+  best community is determined concurrently by n_threads threads, based on
+  the partitions as they are at the start of the batch. Each thread uses its
+  own cache of neighbouring communities, and its own random number
+  generator, so that the partitions are only read while doing so. The moves
+  are then applied in the order of the queue by the calling thread. Because
+  earlier moves in the same batch may have changed the partitions, the
+  improvement of each move is recalculated, and the move is only made if it
+  still improves the quality.
+
+  The threads are started once, and wait for each next batch. Batches start
+  with MOVE_BATCH_START nodes per thread. When more than a quarter of the
+  moves found in a batch no longer improve the quality, the batch size is
+  halved, down to MOVE_BATCH_MIN nodes per thread, and when at most one in
+  sixteen does, it is doubled, up to MOVE_BATCH_MAX nodes per thread.
+
+  Applying the moves, including recalculating their improvement, is serial,
+  and takes roughly a quarter of the time of a sweep on sparse graphs, which
+  limits the speedup to a few times whatever the number of threads.
+
+  Parameters:
+    partitions -- The partitions to optimise.
+    layer_weights -- The weights used for the different layers.
+******************************************************************************/
+double Optimiser::move_nodes_parallel(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, int consider_empty_community, vector<size_t> const& nodes)
+{
+  #ifdef DEBUG
+    cerr << "double Optimiser::move_nodes_parallel(vector<MutableVertexPartition*> partitions, vector<double> weights)" << endl;
+  #endif
+  // Number of multiplex layers
+  size_t nb_layers = partitions.size();
+  if (nb_layers == 0)
+    return -1.0;
+  // Get graphs
+  vector<Graph*> graphs(nb_layers);
+  for (size_t layer = 0; layer < nb_layers; layer++)
+    graphs[layer] = partitions[layer]->get_graph();
+  // Number of nodes in the graph
+  size_t n = graphs[0]->vcount();
+
+  // Total improvement while moving nodes
+  double total_improv = 0.0;
+
+  for (size_t layer = 0; layer < nb_layers; layer++)
+    if (graphs[layer]->vcount() != n)
+      throw Exception("Number of nodes are not equal for all graphs.");
+  // Number of moved nodes during one loop
+  size_t nb_moves = 0;
+
+  size_t n_threads = this->n_threads;
+  // Number of nodes that are considered concurrently before applying moves,
+  // which is adapted to how many of the moves turn out to be stale.
+  size_t batch_size = MOVE_BATCH_START*n_threads;
+
+  // Each thread uses its own cache in each partition
+  for (size_t layer = 0; layer < nb_layers; layer++)
+    partitions[layer]->set_n_caches(n_threads);
+  // and its own candidate communities
+  if (this->_candidates.size() < n_threads)
+    this->_candidates.resize(n_threads);
+
+  // Establish vertex order, in the same way as in move_nodes
+  NodeQueue vertex_order(this->visit_order, graphs[0], this->max_unproductive_visits);
+  vector<size_t> order = nodes;
+  shuffle(order, &rng);
+  for (vector<size_t>::iterator it_node = order.begin();
+       it_node != order.end();
+       it_node++)
+  {
+    if (*it_node >= n)
+      throw Exception("Node to consider outside of range of nodes.");
+    vertex_order.push(*it_node, std::numeric_limits<double>::infinity());
+  }
+
+  // Each thread uses its own random number generator, seeded from ours.
+  vector<igraph_rng_t> thread_rng(n_threads);
+  for (size_t t = 0; t < n_threads; t++)
+  {
+    igraph_rng_init(&thread_rng[t], &igraph_rngtype_mt19937);
+    igraph_rng_seed(&thread_rng[t], get_random_int(0, 0x7FFFFFFF, &rng));
+  }
+
+  vector<size_t> batch;
+  vector<size_t> batch_comm;
+  vector<double> batch_improv;
+  int use_empty_community = false;
+  size_t empty_comm = 0;
+
+  // Determine the best move of node batch[idx] by worker w, which uses its
+  // own cache, candidate communities and random number generator.
+  auto find_move = [&](size_t w, size_t idx)
+  {
+    igraph_rng_t* rng = &thread_rng[w];
+    CandidateCommunities& comms = this->_candidates[w];
+    size_t v = batch[idx];
+    // What is the current community of the node (this should be the same for all layers)
+    size_t v_comm = partitions[0]->membership(v);
+
+    comms.clear();
+    if (consider_comms == ALL_COMMS)
+    {
+      for(size_t comm = 0; comm < partitions[0]->n_communities(); comm++)
+      {
+        for (size_t layer = 0; layer < nb_layers; layer++)
+        {
+          if (partitions[layer]->cnodes(comm) > 0)
+          {
+            comms.insert(comm);
+            break; // Break from for loop in layer
+          }
+        }
+      }
+    }
+    else if (consider_comms == ALL_NEIGH_COMMS)
+    {
+      for (size_t layer = 0; layer < nb_layers; layer++)
+      {
+        vector<size_t> const& neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL);
+        comms.insert(neigh_comm_layer.begin(), neigh_comm_layer.end());
+      }
+    }
+    else if (consider_comms == RAND_COMM)
+    {
+      comms.insert( partitions[0]->membership(graphs[0]->get_random_node(rng)) );
+    }
+    else if (consider_comms == RAND_NEIGH_COMM)
+    {
+      size_t rand_layer = get_random_int(0, nb_layers - 1, rng);
+      if (graphs[rand_layer]->degree(v, IGRAPH_ALL) > 0)
+        comms.insert( partitions[0]->membership(graphs[rand_layer]->get_random_neighbour(v, IGRAPH_ALL, rng)) );
+    }
+
+    size_t max_comm = v_comm;
+    double max_improv = 0.0;
+    comms.sort();
+    // Consider the improvement of moving to each community for all layers
+    this->diff_move_all(partitions, layer_weights, v, comms);
+    for (size_t i = 0; i < comms.size(); i++)
+    {
+      size_t comm = comms[i];
+      double possible_improv = comms.improv[i];
+
+      if (possible_improv > max_improv)
+      {
+        max_comm = comm;
+        max_improv = possible_improv;
+      }
+    }
+
+    // Check if we should move to an empty community
+    if (use_empty_community && partitions[0]->cnodes(v_comm) > 1)
+    {
+      double possible_improv = 0.0;
+      for (size_t layer = 0; layer < nb_layers; layer++)
+        possible_improv += layer_weights[layer]*partitions[layer]->diff_move(v, empty_comm);
+      comms.work.diff_moves += nb_layers;
+
+      if (possible_improv > max_improv)
+      {
+        max_comm = empty_comm;
+        max_improv = possible_improv;
+      }
+    }
+
+    batch_comm[idx] = max_comm;
+    batch_improv[idx] = max_improv;
+  };
+
+  // The workers are started once for all batches. All but the last wait for
+  // each batch, and then take nodes from it until none are left. The last
+  // worker runs on the calling thread: it prepares each batch, also takes
+  // nodes from it, waits until the other workers are done, and then applies
+  // the moves. Worker w uses cache w, so that the calling thread uses cache 0.
+  std::mutex mutex;
+  std::condition_variable batch_ready; // A new batch was prepared, or the workers should stop
+  std::condition_variable batch_done;  // A worker is done with its part of a batch
+  size_t n_batches = 0;       // Number of prepared batches
+  size_t batch_nodes = 0;     // Number of nodes in the last batch
+  size_t n_busy = 0;          // Number of workers taking nodes from the last batch
+  bool finished = false;      // Whether all batches were done
+  bool failed = false;        // Whether a worker failed
+  std::atomic<size_t> next_idx(0);
+
+  auto sweep = [&](size_t t)
+  {
+    if (t + 1 < n_threads)
+    {
+      size_t w = t + 1;
+      MutableVertexPartition::set_thread_cache(w);
+      size_t batches_seen = 0;
+      while (true)
+      {
+        size_t n_nodes = 0;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          while (batches_seen == n_batches && !finished)
+            batch_ready.wait(lock);
+          if (finished)
+            break;
+          batches_seen = n_batches;
+          n_nodes = batch_nodes;
+          n_busy++;
+        }
+        try
+        {
+          for (size_t idx = next_idx++; idx < n_nodes; idx = next_idx++)
+            find_move(w, idx);
+        }
+        catch (...)
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          failed = true;
+          n_busy--;
+          batch_done.notify_all();
+          throw;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        n_busy--;
+        if (n_busy == 0)
+          batch_done.notify_all();
+      }
+      return;
+    }
+
+    try
+    {
+      while (!vertex_order.empty() && !this->past_deadline())
+      {
+        batch.clear();
+        while (!vertex_order.empty() && batch.size() < batch_size)
+        {
+          batch.push_back(vertex_order.pop());
+        }
+        if (this->_control != NULL)
+          this->_control->nodes_processed.fetch_add(batch.size(), std::memory_order_relaxed);
+        batch_comm.assign(batch.size(), 0);
+        batch_improv.assign(batch.size(), 0.0);
+
+        // Make sure there is an empty community available in all layers, since
+        // this cannot be done concurrently. We can only be sure that there is an
+        // empty community when there are less communities than nodes.
+        use_empty_community = consider_empty_community && partitions[0]->n_communities() < n;
+        if (use_empty_community)
+        {
+          size_t n_comms = partitions[0]->n_communities();
+          empty_comm = partitions[0]->get_empty_community();
+          if (partitions[0]->n_communities() > n_comms)
+            for (size_t layer = 1; layer < nb_layers; layer++)
+              partitions[layer]->add_empty_community();
+        }
+
+        /****************************FIND BEST MOVES*************************/
+        {
+          // Workers that are still busy with the previous batch no longer
+          // take any nodes from it, but should not see the new batch.
+          std::unique_lock<std::mutex> lock(mutex);
+          while (n_busy > 0)
+            batch_done.wait(lock);
+          if (failed)
+            break;
+          next_idx = 0;
+          batch_nodes = batch.size();
+          n_batches++;
+        }
+        batch_ready.notify_all();
+        for (size_t idx = next_idx++; idx < batch.size(); idx = next_idx++)
+          find_move(0, idx);
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          while (n_busy > 0)
+            batch_done.wait(lock);
+          if (failed)
+            break;
+        }
+
+        /****************************APPLY MOVES*****************************/
+        size_t n_found = 0; // Number of moves found concurrently
+        size_t n_stale = 0; // Number of those that earlier moves made no longer improve
+        for (size_t idx = 0; idx < batch.size(); idx++)
+        {
+          size_t v = batch[idx];
+          size_t v_comm = partitions[0]->membership(v);
+          size_t max_comm = batch_comm[idx];
+
+          if (max_comm == v_comm || batch_improv[idx] <= 0)
+          {
+            vertex_order.unproductive_visit(v);
+            continue;
+          }
+          n_found += 1;
+
+          // If the empty community has been used by an earlier move in this
+          // batch, use another empty community instead.
+          if (use_empty_community && max_comm == empty_comm && partitions[0]->cnodes(empty_comm) > 0)
+          {
+            if (partitions[0]->cnodes(v_comm) <= 1 || partitions[0]->n_communities() >= n)
+            {
+              vertex_order.unproductive_visit(v);
+              n_stale += 1;
+              continue;
+            }
+            size_t n_comms = partitions[0]->n_communities();
+            max_comm = partitions[0]->get_empty_community();
+            if (partitions[0]->n_communities() > n_comms)
+              for (size_t layer = 1; layer < nb_layers; layer++)
+                partitions[layer]->add_empty_community();
+          }
+
+          // Earlier moves may have changed the improvement
+          double max_improv = 0.0;
+          for (size_t layer = 0; layer < nb_layers; layer++)
+            max_improv += layer_weights[layer]*partitions[layer]->diff_move(v, max_comm);
+          this->_work.diff_moves += nb_layers;
+
+          if (max_improv <= 0)
+          {
+            vertex_order.unproductive_visit(v);
+            n_stale += 1;
+            continue;
+          }
+
+          // Keep track of improvement
+          total_improv += max_improv;
+          this->_work.moves += 1;
+
+          MutableVertexPartition* partition = NULL;
+          for (size_t layer = 0; layer < nb_layers; layer++)
+          {
+            partition = partitions[layer];
+            // Actually move the node
+            partition->move_node(v, max_comm);
+          }
+
+          // Mark neighbours as unstable (in the same way as move_nodes)
+          NeighbourRange neighs = graphs[nb_layers - 1]->get_neighbours(v, IGRAPH_ALL);
+          for (Neighbour const* it_neigh = neighs.begin();
+               it_neigh != neighs.end(); it_neigh++)
+          {
+            size_t u = it_neigh->node;
+            if (partition->membership(u) != max_comm)
+            {
+              if (vertex_order.push(u, max_improv))
+                this->_work.queue_insertions += 1;
+              else if (vertex_order.is_frozen(u))
+                this->_work.skipped_insertions += 1;
+            }
+          }
+          // Keep track of number of moves
+          nb_moves += 1;
+        }
+
+        // Use smaller batches when many of the moves found concurrently are
+        // undone by earlier moves in the same batch, and otherwise larger
+        // batches, for which the workers need to wait less often.
+        if (4*n_stale > n_found && batch_size > MOVE_BATCH_MIN*n_threads)
+          batch_size /= 2;
+        else if (16*n_stale <= n_found && batch_size < MOVE_BATCH_MAX*n_threads)
+          batch_size *= 2;
+      }
+    }
+    catch (...)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished = true;
+      }
+      batch_ready.notify_all();
+      throw;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      finished = true;
+    }
+    batch_ready.notify_all();
+  };
+
+  try
+  {
+    run_workers(n_threads, sweep);
+  }
+  catch (...)
+  {
+    for (size_t t = 0; t < n_threads; t++)
+      igraph_rng_destroy(&thread_rng[t]);
+    for (size_t layer = 0; layer < nb_layers; layer++)
+      partitions[layer]->set_n_caches(1);
+    throw;
+  }
+  for (size_t t = 0; t < n_threads; t++)
+    igraph_rng_destroy(&thread_rng[t]);
+  for (size_t layer = 0; layer < nb_layers; layer++)
+    partitions[layer]->set_n_caches(1);
+
+  partitions[0]->renumber_communities();
+  vector<size_t> const& membership = partitions[0]->membership();
+  for (size_t layer = 1; layer < nb_layers; layer++)
+    partitions[layer]->renumber_communities(membership);
+  this->_work.improvement += total_improv;
   return total_improv;
 }
 
@@ -679,7 +2026,7 @@ double Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
 
   // Iterate over all nodes
   for (vector<size_t>::iterator it = vertex_order.begin();
-       it != vertex_order.end(); it++)
+       it != vertex_order.end() && !this->check_deadline(); it++)
   {
     size_t v = *it;
 
@@ -692,8 +2039,8 @@ double Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
 
     if (partitions[0]->cnodes(v_comm) == 1)
     {
-      set<size_t> comms;
-      MutableVertexPartition* partition = NULL;
+      CandidateCommunities& comms = this->_candidates[0];
+      comms.clear();
 
       if (consider_comms == ALL_COMMS)
       {
@@ -743,20 +2090,13 @@ double Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
 
       size_t max_comm = v_comm;
       double max_improv = 0.0;
-      for (set<size_t>::iterator comm_it = comms.begin();
-           comm_it!= comms.end();
-           comm_it++)
+      comms.sort();
+      // Consider the improvement of moving to each community for all layers
+      this->diff_move_all(partitions, layer_weights, v, comms);
+      for (size_t i = 0; i < comms.size(); i++)
       {
-        size_t comm = *comm_it;
-        double possible_improv = 0.0;
-
-        // Consider the improvement of moving to a community for all layers
-        for (size_t layer = 0; layer < nb_layers; layer++)
-        {
-          partition = partitions[layer];
-          // Make sure to multiply it by the weight per layer
-          possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-        }
+        size_t comm = comms[i];
+        double possible_improv = comms.improv[i];
         #ifdef DEBUG
           cerr << "Improvement of " << possible_improv << " when move to " << comm << "." << endl;
         #endif
@@ -773,6 +2113,7 @@ double Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
       {
           // Keep track of improvement
           total_improv += max_improv;
+          this->_work.moves += 1;
 
           #ifdef DEBUG
             // If we are debugging, calculate quality function
@@ -823,6 +2164,7 @@ double Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
       cerr << "Renumbered communities for layer " << layer << " for " << partitions[layer]->n_communities() << " communities." << endl;
     #endif DEBUG
   }
+  this->_work.improvement += total_improv;
   return total_improv;
 }
 
@@ -859,8 +2201,7 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
   // Establish vertex order
   // We normally initialize the normal vertex order
   // of considering node 0,1,...
-  queue<size_t> vertex_order;
-  vector<int> is_node_stable(n, false);
+  NodeQueue vertex_order(this->visit_order, graphs[0], this->max_unproductive_visits);
   // But if we use a random order, we shuffle this order.
   vector<size_t> nodes = range(n);
   shuffle(nodes, &rng);
@@ -868,7 +2209,7 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
        it_node != nodes.end();
        it_node++)
   {
-    vertex_order.push(*it_node);
+    vertex_order.push(*it_node, std::numeric_limits<double>::infinity());
   }
 
   vector< vector<size_t> > constrained_comms = constrained_partition->get_communities();
@@ -882,11 +2223,12 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
   //       aggregating/collapsing the graph.
 
   // As long as the queue is not empty
-  while(!vertex_order.empty())
+  while(!vertex_order.empty() && !this->check_deadline())
   {
-    size_t v = vertex_order.front(); vertex_order.pop();
+    size_t v = vertex_order.pop();
 
-    set<size_t> comms;
+    CandidateCommunities& comms = this->_candidates[0];
+    comms.clear();
     Graph* graph = NULL;
     MutableVertexPartition* partition = NULL;
     // What is the current community of the node (this should be the same for all layers)
@@ -910,8 +2252,7 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
         /****************************ALL NEIGH COMMS*****************************/
         for (size_t layer = 0; layer < nb_layers; layer++)
         {
-          set<size_t> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
-          comms.insert(neigh_comm_layer.begin(), neigh_comm_layer.end());
+          insert_constrained_neigh_comms(comms, partitions[layer], v, constrained_partition->membership());
         }
     }
     else if (consider_comms == RAND_COMM)
@@ -927,11 +2268,14 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
         // Draw a random community among the neighbours, proportional to the
         // frequency of the communities among the neighbours. Notice this is no
         // longer
-        vector<size_t> all_neigh_comms_incl_dupes;
+        vector<size_t>& all_neigh_comms_incl_dupes = this->_neigh_comms_incl_dupes;
+        all_neigh_comms_incl_dupes.clear();
         for (size_t layer = 0; layer < nb_layers; layer++)
         {
-          set<size_t> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
-          all_neigh_comms_incl_dupes.insert(all_neigh_comms_incl_dupes.end(), neigh_comm_layer.begin(), neigh_comm_layer.end());
+          insert_constrained_neigh_comms(comms, partitions[layer], v, constrained_partition->membership());
+          comms.sort();
+          all_neigh_comms_incl_dupes.insert(all_neigh_comms_incl_dupes.end(), comms.begin(), comms.end());
+          comms.clear();
         }
         if (all_neigh_comms_incl_dupes.size() > 0)
         {
@@ -947,21 +2291,13 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
     size_t max_comm = v_comm;
     double max_improv = 0.0;
 
-    for (set<size_t>::iterator comm_it = comms.begin();
-         comm_it!= comms.end();
-         comm_it++)
+    comms.sort();
+    // Consider the improvement of moving to each community for all layers
+    this->diff_move_all(partitions, layer_weights, v, comms);
+    for (size_t i = 0; i < comms.size(); i++)
     {
-      size_t comm = *comm_it;
-      double possible_improv = 0.0;
-
-      // Consider the improvement of moving to a community for all layers
-      for (size_t layer = 0; layer < nb_layers; layer++)
-      {
-        graph = graphs[layer];
-        partition = partitions[layer];
-        // Make sure to multiply it by the weight per layer
-        possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-      }
+      size_t comm = comms[i];
+      double possible_improv = comms.improv[i];
 
       // Check if improvement is best
       if (possible_improv > max_improv)
@@ -971,13 +2307,14 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
       }
     }
 
-    is_node_stable[v] = true;
-
     // If we actually plan to move the nove
-    if (max_comm != v_comm)
+    if (max_comm == v_comm)
+      vertex_order.unproductive_visit(v);
+    else
     {
       // Keep track of improvement
       total_improv += max_improv;
+      this->_work.moves += 1;
 
       #ifdef DEBUG
         // If we are debugging, calculate quality function
@@ -1016,18 +2353,22 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
         }
       #endif
 
-      // Mark neighbours as unstable (if not in new community)
-      vector<size_t> const& neighs = graph->get_neighbours(v, IGRAPH_ALL);
-      for (vector<size_t>::const_iterator it_neigh = neighs.begin();
+      // Mark neighbours as unstable (if not in new community), as seen in the last layer
+      graph = graphs[nb_layers - 1];
+      partition = partitions[nb_layers - 1];
+      NeighbourRange neighs = graph->get_neighbours(v, IGRAPH_ALL);
+      for (Neighbour const* it_neigh = neighs.begin();
            it_neigh != neighs.end(); it_neigh++)
       {
-        size_t u = *it_neigh;
-        // If the neighbour was stable and is not in the new community, we
-        // should mark it as unstable, and add it to the queue
-        if (is_node_stable[u] && partition->membership(v) != max_comm)
+        size_t u = it_neigh->node;
+        // If the neighbour is not in the new community, we should add it to
+        // the queue, unless it is already queued or frozen.
+        if (partition->membership(u) != max_comm)
         {
-          vertex_order.push(u);
-          is_node_stable[u] = false;
+          if (vertex_order.push(u, max_improv))
+            this->_work.queue_insertions += 1;
+          else if (vertex_order.is_frozen(u))
+            this->_work.skipped_insertions += 1;
         }
       }
 
@@ -1047,6 +2388,7 @@ double Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
       cerr << "Renumbered communities for layer " << layer << " for " << partitions[layer]->n_communities() << " communities." << endl;
     #endif DEBUG
   }
+  this->_work.improvement += total_improv;
   return total_improv;
 }
 
@@ -1093,7 +2435,7 @@ double Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
 
   // For each node
   for (vector<size_t>::iterator it = vertex_order.begin();
-       it != vertex_order.end(); it++)
+       it != vertex_order.end() && !this->check_deadline(); it++)
   {
     size_t v = *it;
 
@@ -1102,8 +2444,8 @@ double Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
 
     if (partitions[0]->cnodes(v_comm) == 1)
     {
-      set<size_t> comms;
-      MutableVertexPartition* partition = NULL;
+      CandidateCommunities& comms = this->_candidates[0];
+      comms.clear();
 
       if (consider_comms == ALL_COMMS)
       {
@@ -1123,8 +2465,7 @@ double Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
           /****************************ALL NEIGH COMMS*****************************/
           for (size_t layer = 0; layer < nb_layers; layer++)
           {
-            set<size_t> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
-            comms.insert(neigh_comm_layer.begin(), neigh_comm_layer.end());
+            insert_constrained_neigh_comms(comms, partitions[layer], v, constrained_partition->membership());
           }
       }
       else if (consider_comms == RAND_COMM)
@@ -1140,11 +2481,14 @@ double Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
           // Draw a random community among the neighbours, proportional to the
           // frequency of the communities among the neighbours. Notice this is no
           // longer
-          vector<size_t> all_neigh_comms_incl_dupes;
+          vector<size_t>& all_neigh_comms_incl_dupes = this->_neigh_comms_incl_dupes;
+          all_neigh_comms_incl_dupes.clear();
           for (size_t layer = 0; layer < nb_layers; layer++)
           {
-            set<size_t> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
-            all_neigh_comms_incl_dupes.insert(all_neigh_comms_incl_dupes.end(), neigh_comm_layer.begin(), neigh_comm_layer.end());
+            insert_constrained_neigh_comms(comms, partitions[layer], v, constrained_partition->membership());
+            comms.sort();
+            all_neigh_comms_incl_dupes.insert(all_neigh_comms_incl_dupes.end(), comms.begin(), comms.end());
+            comms.clear();
           }
           size_t k = all_neigh_comms_incl_dupes.size();
           if (k > 0)
@@ -1164,20 +2508,13 @@ double Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
 
       size_t max_comm = v_comm;
       double max_improv = 0.0;
-      for (set<size_t>::iterator comm_it = comms.begin();
-           comm_it!= comms.end();
-           comm_it++)
+      comms.sort();
+      // Consider the improvement of moving to each community for all layers
+      this->diff_move_all(partitions, layer_weights, v, comms);
+      for (size_t i = 0; i < comms.size(); i++)
       {
-        size_t comm = *comm_it;
-        double possible_improv = 0.0;
-
-        // Consider the improvement of moving to a community for all layers
-        for (size_t layer = 0; layer < nb_layers; layer++)
-        {
-          partition = partitions[layer];
-          // Make sure to multiply it by the weight per layer
-          possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-        }
+        size_t comm = comms[i];
+        double possible_improv = comms.improv[i];
 
         if (possible_improv >= max_improv)
         {
@@ -1191,6 +2528,7 @@ double Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
       {
           // Keep track of improvement
           total_improv += max_improv;
+          this->_work.moves += 1;
 
           #ifdef DEBUG
             // If we are debugging, calculate quality function
@@ -1241,5 +2579,169 @@ double Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
       cerr << "Renumbered communities for layer " << layer << " for " << partitions[layer]->n_communities() << " communities." << endl;
     #endif DEBUG
   }
+  this->_work.improvement += total_improv;
+  return total_improv;
+}
+
+/*****************************************************************************
+  Refine partitions within each community of constrained_partition, like
+  move_nodes_constrained or merge_nodes_constrained (see refine_routine), but
+  using n_threads threads.
+
+  Nodes cannot leave their constrained community, so that each community can
+  be refined independently. For each community, a separate optimiser moves or
+  merges the nodes of a partition of the subgraph of that community (see
+  Graph::subgraph), using its own random seed. The seeds and the numbering of
+  the resulting communities follow the order of the constrained communities,
+  so that the result does not depend on the number of threads. This requires
+  the difference of a move to be the same on the subgraph (see
+  MutableVertexPartition::has_local_diff_move).
+******************************************************************************/
+double Optimiser::refine_parallel(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, int consider_comms, MutableVertexPartition* constrained_partition)
+{
+  #ifdef DEBUG
+    cerr << "double Optimiser::refine_parallel(vector<MutableVertexPartition*> partitions, vector<double> layer_weights, " << consider_comms << ", " << constrained_partition << ")" << endl;
+  #endif
+  // Number of multiplex layers
+  size_t nb_layers = partitions.size();
+  if (nb_layers == 0)
+    return -1.0;
+  // Get graphs
+  vector<Graph*> graphs(nb_layers);
+  for (size_t layer = 0; layer < nb_layers; layer++)
+    graphs[layer] = partitions[layer]->get_graph();
+  // Number of nodes in the graph
+  size_t n = graphs[0]->vcount();
+
+  for (size_t layer = 0; layer < nb_layers; layer++)
+    if (graphs[layer]->vcount() != n)
+      throw Exception("Number of nodes are not equal for all graphs.");
+
+  vector< vector<size_t> > constrained_comms = constrained_partition->get_communities();
+  size_t n_comms = constrained_comms.size();
+
+  // Seed in a fixed order, so that it does not depend on the threads
+  vector<size_t> seeds(n_comms);
+  for (size_t c = 0; c < n_comms; c++)
+    seeds[c] = get_random_int(0, 0x7FFFFFFF, &rng);
+
+  // The refined membership of the nodes of each constrained community, and
+  // the work done, which includes the improvement.
+  vector< vector<size_t> > comm_membership(n_comms);
+  vector<double> comm_improv(n_comms, 0.0);
+  vector<MoveStats> comm_work(n_comms);
+  std::atomic<int> timed_out(false);
+
+  size_t n_threads = this->n_threads;
+  if (n_threads > n_comms)
+    n_threads = n_comms;
+  if (n_threads < 1)
+    n_threads = 1;
+
+  std::atomic<size_t> next_idx(0);
+  run_workers(n_threads, [&](size_t t)
+  {
+    vector<MutableVertexPartition*> sub_partitions(nb_layers, NULL);
+    try
+    {
+      Optimiser optimiser;
+      this->copy_settings(optimiser);
+      this->copy_deadline(optimiser);
+      for (size_t c = next_idx++; c < n_comms; c = next_idx++)
+      {
+        vector<size_t> const& nodes = constrained_comms[c];
+
+        // Number the communities within the constrained community
+        // consecutively, in the order in which they are encountered.
+        std::map<size_t, size_t> local_comm;
+        vector<size_t>& membership = comm_membership[c];
+        membership.resize(nodes.size());
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+          size_t comm = partitions[0]->membership(nodes[i]);
+          std::map<size_t, size_t>::iterator it = local_comm.find(comm);
+          if (it == local_comm.end())
+            it = local_comm.insert(std::make_pair(comm, local_comm.size())).first;
+          membership[i] = it->second;
+        }
+
+        // A single node cannot move anywhere else, nor can we do anything
+        // when we ran out of time.
+        if (nodes.size() == 1 || optimiser.past_deadline())
+          continue;
+
+        for (size_t layer = 0; layer < nb_layers; layer++)
+        {
+          Graph* sub_graph = graphs[layer]->subgraph(nodes);
+          try
+          {
+            sub_partitions[layer] = partitions[layer]->create(sub_graph, membership);
+          }
+          catch (...)
+          {
+            delete sub_graph;
+            throw;
+          }
+          sub_partitions[layer]->destructor_delete_graph = true;
+        }
+
+        optimiser.set_rng_seed(seeds[c]);
+        if (this->refine_routine == Optimiser::MOVE_NODES)
+          comm_improv[c] = optimiser.move_nodes(sub_partitions, layer_weights, consider_comms, false);
+        else if (this->refine_routine == Optimiser::MERGE_NODES)
+          comm_improv[c] = optimiser.merge_nodes(sub_partitions, layer_weights, consider_comms);
+        membership = sub_partitions[0]->membership();
+        comm_work[c] = optimiser.collect_work();
+
+        for (size_t layer = 0; layer < nb_layers; layer++)
+        {
+          delete sub_partitions[layer];
+          sub_partitions[layer] = NULL;
+        }
+      }
+      if (optimiser.timed_out())
+        timed_out = true;
+    }
+    catch (...)
+    {
+      for (size_t layer = 0; layer < nb_layers; layer++)
+        delete sub_partitions[layer];
+      throw;
+    }
+  });
+  if (timed_out)
+    this->_timed_out = true;
+
+  // Number the refined communities in the order of the constrained
+  // communities.
+  double total_improv = 0.0;
+  vector<size_t> new_membership(n);
+  size_t n_new_comms = 0;
+  for (size_t c = 0; c < n_comms; c++)
+  {
+    vector<size_t> const& nodes = constrained_comms[c];
+    vector<size_t> const& membership = comm_membership[c];
+    size_t n_local_comms = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+      new_membership[nodes[i]] = n_new_comms + membership[i];
+      if (membership[i] + 1 > n_local_comms)
+        n_local_comms = membership[i] + 1;
+    }
+    n_new_comms += n_local_comms;
+    total_improv += comm_improv[c];
+    this->_work.add(comm_work[c]);
+  }
+
+  for (size_t layer = 0; layer < nb_layers; layer++)
+    partitions[layer]->set_membership(new_membership);
+  partitions[0]->renumber_communities();
+  vector<size_t> const& membership = partitions[0]->membership();
+  for (size_t layer = 1; layer < nb_layers; layer++)
+    partitions[layer]->renumber_communities(membership);
+  #ifdef DEBUG
+    cerr << "exit Optimiser::refine_parallel(...)" << endl;
+    cerr << "Refined " << n_comms << " communities into " << partitions[0]->n_communities() << " communities." << endl;
+  #endif
   return total_improv;
 }
@@ -60,6 +60,11 @@ class Optimiser(object):
   Finally, the Optimiser class provides a routine to construct a
   :func:`resolution_profile` on a resolution parameter.
 
+  The optimisation routines release the Python global interpreter lock, so
+  that different optimisers can be used on different partitions from
+  multiple Python threads concurrently. The same optimiser, or the same
+  partition, should not be used by multiple threads at the same time.
+
   References
   ----------
 
@@ -217,6 +222,229 @@ class Optimiser(object):
   def consider_empty_community(self, value):
     _c_leiden._Optimiser_set_consider_empty_community(self._optimiser, value)
 
+  #########################################################3
+  # n_threads
+  @property
+  def n_threads(self):
+    """ int: number of threads to use for moving nodes (default 1).
+
+    Notes
+    -------
+    If more than one thread is used, the best community for several nodes is
+    determined concurrently, after which the moves are applied by a single
+    thread. Since applying the moves takes roughly a quarter of the time, the
+    speedup is limited to a few times, whatever the number of threads.
+    Because the moves are based on a slightly outdated partition, the results
+    may differ somewhat from the results when using a single thread, also
+    when using the same random seed. Only :func:`move_nodes` (and hence
+    :func:`optimise_partition` when :attr:`optimise_routine` is
+    :attr:`leidenalg.MOVE_NODES`) uses multiple threads for moving nodes.
+
+    When refining the partition in :func:`optimise_partition`, each community
+    is refined separately, so that several communities are refined
+    concurrently. Each community uses its own random seed, so that the
+    refinement does not depend on the number of threads. This is only done for
+    :class:`ModularityVertexPartition`, :class:`RBConfigurationVertexPartition`,
+    :class:`RBERVertexPartition` and :class:`CPMVertexPartition`, for which
+    the difference of moving a node only depends on the community itself; other
+    partitions are always refined using a single thread.
+    """
+    return _c_leiden._Optimiser_get_n_threads(self._optimiser)
+
+  @n_threads.setter
+  def n_threads(self, value):
+    _c_leiden._Optimiser_set_n_threads(self._optimiser, value)
+
+  #########################################################3
+  # stats
+  @property
+  def stats(self):
+    """ list: timing and work counters of the last call to
+    :func:`optimise_partition` or :func:`optimise_partition_multiplex`.
+
+    There is one ``dict`` per aggregation level of every iteration, containing
+
+    * ``iteration``: the iteration, starting from 0;
+    * ``n_nodes``, ``n_edges``: the number of nodes and edges (summed over all
+      layers) of the graph at this level;
+    * ``move_time``, ``refine_time``, ``collapse_time``: the wall time in
+      seconds spent on moving nodes, refining the partition and aggregating
+      the graph;
+    * ``move``, ``refine``: a ``dict`` with the work done when moving nodes and
+      when refining the partition. It contains the number of ``node_visits``,
+      the number of ``moves`` made, the number of ``diff_moves`` evaluated,
+      the number of ``queue_insertions`` of neighbours, the number of
+      ``skipped_insertions`` of neighbours that were frozen (see
+      :attr:`visit_order`), the total number of ``candidates`` communities
+      considered and the ``max_candidates`` for any single node, and the
+      ``improvement`` in quality.
+
+    Summing ``stats[i]['move']['improvement']`` over all levels gives the
+    total improvement of the quality.
+
+    Examples
+    --------
+
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> diff = optimiser.optimise_partition(partition)
+    >>> moves = sum(level['move']['moves'] for level in optimiser.stats)
+    """
+    return _c_leiden._Optimiser_get_stats(self._optimiser)
+
+  #########################################################3
+  # max_levels
+  @property
+  def max_levels(self):
+    """ int: maximum number of aggregation levels in each iteration of
+    :func:`optimise_partition` (default 0, meaning no maximum).
+
+    Limiting the number of levels limits the time spent on the coarser levels,
+    which usually only improve the quality somewhat.
+    """
+    return _c_leiden._Optimiser_get_max_levels(self._optimiser)
+
+  @max_levels.setter
+  def max_levels(self, value):
+    _c_leiden._Optimiser_set_max_levels(self._optimiser, value)
+
+  #########################################################3
+  # visit_order
+  @property
+  def visit_order(self):
+    """ Determine the order in which nodes are visited when moving nodes.
+
+    Notes
+    -------
+    Nodes are visited from a queue, which initially contains all nodes in a
+    random order. When a node moves, its neighbours that are not in its new
+    community are added to the queue again. This attribute should be set to one
+    of the following values
+
+    * :attr:`leidenalg.FIFO_ORDER`
+      Visit nodes in the order in which they were queued (default).
+
+    * :attr:`leidenalg.GAIN_ORDER`
+      Visit nodes that were queued by the move with the largest improvement
+      first.
+
+    * :attr:`leidenalg.DEGREE_ORDER`
+      Visit nodes with the highest degree first, where degrees are grouped by
+      powers of two. Nodes of a high degree then settle first and their
+      neighbours follow, instead of being visited again after each move of a
+      neighbour.
+
+    * :attr:`leidenalg.BOUNDED_ORDER`
+      Visit nodes in the order in which they were queued, but no longer visit
+      a node after :attr:`max_unproductive_visits` visits in which it did not
+      move.
+
+    On graphs with a heavy-tailed degree distribution,
+    :attr:`leidenalg.BOUNDED_ORDER` may visit nodes much less often, at the
+    cost of a somewhat lower quality. The number of visits is reported in
+    :attr:`stats`.
+    """
+    return _c_leiden._Optimiser_get_visit_order(self._optimiser)
+
+  @visit_order.setter
+  def visit_order(self, value):
+    _c_leiden._Optimiser_set_visit_order(self._optimiser, value)
+
+  #########################################################3
+  # max_unproductive_visits
+  @property
+  def max_unproductive_visits(self):
+    """ int: number of visits without moving after which a node is no longer
+    visited when :attr:`visit_order` is :attr:`leidenalg.BOUNDED_ORDER`
+    (default 3)."""
+    return _c_leiden._Optimiser_get_max_unproductive_visits(self._optimiser)
+
+  @max_unproductive_visits.setter
+  def max_unproductive_visits(self, value):
+    _c_leiden._Optimiser_set_max_unproductive_visits(self._optimiser, value)
+
+  #########################################################3
+  # relabel_nodes
+  @property
+  def relabel_nodes(self):
+    """ Determine whether nodes are relabelled before optimising.
+
+    Notes
+    -------
+    When optimising, the memberships and edges of the neighbours of a node are
+    accessed each time the node is visited. If neighbours have labels that are
+    far apart, these accesses are scattered in memory. Relabelling the nodes
+    then optimises a copy of the graph in which neighbours have labels that
+    are close together, after which the partition is set in terms of the
+    original labels. This attribute should be set to one of the following
+    values
+
+    * :attr:`leidenalg.NO_RELABEL`
+      Keep the original labels (default).
+
+    * :attr:`leidenalg.RCM_RELABEL`
+      Relabel nodes in reverse Cuthill-McKee order, which is a breadth-first
+      order in which neighbours are close together.
+
+    * :attr:`leidenalg.DEGREE_RELABEL`
+      Relabel nodes in order of decreasing degree.
+
+    If nodes are relabelled, the communities of the refined partition are also
+    numbered in the order of their nodes, so that the aggregate graphs keep
+    this order. The copy of the graph takes additional memory, and
+    relabelling is not done for graphs with slices.
+    """
+    return _c_leiden._Optimiser_get_relabel_nodes(self._optimiser)
+
+  @relabel_nodes.setter
+  def relabel_nodes(self, value):
+    _c_leiden._Optimiser_set_relabel_nodes(self._optimiser, value)
+
+  #########################################################3
+  # record_hierarchy
+  @property
+  def record_hierarchy(self):
+    """ boolean: if ``True``, :func:`optimise_partition` and
+    :func:`optimise_partition_multiplex` record the aggregation hierarchy of
+    their last iteration, which is available from :attr:`hierarchy`. By
+    default, the hierarchy is not recorded. """
+    return _c_leiden._Optimiser_get_record_hierarchy(self._optimiser)
+
+  @record_hierarchy.setter
+  def record_hierarchy(self, value):
+    _c_leiden._Optimiser_set_record_hierarchy(self._optimiser, value)
+
+  #########################################################3
+  # hierarchy
+  @property
+  def hierarchy(self):
+    """ :class:`Hierarchy`: the aggregation hierarchy of the last call to
+    :func:`optimise_partition` or :func:`optimise_partition_multiplex`, if
+    :attr:`record_hierarchy` was set, and an empty hierarchy otherwise.
+
+    Examples
+    --------
+
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> optimiser.record_hierarchy = True
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> diff = optimiser.optimise_partition(partition)
+    >>> optimiser.hierarchy.membership(len(optimiser.hierarchy) - 1) == partition.membership
+    True
+    """
+    return Hierarchy(_c_leiden._Optimiser_get_hierarchy(self._optimiser))
+
+  #########################################################3
+  # timed_out
+  @property
+  def timed_out(self):
+    """ bool: whether the last call to :func:`optimise_partition` or
+    :func:`optimise_partition_multiplex` stopped because it exceeded
+    ``max_time``."""
+    return _c_leiden._Optimiser_get_timed_out(self._optimiser)
+
   ##########################################################
   # Set rng seed
   def set_rng_seed(self, value):
@@ -229,7 +457,7 @@ class Optimiser(object):
     """
     _c_leiden._Optimiser_set_rng_seed(self._optimiser, value)
 
-  def optimise_partition(self, partition, n_iterations=2):
+  def optimise_partition(self, partition, n_iterations=2, max_time=None, tolerance=0):
     """ Optimise the given partition.
 
     Parameters
@@ -242,6 +470,16 @@ class Optimiser(object):
       are run. If the number of iterations is negative, the Leiden algorithm is
       run until an iteration in which there was no improvement.
 
+    max_time : float
+      Maximum wall time in seconds. If the time runs out, which is also checked
+      while moving nodes, the best partition found so far is kept and
+      :attr:`timed_out` is set. By default there is no maximum.
+
+    tolerance : float
+      If the number of iterations is negative or the tolerance is positive,
+      stop after an iteration in which the improvement was at most
+      ``tolerance`` times the absolute quality.
+
     Returns
     -------
     float
@@ -257,22 +495,181 @@ class Optimiser(object):
 
     """
 
-    itr = 0
-    diff = 0
-    continue_iteration = itr < n_iterations or n_iterations < 0
-    while continue_iteration:
-      diff_inc = _c_leiden._Optimiser_optimise_partition(self._optimiser, partition._partition)
-      diff += diff_inc
-      itr += 1
-      if n_iterations < 0:
-        continue_iteration = (diff_inc > 0)
+    diff = _c_leiden._Optimiser_optimise_partition(self._optimiser,
+                                                   partition._partition,
+                                                   n_iterations,
+                                                   max_time if max_time else 0,
+                                                   tolerance)
+    partition._update_internal_membership()
+    return diff
+
+  def optimise_partition_async(self, partition, n_iterations=2, max_time=None, tolerance=0, callback=None, interval=1.0):
+    """ Optimise the given partition on a background thread.
+
+    This runs :func:`optimise_partition` on a new thread, and immediately
+    returns an :class:`OptimisationHandle`, through which the progress can be
+    followed and the optimisation can be cancelled. While it runs, neither
+    this optimiser nor the partition should be used otherwise; in particular,
+    another asynchronous optimisation with the same optimiser fails with a
+    :class:`ValueError`.
+
+    Parameters
+    ----------
+    partition
+      The :class:`~VertexPartition.MutableVertexPartition` to optimise.
+
+    n_iterations : int
+      Number of iterations to run the Leiden algorithm (see
+      :func:`optimise_partition`).
+
+    max_time : float
+      Maximum wall time in seconds (see :func:`optimise_partition`).
+
+    tolerance : float
+      Relative tolerance of the improvement (see :func:`optimise_partition`).
+
+    callback
+      If provided, this is called with the
+      :attr:`~OptimisationHandle.progress` every ``interval`` seconds until
+      the optimisation finishes. It is called from another background thread.
+      If it raises an exception, the optimisation is cancelled, and the
+      exception is set on the handle instead of the result.
+
+    interval : float
+      Number of seconds between the calls to ``callback``.
+
+    Returns
+    -------
+    :class:`OptimisationHandle`
+      Handle of the optimisation, whose result is the improvement in quality
+      function.
+
+    Examples
+    --------
+
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> handle = optimiser.optimise_partition_async(partition)
+    >>> diff = handle.result()
+
+    In a coroutine, the handle can be awaited instead, where cancelling the
+    awaiting task, for example because of a timeout, also cancels the
+    optimisation
+
+    >>> diff = await asyncio.wait_for(handle, timeout=10) # doctest: +SKIP
+
+    """
+    import threading
+    from concurrent import futures
+
+    control = _c_leiden._new_OptimiserControl()
+    future = futures.Future()
+    future.set_running_or_notify_cancel()
+    handle = OptimisationHandle(control, future)
+
+    finished = threading.Event()
+    callback_errors = []
+
+    def report():
+      while not finished.wait(interval):
+        try:
+          callback(handle.progress)
+        except BaseException as e:
+          callback_errors.append(e)
+          handle.cancel()
+          return
+
+    reporter = None
+    if callback is not None:
+      reporter = threading.Thread(target=report)
+      reporter.daemon = True
+
+    def run():
+      try:
+        diff = _c_leiden._Optimiser_optimise_partition(self._optimiser,
+                                                       partition._partition,
+                                                       n_iterations,
+                                                       max_time if max_time else 0,
+                                                       tolerance,
+                                                       control)
+        partition._update_internal_membership()
+      except BaseException as e:
+        error = e
       else:
-        continue_iteration = itr < n_iterations
+        error = None
+      # Stop reporting before the handle is done, so that the callback is
+      # not called afterwards and any exception it raised is not lost.
+      finished.set()
+      if reporter is not None:
+        reporter.join()
+      if error is None and callback_errors:
+        error = callback_errors[0]
+      if error is not None:
+        future.set_exception(error)
+      else:
+        future.set_result(diff)
+
+    runner = threading.Thread(target=run)
+    runner.daemon = True
+    if reporter is not None:
+      reporter.start()
+    runner.start()
+    return handle
 
+  def optimise_partition_multistart(self, partition, n_starts, n_iterations=2, return_memberships=False):
+    """ Optimise the given partition several times independently and keep the
+    best result.
+
+    Parameters
+    ----------
+    partition
+      The :class:`~VertexPartition.MutableVertexPartition` to optimise.
+
+    n_starts : int
+      Number of independent optimisations, each starting from the current
+      membership of ``partition``.
+
+    n_iterations : int
+      Number of iterations to run the Leiden algorithm for each start (see
+      :func:`optimise_partition`).
+
+    return_memberships : bool
+      If ``True``, also return the resulting membership of each start, for
+      example to construct a consensus partition.
+
+    Returns
+    -------
+    float
+      Improvement in quality function.
+
+    list of list of int
+      The membership of each start, only returned if ``return_memberships``
+      is ``True``.
+
+    Notes
+    -----
+    The starts are optimised concurrently using :attr:`n_threads` threads,
+    which all share the same graph. Each start uses its own random seed,
+    derived from the seed of this optimiser, and ties are broken in favour of
+    the earliest start, so that the result does not depend on the number of
+    threads. The partition is set to the start with the highest quality.
+
+    Examples
+    --------
+
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> diff = optimiser.optimise_partition_multistart(partition, n_starts=10)
+
+    """
+    result = _c_leiden._Optimiser_optimise_partition_multistart(self._optimiser,
+        partition._partition, n_starts, n_iterations, return_memberships)
     partition._update_internal_membership()
-    return diff
+    return result
 
-  def optimise_partition_multiplex(self, partitions, layer_weights=None, n_iterations=2):
+  def optimise_partition_multiplex(self, partitions, layer_weights=None, n_iterations=2, max_time=None, tolerance=0):
     """ Optimise the given partitions simultaneously.
 
     Parameters
@@ -288,6 +685,13 @@ class Optimiser(object):
       are run. If the number of iterations is negative, the Leiden algorithm is
       run until an iteration in which there was no improvement.
 
+    max_time : float
+      Maximum wall time in seconds, see :func:`optimise_partition`.
+
+    tolerance : float
+      Minimum relative improvement of an iteration, see
+      :func:`optimise_partition`.
+
     Returns
     -------
     float
@@ -353,26 +757,19 @@ class Optimiser(object):
     if not layer_weights:
       layer_weights = [1]*len(partitions)
 
-    itr = 0
-    diff = 0
-    continue_iteration = itr < n_iterations or n_iterations < 0
-    while continue_iteration:
-      diff_inc = _c_leiden._Optimiser_optimise_partition_multiplex(
-        self._optimiser,
-        [partition._partition for partition in partitions],
-        layer_weights)
-      diff += diff_inc
-      itr += 1
-      if n_iterations < 0:
-        continue_iteration = (diff_inc > 0)
-      else:
-        continue_iteration = itr < n_iterations
+    diff = _c_leiden._Optimiser_optimise_partition_multiplex(
+      self._optimiser,
+      [partition._partition for partition in partitions],
+      layer_weights,
+      n_iterations,
+      max_time if max_time else 0,
+      tolerance)
 
     for partition in partitions:
       partition._update_internal_membership()
     return diff
 
-  def move_nodes(self, partition, consider_comms=None):
+  def move_nodes(self, partition, consider_comms=None, nodes=None):
     """ Move nodes to alternative communities for *optimising* the partition.
 
     Parameters
@@ -384,6 +781,13 @@ class Optimiser(object):
       If ``None`` uses :attr:`consider_comms`, but can be set to
       something else.
 
+    nodes
+      The nodes that are initially considered for moving. If ``None``, all
+      nodes are considered. Other nodes are only considered once one of their
+      neighbours has moved. This can be used to update a partition after
+      changing the graph, see
+      :func:`~VertexPartition.MutableVertexPartition.add_edges`.
+
     Returns
     -------
     float
@@ -412,7 +816,9 @@ class Optimiser(object):
     """
     if (consider_comms is None):
       consider_comms = self.consider_comms
-    diff =  _c_leiden._Optimiser_move_nodes(self._optimiser, partition._partition, consider_comms)
+    if nodes is not None:
+      nodes = list(nodes)
+    diff =  _c_leiden._Optimiser_move_nodes(self._optimiser, partition._partition, consider_comms, nodes)
     partition._update_internal_membership()
     return diff
 
@@ -562,7 +968,7 @@ class Optimiser(object):
         partition_type,
         resolution_range,
         weights=None,
-        bisect_func=lambda p: p.bisect_value(),
+        bisect_func=None,
         min_diff_bisect_value=1,
         min_diff_resolution=1e-3,
         linear_bisection=False,
@@ -596,7 +1002,9 @@ class Optimiser(object):
     ----------------
     bisect_func
       The function used for bisectioning. For the methods currently
-      implemented, this should usually not be altered.
+      implemented, this should usually not be altered. If :obj:`None`, the
+      default :func:`~VertexPartition.LinearResolutionParameterVertexPartition.bisect_value`
+      is used, and the profile is constructed natively (see Notes).
 
     min_diff_bisect_value
       The difference in the value returned by the bisect_func below which the
@@ -620,6 +1028,16 @@ class Optimiser(object):
       Indicates the number of iterations of the algorithm to run. If negative
       (or zero) the algorithm is run until a stable iteration.
 
+    Notes
+    -----
+    Unless a different ``bisect_func`` is provided, the bisectioning is done
+    natively. All partitions then share the same graph, and the new resolution
+    values of all intervals that are bisected in the same round are optimised
+    concurrently, using :attr:`n_threads` threads. Each new resolution value
+    starts from the best partition of the two ends of its interval. Each
+    resolution value uses its own random seed, derived from the seed of this
+    optimiser, so that the profile does not depend on the number of threads.
+
     Examples
     --------
     >>> G = ig.Graph.Famous('Zachary')
@@ -627,23 +1045,46 @@ class Optimiser(object):
     >>> profile = optimiser.resolution_profile(G, la.CPMVertexPartition,
     ...                                        resolution_range=(0,1))
     """
+    assert issubclass(partition_type, LinearResolutionParameterVertexPartition), "Bisectioning only works on partitions with a linear resolution parameter."
+
+    if bisect_func is None:
+      partition = partition_type(graph, weights=weights,
+          resolution_parameter=resolution_range[0], **kwargs)
+      profile = _c_leiden._Optimiser_resolution_profile(self._optimiser,
+          partition._partition, resolution_range[0], resolution_range[1],
+          min_diff_bisect_value, min_diff_resolution, linear_bisection,
+          number_iterations)
+      return [partition_type._FromCPartitionOnGraph(p, graph, partition)
+              for p in profile]
+
+    # The quality of each partition for all resolution parameters at once,
+    # which only requires a single pass over the communities of each partition
+    def quality_table(bisect_values):
+      resolutions = list(bisect_values.keys())
+      table = {}
+      for bisect in bisect_values.values():
+        if id(bisect.partition) not in table:
+          table[id(bisect.partition)] = dict(zip(resolutions,
+              bisect.partition.qualities(resolutions)))
+      return table
 
     # Helper function for cleaning values to be a stepwise function
     def clean_stepwise(bisect_values):
+      quality = quality_table(bisect_values)
       # Check best partition for each resolution parameter
-      for res, bisect in bisect_values.iteritems():
+      for res, bisect in list(bisect_values.items()):
         best_bisect = bisect
-        best_quality = bisect.partition.quality(res)
-        for res2, bisect2 in bisect_values.iteritems():
-          if bisect2.partition.quality(res) > best_quality:
+        best_quality = quality[id(bisect.partition)][res]
+        for res2, bisect2 in bisect_values.items():
+          if quality[id(bisect2.partition)][res] > best_quality:
             best_bisect = bisect2
-            best_quality = bisect2.partition.quality(res)
+            best_quality = quality[id(bisect2.partition)][res]
         if best_bisect != bisect:
           bisect_values[res] = best_bisect
 
       # We only need to keep the changes in the bisection values
       bisect_list = sorted([(res, part.bisect_value) for res, part in
-        bisect_values.iteritems()], key=lambda x: x[0])
+        bisect_values.items()], key=lambda x: x[0])
       for (res1, v1), (res2, v2) \
           in zip(bisect_list,
                  bisect_list[1:]):
@@ -652,7 +1093,7 @@ class Optimiser(object):
         if v1 == v2:
           del bisect_values[res2]
 
-      for res, bisect in bisect_values.iteritems():
+      for res, bisect in list(bisect_values.items()):
         bisect.partition.resolution_parameter = res
 
     # We assume here that the bisection values are
@@ -660,13 +1101,16 @@ class Optimiser(object):
     # parameter values.
     def ensure_monotonicity(bisect_values, new_res):
       # First check if this partition improves on any other partition
-      for res, bisect_part in bisect_values.iteritems():
-        if bisect_values[new_res].partition.quality(res) > bisect_part.partition.quality(res):
+      resolutions = list(bisect_values.keys())
+      new_quality = dict(zip(resolutions,
+          bisect_values[new_res].partition.qualities(resolutions)))
+      for res, bisect_part in list(bisect_values.items()):
+        if new_quality[res] > bisect_part.partition.quality(res):
           bisect_values[res] = bisect_values[new_res]
       # Then check what is best partition for the new_res
       current_quality = bisect_values[new_res].partition.quality(new_res)
       best_res = new_res
-      for res, bisect_part in bisect_values.iteritems():
+      for res, bisect_part in list(bisect_values.items()):
         if bisect_part.partition.quality(new_res) > current_quality:
           best_res = new_res
       bisect_values[new_res] = bisect_values[best_res]
@@ -681,7 +1125,6 @@ class Optimiser(object):
         n_itr += 1
       return partition
 
-    assert issubclass(partition_type, LinearResolutionParameterVertexPartition), "Bisectioning only works on partitions with a linear resolution parameter."
     # Start actual bisectioning
     bisect_values = {}
     stack_res_range = []
@@ -728,7 +1171,7 @@ class Optimiser(object):
         stack_res_range.append((new_res, current_range[1]))
         # If we haven't scanned this resolution value yet,
         # do so now
-        if not bisect_values.has_key(new_res):
+        if not new_res in bisect_values:
           partition = find_partition(self, graph, partition_type=partition_type,
               weights=weights, resolution_parameter=new_res, **kwargs)
           bisect_values[new_res] = BisectPartition(partition=partition,
@@ -744,4 +1187,110 @@ class Optimiser(object):
     # Use an ordered dict so that when iterating over it, the results appear in
     # increasing order based on the resolution value.
     return sorted((bisect.partition for res, bisect in
-      bisect_values.iteritems()), key=lambda x: x.resolution_parameter)
+      bisect_values.items()), key=lambda x: x.resolution_parameter)
+
+class OptimisationHandle(object):
+  """ Handle of an optimisation running on a background thread, as returned by
+  :func:`Optimiser.optimise_partition_async`.
+
+  The handle can be polled using :func:`done` and :attr:`progress`, waited for
+  using :func:`result`, or awaited in a coroutine. After :func:`cancel`, the
+  optimisation stops as soon as possible, which is checked while moving nodes
+  and between aggregation levels, and keeps the best partition found so far,
+  similar to running out of time.
+
+  Attributes
+  ----------
+  future : :class:`concurrent.futures.Future`
+    The future of the improvement in quality function.
+  """
+  def __init__(self, control, future):
+    self._control = control
+    self.future = future
+
+  def done(self):
+    """ Whether the optimisation finished. """
+    return self.future.done()
+
+  def cancel(self):
+    """ Stop the optimisation as soon as possible. """
+    _c_leiden._OptimiserControl_cancel(self._control)
+
+  @property
+  def progress(self):
+    """ dict: the progress of the optimisation so far, containing
+
+    * ``iteration``: the current iteration, starting from 0;
+    * ``level``: the current aggregation level within the iteration, starting
+      from 0;
+    * ``nodes_processed``: the approximate number of times a node was
+      considered for moving, over all levels and iterations;
+    * ``quality``: the quality after moving the nodes of the last level that
+      was finished;
+    * ``cancelled``: whether :func:`cancel` was called.
+    """
+    return _c_leiden._OptimiserControl_get_progress(self._control)
+
+  def result(self, timeout=None):
+    """ Wait for the optimisation to finish, for at most ``timeout`` seconds
+    if provided, and return the improvement in quality function. """
+    return self.future.result(timeout)
+
+  def __await__(self):
+    import asyncio
+    future = asyncio.wrap_future(self.future)
+    future.add_done_callback(lambda f: self.cancel() if f.cancelled() else None)
+    return future.__await__()
+
+class Hierarchy(object):
+  """ Aggregation hierarchy of a single run of the Leiden algorithm, see
+  :attr:`Optimiser.hierarchy`.
+
+  Level ``k`` maps each node of the graph of aggregation level ``k`` (where
+  level 0 is the graph itself) to a node of the graph of level ``k + 1``,
+  which is a (refined) community of level ``k``. The last level maps each node
+  of the last graph to its community in the resulting partition. Hence,
+  :func:`membership` of the last level is the membership of the partition,
+  while lower levels give increasingly finer memberships, which are nested
+  within each other.
+
+  Each level is a read-only :class:`memoryview` of unsigned 32 bit integers,
+  directly on the memory of the hierarchy, without copying it. The levels
+  can be wrapped without copying, for example using
+
+  >>> import numpy as np # doctest: +SKIP
+  >>> level = np.asarray(hierarchy[0]) # doctest: +SKIP
+
+  The hierarchy is only available when using Python 3.
+  """
+  def __init__(self, levels):
+    self._levels = levels
+
+  def __len__(self):
+    return len(self._levels)
+
+  def __getitem__(self, level):
+    return self._levels[level]
+
+  def membership(self, level):
+    """ The membership of the nodes of the graph at the given level of the
+    hierarchy, composing the levels up to and including it.
+
+    Parameters
+    ----------
+    level : int
+      The level, where ``len(hierarchy) - 1`` gives the membership of the
+      partition.
+
+    Returns
+    -------
+    list of int
+      The community of each node.
+    """
+    if level < 0:
+      level += len(self)
+    membership = list(self[0])
+    for k in range(1, level + 1):
+      mapping = self[k]
+      membership = [mapping[c] for c in membership]
+    return membership
@@ -34,6 +34,11 @@ RBConfigurationVertexPartition* RBConfigurationVertexPartition::create(Graph* gr
   return new RBConfigurationVertexPartition(graph, membership, this->resolution_parameter);
 }
 
+RBConfigurationVertexPartition* RBConfigurationVertexPartition::clone()
+{
+  return new RBConfigurationVertexPartition(*this);
+}
+
 /*****************************************************************************
   Returns the difference in modularity if we move a node to a new community
 *****************************************************************************/
@@ -119,6 +124,53 @@ double RBConfigurationVertexPartition::diff_move(size_t v, size_t new_comm)
   return diff;
 }
 
+/*****************************************************************************
+  Returns the difference in modularity if we move a node to each of the
+  communities in comms (see diff_move).
+*****************************************************************************/
+void RBConfigurationVertexPartition::diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs)
+{
+  #ifdef DEBUG
+    cerr << "void RBConfigurationVertexPartition::diff_move_all(" << v << ", " << comms.size() << " communities)" << endl;
+  #endif
+  size_t n_comms = comms.size();
+  diffs.resize(n_comms);
+  size_t old_comm = this->_membership[v];
+  double total_weight = this->graph->total_weight()*(2.0 - this->graph->is_directed());
+  if (total_weight == 0.0)
+  {
+    diffs.assign(n_comms, 0.0);
+    return;
+  }
+
+  vector<double> const& weight_to = this->weights_to_comms(v);
+  vector<double> const& weight_from = this->weights_from_comms(v);
+  size_t n_cached = weight_to.size();
+
+  // Terms that only depend on the node and its current community
+  double w_to_old = old_comm < n_cached ? weight_to[old_comm] : 0.0;
+  double w_from_old = old_comm < n_cached ? weight_from[old_comm] : 0.0;
+  double k_out = this->graph->strength(v, IGRAPH_OUT);
+  double k_in = this->graph->strength(v, IGRAPH_IN);
+  double self_weight = this->graph->node_self_weight(v);
+  double K_out_old = this->total_weight_from_comm(old_comm);
+  double K_in_old = this->total_weight_to_comm(old_comm);
+  double diff_old = (w_to_old - this->resolution_parameter*k_out*K_in_old/total_weight) + \
+             (w_from_old - this->resolution_parameter*k_in*K_out_old/total_weight);
+
+  for (size_t i = 0; i < n_comms; i++)
+  {
+    size_t new_comm = comms[i];
+    double w_to_new = new_comm < n_cached ? weight_to[new_comm] : 0.0;
+    double w_from_new = new_comm < n_cached ? weight_from[new_comm] : 0.0;
+    double K_out_new = this->total_weight_from_comm(new_comm) + k_out;
+    double K_in_new = this->total_weight_to_comm(new_comm) + k_in;
+    double diff_new = (w_to_new + self_weight - this->resolution_parameter*k_out*K_in_new/total_weight) + \
+               (w_from_new + self_weight - this->resolution_parameter*k_in*K_out_new/total_weight);
+    diffs[i] = new_comm != old_comm ? diff_new - diff_old : 0.0;
+  }
+}
+
 /*****************************************************************************
   Give the modularity of the partition.
 
@@ -159,3 +211,26 @@ double RBConfigurationVertexPartition::quality(double resolution_parameter)
   #endif
   return q;
 }
+
+/****************************************************************************
+  The terms of the quality (see quality), which are both summed over all
+  communities at once.
+*****************************************************************************/
+void RBConfigurationVertexPartition::quality_terms(double& E, double& F)
+{
+  E = F = 0.0;
+  if (this->graph->total_weight() == 0)
+    return;
+
+  double w = 0.0;
+  double w_out_in = 0.0;
+  size_t nb_comms = this->n_communities();
+  for (size_t c = 0; c < nb_comms; c++)
+  {
+    w += this->total_weight_in_comm(c);
+    w_out_in += this->total_weight_from_comm(c)*this->total_weight_to_comm(c);
+  }
+  double scale = 2.0 - this->graph->is_directed();
+  E = scale*w;
+  F = scale*w_out_in/((this->graph->is_directed() ? 1.0 : 4.0)*this->graph->total_weight());
+}
@@ -23,3 +23,11 @@ ResolutionParameterVertexPartition::ResolutionParameterVertexPartition(Graph* gr
 
 ResolutionParameterVertexPartition::~ResolutionParameterVertexPartition()
 { }
+
+void ResolutionParameterVertexPartition::qualities(vector<double> const& resolution_parameters, vector<double>& qualities)
+{
+  size_t n_res = resolution_parameters.size();
+  qualities.resize(n_res);
+  for (size_t i = 0; i < n_res; i++)
+    qualities[i] = this->quality(resolution_parameters[i]);
+}
@@ -10,11 +10,15 @@ SignificanceVertexPartition::SignificanceVertexPartition(Graph* graph,
       vector<size_t> const& membership) :
         MutableVertexPartition(graph,
         membership)
-{ }
+{
+  this->init_comm_kll(1);
+}
 
 SignificanceVertexPartition::SignificanceVertexPartition(Graph* graph) :
         MutableVertexPartition(graph)
-{ }
+{
+  this->init_comm_kll(1);
+}
 
 SignificanceVertexPartition* SignificanceVertexPartition::create(Graph* graph)
 {
@@ -26,9 +30,75 @@ SignificanceVertexPartition* SignificanceVertexPartition::create(Graph* graph, v
   return new SignificanceVertexPartition(graph, membership);
 }
 
+SignificanceVertexPartition* SignificanceVertexPartition::clone()
+{
+  return new SignificanceVertexPartition(*this);
+}
+
 SignificanceVertexPartition::~SignificanceVertexPartition()
 { }
 
+void SignificanceVertexPartition::set_n_caches(size_t n_caches)
+{
+  MutableVertexPartition::set_n_caches(n_caches);
+  this->init_comm_kll(n_caches);
+}
+
+void SignificanceVertexPartition::graph_changed()
+{
+  this->init_comm_kll(this->_comm_kll.size());
+}
+
+void SignificanceVertexPartition::init_comm_kll(size_t n_caches)
+{
+  if (n_caches < 1)
+    n_caches = 1;
+  size_t n = this->graph->vcount();
+  this->_comm_kll.resize(n_caches);
+  for (vector<CommunityKLL>::iterator it = this->_comm_kll.begin();
+       it != this->_comm_kll.end(); it++)
+  {
+    // No community has this size, so that nothing is memoized initially.
+    it->density = this->graph->density();
+    it->csize.assign(n, (size_t)-1);
+    it->weight_in.assign(n, 0.0);
+    it->NKLL.assign(n, 0.0);
+  }
+}
+
+/********************************************************************************
+   Calculate N_c KLL(p_c, p) for community c, which is memoized in the cache of
+   the calling thread until the size or the internal weight of c changes.
+*********************************************************************************/
+double SignificanceVertexPartition::comm_NKLL(size_t comm)
+{
+  size_t n_c = this->csize(comm);
+  double m_c = this->total_weight_in_comm(comm);
+  CommunityKLL& memo = this->_comm_kll[thread_cache(this->_comm_kll.size())];
+  if (memo.density != this->graph->density())
+  {
+    // The edges of the graph have changed, so that nothing memoized is valid.
+    memo.density = this->graph->density();
+    memo.csize.assign(memo.csize.size(), (size_t)-1);
+  }
+  bool memoize = comm < memo.NKLL.size();
+  if (memoize && memo.csize[comm] == n_c && memo.weight_in[comm] == m_c)
+    return memo.NKLL[comm];
+
+  size_t N_c = this->graph->possible_edges(n_c);
+  double p_c = 0.0;
+  if (N_c > 0)
+    p_c = m_c/N_c;
+  double NKLL = (double)N_c*KLL(p_c, this->graph->density());
+  if (memoize)
+  {
+    memo.csize[comm] = n_c;
+    memo.weight_in[comm] = m_c;
+    memo.NKLL[comm] = NKLL;
+  }
+  return NKLL;
+}
+
 double SignificanceVertexPartition::diff_move(size_t v, size_t new_comm)
 {
   #ifdef DEBUG
@@ -49,12 +119,12 @@ double SignificanceVertexPartition::diff_move(size_t v, size_t new_comm)
 
     //Old comm
     size_t n_old = this->csize(old_comm);
-    size_t N_old = this->graph->possible_edges(n_old);
     double m_old = this->total_weight_in_comm(old_comm);
-    double q_old = 0.0;
-    if (N_old > 0)
-      q_old = m_old/N_old;
     #ifdef DEBUG
+      size_t N_old = this->graph->possible_edges(n_old);
+      double q_old = 0.0;
+      if (N_old > 0)
+        q_old = m_old/N_old;
       cerr << "\t" << "n_old: " << n_old << ", N_old: " << N_old << ", m_old: " << m_old << ", q_old: " << q_old
            << ", KL: " << KL(q_old, p)  << "." << endl;
     #endif
@@ -79,12 +149,12 @@ double SignificanceVertexPartition::diff_move(size_t v, size_t new_comm)
 
     // New comm
     size_t n_new = this->csize(new_comm);
-    size_t N_new = this->graph->possible_edges(n_new);
     double m_new = this->total_weight_in_comm(new_comm);
-    double q_new = 0.0;
-    if (N_new > 0)
-      q_new = m_new/N_new;
     #ifdef DEBUG
+      size_t N_new = this->graph->possible_edges(n_new);
+      double q_new = 0.0;
+      if (N_new > 0)
+        q_new = m_new/N_new;
       cerr << "\t" << "n_new: " << n_new << ", N_new: " << N_new << ", m_new: " << m_new << ", q_new: " << q_new
            << ", KL: " << KL(q_new, p)  << "." << endl;
     #endif
@@ -108,10 +178,10 @@ double SignificanceVertexPartition::diff_move(size_t v, size_t new_comm)
            << ", KL: " << KL(q_newx, p) << "." << endl;
     #endif
 
-    // Calculate actual diff
+    // Calculate actual diff, the terms before the move are memoized.
 
     diff =   (double)N_oldx*KLL(q_oldx, p) + (double)N_newx*KLL(q_newx, p)
-           - (double)N_old *KLL(q_old,  p) - (double)N_new *KLL(q_new,  p);
+           - this->comm_NKLL(old_comm) - this->comm_NKLL(new_comm);
     #ifdef DEBUG
       cerr << "\t" << "diff: " << diff << "." << endl;
     #endif
@@ -123,6 +193,63 @@ double SignificanceVertexPartition::diff_move(size_t v, size_t new_comm)
   return diff;
 }
 
+/********************************************************************************
+   Calculate diff_move for all communities in comms at once. The terms for the
+   old community only need to be calculated once, while the terms for each new
+   community before the move are memoized, so that only N_newx KLL(q_newx, p)
+   has to be calculated for each community separately.
+*********************************************************************************/
+void SignificanceVertexPartition::diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs)
+{
+  size_t n_comms = comms.size();
+  diffs.resize(n_comms);
+  if (n_comms == 0)
+    return;
+
+  size_t old_comm = this->membership(v);
+  size_t nsize = this->graph->node_size(v);
+  double normalise = (2.0 - this->graph->is_directed());
+  double p = this->graph->density();
+  double sw = this->graph->node_self_weight(v);
+  vector<double> const& w_to = this->weights_to_comms(v);
+  vector<double> const& w_from = this->weights_from_comms(v);
+
+  // Old comm after move
+  size_t n_oldx = this->csize(old_comm) - nsize;
+  size_t N_oldx = this->graph->possible_edges(n_oldx);
+  double wtc = this->weight_to_comm(v, old_comm) - sw;
+  double wfc = this->weight_from_comm(v, old_comm) - sw;
+  double m_oldx = this->total_weight_in_comm(old_comm) - wtc/normalise - wfc/normalise - sw;
+  double q_oldx = 0.0;
+  if (N_oldx > 0)
+    q_oldx = m_oldx/N_oldx;
+  double NKLL_oldx = (double)N_oldx*KLL(q_oldx, p);
+  double NKLL_old = this->comm_NKLL(old_comm);
+
+  for (size_t i = 0; i < n_comms; i++)
+  {
+    size_t comm = comms[i];
+    if (comm == old_comm)
+    {
+      diffs[i] = 0.0;
+      continue;
+    }
+
+    // New comm after move
+    size_t n_newx = this->csize(comm) + nsize;
+    size_t N_newx = this->graph->possible_edges(n_newx);
+    wtc = comm < w_to.size() ? w_to[comm] : 0.0;
+    wfc = comm < w_from.size() ? w_from[comm] : 0.0;
+    double m_newx = this->total_weight_in_comm(comm) + wtc/normalise + wfc/normalise + sw;
+    double q_newx = 0.0;
+    if (N_newx > 0)
+      q_newx = m_newx/N_newx;
+
+    diffs[i] =   NKLL_oldx + (double)N_newx*KLL(q_newx, p)
+               - NKLL_old - this->comm_NKLL(comm);
+  }
+}
+
 /********************************************************************************
    Calculate the significance of the partition.
 *********************************************************************************/
@@ -4,11 +4,15 @@ SurpriseVertexPartition::SurpriseVertexPartition(Graph* graph,
       vector<size_t> const& membership) :
         MutableVertexPartition(graph,
         membership)
-{ }
+{
+  this->init_partition_kll(1);
+}
 
 SurpriseVertexPartition::SurpriseVertexPartition(Graph* graph) :
         MutableVertexPartition(graph)
-{ }
+{
+  this->init_partition_kll(1);
+}
 
 SurpriseVertexPartition* SurpriseVertexPartition::create(Graph* graph)
 {
@@ -20,9 +24,56 @@ SurpriseVertexPartition* SurpriseVertexPartition::create(Graph* graph)
   return new  SurpriseVertexPartition(graph, membership);
 }
 
+SurpriseVertexPartition* SurpriseVertexPartition::clone()
+{
+  return new SurpriseVertexPartition(*this);
+}
+
 SurpriseVertexPartition::~SurpriseVertexPartition()
 { }
 
+void SurpriseVertexPartition::set_n_caches(size_t n_caches)
+{
+  MutableVertexPartition::set_n_caches(n_caches);
+  this->init_partition_kll(n_caches);
+}
+
+void SurpriseVertexPartition::init_partition_kll(size_t n_caches)
+{
+  if (n_caches < 1)
+    n_caches = 1;
+  this->_partition_kll.resize(n_caches);
+  for (vector<PartitionKLL>::iterator it = this->_partition_kll.begin();
+       it != this->_partition_kll.end(); it++)
+  {
+    // There are never more possible internal edges than this, so that
+    // nothing is memoized initially.
+    it->m = 0.0;
+    it->mc = 0.0;
+    it->nc2 = (size_t)-1;
+    it->KLL = 0.0;
+  }
+}
+
+/********************************************************************************
+   Calculate KLL(q, s) for the current partition, which is memoized in the cache
+   of the calling thread until mc or nc2 (or the total weight m) changes.
+*********************************************************************************/
+double SurpriseVertexPartition::partition_KLL(double mc, size_t nc2, double m, size_t n2)
+{
+  PartitionKLL& memo = this->_partition_kll[thread_cache(this->_partition_kll.size())];
+  if (memo.nc2 != nc2 || memo.mc != mc || memo.m != m)
+  {
+    double q = mc/m;
+    double s = (double)nc2/(double)n2;
+    memo.m = m;
+    memo.mc = mc;
+    memo.nc2 = nc2;
+    memo.KLL = KLL(q, s);
+  }
+  return memo.KLL;
+}
+
 double SurpriseVertexPartition::diff_move(size_t v, size_t new_comm)
 {
   #ifdef DEBUG
@@ -83,8 +134,6 @@ double SurpriseVertexPartition::diff_move(size_t v, size_t new_comm)
       cerr << "\t" << "m_new: " << m_new << ", n_new: " << n_new << "." << endl;
     #endif
 
-    double q = mc/m;
-    double s = (double)nc2/(double)n2;
     double q_new = (mc - m_old + m_new)/m;
     #ifdef DEBUG
       cerr << "\t" << "mc - m_old + m_new=" << (mc - m_old + m_new) << endl;
@@ -95,10 +144,12 @@ double SurpriseVertexPartition::diff_move(size_t v, size_t new_comm)
       cerr << "\t" << "delta_nc2=" << delta_nc2 << endl;
     #endif
     #ifdef DEBUG
+      double q = mc/m;
+      double s = (double)nc2/(double)n2;
       cerr << "\t" << "q:\t" << q << ", s:\t"  << s << "." << endl;
       cerr << "\t" << "q_new:\t" << q_new << ", s_new:\t"  << s_new << "." << endl;
     #endif
-    diff = m*(KLL(q_new, s_new) - KLL(q, s));
+    diff = m*(KLL(q_new, s_new) - this->partition_KLL(mc, nc2, m, n2));
 
     #ifdef DEBUG
       cerr << "\t" << "diff: " << diff << "." << endl;
@@ -111,6 +162,59 @@ double SurpriseVertexPartition::diff_move(size_t v, size_t new_comm)
   return diff;
 }
 
+/********************************************************************************
+   Calculate diff_move for all communities in comms at once. Everything that
+   does not depend on the new community is only calculated once, and KLL(q, s)
+   before the move is memoized, so that only KLL(q_new, s_new) has to be
+   calculated for each community separately.
+*********************************************************************************/
+void SurpriseVertexPartition::diff_move_all(size_t v, vector<size_t> const& comms, vector<double>& diffs)
+{
+  size_t n_comms = comms.size();
+  diffs.assign(n_comms, 0.0);
+  double m = this->graph->total_weight();
+  if (n_comms == 0 || m == 0)
+    return;
+
+  size_t old_comm = this->membership(v);
+  size_t nsize = this->graph->node_size(v);
+  double normalise = (2.0 - this->graph->is_directed());
+  size_t n = this->graph->total_size();
+  size_t n2 = this->graph->possible_edges(n);
+  vector<double> const& w_to = this->weights_to_comms(v);
+  vector<double> const& w_from = this->weights_from_comms(v);
+
+  // Before move
+  double mc = this->total_weight_in_all_comms();
+  size_t nc2 = this->total_possible_edges_in_all_comms();
+  double KLL_before = this->partition_KLL(mc, nc2, m, n2);
+
+  // To old comm
+  size_t n_old = this->csize(old_comm);
+  double sw = this->graph->node_self_weight(v);
+  double wtc = this->weight_to_comm(v, old_comm) - sw;
+  double wfc = this->weight_from_comm(v, old_comm) - sw;
+  double m_old = wtc/normalise + wfc/normalise + sw;
+
+  for (size_t i = 0; i < n_comms; i++)
+  {
+    size_t comm = comms[i];
+    if (comm == old_comm)
+      continue;
+
+    // To new comm
+    size_t n_new = this->csize(comm);
+    wtc = comm < w_to.size() ? w_to[comm] : 0.0;
+    wfc = comm < w_from.size() ? w_from[comm] : 0.0;
+    double m_new = wtc/normalise + wfc/normalise + sw;
+
+    double q_new = (mc - m_old + m_new)/m;
+    double delta_nc2 = 2.0*nsize*(ptrdiff_t)(n_new - n_old + nsize)/normalise;
+    double s_new = (double)(nc2 + delta_nc2)/(double)n2;
+    diffs[i] = m*(KLL(q_new, s_new) - KLL_before);
+  }
+}
+
 double SurpriseVertexPartition::quality()
 {
   #ifdef DEBUG
@@ -5,6 +5,23 @@ import sys
 # Check if working with Python 3
 PY3 = (sys.version > '3')
 
+def _as_list_or_buffer(values):
+  """ Return ``values`` unchanged if it supports the buffer protocol (e.g. a
+  NumPy array), so that it can be read without copying, and convert it to a
+  list otherwise. """
+  try:
+    memoryview(values)
+  except (TypeError, ValueError):
+    return list(values)
+  return values
+
+def _restore_partition(cls, graph, kwargs, state):
+  """ Recreate a pickled partition (see
+  :func:`~VertexPartition.MutableVertexPartition.__reduce__`). """
+  partition = cls(graph, **kwargs)
+  partition.restore(state)
+  return partition
+
 class MutableVertexPartition(_ig.VertexClustering):
   """ Contains a partition of graph, derives from :class:`ig.VertexClustering`.
 
@@ -65,6 +82,18 @@ class MutableVertexPartition(_ig.VertexClustering):
     new_partition._update_internal_membership()
     return new_partition
 
+  @classmethod
+  def _FromCPartitionOnGraph(cls, partition, graph, graph_owner):
+    """ Wrap a C++ partition that shares the C++ graph of ``graph_owner``,
+    which corresponds to ``graph``. A reference to ``graph_owner`` is kept, so
+    that the shared graph is not deleted before this partition. """
+    new_partition = cls.__new__(cls)
+    MutableVertexPartition.__init__(new_partition, graph)
+    new_partition._partition = partition
+    new_partition._graph_owner = graph_owner
+    new_partition._update_internal_membership()
+    return new_partition
+
   @classmethod
   def FromPartition(cls, partition, **kwargs):
     """ Create a new partition from an existing partition.
@@ -92,6 +121,169 @@ class MutableVertexPartition(_ig.VertexClustering):
     new_partition = cls(partition.graph, partition.membership, **kwargs)
     return new_partition
 
+  @classmethod
+  def FromFile(cls, filename, initial_membership=None, validate=True, **kwargs):
+    """ Create a new partition on a graph stored by :func:`save_graph`.
+
+    The file is memory mapped, so that the graph is not copied into memory
+    and no :class:`ig.Graph` with all edges needs to be constructed. This is
+    useful when repeatedly detecting communities on the same large graph.
+
+    Parameters
+    ----------
+    filename : str
+      File created by :func:`save_graph`.
+
+    initial_membership : list of int
+      Initial membership for the partition. If :obj:`None` then defaults to a
+      singleton partition.
+
+    validate : bool
+      Check that the stored adjacency is consistent before using it, so that a
+      corrupted file raises a :class:`ValueError`. This reads the entire file,
+      and may be turned off for files that are known to be intact.
+
+    resolution_parameter : double
+      Resolution parameter, only used for partitions with a resolution
+      parameter.
+
+    Notes
+    -----
+    The ``graph`` of the resulting partition is only constructed from the
+    stored graph when it is first used, for example by ``graph``,
+    :func:`modularity`, :func:`subgraphs`, :func:`giant` or
+    :func:`cluster_graph`. It then contains all edges, with their weights in
+    the edge attribute ``weight``, and the node sizes in the node attribute
+    ``node_size``, so that it takes as much memory as any :class:`ig.Graph`
+    of the same size. Other vertex and edge attributes are not stored by
+    :func:`save_graph`, and are therefore not available.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> la.save_graph(G, 'zachary.graph')
+    >>> p = la.ModularityVertexPartition.FromFile('zachary.graph')
+    """
+    method = cls.__name__.replace('VertexPartition', '')
+    resolution_parameter = kwargs.get('resolution_parameter', 1.0)
+    if initial_membership is not None:
+      initial_membership = _as_list_or_buffer(initial_membership)
+    partition, n, directed = _c_leiden._new_VertexPartition_from_file(filename,
+        method, initial_membership, resolution_parameter, validate)
+    return cls._FromCPartitionWithoutEdges(partition, n, directed)
+
+  @classmethod
+  def FromEdges(cls, edges, n=0, directed=False, initial_membership=None,
+                node_sizes=None, **kwargs):
+    """ Create a new partition on a graph that is streamed from its edges.
+
+    The graph is constructed in two passes over the edges, without
+    constructing an :class:`ig.Graph`, so that no more than a single copy of
+    the edges is kept in memory besides the graph itself. Parallel edges are
+    merged by summing their weights.
+
+    Parameters
+    ----------
+    edges : str, iterable or callable
+      Either the name of a text file with one edge ``from to [weight]`` per
+      line, or the chunks of edges. Each chunk is a tuple ``(from, to)`` or
+      ``(from, to, weights)`` of lists or NumPy arrays. The chunks need to be
+      iterated twice, so they should be given as a sequence, or as a function
+      that returns a new iterator over the chunks whenever it is called.
+
+    n : int
+      Minimal number of nodes. If the edges refer to nodes beyond ``n``, these
+      nodes are added to the graph.
+
+    directed : bool
+      Whether the graph is directed.
+
+    initial_membership : list of int
+      Initial membership for the partition. If :obj:`None` then defaults to a
+      singleton partition.
+
+    node_sizes : list of int
+      Sizes of nodes. If :obj:`None` all nodes have a size of 1.
+
+    resolution_parameter : double
+      Resolution parameter, only used for partitions with a resolution
+      parameter.
+
+    Notes
+    -----
+    Similar to :func:`FromFile`, the ``graph`` of the resulting partition is
+    only constructed when it is first used, for example by ``graph``,
+    :func:`modularity`, :func:`subgraphs`, :func:`giant` or
+    :func:`cluster_graph`. It then contains all edges, where parallel edges
+    are merged, with their weights in the edge attribute ``weight``, and the
+    node sizes in the node attribute ``node_size``.
+
+    Examples
+    --------
+    >>> import numpy as np
+    >>> def chunks():
+    ...   for i in range(10):
+    ...     yield np.arange(i*10, (i + 1)*10), np.arange(i*10 + 1, (i + 1)*10 + 1)
+    >>> p = la.ModularityVertexPartition.FromEdges(chunks)
+    """
+    method = cls.__name__.replace('VertexPartition', '')
+    resolution_parameter = kwargs.get('resolution_parameter', 1.0)
+    builder = _c_leiden._new_GraphBuilder(n, directed)
+    if isinstance(edges, str):
+      _c_leiden._GraphBuilder_read_file(builder, edges)
+    else:
+      for fill in (False, True):
+        chunks = edges() if callable(edges) else edges
+        for chunk in chunks:
+          edge_from = _as_list_or_buffer(chunk[0])
+          edge_to = _as_list_or_buffer(chunk[1])
+          if fill:
+            weights = _as_list_or_buffer(chunk[2]) if len(chunk) > 2 else None
+            _c_leiden._GraphBuilder_add_edges(builder, edge_from, edge_to, weights)
+          else:
+            _c_leiden._GraphBuilder_count_edges(builder, edge_from, edge_to)
+    if initial_membership is not None:
+      initial_membership = _as_list_or_buffer(initial_membership)
+    if node_sizes is not None:
+      node_sizes = _as_list_or_buffer(node_sizes)
+    partition, n, directed = _c_leiden._new_VertexPartition_from_builder(builder,
+        method, initial_membership, node_sizes, resolution_parameter)
+    return cls._FromCPartitionWithoutEdges(partition, n, directed)
+
+  @classmethod
+  def _FromCPartitionWithoutEdges(cls, partition, n, directed):
+    """ Wrap a C++ partition whose graph is not available as an
+    :class:`ig.Graph`, which is only constructed when it is used (see
+    ``_graph``). """
+    new_partition = cls.__new__(cls)
+    MutableVertexPartition.__init__(new_partition, _ig.Graph(n=n, directed=directed))
+    new_partition._partition = partition
+    new_partition._graph_directed = directed
+    new_partition._graph = None
+    new_partition._update_internal_membership()
+    return new_partition
+
+  @property
+  def _graph(self):
+    """ The :class:`ig.Graph` of the partition, as used by
+    :class:`ig.VertexClustering`. For partitions created by :func:`FromFile`
+    and :func:`FromEdges` it is constructed from the graph of the partition
+    when it is first used. """
+    graph = self.__dict__.get('_ig_graph')
+    if graph is None:
+      n, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+      graph = _ig.Graph(n=n,
+                        edges=edges,
+                        directed=self._graph_directed,
+                        edge_attrs={'weight': weights},
+                        vertex_attrs={'node_size': node_sizes})
+      self._ig_graph = graph
+    return graph
+
+  @_graph.setter
+  def _graph(self, graph):
+    self._ig_graph = graph
+
   def _update_internal_membership(self):
     self._membership = _c_leiden._MutableVertexPartition_get_membership(self._partition)
     # Reset the length of the object, i.e. the number of communities
@@ -102,9 +294,133 @@ class MutableVertexPartition(_ig.VertexClustering):
 
   def set_membership(self, membership):
     """ Set membership. """
-    _c_leiden._MutableVertexPartition_set_membership(self._partition, list(membership))
+    _c_leiden._MutableVertexPartition_set_membership(self._partition, _as_list_or_buffer(membership))
+    self._update_internal_membership()
+
+  def membership_view(self):
+    """ Read-only view of the membership of the partition.
+
+    Returns
+    -------
+    memoryview
+      View directly on the membership of the underlying partition, without
+      copying it. The view reflects later changes to the partition.
+
+    Notes
+    -----
+    The view can be wrapped without copying, for example using
+
+    >>> import numpy as np # doctest: +SKIP
+    >>> membership = np.asarray(partition.membership_view()) # doctest: +SKIP
+
+    The view is only available when using Python 3.
+    """
+    return _c_leiden._MutableVertexPartition_get_membership_view(self._partition)
+
+  def __getitem__(self, idx):
+    """ The nodes of community ``idx`` in increasing order.
+
+    Notes
+    -----
+    The nodes of each community are kept by the underlying partition, so that
+    this takes time proportional to the size of the community, instead of to
+    the number of nodes of the graph.
+    """
+    if idx < 0 or idx >= len(self):
+      raise IndexError("cluster index out of range")
+    return _c_leiden._MutableVertexPartition_get_community(self._partition, idx)
+
+  def clone(self):
+    """ Create a copy of this partition on the same graph.
+
+    Returns
+    -------
+    :class:`~VertexPartition.MutableVertexPartition`
+      Copy of this partition, which can be changed independently.
+
+    Notes
+    -----
+    The administration of the partition is copied, instead of being
+    recalculated from all edges, as it would be when creating a new partition
+    with the same membership. The copy shares the underlying graph with this
+    partition, so that the graph of neither should be changed, for example
+    using :func:`~VertexPartition.MutableVertexPartition.add_edges`.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.CPMVertexPartition(G, resolution_parameter=0.1)
+    >>> diff = la.Optimiser().optimise_partition(partition)
+    >>> copy = partition.clone()
+    >>> copy.resolution_parameter = 0.2
+    >>> diff = la.Optimiser().optimise_partition(copy)
+    """
+    # Keep a reference to the partition that deletes the shared graph
+    graph_owner = getattr(self, '_graph_owner', self)
+    return self._FromCPartitionOnGraph(
+        _c_leiden._MutableVertexPartition_clone(self._partition),
+        self.graph, graph_owner)
+
+  def checkpoint(self):
+    """ The state of the partition, which can be restored later.
+
+    Returns
+    -------
+    bytes
+      Compact binary representation of the membership and the administration
+      of the partition.
+
+    See Also
+    --------
+    :func:`~VertexPartition.MutableVertexPartition.restore`
+    """
+    return _c_leiden._MutableVertexPartition_checkpoint(self._partition)
+
+  def restore(self, state):
+    """ Restore a state created by
+    :func:`~VertexPartition.MutableVertexPartition.checkpoint`.
+
+    Parameters
+    ----------
+    state : bytes
+      State of a partition of the same graph.
+
+    Notes
+    -----
+    The administration is read from the state, instead of being recalculated
+    from all edges, so that a long optimisation can be resumed quickly. A
+    :class:`ValueError` is raised if the state is not for a partition of the
+    same graph.
+
+    Partitions can also be pickled, which stores the graph and the state of
+    the partition.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> state = partition.checkpoint()
+    >>> diff = la.Optimiser().optimise_partition(partition)
+    >>> partition.restore(state)
+    """
+    _c_leiden._MutableVertexPartition_restore(self._partition, state)
     self._update_internal_membership()
 
+  def _init_kwargs(self, weights, node_sizes):
+    """ The keyword arguments to recreate this partition, given the weights
+    and node sizes of its graph (see ``__reduce__``). """
+    raise TypeError("Cannot pickle a {0}.".format(type(self).__name__))
+
+  def __reduce__(self):
+    n, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+    graph = self.graph
+    if graph.vcount() != n or graph.get_edgelist() != edges:
+      # The edges of the partition were changed, so that a graph with these
+      # edges is stored.
+      graph = _ig.Graph(n=n, edges=edges, directed=self.graph.is_directed())
+    return (_restore_partition,
+            (type(self), graph, self._init_kwargs(weights, node_sizes), self.checkpoint()))
+
   # Calculate improvement *if* we move this node
   def diff_move(self,v,new_comm):
     """ Calculate the difference in the quality function if node ``v`` is
@@ -260,7 +576,8 @@ class MutableVertexPartition(_ig.VertexClustering):
 
     Notes
     -----
-    The sort is not necessarily stable.
+    Communities of the same size are numbered in decreasing number of nodes,
+    and then in their previous order.
     """
     _c_leiden._MutableVertexPartition_renumber_communities(self._partition)
     self._update_internal_membership()
@@ -383,6 +700,113 @@ class MutableVertexPartition(_ig.VertexClustering):
     """
     return _c_leiden._MutableVertexPartition_weight_from_comm(self._partition, v, comm)
 
+  def add_edges(self, edges, weights=None):
+    """ Add edges to the graph of the partition, and update the partition.
+
+    Parameters
+    ----------
+    edges
+      List of ``(v, u)`` pairs of nodes between which to add an edge.
+
+    weights
+      Weights of the added edges. If ``None``, all added edges have weight 1.
+
+    Returns
+    -------
+    list of int
+      The nodes affected by the change, i.e. the endpoints of the added edges
+      and their neighbours.
+
+    Notes
+    -----
+    Only the graph underlying the partition is changed, ``partition.graph`` is
+    left unchanged. The added edges are numbered after the existing edges. The
+    administration of the partition is updated without recalculating it, after
+    which the partition can be improved by only considering the affected nodes,
+    using :func:`Optimiser.move_nodes`. This should not be used for a partition
+    that shares its graph with other partitions, such as the partitions
+    returned by :func:`Optimiser.resolution_profile`.
+
+    See Also
+    --------
+    :func:`~VertexPartition.MutableVertexPartition.delete_edges`
+
+    :func:`~VertexPartition.MutableVertexPartition.set_edge_weights`
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> diff = optimiser.optimise_partition(partition)
+    >>> nodes = partition.add_edges([(0, 33), (1, 32)])
+    >>> diff = optimiser.move_nodes(partition, nodes=nodes)
+    """
+    edges = list(edges)
+    edge_from = [v for v, u in edges]
+    edge_to = [u for v, u in edges]
+    if weights is None:
+      weights = [1.0]*len(edges)
+    nodes = _c_leiden._MutableVertexPartition_add_edges(self._partition,
+                                                      edge_from, edge_to,
+                                                      _as_list_or_buffer(weights))
+    self._update_internal_membership()
+    return nodes
+
+  def delete_edges(self, edges):
+    """ Delete edges from the graph of the partition, and update the partition.
+
+    Parameters
+    ----------
+    edges
+      Indices of the edges to delete. The remaining edges are renumbered, while
+      keeping their order.
+
+    Returns
+    -------
+    list of int
+      The nodes affected by the change, i.e. the endpoints of the deleted edges
+      and their remaining neighbours.
+
+    Notes
+    -----
+    See :func:`~VertexPartition.MutableVertexPartition.add_edges`.
+    """
+    nodes = _c_leiden._MutableVertexPartition_delete_edges(self._partition,
+                                                         _as_list_or_buffer(edges))
+    self._update_internal_membership()
+    return nodes
+
+  def set_edge_weights(self, edges, weights):
+    """ Change the weights of edges of the graph of the partition, and update
+    the partition.
+
+    Parameters
+    ----------
+    edges
+      Indices of the edges of which to change the weight.
+
+    weights
+      The new weights of the edges.
+
+    Returns
+    -------
+    list of int
+      The nodes affected by the change, i.e. the endpoints of the edges and
+      their neighbours.
+
+    Notes
+    -----
+    See :func:`~VertexPartition.MutableVertexPartition.add_edges`. In contrast
+    to adding or deleting edges, this takes time proportional to the degrees
+    of the endpoints of the edges, instead of the size of the graph.
+    """
+    nodes = _c_leiden._MutableVertexPartition_set_edge_weights(self._partition,
+                                                             _as_list_or_buffer(edges),
+                                                             _as_list_or_buffer(weights))
+    self._update_internal_membership()
+    return nodes
+
 class ModularityVertexPartition(MutableVertexPartition):
   """ Implements modularity. This quality function is well-defined only for positive edge weights.
 
@@ -440,7 +864,7 @@ class ModularityVertexPartition(MutableVertexPartition):
       Weights of edges. Can be either an iterable or an edge attribute.
     """
     if initial_membership is not None:
-      initial_membership = list(initial_membership)
+      initial_membership = _as_list_or_buffer(initial_membership)
 
     super(ModularityVertexPartition, self).__init__(graph, initial_membership)
     pygraph_t = _get_py_capsule(graph)
@@ -449,13 +873,16 @@ class ModularityVertexPartition(MutableVertexPartition):
       if isinstance(weights, str):
         weights = graph.es[weights]
       else:
-        # Make sure it is a list
-        weights = list(weights)
+        # Make sure it is a list or a buffer
+        weights = _as_list_or_buffer(weights)
 
     self._partition = _c_leiden._new_ModularityVertexPartition(pygraph_t,
         initial_membership, weights)
     self._update_internal_membership()
 
+  def _init_kwargs(self, weights, node_sizes):
+    return {'weights': weights}
+
 class SurpriseVertexPartition(MutableVertexPartition):
   """ Implements (asymptotic) Surprise. This quality function is well-defined only for positive edge weights.
 
@@ -513,7 +940,7 @@ class SurpriseVertexPartition(MutableVertexPartition):
       this could be changed.
     """
     if initial_membership is not None:
-      initial_membership = list(initial_membership)
+      initial_membership = _as_list_or_buffer(initial_membership)
 
     super(SurpriseVertexPartition, self).__init__(graph, initial_membership)
 
@@ -523,13 +950,16 @@ class SurpriseVertexPartition(MutableVertexPartition):
       if isinstance(weights, str):
         weights = graph.es[weights]
       else:
-        # Make sure it is a list
-        weights = list(weights)
+        # Make sure it is a list or a buffer
+        weights = _as_list_or_buffer(weights)
 
     self._partition = _c_leiden._new_SurpriseVertexPartition(pygraph_t,
         initial_membership, weights)
     self._update_internal_membership()
 
+  def _init_kwargs(self, weights, node_sizes):
+    return {'weights': weights, 'node_sizes': node_sizes}
+
 class SignificanceVertexPartition(MutableVertexPartition):
   """ Implements Significance. This quality function is well-defined only for unweighted graphs.
 
@@ -581,7 +1011,7 @@ class SignificanceVertexPartition(MutableVertexPartition):
       this could be changed.
     """
     if initial_membership is not None:
-      initial_membership = list(initial_membership)
+      initial_membership = _as_list_or_buffer(initial_membership)
 
     super(SignificanceVertexPartition, self).__init__(graph, initial_membership)
 
@@ -590,6 +1020,9 @@ class SignificanceVertexPartition(MutableVertexPartition):
     self._partition = _c_leiden._new_SignificanceVertexPartition(pygraph_t, initial_membership)
     self._update_internal_membership()
 
+  def _init_kwargs(self, weights, node_sizes):
+    return {'node_sizes': node_sizes}
+
 class LinearResolutionParameterVertexPartition(MutableVertexPartition):
   """ Some quality functions have a linear resolution parameter, for which the
   basis is implemented here.
@@ -636,6 +1069,37 @@ class LinearResolutionParameterVertexPartition(MutableVertexPartition):
   def quality(self, resolution_parameter=None):
     return _c_leiden._ResolutionParameterVertexPartition_quality(self._partition, resolution_parameter)
 
+  def qualities(self, resolution_parameters):
+    """ The quality for each of the resolution parameters.
+
+    Parameters
+    ----------
+    resolution_parameters : list of double
+      Resolution parameters for which to determine the quality, either as a
+      list or as a buffer (e.g. a NumPy array).
+
+    Returns
+    -------
+    list of double
+      The quality for each of the resolution parameters.
+
+    Notes
+    -----
+    Because the quality is of the form :math:`E - \\gamma F`, the terms
+    :math:`E` and :math:`F` are only determined once, after which the quality
+    for all resolution parameters is determined at once. This is much faster
+    than calling :func:`quality` for each resolution parameter separately.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.CPMVertexPartition(G, resolution_parameter=0.1)
+    >>> diff = la.Optimiser().optimise_partition(partition)
+    >>> q = partition.qualities([0.0, 0.05, 0.1])
+    """
+    return _c_leiden._ResolutionParameterVertexPartition_qualities(self._partition,
+        _as_list_or_buffer(resolution_parameters))
+
 class RBERVertexPartition(LinearResolutionParameterVertexPartition):
   """ Implements Reichardt and Bornholdt's Potts model with a configuration null model.
   This quality function is well-defined only for positive edge weights.
@@ -692,7 +1156,7 @@ class RBERVertexPartition(LinearResolutionParameterVertexPartition):
       Resolution parameter.
     """
     if initial_membership is not None:
-      initial_membership = list(initial_membership)
+      initial_membership = _as_list_or_buffer(initial_membership)
 
     super(RBERVertexPartition, self).__init__(graph, initial_membership)
 
@@ -702,20 +1166,24 @@ class RBERVertexPartition(LinearResolutionParameterVertexPartition):
       if isinstance(weights, str):
         weights = graph.es[weights]
       else:
-        # Make sure it is a list
-        weights = list(weights)
+        # Make sure it is a list or a buffer
+        weights = _as_list_or_buffer(weights)
 
     if node_sizes is not None:
       if isinstance(node_sizes, str):
         node_sizes = graph.vs[node_sizes]
       else:
-        # Make sure it is a list
-        node_sizes = list(node_sizes)
+        # Make sure it is a list or a buffer
+        node_sizes = _as_list_or_buffer(node_sizes)
 
     self._partition = _c_leiden._new_RBERVertexPartition(pygraph_t,
         initial_membership, weights, node_sizes, resolution_parameter)
     self._update_internal_membership()
 
+  def _init_kwargs(self, weights, node_sizes):
+    return {'weights': weights, 'node_sizes': node_sizes,
+            'resolution_parameter': self.resolution_parameter}
+
 class RBConfigurationVertexPartition(LinearResolutionParameterVertexPartition):
   """ Implements Reichardt and Bornholdt's Potts model with a configuration null model.
   This quality function is well-defined only for positive edge weights.
@@ -783,7 +1251,7 @@ class RBConfigurationVertexPartition(LinearResolutionParameterVertexPartition):
       Resolution parameter.
     """
     if initial_membership is not None:
-      initial_membership = list(initial_membership)
+      initial_membership = _as_list_or_buffer(initial_membership)
 
     super(RBConfigurationVertexPartition, self).__init__(graph, initial_membership)
 
@@ -793,13 +1261,17 @@ class RBConfigurationVertexPartition(LinearResolutionParameterVertexPartition):
       if isinstance(weights, str):
         weights = graph.es[weights]
       else:
-        # Make sure it is a list
-        weights = list(weights)
+        # Make sure it is a list or a buffer
+        weights = _as_list_or_buffer(weights)
 
     self._partition = _c_leiden._new_RBConfigurationVertexPartition(pygraph_t,
         initial_membership, weights, resolution_parameter)
     self._update_internal_membership()
 
+  def _init_kwargs(self, weights, node_sizes):
+    return {'weights': weights,
+            'resolution_parameter': self.resolution_parameter}
+
 class CPMVertexPartition(LinearResolutionParameterVertexPartition):
   """ Implements CPM.
   This quality function is well-defined for both positive and negative edge weights.
@@ -867,7 +1339,7 @@ class CPMVertexPartition(LinearResolutionParameterVertexPartition):
       Resolution parameter.
     """
     if initial_membership is not None:
-      initial_membership = list(initial_membership)
+      initial_membership = _as_list_or_buffer(initial_membership)
 
     super(CPMVertexPartition, self).__init__(graph, initial_membership)
 
@@ -877,20 +1349,24 @@ class CPMVertexPartition(LinearResolutionParameterVertexPartition):
       if isinstance(weights, str):
         weights = graph.es[weights]
       else:
-        # Make sure it is a list
-        weights = list(weights)
+        # Make sure it is a list or a buffer
+        weights = _as_list_or_buffer(weights)
 
     if node_sizes is not None:
       if isinstance(node_sizes, str):
         node_sizes = graph.vs[node_sizes]
       else:
-        # Make sure it is a list
-        node_sizes = list(node_sizes)
+        # Make sure it is a list or a buffer
+        node_sizes = _as_list_or_buffer(node_sizes)
 
     self._partition = _c_leiden._new_CPMVertexPartition(pygraph_t,
         initial_membership, weights, node_sizes, resolution_parameter)
     self._update_internal_membership()
 
+  def _init_kwargs(self, weights, node_sizes):
+    return {'weights': weights, 'node_sizes': node_sizes,
+            'resolution_parameter': self.resolution_parameter}
+
   def Bipartite(graph, resolution_parameter_01,
                 resolution_parameter_0 = 0, resolution_parameter_1 = 0,
                 degree_as_node_size=False, types='type', **kwargs):
@@ -1036,3 +1512,120 @@ class CPMVertexPartition(LinearResolutionParameterVertexPartition):
                      resolution_parameter=resolution_parameter_01 - resolution_parameter_1,
                      **kwargs)
     return partition_01, partition_0, partition_1
+
+class MultisliceVertexPartition(LinearResolutionParameterVertexPartition):
+  """ Implements a partition of a graph whose nodes are divided into slices,
+  for example the time slices of a temporal network.
+
+  The graph contains the edges within all slices, and the edges that couple
+  nodes of different slices (see :func:`find_partition_temporal`). The null
+  model is only evaluated within each slice, while the coupling edges simply
+  reward keeping coupled nodes in the same community.
+
+  Notes
+  -----
+  The quality function is
+
+  .. math:: Q = \\sum_{ij} \\left(A_{ij} + C_{ij} - \\gamma P_{ij} \\delta(s_i, s_j)\\right)\\delta(\\sigma_i, \\sigma_j)
+
+  where :math:`A` contains the intraslice edges, :math:`C` the interslice
+  edges, :math:`s_i` is the slice of node :math:`i` and :math:`\\sigma_i` its
+  community. For the ``'configuration'`` null model :math:`P_{ij} =
+  \\frac{k_i k_j}{2m_s}`, where :math:`k_i` is the degree of node :math:`i`
+  within its slice and :math:`m_s` the total weight of slice :math:`s`, as in
+  :class:`RBConfigurationVertexPartition`. For the ``'CPM'`` null model
+  :math:`P_{ij} = 1`, as in :class:`CPMVertexPartition`.
+
+  This is the same quality as that of optimising one layer per slice and one
+  layer for the interslice edges using
+  :func:`Optimiser.optimise_partition_multiplex`, but each node only needs to
+  be considered in a single graph, so that the cost is proportional to the
+  number of edges, rather than to the number of nodes times the number of
+  slices.
+  """
+  _null_models = {'configuration': 1, 'CPM': 2}
+
+  def __init__(self, graph, slices, null_model='configuration', initial_membership=None, weights=None, node_sizes=None, resolution_parameter=1.0):
+    """
+    Parameters
+    ----------
+    graph : :class:`ig.Graph`
+      Graph to define the partition on.
+
+    slices : list of int, or vertex attribute
+      The slice of each node.
+
+    null_model : str
+      The null model within each slice, either ``'configuration'`` or
+      ``'CPM'``.
+
+    initial_membership : list of int
+      Initial membership for the partition. If :obj:`None` then defaults to a
+      singleton partition.
+
+    weights : list of double, or edge attribute
+      Weights of edges. Can be either an iterable or an edge attribute.
+
+    node_sizes : list of int, or vertex attribute
+      Sizes of nodes are necessary to know the size of communities in aggregate
+      graphs. Usually this is set to 1 for all nodes, but in specific cases
+      this could be changed.
+
+    resolution_parameter : double
+      Resolution parameter.
+    """
+    if initial_membership is not None:
+      initial_membership = _as_list_or_buffer(initial_membership)
+
+    super(MultisliceVertexPartition, self).__init__(graph, initial_membership)
+
+    pygraph_t = _get_py_capsule(graph)
+
+    if isinstance(slices, str):
+      slices = graph.vs[slices]
+    else:
+      slices = _as_list_or_buffer(slices)
+
+    if not null_model in self._null_models:
+      raise ValueError("Unknown null model {0}, should be one of {1}.".format(null_model, sorted(self._null_models)))
+
+    if weights is not None:
+      if isinstance(weights, str):
+        weights = graph.es[weights]
+      else:
+        # Make sure it is a list or a buffer
+        weights = _as_list_or_buffer(weights)
+
+    if node_sizes is not None:
+      if isinstance(node_sizes, str):
+        node_sizes = graph.vs[node_sizes]
+      else:
+        # Make sure it is a list or a buffer
+        node_sizes = _as_list_or_buffer(node_sizes)
+
+    self._partition = _c_leiden._new_MultisliceVertexPartition(pygraph_t,
+        slices, self._null_models[null_model], initial_membership, weights,
+        node_sizes, resolution_parameter)
+    self._update_internal_membership()
+
+  def _init_kwargs(self, weights, node_sizes):
+    slices, null_model = _c_leiden._MultisliceVertexPartition_get_slices(self._partition)
+    null_model = [name for name, value in self._null_models.items() if value == null_model][0]
+    return {'slices': slices, 'null_model': null_model, 'weights': weights,
+            'node_sizes': node_sizes,
+            'resolution_parameter': self.resolution_parameter}
+
+  @classmethod
+  def _FromCPartition(cls, partition):
+    # The slices are already part of the C++ partition, so that the wrapper is
+    # created without constructing another partition.
+    n, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(partition)
+    graph = _ig.Graph(n=n,
+                      edges=edges,
+                      edge_attrs={'weight': weights},
+                      vertex_attrs={'node_size': node_sizes})
+    new_partition = cls.__new__(cls)
+    MutableVertexPartition.__init__(new_partition, graph)
+    new_partition._partition = partition
+    new_partition._update_internal_membership()
+    return new_partition
@@ -40,19 +40,32 @@ from .functions import RAND_NEIGH_COMM
 from .functions import MOVE_NODES
 from .functions import MERGE_NODES
 
+from .functions import FIFO_ORDER
+from .functions import GAIN_ORDER
+from .functions import DEGREE_ORDER
+from .functions import BOUNDED_ORDER
+from .functions import NO_RELABEL
+from .functions import RCM_RELABEL
+from .functions import DEGREE_RELABEL
+
 from .functions import find_partition
 from .functions import find_partition_multiplex
 from .functions import find_partition_temporal
 from .functions import slices_to_layers
 from .functions import time_slices_to_layers
+from .functions import save_graph
+from .functions import set_graph_n_threads
 
 from .Optimiser import Optimiser
+from .Optimiser import OptimisationHandle
+from .Optimiser import Hierarchy
 from .VertexPartition import ModularityVertexPartition
 from .VertexPartition import SurpriseVertexPartition
 from .VertexPartition import SignificanceVertexPartition
 from .VertexPartition import RBERVertexPartition
 from .VertexPartition import RBConfigurationVertexPartition
 from .VertexPartition import CPMVertexPartition
+from .VertexPartition import MultisliceVertexPartition
 
 from pkg_resources import get_distribution, DistributionNotFound
 import os.path
@@ -9,6 +9,14 @@ from ._c_leiden import RAND_NEIGH_COMM
 from ._c_leiden import MOVE_NODES
 from ._c_leiden import MERGE_NODES
 
+from ._c_leiden import FIFO_ORDER
+from ._c_leiden import GAIN_ORDER
+from ._c_leiden import DEGREE_ORDER
+from ._c_leiden import BOUNDED_ORDER
+from ._c_leiden import NO_RELABEL
+from ._c_leiden import RCM_RELABEL
+from ._c_leiden import DEGREE_RELABEL
+
 from collections import Counter
 
 # Check if working with Python 3
@@ -21,6 +29,7 @@ def _get_py_capsule(graph):
     return graph.__graph_as_cobject()
 
 from .VertexPartition import *
+from .VertexPartition import _as_list_or_buffer
 from .Optimiser import *
 
 def find_partition(graph, partition_type, initial_membership=None, weights=None, n_iterations=2, seed=None, **kwargs):
@@ -181,6 +190,14 @@ def find_partition_temporal(graphs, partition_type,
   practice with a weight of 1). See :func:`time_slices_to_layers` for
   a more detailed explanation.
 
+  For :class:`ModularityVertexPartition`,
+  :class:`RBConfigurationVertexPartition` and :class:`CPMVertexPartition` the
+  slices are not converted to layers, but are optimised in a single graph
+  using a :class:`MultisliceVertexPartition` (unless other keyword arguments
+  than ``resolution_parameter`` are passed). This gives the same quality, but
+  its cost is proportional to the number of edges, rather than to the number
+  of nodes times the number of slices.
+
   Parameters
   ----------
   graphs : list of :class:`ig.Graph`
@@ -244,41 +261,78 @@ def find_partition_temporal(graphs, partition_type,
   ...                                                      la.ModularityVertexPartition,
   ...                                                      interslice_weight=1)
   """
-  # Create layers
-  G_layers, G_interslice, G = time_slices_to_layers(graphs,
-                                                    interslice_weight,
-                                                    slice_attr=slice_attr,
-                                                    vertex_id_attr=vertex_id_attr,
-                                                    edge_type_attr=edge_type_attr,
-                                                    weight_attr=weight_attr)
-  # Optimise partitions
-  arg_dict = {}
-  if 'node_sizes' in partition_type.__init__.__code__.co_varnames:
-    arg_dict['node_sizes'] = 'node_size'
-
-  if 'weights' in partition_type.__init__.__code__.co_varnames:
-    arg_dict['weights'] = 'weight'
-
-  arg_dict.update(kwargs)
-
-  partitions = []
-  for H in G_layers:
-    arg_dict['graph'] = H
-    partitions.append(partition_type(**arg_dict))
-
-  # We can always take the same interslice partition, as this should have no
-  # cost in the optimisation.
-  partition_interslice = CPMVertexPartition(G_interslice, resolution_parameter=0,
-                                            node_sizes='node_size', weights=weight_attr)
   optimiser = Optimiser()
 
   if (not seed is None):
     optimiser.set_rng_seed(seed)
 
-  improvement = optimiser.optimise_partition_multiplex(partitions + [partition_interslice], n_iterations=n_iterations)
+  # The null models of these partition types only need to be evaluated within
+  # each slice, so that all slices can be optimised in a single graph.
+  native_null_models = {ModularityVertexPartition: 'configuration',
+                        RBConfigurationVertexPartition: 'configuration',
+                        CPMVertexPartition: 'CPM'}
+  native_args = set() if partition_type is ModularityVertexPartition else set(['resolution_parameter'])
+  if partition_type in native_null_models and set(kwargs).issubset(native_args):
+    G_slices = _ig.Graph.Tree(len(graphs), 1, mode=_ig.TREE_UNDIRECTED)
+    G_slices.es[weight_attr] = interslice_weight
+    G_slices.vs[slice_attr] = graphs
+    G = _slices_to_graph(G_slices, slice_attr, vertex_id_attr, edge_type_attr, weight_attr)
+
+    slices = G.vs[slice_attr]
+    weights = [1.0 if w is None else w for w in G.es[weight_attr]]
+    if partition_type is ModularityVertexPartition:
+      # Modularity normalises each slice by its own total weight, while the
+      # interslice couplings are not normalised.
+      edge_slices = [slices[v] for v, u in G.get_edgelist()]
+      intraslice = [edge_type == 'intraslice' for edge_type in G.es[edge_type_attr]]
+      slice_weight = [0.0]*len(graphs)
+      for e, slice_idx in enumerate(edge_slices):
+        if intraslice[e]:
+          slice_weight[slice_idx] += weights[e]
+      scale = 2.0 - G.is_directed()
+      for e, slice_idx in enumerate(edge_slices):
+        if intraslice[e]:
+          weights[e] /= scale*slice_weight[slice_idx]
+
+    partition = MultisliceVertexPartition(G, slices,
+                                          null_model=native_null_models[partition_type],
+                                          weights=weights,
+                                          **kwargs)
+    improvement = optimiser.optimise_partition(partition, n_iterations=n_iterations)
+    membership = partition.membership
+  else:
+    # Create layers
+    G_layers, G_interslice, G = time_slices_to_layers(graphs,
+                                                      interslice_weight,
+                                                      slice_attr=slice_attr,
+                                                      vertex_id_attr=vertex_id_attr,
+                                                      edge_type_attr=edge_type_attr,
+                                                      weight_attr=weight_attr)
+    # Optimise partitions
+    arg_dict = {}
+    if 'node_sizes' in partition_type.__init__.__code__.co_varnames:
+      arg_dict['node_sizes'] = 'node_size'
+
+    if 'weights' in partition_type.__init__.__code__.co_varnames:
+      arg_dict['weights'] = 'weight'
+
+    arg_dict.update(kwargs)
+
+    partitions = []
+    for H in G_layers:
+      arg_dict['graph'] = H
+      partitions.append(partition_type(**arg_dict))
+
+    # We can always take the same interslice partition, as this should have no
+    # cost in the optimisation.
+    partition_interslice = CPMVertexPartition(G_interslice, resolution_parameter=0,
+                                              node_sizes='node_size', weights=weight_attr)
+
+    improvement = optimiser.optimise_partition_multiplex(partitions + [partition_interslice], n_iterations=n_iterations)
+    membership = partitions[0].membership
 
   # Transform results back into original form.
-  membership = {(v[slice_attr], v[vertex_id_attr]): m for v, m in zip(G.vs, partitions[0].membership)}
+  membership = {(v[slice_attr], v[vertex_id_attr]): m for v, m in zip(G.vs, membership)}
 
   membership_time_slices = []
   for slice_idx, H in enumerate(graphs):
@@ -286,6 +340,77 @@ def find_partition_temporal(graphs, partition_type,
     membership_time_slices.append(list(membership_slice))
   return membership_time_slices, improvement
 
+def save_graph(graph, filename, weights=None, node_sizes=None):
+  """ Store a graph in a binary file that can be memory mapped.
+
+  The file contains the graph in the internal representation used for
+  optimisation, including weights and node sizes. Partitions can be created on
+  the stored graph using
+  :func:`~VertexPartition.MutableVertexPartition.FromFile`, without
+  constructing an :class:`ig.Graph` again. The file is specific to the
+  platform on which it was created.
+
+  Parameters
+  ----------
+  graph : :class:`ig.Graph`
+    The graph to store.
+
+  filename : str
+    Name of the file to write.
+
+  weights : list of double, or edge attribute
+    Weights of edges. Can be either an iterable or an edge attribute.
+
+  node_sizes : list of int, or vertex attribute
+    Sizes of nodes. Can be either an iterable or a vertex attribute.
+
+  Examples
+  --------
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> la.save_graph(G, 'zachary.graph')
+  >>> partition = la.find_partition(G, la.ModularityVertexPartition)
+  >>> p = la.CPMVertexPartition.FromFile('zachary.graph',
+  ...                                    initial_membership=partition.membership,
+  ...                                    resolution_parameter=0.1)
+  """
+  pygraph_t = _get_py_capsule(graph)
+
+  if weights is not None:
+    if isinstance(weights, str):
+      weights = graph.es[weights]
+    else:
+      weights = _as_list_or_buffer(weights)
+
+  if node_sizes is not None:
+    if isinstance(node_sizes, str):
+      node_sizes = graph.vs[node_sizes]
+    else:
+      node_sizes = _as_list_or_buffer(node_sizes)
+
+  _c_leiden._save_graph(pygraph_t, filename, weights, node_sizes)
+
+def set_graph_n_threads(n_threads):
+  """ Set the number of threads used for constructing graphs.
+
+  This applies to the graphs that are constructed when creating a partition,
+  and to the aggregate graphs that are constructed during optimisation. The
+  constructed graph does not depend on the number of threads. Small graphs are
+  always constructed using a single thread.
+
+  Parameters
+  ----------
+  n_threads : int
+    Number of threads to use. If 0, all available cores are used. By default,
+    graphs are constructed using a single thread.
+
+  Examples
+  --------
+  >>> la.set_graph_n_threads(4)
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> partition = la.find_partition(G, la.ModularityVertexPartition)
+  """
+  _c_leiden._set_graph_n_threads(n_threads)
+
 #%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 # These are helper functions to create a proper
 # disjoint union in python. The igraph implementation
@@ -344,6 +469,66 @@ def time_slices_to_layers(graphs,
                           edge_type_attr,
                           weight_attr)
 
+def _slices_to_graph(G_coupling, slice_attr, vertex_id_attr, edge_type_attr,
+                     weight_attr):
+  """ Create the complete graph containing all slices of ``G_coupling`` and
+  the interslice couplings between them (see :func:`slices_to_layers`). The
+  vertex attribute ``slice_attr`` of the complete graph contains the slice of
+  each node, and the edge attribute ``edge_type_attr`` whether an edge is an
+  ``interslice`` or ``intraslice`` link. """
+  if not slice_attr in G_coupling.vertex_attributes():
+    raise ValueError("Could not find the vertex attribute {0} in the coupling graph.".format(slice_attr))
+
+  if not weight_attr in G_coupling.edge_attributes():
+    raise ValueError("Could not find the edge attribute {0} in the coupling graph.".format(weight_attr))
+
+  # Create disjoint union of the time graphs
+  for v_slice in G_coupling.vs:
+    H = v_slice[slice_attr]
+    H.vs[slice_attr] = v_slice.index
+    if not vertex_id_attr in H.vertex_attributes():
+      raise ValueError("Could not find the vertex attribute {0} to identify nodes in different slices.".format(vertex_id_attr ))
+    if not weight_attr in H.edge_attributes():
+      H.es[weight_attr] = 1
+
+  G = disjoint_union_attrs(G_coupling.vs[slice_attr])
+  G.es[edge_type_attr] = 'intraslice'
+
+  # Index the nodes of each slice by their identifier, so that the nodes of
+  # two slices can be coupled without scanning all nodes.
+  slice_nodes = [{} for v_slice in G_coupling.vs]
+  for v, (slice_idx, node_id) in enumerate(zip(G.vs[slice_attr], G.vs[vertex_id_attr])):
+    slice_nodes[slice_idx][node_id] = v
+
+  def unique_slice_nodes(slice_idx):
+    H = G_coupling.vs[slice_idx][slice_attr]
+    if len(slice_nodes[slice_idx]) != H.vcount():
+      err = '\n'.join(
+        ['\t{0} {1} times'.format(item, count) for item, count in Counter(H.vs[vertex_id_attr]).items() if count > 1]
+        )
+      raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(slice_idx, err))
+    return slice_nodes[slice_idx]
+
+  edges = []
+  interslice_weights = []
+  for v_slice in G_coupling.vs:
+    for u_slice in v_slice.neighbors(mode=_ig.OUT):
+      if v_slice.index < u_slice.index or G_coupling.is_directed():
+        nodes_v = unique_slice_nodes(v_slice.index)
+        nodes_u = unique_slice_nodes(u_slice.index)
+        common_nodes = sorted(set(nodes_v).intersection(nodes_u))
+        interslice_weight = G_coupling.es[G_coupling.get_eid(v_slice, u_slice)][weight_attr]
+        edges.extend((nodes_v[node_id], nodes_u[node_id]) for node_id in common_nodes)
+        interslice_weights.extend([interslice_weight]*len(common_nodes))
+
+  e_start = G.ecount()
+  G.add_edges(edges)
+  e_idx = range(e_start, G.ecount())
+  G.es[e_idx][weight_attr] = interslice_weights
+  G.es[e_idx][edge_type_attr] = 'interslice'
+
+  return G
+
 def slices_to_layers(G_coupling,
                      slice_attr='slice',
                      vertex_id_attr='id',
@@ -438,51 +623,8 @@ def slices_to_layers(G_coupling,
   :func:`time_slices_to_layers`
 
   """
-  if not slice_attr in G_coupling.vertex_attributes():
-    raise ValueError("Could not find the vertex attribute {0} in the coupling graph.".format(slice_attr))
-
-  if not weight_attr in G_coupling.edge_attributes():
-    raise ValueError("Could not find the edge attribute {0} in the coupling graph.".format(weight_attr))
-
-  # Create disjoint union of the time graphs
-  for v_slice in G_coupling.vs:
-    H = v_slice[slice_attr]
-    H.vs[slice_attr] = v_slice.index
-    if not vertex_id_attr in H.vertex_attributes():
-      raise ValueError("Could not find the vertex attribute {0} to identify nodes in different slices.".format(vertex_id_attr ))
-    if not weight_attr in H.edge_attributes():
-      H.es[weight_attr] = 1
-
-  G = disjoint_union_attrs(G_coupling.vs[slice_attr])
-  G.es[edge_type_attr] = 'intraslice'
-
-  for v_slice in G_coupling.vs:
-    for u_slice in v_slice.neighbors(mode=_ig.OUT):
-      if v_slice.index < u_slice.index or G_coupling.is_directed():
-        nodes_v = G.vs.select(lambda v: v[slice_attr]==v_slice.index)[vertex_id_attr]
-        if len(set(nodes_v)) != len(nodes_v):
-          err = '\n'.join(
-            ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes_v).items() if count > 1]
-            )
-          raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(v_slice.index, err))
-        nodes_u = G.vs.select(lambda v: v[slice_attr]==u_slice.index)[vertex_id_attr]
-        if len(set(nodes_u)) != len(nodes_u):
-          err = '\n'.join(
-            ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes_u).items() if count > 1]
-            )
-          raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(u_slice.index, err))
-        common_nodes = set(nodes_v).intersection(set(nodes_u))
-        nodes_v = sorted([v for v in G.vs if v[slice_attr] == v_slice.index and v[vertex_id_attr] in common_nodes], key=lambda v: v[vertex_id_attr])
-        nodes_u = sorted([v for v in G.vs if v[slice_attr] == u_slice.index and v[vertex_id_attr] in common_nodes], key=lambda v: v[vertex_id_attr])
-        edges = zip(nodes_v, nodes_u)
-        e_start = G.ecount()
-        G.add_edges(edges)
-        e_end = G.ecount()
-        e_idx = range(e_start, e_end)
-        interslice_weight = G_coupling.es[G_coupling.get_eid(v_slice, u_slice)][weight_attr]
-        if not interslice_weight is None:
-          G.es[e_idx][weight_attr] = interslice_weight
-        G.es[e_idx][edge_type_attr] = 'interslice'
+  G = _slices_to_graph(G_coupling, slice_attr, vertex_id_attr,
+                      edge_type_attr, weight_attr)
 
   # Convert aggregate graph to individual layers for each time slice.
   G_layers = [None]*G_coupling.vcount()
@@ -17,6 +17,136 @@
     Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
     delete optimiser;
   }
+
+  PyObject* capsule_OptimiserControl(OptimiserControl* control)
+  {
+    PyObject* py_control = PyCapsule_New(control, "leidenalg.OptimiserControl", del_OptimiserControl);
+    return py_control;
+  }
+
+  OptimiserControl* decapsule_OptimiserControl(PyObject* py_control)
+  {
+    OptimiserControl* control = (OptimiserControl*) PyCapsule_GetPointer(py_control, "leidenalg.OptimiserControl");
+    return control;
+  }
+
+  void del_OptimiserControl(PyObject* py_control)
+  {
+    OptimiserControl* control = decapsule_OptimiserControl(py_control);
+    delete control;
+  }
+
+  PyObject* capsule_Hierarchy(Hierarchy* hierarchy)
+  {
+    PyObject* py_hierarchy = PyCapsule_New(hierarchy, "leidenalg.Hierarchy", del_Hierarchy);
+    return py_hierarchy;
+  }
+
+  Hierarchy* decapsule_Hierarchy(PyObject* py_hierarchy)
+  {
+    Hierarchy* hierarchy = (Hierarchy*) PyCapsule_GetPointer(py_hierarchy, "leidenalg.Hierarchy");
+    return hierarchy;
+  }
+
+  void del_Hierarchy(PyObject* py_hierarchy)
+  {
+    Hierarchy* hierarchy = decapsule_Hierarchy(py_hierarchy);
+    delete hierarchy;
+  }
+
+#ifdef IS_PY3K
+/****************************************************************************
+  Read-only view of a single level of an aggregation hierarchy.
+
+  The exporter keeps a reference to the capsule of the hierarchy, which is
+  never changed, so that the level remains valid for as long as any view on
+  it exists. The shape and stride of each view are stored in view->internal.
+****************************************************************************/
+typedef struct
+{
+  PyObject_HEAD
+  PyObject* py_hierarchy;
+  size_t level;
+} HierarchyBuffer;
+
+void del_HierarchyBuffer(HierarchyBuffer* self)
+{
+  Py_XDECREF(self->py_hierarchy);
+  PyObject_Del(self);
+}
+
+int HierarchyBuffer_getbuffer(HierarchyBuffer* self, Py_buffer* view, int flags)
+{
+  if (flags & PyBUF_WRITABLE)
+  {
+    PyErr_SetString(PyExc_BufferError, "Hierarchy can only be read.");
+    return -1;
+  }
+
+  Hierarchy* hierarchy = decapsule_Hierarchy(self->py_hierarchy);
+  vector<uint32_t> const& level = (*hierarchy)[self->level];
+
+  Py_ssize_t* shape_stride = new Py_ssize_t[2];
+  shape_stride[0] = level.size();
+  shape_stride[1] = sizeof(uint32_t);
+
+  view->obj = (PyObject*)self;
+  Py_INCREF(self);
+  view->buf = (void*)level.data();
+  view->len = level.size()*sizeof(uint32_t);
+  view->readonly = 1;
+  view->itemsize = sizeof(uint32_t);
+  // Use the unsigned type that matches uint32_t, which is commonly understood
+  if (sizeof(uint32_t) == sizeof(unsigned int))
+    view->format = (flags & PyBUF_FORMAT) ? (char*)"I" : NULL;
+  else
+    view->format = (flags & PyBUF_FORMAT) ? (char*)"L" : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &shape_stride[0] : NULL;
+  view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? &shape_stride[1] : NULL;
+  view->suboffsets = NULL;
+  view->internal = shape_stride;
+  return 0;
+}
+
+void HierarchyBuffer_releasebuffer(HierarchyBuffer* self, Py_buffer* view)
+{
+  delete [] (Py_ssize_t*)view->internal;
+}
+
+static PyBufferProcs HierarchyBuffer_as_buffer = {
+  (getbufferproc)HierarchyBuffer_getbuffer,
+  (releasebufferproc)HierarchyBuffer_releasebuffer
+};
+
+static PyTypeObject HierarchyBufferType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+int init_HierarchyBuffer_type()
+{
+  HierarchyBufferType.tp_name = "leidenalg._c_leiden.HierarchyBuffer";
+  HierarchyBufferType.tp_basicsize = sizeof(HierarchyBuffer);
+  HierarchyBufferType.tp_dealloc = (destructor)del_HierarchyBuffer;
+  HierarchyBufferType.tp_as_buffer = &HierarchyBuffer_as_buffer;
+  HierarchyBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+  HierarchyBufferType.tp_doc = "Exports a level of an aggregation hierarchy.";
+  return PyType_Ready(&HierarchyBufferType);
+}
+#endif
+
+  static PyObject* move_stats_to_py(MoveStats const& stats)
+  {
+    return Py_BuildValue("{s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:d}",
+                         "node_visits",        (Py_ssize_t)stats.node_visits,
+                         "moves",              (Py_ssize_t)stats.moves,
+                         "diff_moves",         (Py_ssize_t)stats.diff_moves,
+                         "queue_insertions",   (Py_ssize_t)stats.queue_insertions,
+                         "skipped_insertions", (Py_ssize_t)stats.skipped_insertions,
+                         "candidates",         (Py_ssize_t)stats.candidates,
+                         "max_candidates",     (Py_ssize_t)stats.max_candidates,
+                         "improvement",        stats.improvement);
+  }
 #ifdef __cplusplus
 extern "C"
 {
@@ -35,23 +165,75 @@ extern "C"
     return py_optimiser;
   }
 
+  PyObject* _new_OptimiserControl(PyObject *self, PyObject *args)
+  {
+    if (args != NULL)
+    {
+      PyErr_BadArgument();
+      return NULL;
+    }
+
+    OptimiserControl* control = new OptimiserControl();
+    PyObject* py_control = capsule_OptimiserControl(control);
+    return py_control;
+  }
+
+  PyObject* _OptimiserControl_cancel(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_control = NULL;
+    static char* kwlist[] = {"control", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_control))
+        return NULL;
+
+    OptimiserControl* control = decapsule_OptimiserControl(py_control);
+    control->cancel();
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _OptimiserControl_get_progress(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_control = NULL;
+    static char* kwlist[] = {"control", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_control))
+        return NULL;
+
+    OptimiserControl* control = decapsule_OptimiserControl(py_control);
+    return Py_BuildValue("{s:n,s:n,s:n,s:d,s:O}",
+                         "iteration",       (Py_ssize_t)control->iteration.load(),
+                         "level",           (Py_ssize_t)control->level.load(),
+                         "nodes_processed", (Py_ssize_t)control->nodes_processed.load(),
+                         "quality",         control->quality.load(),
+                         "cancelled",       control->cancelled.load() ? Py_True : Py_False);
+  }
+
   PyObject* _Optimiser_optimise_partition(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
     PyObject* py_partition = NULL;
+    int n_iterations = 1;
+    double max_time = 0.0;
+    double tolerance = 0.0;
+    PyObject* py_control = NULL;
 
-    static char* kwlist[] = {"optimiser", "partition", NULL};
+    static char* kwlist[] = {"optimiser", "partition", "n_iterations", "max_time", "tolerance", "control", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", kwlist,
-                                     &py_optimiser, &py_partition))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iddO", kwlist,
+                                     &py_optimiser, &py_partition,
+                                     &n_iterations, &max_time, &tolerance,
+                                     &py_control))
         return NULL;
 
     #ifdef DEBUG
-      cerr << "optimise_partition(" << py_partition << ");" << endl;
+      cerr << "optimise_partition(" << py_partition << ", " << n_iterations << ", " << max_time << ", " << tolerance << ");" << endl;
     #endif
 
     #ifdef DEBUG
@@ -70,16 +252,34 @@ extern "C"
       cerr << "Using partition at address " << partition << endl;
     #endif
 
-    double q = 0.0;
-    try
+    // The progress is reported to the control, if any, which may be read
+    // and cancelled from other Python threads during the optimisation.
+    OptimiserControl* control = NULL;
+    if (py_control != NULL && py_control != Py_None)
+      control = decapsule_OptimiserControl(py_control);
+    if (PyErr_Occurred())
+      return NULL;
+
+    // The control is attached and detached while holding the GIL, so that
+    // another thread cannot attach its own control to the same optimiser in
+    // the meantime.
+    if (control != NULL)
     {
-      q = optimiser->optimise_partition(partition);
+      if (optimiser->control() != NULL)
+      {
+        PyErr_SetString(PyExc_ValueError, "Optimiser is already optimising with a control.");
+        return NULL;
+      }
+      optimiser->set_control(control);
     }
-    catch (std::exception e)
-    {
-      PyErr_SetString(PyExc_ValueError, e.what());
+
+    // Release the GIL during the optimisation, no Python objects are used
+    double q = 0.0;
+    bool ok = call_without_gil([&]() { q = optimiser->optimise_partition(partition, n_iterations, max_time, tolerance); });
+    if (control != NULL)
+      optimiser->set_control(NULL);
+    if (!ok)
       return NULL;
-    }
     return PyFloat_FromDouble(q);
   }
 
@@ -88,8 +288,12 @@ extern "C"
     PyObject* py_optimiser = NULL;
     PyObject* py_partitions = NULL;
     PyObject* py_layer_weights = NULL;
+    int n_iterations = 1;
+    double max_time = 0.0;
+    double tolerance = 0.0;
 
-    if (!PyArg_ParseTuple(args, "OOO", &py_optimiser, &py_partitions, &py_layer_weights))
+    if (!PyArg_ParseTuple(args, "OOO|idd", &py_optimiser, &py_partitions, &py_layer_weights,
+                          &n_iterations, &max_time, &tolerance))
         return NULL;
 
     size_t nb_partitions = PyList_Size(py_partitions);
@@ -146,16 +350,11 @@ extern "C"
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
+    // Release the GIL during the optimisation, no Python objects are used
     double q = 0.0;
-    try
-    {
-      q = optimiser->optimise_partition(partitions, layer_weights);
-    }
-    catch (std::exception e)
-    {
-      PyErr_SetString(PyExc_ValueError, e.what());
+    bool ok = call_without_gil([&]() { q = optimiser->optimise_partition(partitions, layer_weights, n_iterations, max_time, tolerance); });
+    if (!ok)
       return NULL;
-    }
     return PyFloat_FromDouble(q);
   }
 
@@ -164,15 +363,16 @@ extern "C"
     PyObject* py_optimiser = NULL;
     PyObject* py_partition = NULL;
     int consider_comms = -1;
+    PyObject* py_nodes = NULL;
 
-    static char* kwlist[] = {"optimiser", "partition", "consider_comms", NULL};
+    static char* kwlist[] = {"optimiser", "partition", "consider_comms", "nodes", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|i", kwlist,
-                                     &py_optimiser, &py_partition, &consider_comms))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iO", kwlist,
+                                     &py_optimiser, &py_partition, &consider_comms, &py_nodes))
         return NULL;
 
     #ifdef DEBUG
@@ -198,16 +398,33 @@ extern "C"
     if (consider_comms < 0)
       consider_comms = optimiser->consider_comms;
 
-    double q  = 0.0;
-    try
+    // Only consider the given nodes initially, or all nodes by default
+    vector<size_t> nodes;
+    if (py_nodes != NULL && py_nodes != Py_None)
     {
-      q = optimiser->move_nodes(partition, consider_comms);
+      try
+      {
+        if (!read_indices_from_py(py_nodes, nodes,
+                                  "Node cannot be negative",
+                                  "Expected integer value for node."))
+          return NULL;
+      }
+      catch (std::exception& e)
+      {
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return NULL;
+      }
     }
-    catch (std::exception e)
-    {
-      PyErr_SetString(PyExc_ValueError, e.what());
+    else
+      nodes = range(partition->get_graph()->vcount());
+    vector<MutableVertexPartition*> partitions(1, partition);
+    vector<double> layer_weights(1, 1.0);
+
+    // Release the GIL during the optimisation, no Python objects are used
+    double q = 0.0;
+    bool ok = call_without_gil([&]() { q = optimiser->move_nodes(partitions, layer_weights, consider_comms, optimiser->consider_empty_community, nodes); });
+    if (!ok)
       return NULL;
-    }
     return PyFloat_FromDouble(q);
   }
 
@@ -250,16 +467,11 @@ extern "C"
     if (consider_comms < 0)
       consider_comms = optimiser->consider_comms;
 
+    // Release the GIL during the optimisation, no Python objects are used
     double q = 0.0;
-    try
-    {
-      q = optimiser->merge_nodes(partition, consider_comms);
-    }
-    catch (std::exception e)
-    {
-      PyErr_SetString(PyExc_ValueError, e.what());
+    bool ok = call_without_gil([&]() { q = optimiser->merge_nodes(partition, consider_comms); });
+    if (!ok)
       return NULL;
-    }
     return PyFloat_FromDouble(q);
   }
 
@@ -311,16 +523,11 @@ extern "C"
     if (consider_comms < 0)
       consider_comms = optimiser->refine_consider_comms;
 
+    // Release the GIL during the optimisation, no Python objects are used
     double q = 0.0;
-    try
-    {
-      q = optimiser->move_nodes_constrained(partition, consider_comms, constrained_partition);
-    }
-    catch (std::exception e)
-    {
-      PyErr_SetString(PyExc_ValueError, e.what());
+    bool ok = call_without_gil([&]() { q = optimiser->move_nodes_constrained(partition, consider_comms, constrained_partition); });
+    if (!ok)
       return NULL;
-    }
     return PyFloat_FromDouble(q);
   }
 
@@ -372,17 +579,161 @@ extern "C"
     if (consider_comms < 0)
       consider_comms = optimiser->refine_consider_comms;
 
+    // Release the GIL during the optimisation, no Python objects are used
+    double q = 0.0;
+    bool ok = call_without_gil([&]() { q = optimiser->merge_nodes_constrained(partition, consider_comms, constrained_partition); });
+    if (!ok)
+      return NULL;
+    return PyFloat_FromDouble(q);
+  }
+
+  PyObject* _Optimiser_optimise_partition_multistart(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    PyObject* py_partition = NULL;
+    int n_starts = 1;
+    int n_iterations = 2;
+    int return_memberships = false;
+
+    static char* kwlist[] = {"optimiser", "partition", "n_starts", "n_iterations", "return_memberships", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOi|ii", kwlist,
+                                     &py_optimiser, &py_partition, &n_starts, &n_iterations, &return_memberships))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "optimise_partition_multistart(" << py_partition << ", " << n_starts << ", " << n_iterations << ");" << endl;
+    #endif
+
+    if (n_starts < 1)
+    {
+      PyErr_SetString(PyExc_ValueError, "Number of starts should be at least 1.");
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule partition at address " << py_partition << endl;
+    #endif
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    // Release the GIL during the optimisation, no Python objects are used
     double q = 0.0;
-    try
+    vector< vector<size_t> > memberships;
+    bool ok = call_without_gil([&]()
+    {
+      if (return_memberships)
+        q = optimiser->optimise_partition_multistart(partition, n_starts, n_iterations, memberships);
+      else
+        q = optimiser->optimise_partition_multistart(partition, n_starts, n_iterations);
+    });
+    if (!ok)
+      return NULL;
+
+    if (!return_memberships)
+      return PyFloat_FromDouble(q);
+
+    PyObject* py_memberships = PyList_New(memberships.size());
+    for (size_t i = 0; i < memberships.size(); i++)
     {
-      q = optimiser->merge_nodes_constrained(partition, consider_comms, constrained_partition);
+      size_t n = memberships[i].size();
+      PyObject* py_membership = PyList_New(n);
+      for (size_t v = 0; v < n; v++)
+      {
+        #ifdef IS_PY3K
+          PyObject* item = PyLong_FromSize_t(memberships[i][v]);
+        #else
+          PyObject* item = PyInt_FromSize_t(memberships[i][v]);
+        #endif
+        PyList_SET_ITEM(py_membership, v, item);
+      }
+      PyList_SET_ITEM(py_memberships, i, py_membership);
     }
-    catch (std::exception e)
+    return Py_BuildValue("dN", q, py_memberships);
+  }
+
+  PyObject* _Optimiser_resolution_profile(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    PyObject* py_partition = NULL;
+    double resolution_min = 0.0;
+    double resolution_max = 0.0;
+    double min_diff_bisect_value = 1.0;
+    double min_diff_resolution = 1e-3;
+    int linear_bisection = false;
+    int number_iterations = 1;
+
+    static char* kwlist[] = {"optimiser", "partition", "resolution_min", "resolution_max",
+                             "min_diff_bisect_value", "min_diff_resolution",
+                             "linear_bisection", "number_iterations", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOdd|ddii", kwlist,
+                                     &py_optimiser, &py_partition, &resolution_min, &resolution_max,
+                                     &min_diff_bisect_value, &min_diff_resolution,
+                                     &linear_bisection, &number_iterations))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "resolution_profile(" << py_partition << ", " << resolution_min << ", " << resolution_max << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule partition at address " << py_partition << endl;
+    #endif
+    ResolutionParameterVertexPartition* partition =
+      dynamic_cast<ResolutionParameterVertexPartition*>(decapsule_MutableVertexPartition(py_partition));
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+    if (partition == NULL)
     {
-      PyErr_SetString(PyExc_ValueError, e.what());
+      PyErr_SetString(PyExc_TypeError, "Resolution profile requires a partition with a resolution parameter.");
       return NULL;
     }
-    return PyFloat_FromDouble(q);
+
+    // Release the GIL during the optimisation, no Python objects are used
+    vector<ResolutionParameterVertexPartition*> profile;
+    bool ok = call_without_gil([&]()
+    {
+      profile = optimiser->resolution_profile(partition, resolution_min, resolution_max,
+                                              min_diff_bisect_value, min_diff_resolution,
+                                              linear_bisection, number_iterations);
+    });
+    if (!ok)
+      return NULL;
+
+    // The partitions share the graph of partition, which remains responsible
+    // for deleting it.
+    PyObject* py_profile = PyList_New(profile.size());
+    for (size_t i = 0; i < profile.size(); i++)
+      PyList_SET_ITEM(py_profile, i, capsule_MutableVertexPartition(profile[i]));
+    return py_profile;
   }
 
   PyObject* _Optimiser_set_consider_comms(PyObject *self, PyObject *args, PyObject *keywds)
@@ -708,22 +1059,59 @@ extern "C"
     return PyBool_FromLong(optimiser->consider_empty_community);
   }
 
-  PyObject* _Optimiser_set_refine_partition(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_set_n_threads(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
-    int refine_partition = false;
-    static char* kwlist[] = {"optimiser", "refine_partition", NULL};
+    int n_threads = 1;
+    static char* kwlist[] = {"optimiser", "n_threads", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
     if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
-                                     &py_optimiser, &refine_partition))
+                                     &py_optimiser, &n_threads))
         return NULL;
 
     #ifdef DEBUG
-      cerr << "set_refine_partition(" << refine_partition << ");" << endl;
+      cerr << "set_n_threads(" << n_threads << ");" << endl;
+    #endif
+
+    if (n_threads < 1)
+    {
+      PyErr_SetString(PyExc_ValueError, "Number of threads should be at least 1.");
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->n_threads = n_threads;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_n_threads(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_n_threads();" << endl;
     #endif
 
     #ifdef DEBUG
@@ -734,13 +1122,52 @@ extern "C"
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
-    optimiser->refine_partition = refine_partition;
+    #ifdef IS_PY3K
+    return PyLong_FromLong(optimiser->n_threads);
+    #else
+    return PyInt_FromLong(optimiser->n_threads);
+    #endif
+  }
+
+  PyObject* _Optimiser_set_max_levels(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int max_levels = 0;
+    static char* kwlist[] = {"optimiser", "max_levels", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
+                                     &py_optimiser, &max_levels))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_max_levels(" << max_levels << ");" << endl;
+    #endif
+
+    if (max_levels < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "Maximum number of levels should not be negative.");
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->max_levels = max_levels;
 
     Py_INCREF(Py_None);
     return Py_None;
   }
 
-  PyObject* _Optimiser_get_refine_partition(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_get_max_levels(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
     static char* kwlist[] = {"optimiser", NULL};
@@ -754,7 +1181,7 @@ extern "C"
         return NULL;
 
     #ifdef DEBUG
-      cerr << "get_refine_partition();" << endl;
+      cerr << "get_max_levels();" << endl;
     #endif
 
     #ifdef DEBUG
@@ -765,7 +1192,474 @@ extern "C"
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
-    return PyBool_FromLong(optimiser->refine_partition);
+    #ifdef IS_PY3K
+    return PyLong_FromLong(optimiser->max_levels);
+    #else
+    return PyInt_FromLong(optimiser->max_levels);
+    #endif
+  }
+
+  PyObject* _Optimiser_set_visit_order(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int visit_order = Optimiser::FIFO_ORDER;
+    static char* kwlist[] = {"optimiser", "visit_order", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
+                                     &py_optimiser, &visit_order))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_visit_order(" << visit_order << ");" << endl;
+    #endif
+
+    if (visit_order != Optimiser::FIFO_ORDER && visit_order != Optimiser::GAIN_ORDER &&
+        visit_order != Optimiser::DEGREE_ORDER && visit_order != Optimiser::BOUNDED_ORDER)
+    {
+      PyErr_SetString(PyExc_ValueError, "Unknown order for visiting nodes.");
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->visit_order = visit_order;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_visit_order(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_visit_order();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    #ifdef IS_PY3K
+    return PyLong_FromLong(optimiser->visit_order);
+    #else
+    return PyInt_FromLong(optimiser->visit_order);
+    #endif
+  }
+
+  PyObject* _Optimiser_set_max_unproductive_visits(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int max_unproductive_visits = 3;
+    static char* kwlist[] = {"optimiser", "max_unproductive_visits", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
+                                     &py_optimiser, &max_unproductive_visits))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_max_unproductive_visits(" << max_unproductive_visits << ");" << endl;
+    #endif
+
+    if (max_unproductive_visits < 1)
+    {
+      PyErr_SetString(PyExc_ValueError, "Maximum number of unproductive visits should be positive.");
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->max_unproductive_visits = (size_t)max_unproductive_visits;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_max_unproductive_visits(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_max_unproductive_visits();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    #ifdef IS_PY3K
+    return PyLong_FromLong(optimiser->max_unproductive_visits);
+    #else
+    return PyInt_FromLong(optimiser->max_unproductive_visits);
+    #endif
+  }
+
+  PyObject* _Optimiser_set_relabel_nodes(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int relabel_nodes = Optimiser::NO_RELABEL;
+    static char* kwlist[] = {"optimiser", "relabel_nodes", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
+                                     &py_optimiser, &relabel_nodes))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_relabel_nodes(" << relabel_nodes << ");" << endl;
+    #endif
+
+    if (relabel_nodes != Optimiser::NO_RELABEL && relabel_nodes != Optimiser::RCM_RELABEL &&
+        relabel_nodes != Optimiser::DEGREE_RELABEL)
+    {
+      PyErr_SetString(PyExc_ValueError, "Unknown order for relabelling nodes.");
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->relabel_nodes = relabel_nodes;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_relabel_nodes(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_relabel_nodes();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    #ifdef IS_PY3K
+    return PyLong_FromLong(optimiser->relabel_nodes);
+    #else
+    return PyInt_FromLong(optimiser->relabel_nodes);
+    #endif
+  }
+
+  PyObject* _Optimiser_get_timed_out(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_timed_out();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    return PyBool_FromLong(optimiser->timed_out());
+  }
+
+  PyObject* _Optimiser_get_hierarchy(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_hierarchy();" << endl;
+    #endif
+
+    #ifdef IS_PY3K
+      Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+      if (optimiser == NULL)
+        return NULL;
+
+      // Keep our own copy of the hierarchy, since the optimiser replaces it
+      // when it is run again.
+      PyObject* py_hierarchy = capsule_Hierarchy(new Hierarchy(optimiser->hierarchy()));
+      if (py_hierarchy == NULL)
+        return NULL;
+      size_t n_levels = decapsule_Hierarchy(py_hierarchy)->size();
+
+      PyObject* py_levels = PyList_New(n_levels);
+      for (size_t k = 0; py_levels != NULL && k < n_levels; k++)
+      {
+        HierarchyBuffer* py_buffer = PyObject_New(HierarchyBuffer, &HierarchyBufferType);
+        if (py_buffer == NULL)
+        {
+          Py_CLEAR(py_levels);
+          break;
+        }
+        Py_INCREF(py_hierarchy);
+        py_buffer->py_hierarchy = py_hierarchy;
+        py_buffer->level = k;
+
+        // The memoryview holds the only remaining reference to the exporter
+        PyObject* py_view = PyMemoryView_FromObject((PyObject*)py_buffer);
+        Py_DECREF(py_buffer);
+        if (py_view == NULL)
+        {
+          Py_CLEAR(py_levels);
+          break;
+        }
+        PyList_SET_ITEM(py_levels, k, py_view);
+      }
+      Py_DECREF(py_hierarchy);
+      return py_levels;
+    #else
+      PyErr_SetString(PyExc_NotImplementedError, "Hierarchy views require Python 3.");
+      return NULL;
+    #endif
+  }
+
+  PyObject* _Optimiser_get_stats(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_stats();" << endl;
+    #endif
+
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    vector<LevelStats> const& stats = optimiser->stats();
+
+    PyObject* py_stats = PyList_New(stats.size());
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+      LevelStats const& level = stats[i];
+      PyObject* py_level = Py_BuildValue("{s:n,s:n,s:n,s:d,s:d,s:d,s:N,s:N}",
+                                         "iteration",     (Py_ssize_t)level.iteration,
+                                         "n_nodes",       (Py_ssize_t)level.n_nodes,
+                                         "n_edges",       (Py_ssize_t)level.n_edges,
+                                         "move_time",     level.move_time,
+                                         "refine_time",   level.refine_time,
+                                         "collapse_time", level.collapse_time,
+                                         "move",          move_stats_to_py(level.move),
+                                         "refine",        move_stats_to_py(level.refine));
+      if (py_level == NULL)
+      {
+        Py_DECREF(py_stats);
+        return NULL;
+      }
+      PyList_SET_ITEM(py_stats, i, py_level);
+    }
+    return py_stats;
+  }
+
+  PyObject* _Optimiser_set_refine_partition(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int refine_partition = false;
+    static char* kwlist[] = {"optimiser", "refine_partition", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
+                                     &py_optimiser, &refine_partition))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_refine_partition(" << refine_partition << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->refine_partition = refine_partition;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_refine_partition(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_refine_partition();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    return PyBool_FromLong(optimiser->refine_partition);
+  }
+
+  PyObject* _Optimiser_set_record_hierarchy(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int record_hierarchy = false;
+    static char* kwlist[] = {"optimiser", "record_hierarchy", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
+                                     &py_optimiser, &record_hierarchy))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_record_hierarchy(" << record_hierarchy << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->record_hierarchy = record_hierarchy;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_record_hierarchy(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_record_hierarchy();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    return PyBool_FromLong(optimiser->record_hierarchy);
   }
 
   PyObject* _Optimiser_set_rng_seed(PyObject *self, PyObject *args, PyObject *keywds)
@@ -4,6 +4,347 @@
 #define IS_PY3K
 #endif
 
+/****************************************************************************
+  Reading vectors from Python objects.
+
+  Any object that exports a one-dimensional buffer (e.g. a NumPy array or an
+  array.array) in native byte order is read directly from its memory. Any
+  other object is read as a sequence of Python numbers.
+****************************************************************************/
+enum BufferItemKind { BUFFER_SIGNED, BUFFER_UNSIGNED, BUFFER_FLOAT, BUFFER_UNSUPPORTED };
+
+// Determine how to interpret the items of a buffer. The width of an item is
+// taken from the itemsize, so that both native and standard sizes are handled.
+BufferItemKind get_buffer_item_kind(Py_buffer* view)
+{
+  const char* format = view->format;
+  if (format == NULL)
+    return BUFFER_UNSIGNED; // Plain bytes
+
+  unsigned short test_endianness = 1;
+  bool little_endian = *((unsigned char*)&test_endianness) == 1;
+  switch (format[0])
+  {
+    case '@':
+    case '=':
+      format++;
+      break;
+    case '<':
+      if (!little_endian)
+        return BUFFER_UNSUPPORTED;
+      format++;
+      break;
+    case '>':
+    case '!':
+      if (little_endian)
+        return BUFFER_UNSUPPORTED;
+      format++;
+      break;
+  }
+
+  if (format[0] == '\0' || format[1] != '\0')
+    return BUFFER_UNSUPPORTED;
+
+  switch (format[0])
+  {
+    case 'b': case 'h': case 'i': case 'l': case 'q': case 'n':
+      if (view->itemsize == 1 || view->itemsize == 2 || view->itemsize == 4 || view->itemsize == 8)
+        return BUFFER_SIGNED;
+      break;
+    case 'B': case 'H': case 'I': case 'L': case 'Q': case 'N': case '?':
+      if (view->itemsize == 1 || view->itemsize == 2 || view->itemsize == 4 || view->itemsize == 8)
+        return BUFFER_UNSIGNED;
+      break;
+    case 'f':
+      if (view->itemsize == sizeof(float))
+        return BUFFER_FLOAT;
+      break;
+    case 'd':
+      if (view->itemsize == sizeof(double))
+        return BUFFER_FLOAT;
+      break;
+  }
+  return BUFFER_UNSUPPORTED;
+}
+
+// Try to obtain a one-dimensional buffer of a supported item kind from
+// py_obj. Returns false (and leaves no error set) if the object should be
+// read as a sequence instead.
+bool get_buffer_from_py(PyObject* py_obj, Py_buffer* view, BufferItemKind* kind)
+{
+  if (!PyObject_CheckBuffer(py_obj))
+    return false;
+
+  if (PyObject_GetBuffer(py_obj, view, PyBUF_STRIDES | PyBUF_FORMAT) < 0)
+  {
+    PyErr_Clear();
+    return false;
+  }
+
+  *kind = get_buffer_item_kind(view);
+  if (view->ndim != 1 || *kind == BUFFER_UNSUPPORTED)
+  {
+    PyBuffer_Release(view);
+    return false;
+  }
+  return true;
+}
+
+inline const char* get_buffer_item(Py_buffer* view, size_t i)
+{
+  Py_ssize_t stride = view->strides != NULL ? view->strides[0] : view->itemsize;
+  return (const char*)view->buf + i*stride;
+}
+
+long long get_buffer_item_as_signed(Py_buffer* view, size_t i)
+{
+  const char* item = get_buffer_item(view, i);
+  switch (view->itemsize)
+  {
+    case 1: { int8_t x;  memcpy(&x, item, 1); return x; }
+    case 2: { int16_t x; memcpy(&x, item, 2); return x; }
+    case 4: { int32_t x; memcpy(&x, item, 4); return x; }
+    default: { int64_t x; memcpy(&x, item, 8); return x; }
+  }
+}
+
+unsigned long long get_buffer_item_as_unsigned(Py_buffer* view, size_t i)
+{
+  const char* item = get_buffer_item(view, i);
+  switch (view->itemsize)
+  {
+    case 1: { uint8_t x;  memcpy(&x, item, 1); return x; }
+    case 2: { uint16_t x; memcpy(&x, item, 2); return x; }
+    case 4: { uint32_t x; memcpy(&x, item, 4); return x; }
+    default: { uint64_t x; memcpy(&x, item, 8); return x; }
+  }
+}
+
+double get_buffer_item_as_double(Py_buffer* view, BufferItemKind kind, size_t i)
+{
+  switch (kind)
+  {
+    case BUFFER_SIGNED:
+      return (double)get_buffer_item_as_signed(view, i);
+    case BUFFER_UNSIGNED:
+      return (double)get_buffer_item_as_unsigned(view, i);
+    default:
+    {
+      const char* item = get_buffer_item(view, i);
+      if (view->itemsize == sizeof(float))
+      {
+        float x; memcpy(&x, item, sizeof(float)); return x;
+      }
+      double x; memcpy(&x, item, sizeof(double)); return x;
+    }
+  }
+}
+
+/* Read a vector of non-negative integers (e.g. a membership vector). Returns
+ * false and sets a TypeError if some item is not an integer, and throws an
+ * Exception with negative_error if some item is negative. */
+bool read_indices_from_py(PyObject* py_obj, vector<size_t>& result, const char* negative_error, const char* type_error)
+{
+  Py_buffer view;
+  BufferItemKind kind;
+  if (get_buffer_from_py(py_obj, &view, &kind))
+  {
+    if (kind == BUFFER_FLOAT)
+    {
+      PyBuffer_Release(&view);
+      PyErr_SetString(PyExc_TypeError, type_error);
+      return false;
+    }
+    size_t n = view.shape[0];
+    result.resize(n);
+    for (size_t v = 0; v < n; v++)
+    {
+      if (kind == BUFFER_SIGNED)
+      {
+        long long m = get_buffer_item_as_signed(&view, v);
+        if (m < 0)
+        {
+          PyBuffer_Release(&view);
+          throw Exception(negative_error);
+        }
+        result[v] = m;
+      }
+      else
+        result[v] = get_buffer_item_as_unsigned(&view, v);
+    }
+    PyBuffer_Release(&view);
+    return true;
+  }
+
+  PyObject* py_seq = PySequence_Fast(py_obj, type_error);
+  if (py_seq == NULL)
+    return false;
+  size_t n = PySequence_Fast_GET_SIZE(py_seq);
+  result.resize(n);
+  for (size_t v = 0; v < n; v++)
+  {
+    PyObject* py_item = PySequence_Fast_GET_ITEM(py_seq, v);
+    if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
+    {
+      Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
+      if (m >= 0)
+        result[v] = m;
+      else
+      {
+        Py_DECREF(py_seq);
+        throw Exception(negative_error);
+      }
+    }
+    else
+    {
+      Py_DECREF(py_seq);
+      PyErr_SetString(PyExc_TypeError, type_error);
+      return false;
+    }
+  }
+  Py_DECREF(py_seq);
+  return true;
+}
+
+/* Read the edge weights, throws an Exception in case of invalid weights. */
+void read_weights_from_py(PyObject* py_weights, vector<double>& weights, int check_positive_weight)
+{
+  Py_buffer view;
+  BufferItemKind kind;
+  PyObject* py_seq = NULL;
+  size_t m;
+  bool is_buffer = get_buffer_from_py(py_weights, &view, &kind);
+  if (is_buffer)
+    m = view.shape[0];
+  else
+  {
+    py_seq = PySequence_Fast(py_weights, "Expected a sequence of weights.");
+    if (py_seq == NULL)
+    {
+      PyErr_Clear();
+      throw Exception("Expected floating point value for weight vector.");
+    }
+    m = PySequence_Fast_GET_SIZE(py_seq);
+  }
+
+  weights.resize(m);
+  const char* error = NULL;
+  for (size_t e = 0; e < m; e++)
+  {
+    if (is_buffer)
+      weights[e] = get_buffer_item_as_double(&view, kind, e);
+    else
+    {
+      PyObject* py_item = PySequence_Fast_GET_ITEM(py_seq, e);
+      if (PyNumber_Check(py_item))
+      {
+        weights[e] = PyFloat_AsDouble(py_item);
+      }
+      else
+      {
+        error = "Expected floating point value for weight vector.";
+        break;
+      }
+    }
+
+    if (check_positive_weight && weights[e] < 0)
+    {
+      error = "Cannot accept negative weights.";
+      break;
+    }
+
+    if (isnan(weights[e]))
+    {
+      error = "Cannot accept NaN weights.";
+      break;
+    }
+
+    if (!isfinite(weights[e]))
+    {
+      error = "Cannot accept infinite weights.";
+      break;
+    }
+  }
+
+  if (is_buffer)
+    PyBuffer_Release(&view);
+  else
+    Py_DECREF(py_seq);
+
+  if (error != NULL)
+    throw Exception(error);
+}
+
+/* Read the node sizes, throws an Exception in case of invalid node sizes. */
+void read_node_sizes_from_py(PyObject* py_node_sizes, vector<size_t>& node_sizes)
+{
+  Py_buffer view;
+  BufferItemKind kind;
+  if (get_buffer_from_py(py_node_sizes, &view, &kind))
+  {
+    size_t n = view.shape[0];
+    node_sizes.resize(n);
+    const char* error = NULL;
+    for (size_t v = 0; v < n; v++)
+    {
+      if (kind == BUFFER_FLOAT)
+      {
+        error = "Expected integer value for node sizes vector.";
+        break;
+      }
+      else if (kind == BUFFER_SIGNED)
+      {
+        long long s = get_buffer_item_as_signed(&view, v);
+        if (s < 0)
+        {
+          error = "Cannot accept negative node sizes.";
+          break;
+        }
+        node_sizes[v] = s;
+      }
+      else
+        node_sizes[v] = get_buffer_item_as_unsigned(&view, v);
+    }
+    PyBuffer_Release(&view);
+    if (error != NULL)
+      throw Exception(error);
+    return;
+  }
+
+  PyObject* py_seq = PySequence_Fast(py_node_sizes, "Expected a sequence of node sizes.");
+  if (py_seq == NULL)
+  {
+    PyErr_Clear();
+    throw Exception("Expected integer value for node sizes vector.");
+  }
+  size_t n = PySequence_Fast_GET_SIZE(py_seq);
+  node_sizes.resize(n);
+  for (size_t v = 0; v < n; v++)
+  {
+    PyObject* py_item = PySequence_Fast_GET_ITEM(py_seq, v);
+    #ifdef IS_PY3K
+    if (PyLong_Check(py_item))
+    #else
+    if (PyInt_Check(py_item) || PyLong_Check(py_item))
+    #endif
+    {
+      long s = PyLong_AsLong(py_item);
+      if (s < 0)
+      {
+        Py_DECREF(py_seq);
+        throw Exception("Cannot accept negative node sizes.");
+      }
+      node_sizes[v] = s;
+    }
+    else
+    {
+      Py_DECREF(py_seq);
+      throw Exception("Expected integer value for node sizes vector.");
+    }
+  }
+  Py_DECREF(py_seq);
+}
+
 Graph* create_graph_from_py(PyObject* py_obj_graph)
 {
   return create_graph_from_py(py_obj_graph, NULL, NULL, false);
@@ -56,28 +397,11 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, PyObje
       cerr << "Reading node_sizes." << endl;
     #endif
 
-    size_t nb_node_size = PyList_Size(py_node_sizes);
-    if (nb_node_size != n)
+    read_node_sizes_from_py(py_node_sizes, node_sizes);
+    if (node_sizes.size() != n)
     {
       throw Exception("Node size vector not the same size as the number of nodes.");
     }
-    node_sizes.resize(n);
-    for (size_t v = 0; v < n; v++)
-    {
-      PyObject* py_item = PyList_GetItem(py_node_sizes, v);
-      #ifdef IS_PY3K
-      if (PyLong_Check(py_item))
-      #else
-      if (PyInt_Check(py_item) || PyLong_Check(py_item))
-      #endif
-      {
-        node_sizes[v] = PyLong_AsLong(py_item);
-      }
-      else
-      {
-        throw Exception("Expected integer value for node sizes vector.");
-      }
-    }
   }
 
   if (py_weights != NULL && py_weights != Py_None)
@@ -85,37 +409,9 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, PyObje
     #ifdef DEBUG
       cerr << "Reading weights." << endl;
     #endif
-    size_t nb_weights = PyList_Size(py_weights);
-    if (nb_weights != m)
+    read_weights_from_py(py_weights, weights, check_positive_weight);
+    if (weights.size() != m)
       throw Exception("Weight vector not the same size as the number of edges.");
-    weights.resize(m);
-    for (size_t e = 0; e < m; e++)
-    {
-      PyObject* py_item = PyList_GetItem(py_weights, e);
-      #ifdef DEBUG
-        //PyObject* py_item_repr = PyObject_Repr(py_item);
-        //const char* s = PyUnicode_AsUTF8(py_item_repr);
-        //cerr << "Got item " << e << ": " << s << endl;
-      #endif
-      if (PyNumber_Check(py_item))
-      {
-        weights[e] = PyFloat_AsDouble(py_item);
-      }
-      else
-      {
-        throw Exception("Expected floating point value for weight vector.");
-      }
-
-      if (check_positive_weight)
-        if (weights[e] < 0 )
-          throw Exception("Cannot accept negative weights.");
-
-      if (isnan(weights[e]))
-        throw Exception("Cannot accept NaN weights.");
-
-      if (!isfinite(weights[e]))
-        throw Exception("Cannot accept infinite weights.");
-    }
   }
 
   // TODO: Pass correct_for_self_loops as parameter
@@ -145,6 +441,36 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, PyObje
   return graph;
 }
 
+/****************************************************************************
+  Create a partition of the given method ("Modularity", "Significance",
+  "Surprise", "CPM", "RBER" or "RBConfiguration") on a graph. If
+  initial_membership is NULL, this is a singleton partition. The resolution
+  parameter is ignored for methods without a resolution parameter.
+****************************************************************************/
+MutableVertexPartition* create_partition(Graph* graph, char* method, vector<size_t>* initial_membership, double resolution_parameter)
+{
+  vector<size_t> membership;
+  if (initial_membership != NULL)
+    membership = *initial_membership;
+  else
+    membership = range(graph->vcount());
+
+  if (strcmp(method, "Modularity") == 0)
+    return new ModularityVertexPartition(graph, membership);
+  else if (strcmp(method, "Significance") == 0)
+    return new SignificanceVertexPartition(graph, membership);
+  else if (strcmp(method, "Surprise") == 0)
+    return new SurpriseVertexPartition(graph, membership);
+  else if (strcmp(method, "CPM") == 0)
+    return new CPMVertexPartition(graph, membership, resolution_parameter);
+  else if (strcmp(method, "RBER") == 0)
+    return new RBERVertexPartition(graph, membership, resolution_parameter);
+  else if (strcmp(method, "RBConfiguration") == 0)
+    return new RBConfigurationVertexPartition(graph, membership, resolution_parameter);
+  else
+    throw Exception("Unknown method for partition.");
+}
+
 PyObject* capsule_MutableVertexPartition(MutableVertexPartition* partition)
 {
   PyObject* py_partition = PyCapsule_New(partition, "leidenalg.VertexPartition.MutableVertexPartition", del_MutableVertexPartition);
@@ -163,6 +489,132 @@ void del_MutableVertexPartition(PyObject* py_partition)
   delete partition;
 }
 
+PyObject* capsule_GraphBuilder(GraphBuilder* builder)
+{
+  PyObject* py_builder = PyCapsule_New(builder, "leidenalg.GraphBuilder", del_GraphBuilder);
+  return py_builder;
+}
+
+GraphBuilder* decapsule_GraphBuilder(PyObject* py_builder)
+{
+  GraphBuilder* builder = (GraphBuilder*) PyCapsule_GetPointer(py_builder, "leidenalg.GraphBuilder");
+  return builder;
+}
+
+void del_GraphBuilder(PyObject* py_builder)
+{
+  GraphBuilder* builder = decapsule_GraphBuilder(py_builder);
+  delete builder;
+}
+
+/****************************************************************************
+  Update the partition after the edges of its graph have changed, and return
+  the nodes affected by the changes as a list.
+****************************************************************************/
+PyObject* apply_edge_changes_to_py(MutableVertexPartition* partition, EdgeChanges const& changes)
+{
+  partition->apply_edge_changes(changes);
+  vector<size_t> nodes = partition->get_graph()->affected_nodes(changes);
+
+  PyObject* py_nodes = PyList_New(nodes.size());
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    #ifdef IS_PY3K
+      PyObject* item = PyLong_FromSize_t(nodes[i]);
+    #else
+      PyObject* item = PyInt_FromSize_t(nodes[i]);
+    #endif
+    PyList_SetItem(py_nodes, i, item);
+  }
+  return py_nodes;
+}
+
+#ifdef IS_PY3K
+/****************************************************************************
+  Read-only view of the membership of a partition.
+
+  The exporter keeps a reference to the partition capsule, so that the
+  partition is not deleted while any view on it exists. Each view also
+  exports the membership of the partition (see export_membership), so that
+  its storage does not change until the view is released. The view does show
+  any later changes of the membership itself. The shape and stride of each
+  view are stored in view->internal.
+****************************************************************************/
+typedef struct
+{
+  PyObject_HEAD
+  PyObject* py_partition;
+} MembershipBuffer;
+
+void del_MembershipBuffer(MembershipBuffer* self)
+{
+  Py_XDECREF(self->py_partition);
+  PyObject_Del(self);
+}
+
+int MembershipBuffer_getbuffer(MembershipBuffer* self, Py_buffer* view, int flags)
+{
+  if (flags & PyBUF_WRITABLE)
+  {
+    PyErr_SetString(PyExc_BufferError, "Membership can only be read.");
+    return -1;
+  }
+
+  MutableVertexPartition* partition = decapsule_MutableVertexPartition(self->py_partition);
+  vector<size_t> const& membership = partition->membership();
+
+  Py_ssize_t* shape_stride = new Py_ssize_t[2];
+  shape_stride[0] = membership.size();
+  shape_stride[1] = sizeof(size_t);
+  partition->export_membership();
+
+  view->obj = (PyObject*)self;
+  Py_INCREF(self);
+  view->buf = (void*)membership.data();
+  view->len = membership.size()*sizeof(size_t);
+  view->readonly = 1;
+  view->itemsize = sizeof(size_t);
+  // Use the unsigned type that matches size_t, which is commonly understood
+  if (sizeof(size_t) == sizeof(unsigned long))
+    view->format = (flags & PyBUF_FORMAT) ? (char*)"L" : NULL;
+  else
+    view->format = (flags & PyBUF_FORMAT) ? (char*)"Q" : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &shape_stride[0] : NULL;
+  view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? &shape_stride[1] : NULL;
+  view->suboffsets = NULL;
+  view->internal = shape_stride;
+  return 0;
+}
+
+void MembershipBuffer_releasebuffer(MembershipBuffer* self, Py_buffer* view)
+{
+  delete [] (Py_ssize_t*)view->internal;
+  MutableVertexPartition* partition = decapsule_MutableVertexPartition(self->py_partition);
+  partition->release_membership();
+}
+
+static PyBufferProcs MembershipBuffer_as_buffer = {
+  (getbufferproc)MembershipBuffer_getbuffer,
+  (releasebufferproc)MembershipBuffer_releasebuffer
+};
+
+static PyTypeObject MembershipBufferType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+int init_MembershipBuffer_type()
+{
+  MembershipBufferType.tp_name = "leidenalg._c_leiden.MembershipBuffer";
+  MembershipBufferType.tp_basicsize = sizeof(MembershipBuffer);
+  MembershipBufferType.tp_dealloc = (destructor)del_MembershipBuffer;
+  MembershipBufferType.tp_as_buffer = &MembershipBuffer_as_buffer;
+  MembershipBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+  MembershipBufferType.tp_doc = "Exports the membership of a partition.";
+  return PyType_Ready(&MembershipBufferType);
+}
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -195,25 +647,10 @@ extern "C"
         #ifdef DEBUG
           cerr << "Reading initial membership." << endl;
         #endif
-        size_t n = PyList_Size(py_initial_membership);
-        initial_membership.resize(n);
-        for (size_t v = 0; v < n; v++)
-        {
-          PyObject* py_item = PyList_GetItem(py_initial_membership, v);
-          if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-          {
-            Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-            if (m >= 0)
-              initial_membership[v] = m;
-            else
-              throw Exception("Membership cannot be negative");
-          }
-          else
-          {
-            PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
-            return NULL;
-          }
-        }
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
 
         partition = new ModularityVertexPartition(graph, initial_membership);
       }
@@ -266,25 +703,10 @@ extern "C"
         #ifdef DEBUG
           cerr << "Reading initial membership." << endl;
         #endif
-        size_t n = PyList_Size(py_initial_membership);
-        initial_membership.resize(n);
-        for (size_t v = 0; v < n; v++)
-        {
-          PyObject* py_item = PyList_GetItem(py_initial_membership, v);
-          if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-          {
-            Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-            if (m >= 0)
-              initial_membership[v] = m;
-            else
-              throw Exception("Membership cannot be negative");
-          }
-          else
-          {
-            PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
-            return NULL;
-          }
-        }
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
 
         partition = new SignificanceVertexPartition(graph, initial_membership);
       }
@@ -337,25 +759,10 @@ extern "C"
         #ifdef DEBUG
           cerr << "Reading initial membership." << endl;
         #endif
-        size_t n = PyList_Size(py_initial_membership);
-        initial_membership.resize(n);
-        for (size_t v = 0; v < n; v++)
-        {
-          PyObject* py_item = PyList_GetItem(py_initial_membership, v);
-          if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-          {
-            Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-            if (m >= 0)
-              initial_membership[v] = m;
-            else
-              throw Exception("Membership cannot be negative");
-          }
-          else
-          {
-            PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
-            return NULL;
-          }
-        }
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
 
         partition = new SurpriseVertexPartition(graph, initial_membership);
       }
@@ -410,28 +817,10 @@ extern "C"
         #ifdef DEBUG
           cerr << "Reading initial membership." << endl;
         #endif
-        size_t n = PyList_Size(py_initial_membership);
-        #ifdef DEBUG
-          cerr << "Size " << n << endl;
-        #endif
-        initial_membership.resize(n);
-        for (size_t v = 0; v < n; v++)
-        {
-          PyObject* py_item = PyList_GetItem(py_initial_membership, v);
-          if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-          {
-            Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-            if (m >= 0)
-              initial_membership[v] = m;
-            else
-              throw Exception("Membership cannot be negative");
-          }
-          else
-          {
-            PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
-            return NULL;
-          }
-        }
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
 
         partition = new CPMVertexPartition(graph, initial_membership, resolution_parameter);
       }
@@ -456,6 +845,64 @@ extern "C"
     }
   }
 
+  PyObject* _new_MultisliceVertexPartition(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_obj_graph = NULL;
+    PyObject* py_slices = NULL;
+    int null_model = MultisliceVertexPartition::CONFIGURATION;
+    PyObject* py_initial_membership = NULL;
+    PyObject* py_weights = NULL;
+    PyObject* py_node_sizes = NULL;
+    double resolution_parameter = 1.0;
+
+    static char* kwlist[] = {"graph", "slices", "null_model", "initial_membership", "weights", "node_sizes", "resolution_parameter", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iOOOd", kwlist,
+                                     &py_obj_graph, &py_slices, &null_model, &py_initial_membership, &py_weights, &py_node_sizes, &resolution_parameter))
+        return NULL;
+
+    vector<size_t> slices;
+    if (!read_indices_from_py(py_slices, slices,
+                              "Slice cannot be negative",
+                              "Expected integer value for slices vector."))
+      return NULL;
+
+    vector<size_t> initial_membership;
+    int has_membership = (py_initial_membership != NULL && py_initial_membership != Py_None);
+    if (has_membership)
+    {
+      if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                "Membership cannot be negative",
+                                "Expected integer value for membership vector."))
+        return NULL;
+    }
+
+    Graph* graph = NULL;
+    try
+    {
+      graph = create_graph_from_py(py_obj_graph, py_weights, py_node_sizes, false);
+      graph->set_slices(slices);
+
+      MultisliceVertexPartition* partition = NULL;
+      if (has_membership)
+        partition = new MultisliceVertexPartition(graph, null_model, initial_membership, resolution_parameter);
+      else
+        partition = new MultisliceVertexPartition(graph, null_model, resolution_parameter);
+
+      // Do *NOT* forget to remove the graph upon deletion
+      partition->destructor_delete_graph = true;
+
+      return capsule_MutableVertexPartition(partition);
+    }
+    catch (std::exception const & e )
+    {
+      delete graph;
+      string s = "Could not construct partition: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return NULL;
+    }
+  }
+
   PyObject* _new_RBERVertexPartition(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_obj_graph = NULL;
@@ -486,25 +933,10 @@ extern "C"
         #ifdef DEBUG
           cerr << "Reading initial membership." << endl;
         #endif
-        size_t n = PyList_Size(py_initial_membership);
-        initial_membership.resize(n);
-        for (size_t v = 0; v < n; v++)
-        {
-          PyObject* py_item = PyList_GetItem(py_initial_membership, v);
-          if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-          {
-            Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-            if (m >= 0)
-              initial_membership[v] = m;
-            else
-              throw Exception("Membership cannot be negative");
-          }
-          else
-          {
-            PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
-            return NULL;
-          }
-        }
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
 
         partition = new RBERVertexPartition(graph, initial_membership, resolution_parameter);
       }
@@ -558,25 +990,10 @@ extern "C"
         #ifdef DEBUG
           cerr << "Reading initial membership." << endl;
         #endif
-        size_t n = PyList_Size(py_initial_membership);
-        initial_membership.resize(n);
-        for (size_t v = 0; v < n; v++)
-        {
-          PyObject* py_item = PyList_GetItem(py_initial_membership, v);
-          if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-          {
-            Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-            if (m >= 0)
-              initial_membership[v] = m;
-            else
-              throw Exception("Membership cannot be negative");
-          }
-          else
-          {
-            PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
-            return NULL;
-          }
-        }
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
 
         partition = new RBConfigurationVertexPartition(graph, initial_membership, resolution_parameter);
       }
@@ -601,11 +1018,315 @@ extern "C"
     }
   }
 
-  PyObject* _MutableVertexPartition_get_py_igraph(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _new_VertexPartition_from_file(PyObject *self, PyObject *args, PyObject *keywds)
   {
-    PyObject* py_partition = NULL;
+    char* filename = NULL;
+    char* method = NULL;
+    PyObject* py_initial_membership = NULL;
+    double resolution_parameter = 1.0;
+    int validate = true;
 
-    static char* kwlist[] = {"partition", NULL};
+    static char* kwlist[] = {"filename", "method", "initial_membership", "resolution_parameter", "validate", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "ss|Odi", kwlist,
+                                     &filename, &method, &py_initial_membership, &resolution_parameter, &validate))
+        return NULL;
+
+    Graph* graph = NULL;
+    try
+    {
+      vector<size_t> initial_membership;
+      if (py_initial_membership != NULL && py_initial_membership != Py_None)
+      {
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
+      }
+
+      // Release the GIL while loading, no Python objects are used
+      bool ok = call_without_gil([&]() { graph = Graph::load(filename, validate); }, "Could not load graph: ");
+      if (!ok)
+        return NULL;
+
+      if (py_initial_membership != NULL && py_initial_membership != Py_None &&
+          initial_membership.size() != graph->vcount())
+        throw Exception("Membership vector has incorrect size.");
+
+      MutableVertexPartition* partition = create_partition(graph, method,
+          (py_initial_membership != NULL && py_initial_membership != Py_None) ? &initial_membership : NULL,
+          resolution_parameter);
+
+      // Do *NOT* forget to remove the graph upon deletion
+      partition->destructor_delete_graph = true;
+
+      PyObject* py_partition = capsule_MutableVertexPartition(partition);
+      return Py_BuildValue("Nni", py_partition, (Py_ssize_t)graph->vcount(), graph->is_directed());
+    }
+    catch (std::exception& e )
+    {
+      delete graph;
+      string s = "Could not construct partition: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return NULL;
+    }
+  }
+
+  PyObject* _new_VertexPartition_from_builder(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_builder = NULL;
+    char* method = NULL;
+    PyObject* py_initial_membership = NULL;
+    PyObject* py_node_sizes = NULL;
+    double resolution_parameter = 1.0;
+
+    static char* kwlist[] = {"builder", "method", "initial_membership", "node_sizes", "resolution_parameter", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Os|OOd", kwlist,
+                                     &py_builder, &method, &py_initial_membership, &py_node_sizes, &resolution_parameter))
+        return NULL;
+
+    GraphBuilder* builder = decapsule_GraphBuilder(py_builder);
+
+    Graph* graph = NULL;
+    try
+    {
+      vector<size_t> initial_membership;
+      int has_membership = (py_initial_membership != NULL && py_initial_membership != Py_None);
+      if (has_membership)
+      {
+        if (!read_indices_from_py(py_initial_membership, initial_membership,
+                                  "Membership cannot be negative",
+                                  "Expected integer value for membership vector."))
+          return NULL;
+      }
+
+      if (py_node_sizes != NULL && py_node_sizes != Py_None)
+      {
+        vector<size_t> node_sizes;
+        read_node_sizes_from_py(py_node_sizes, node_sizes);
+        graph = builder->get_graph(node_sizes);
+      }
+      else
+        graph = builder->get_graph();
+
+      if (has_membership && initial_membership.size() != graph->vcount())
+        throw Exception("Membership vector has incorrect size.");
+
+      MutableVertexPartition* partition = create_partition(graph, method,
+          has_membership ? &initial_membership : NULL,
+          resolution_parameter);
+
+      // Do *NOT* forget to remove the graph upon deletion
+      partition->destructor_delete_graph = true;
+
+      PyObject* py_partition = capsule_MutableVertexPartition(partition);
+      return Py_BuildValue("Nni", py_partition, (Py_ssize_t)graph->vcount(), graph->is_directed());
+    }
+    catch (std::exception& e )
+    {
+      delete graph;
+      string s = "Could not construct partition: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return NULL;
+    }
+  }
+
+  PyObject* _new_GraphBuilder(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    Py_ssize_t n = 0;
+    int directed = false;
+    int correct_self_loops = false;
+
+    static char* kwlist[] = {"n", "directed", "correct_self_loops", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|nii", kwlist,
+                                     &n, &directed, &correct_self_loops))
+        return NULL;
+
+    if (n < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "Number of nodes cannot be negative.");
+      return NULL;
+    }
+
+    GraphBuilder* builder = new GraphBuilder(n, directed, correct_self_loops);
+    return capsule_GraphBuilder(builder);
+  }
+
+  PyObject* _GraphBuilder_count_edges(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_builder = NULL;
+    PyObject* py_from = NULL;
+    PyObject* py_to = NULL;
+
+    static char* kwlist[] = {"builder", "edge_from", "edge_to", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO", kwlist,
+                                     &py_builder, &py_from, &py_to))
+        return NULL;
+
+    GraphBuilder* builder = decapsule_GraphBuilder(py_builder);
+
+    try
+    {
+      vector<size_t> from;
+      vector<size_t> to;
+      if (!read_indices_from_py(py_from, from,
+                                "Node cannot be negative",
+                                "Expected integer value for node.") ||
+          !read_indices_from_py(py_to, to,
+                                "Node cannot be negative",
+                                "Expected integer value for node."))
+        return NULL;
+      if (from.size() != to.size())
+        throw Exception("Number of sources and targets of edges differ.");
+
+      builder->count_edges(from.data(), to.data(), from.size());
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _GraphBuilder_add_edges(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_builder = NULL;
+    PyObject* py_from = NULL;
+    PyObject* py_to = NULL;
+    PyObject* py_weights = NULL;
+
+    static char* kwlist[] = {"builder", "edge_from", "edge_to", "weights", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|O", kwlist,
+                                     &py_builder, &py_from, &py_to, &py_weights))
+        return NULL;
+
+    GraphBuilder* builder = decapsule_GraphBuilder(py_builder);
+
+    try
+    {
+      vector<size_t> from;
+      vector<size_t> to;
+      vector<double> weights;
+      if (!read_indices_from_py(py_from, from,
+                                "Node cannot be negative",
+                                "Expected integer value for node.") ||
+          !read_indices_from_py(py_to, to,
+                                "Node cannot be negative",
+                                "Expected integer value for node."))
+        return NULL;
+      if (from.size() != to.size())
+        throw Exception("Number of sources and targets of edges differ.");
+
+      if (py_weights != NULL && py_weights != Py_None)
+      {
+        read_weights_from_py(py_weights, weights, false);
+        if (weights.size() != from.size())
+          throw Exception("Weight vector not the same size as the number of edges.");
+        builder->add_edges(from.data(), to.data(), weights.data(), from.size());
+      }
+      else
+        builder->add_edges(from.data(), to.data(), NULL, from.size());
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _GraphBuilder_read_file(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_builder = NULL;
+    char* filename = NULL;
+
+    static char* kwlist[] = {"builder", "filename", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Os", kwlist,
+                                     &py_builder, &filename))
+        return NULL;
+
+    GraphBuilder* builder = decapsule_GraphBuilder(py_builder);
+
+    // Release the GIL while reading, no Python objects are used
+    bool ok = call_without_gil([&]() { builder->read_file(filename); });
+    if (!ok)
+      return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _save_graph(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_obj_graph = NULL;
+    char* filename = NULL;
+    PyObject* py_weights = NULL;
+    PyObject* py_node_sizes = NULL;
+
+    static char* kwlist[] = {"graph", "filename", "weights", "node_sizes", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Os|OO", kwlist,
+                                     &py_obj_graph, &filename, &py_weights, &py_node_sizes))
+        return NULL;
+
+    Graph* graph = NULL;
+    try
+    {
+      graph = create_graph_from_py(py_obj_graph, py_weights, py_node_sizes, false);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    // Release the GIL while writing, no Python objects are used
+    bool ok = call_without_gil([&]() { graph->save(filename); });
+    delete graph;
+    if (!ok)
+      return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _set_graph_n_threads(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    int n_threads = 0;
+
+    static char* kwlist[] = {"n_threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "i", kwlist,
+                                     &n_threads))
+        return NULL;
+
+    if (n_threads < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "Number of threads should be non-negative.");
+      return NULL;
+    }
+
+    Graph::set_n_threads(n_threads);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _MutableVertexPartition_get_py_igraph(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+
+    static char* kwlist[] = {"partition", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
@@ -683,26 +1404,11 @@ extern "C"
       cerr << "from_coarse_partition();" << endl;
     #endif
 
-    size_t n = PyList_Size(py_membership);
     vector<size_t> membership;
-    membership.resize(n);
-    for (size_t v = 0; v < n; v++)
-    {
-      PyObject* py_item = PyList_GetItem(py_membership, v);
-      if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-      {
-        Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-        if (m >= 0)
-          membership[v] = m;
-        else
-          throw Exception("Membership cannot be negative");
-      }
-      else
-      {
-        PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
-        return NULL;
-      }
-    }
+    if (!read_indices_from_py(py_membership, membership,
+                              "Membership cannot be negative",
+                              "Expected integer value for membership vector."))
+      return NULL;
 
     #ifdef DEBUG
       cerr << "Capsule partition at address " << py_partition << endl;
@@ -717,27 +1423,11 @@ extern "C"
     if (py_coarse_node != NULL && py_coarse_node != Py_None)
     {
       cerr << "Get coarse node list" << endl;
-      size_t n = PyList_Size(py_coarse_node);
       vector<size_t> coarse_node;
-      coarse_node.resize(n);
-      for (size_t v = 0; v < n; v++)
-      {
-        PyObject* py_item = PyList_GetItem(py_coarse_node, v);
-
-        if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-        {
-          Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-          if (m >= 0)
-            coarse_node[v] = m;
-          else
-            throw Exception("Coarse node cannot be negative");
-        }
-        else
-        {
-          PyErr_SetString(PyExc_TypeError, "Expected integer value for coarse vector.");
-          return NULL;
-        }
-      }
+      if (!read_indices_from_py(py_coarse_node, coarse_node,
+                                "Coarse node cannot be negative",
+                                "Expected integer value for coarse vector."))
+        return NULL;
 
     cerr << "Got coarse node list" << endl;
       partition->from_coarse_partition(membership, coarse_node);
@@ -1238,6 +1928,91 @@ extern "C"
     return py_membership;
   }
 
+  PyObject* _MutableVertexPartition_get_community(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    size_t comm;
+    static char* kwlist[] = {"partition", "comm", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OK", kwlist,
+                                     &py_partition, &comm))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_community(" << comm << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule partition at address " << py_partition << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    if (comm >= partition->n_communities())
+    {
+      PyErr_SetString(PyExc_IndexError, "Try to index beyond the number of communities.");
+      return NULL;
+    }
+
+    vector<size_t> community = partition->get_community(comm);
+    PyObject* py_community = PyList_New(community.size());
+    for (size_t i = 0; i < community.size(); i++)
+    {
+      #ifdef IS_PY3K
+        PyObject* item = PyLong_FromSize_t(community[i]);
+      #else
+        PyObject* item = PyInt_FromSize_t(community[i]);
+      #endif
+      PyList_SetItem(py_community, i, item);
+    }
+    return py_community;
+  }
+
+  PyObject* _MutableVertexPartition_get_membership_view(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    static char* kwlist[] = {"partition", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_partition))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_membership_view();" << endl;
+    #endif
+
+    #ifdef IS_PY3K
+      if (decapsule_MutableVertexPartition(py_partition) == NULL)
+        return NULL;
+
+      MembershipBuffer* py_buffer = PyObject_New(MembershipBuffer, &MembershipBufferType);
+      if (py_buffer == NULL)
+        return NULL;
+      Py_INCREF(py_partition);
+      py_buffer->py_partition = py_partition;
+
+      // The memoryview holds the only remaining reference to the exporter
+      PyObject* py_view = PyMemoryView_FromObject((PyObject*)py_buffer);
+      Py_DECREF(py_buffer);
+      return py_view;
+    #else
+      PyErr_SetString(PyExc_NotImplementedError, "Membership views require Python 3.");
+      return NULL;
+    #endif
+  }
+
   PyObject* _MutableVertexPartition_set_membership(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_partition = NULL;
@@ -1267,36 +2042,309 @@ extern "C"
       cerr << "Using partition at address " << partition << endl;
     #endif
 
-    size_t n = PyList_Size(py_membership);
     vector<size_t> membership;
-    membership.resize(n);
-    for (size_t v = 0; v < n; v++)
+    if (!read_indices_from_py(py_membership, membership,
+                              "Membership node cannot be negative",
+                              "Expected integer value for membership vector."))
+      return NULL;
+
+    partition->set_membership(membership);
+
+    #ifdef DEBUG
+      cerr << "Exiting set_membership();" << endl;
+    #endif
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _MutableVertexPartition_clone(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+
+    static char* kwlist[] = {"partition", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_partition))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "clone();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    // The clone shares the graph of the partition, and does not delete it
+    MutableVertexPartition* clone = partition->clone();
+
+    #ifdef DEBUG
+      cerr << "Created clone at address " << clone << endl;
+    #endif
+
+    return capsule_MutableVertexPartition(clone);
+  }
+
+  PyObject* _MutableVertexPartition_checkpoint(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+
+    static char* kwlist[] = {"partition", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_partition))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "checkpoint();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    string state;
+    try
     {
-      PyObject* py_item = PyList_GetItem(py_membership, v);
+      state = partition->checkpoint();
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
 
-      if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
-      {
-          Py_ssize_t m = PyNumber_AsSsize_t(py_item, NULL);
-          if (m >= 0)
-            membership[v] = m;
-          else
-            throw Exception("Membership node cannot be negative");
-      }
-      else
+    #ifdef IS_PY3K
+      return PyBytes_FromStringAndSize(state.data(), state.size());
+    #else
+      return PyString_FromStringAndSize(state.data(), state.size());
+    #endif
+  }
+
+  PyObject* _MutableVertexPartition_restore(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    PyObject* py_state = NULL;
+
+    static char* kwlist[] = {"partition", "state", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", kwlist,
+                                     &py_partition, &py_state))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "restore();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(py_state, &view, PyBUF_SIMPLE) < 0)
+      return NULL;
+    string state((char const*)view.buf, view.len);
+    PyBuffer_Release(&view);
+
+    try
+    {
+      partition->restore(state);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _MultisliceVertexPartition_get_slices(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+
+    static char* kwlist[] = {"partition", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_partition))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_slices();" << endl;
+    #endif
+
+    MultisliceVertexPartition* partition =
+      dynamic_cast<MultisliceVertexPartition*>(decapsule_MutableVertexPartition(py_partition));
+    if (partition == NULL)
+    {
+      PyErr_SetString(PyExc_TypeError, "Expected a multislice partition.");
+      return NULL;
+    }
+
+    // Only the nodes of an original graph lie within a single slice
+    Graph* graph = partition->get_graph();
+    size_t n = graph->vcount();
+    PyObject* py_slices = PyList_New(n);
+    for (size_t v = 0; v < n; v++)
+    {
+      if (graph->n_node_slices(v) != 1)
       {
-        PyErr_SetString(PyExc_TypeError, "Expected integer value for membership vector.");
+        Py_DECREF(py_slices);
+        PyErr_SetString(PyExc_ValueError, "Nodes do not lie within a single slice.");
         return NULL;
       }
+      #ifdef IS_PY3K
+        PyObject* item = PyLong_FromSize_t(graph->node_slices(v)[0].slice);
+      #else
+        PyObject* item = PyInt_FromSize_t(graph->node_slices(v)[0].slice);
+      #endif
+      PyList_SetItem(py_slices, v, item);
     }
 
-    partition->set_membership(membership);
+    return Py_BuildValue("Ni", py_slices, partition->null_model());
+  }
+
+  PyObject* _MutableVertexPartition_add_edges(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    PyObject* py_from = NULL;
+    PyObject* py_to = NULL;
+    PyObject* py_weights = NULL;
+
+    static char* kwlist[] = {"partition", "edge_from", "edge_to", "weights", NULL};
 
     #ifdef DEBUG
-      cerr << "Exiting set_membership();" << endl;
+      cerr << "Parsing arguments..." << endl;
     #endif
 
-    Py_INCREF(Py_None);
-    return Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOO", kwlist,
+                                     &py_partition, &py_from, &py_to, &py_weights))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "add_edges();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    try
+    {
+      vector<size_t> from;
+      vector<size_t> to;
+      vector<double> weights;
+      if (!read_indices_from_py(py_from, from,
+                                "Node cannot be negative",
+                                "Expected integer value for node.") ||
+          !read_indices_from_py(py_to, to,
+                                "Node cannot be negative",
+                                "Expected integer value for node."))
+        return NULL;
+      read_weights_from_py(py_weights, weights, false);
+
+      EdgeChanges changes;
+      partition->get_graph()->add_edges(from, to, weights, changes);
+      return apply_edge_changes_to_py(partition, changes);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
+
+  PyObject* _MutableVertexPartition_delete_edges(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    PyObject* py_edges = NULL;
+
+    static char* kwlist[] = {"partition", "edges", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", kwlist,
+                                     &py_partition, &py_edges))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "delete_edges();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    try
+    {
+      vector<size_t> edges;
+      if (!read_indices_from_py(py_edges, edges,
+                                "Edge cannot be negative",
+                                "Expected integer value for edge."))
+        return NULL;
+
+      EdgeChanges changes;
+      partition->get_graph()->delete_edges(edges, changes);
+      return apply_edge_changes_to_py(partition, changes);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
+
+  PyObject* _MutableVertexPartition_set_edge_weights(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    PyObject* py_edges = NULL;
+    PyObject* py_weights = NULL;
+
+    static char* kwlist[] = {"partition", "edges", "weights", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO", kwlist,
+                                     &py_partition, &py_edges, &py_weights))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_edge_weights();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    try
+    {
+      vector<size_t> edges;
+      vector<double> weights;
+      if (!read_indices_from_py(py_edges, edges,
+                                "Edge cannot be negative",
+                                "Expected integer value for edge."))
+        return NULL;
+      read_weights_from_py(py_weights, weights, false);
+
+      EdgeChanges changes;
+      partition->get_graph()->set_edge_weights(edges, weights, changes);
+      return apply_edge_changes_to_py(partition, changes);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
   }
 
   PyObject* _ResolutionParameterVertexPartition_get_resolution(PyObject *self, PyObject *args, PyObject *keywds)
@@ -1411,6 +2459,49 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
+  PyObject* _ResolutionParameterVertexPartition_qualities(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    PyObject* py_resolution_parameters = NULL;
+
+    static char* kwlist[] = {"partition", "resolution_parameters", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", kwlist,
+                                     &py_partition, &py_resolution_parameters))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "qualities();" << endl;
+    #endif
+
+    ResolutionParameterVertexPartition* partition = (ResolutionParameterVertexPartition*)decapsule_MutableVertexPartition(py_partition);
+
+    vector<double> resolution_parameters;
+    try
+    {
+      // Resolution parameters are read like weights, but may be negative
+      read_weights_from_py(py_resolution_parameters, resolution_parameters, false);
+    }
+    catch (std::exception& e)
+    {
+      string s = "Could not read resolution parameters: " + string(e.what());
+      PyErr_SetString(PyExc_ValueError, s.c_str());
+      return NULL;
+    }
+
+    vector<double> qualities;
+    partition->qualities(resolution_parameters, qualities);
+
+    PyObject* py_qualities = PyList_New(qualities.size());
+    for (size_t i = 0; i < qualities.size(); i++)
+      PyList_SetItem(py_qualities, i, PyFloat_FromDouble(qualities[i]));
+    return py_qualities;
+  }
+
 #ifdef __cplusplus
 }
 #endif
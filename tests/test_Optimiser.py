@@ -64,6 +64,49 @@ class OptimiserTest(unittest.TestCase):
         partition.sizes(), 2*[50],
         msg="After optimising partition failed to find bipartite structure with CPMVertexPartition(resolution_parameter=-0.1)");
 
+  def test_optimiser_n_threads(self):
+    G = reduce(ig.Graph.disjoint_union, (ig.Graph.Tree(10, 3, mode=ig.TREE_UNDIRECTED) for i in range(10)));
+    partition = leidenalg.CPMVertexPartition(G, resolution_parameter=0);
+    self.optimiser.n_threads = 4;
+    self.optimiser.optimise_partition(partition);
+    self.assertListEqual(
+        partition.sizes(), 10*[10],
+        msg="After optimising partition using multiple threads failed to find different components with CPMVertexPartition(resolution_parameter=0)");
+
+  def test_refine_partition_n_threads(self):
+    G = ig.Graph.Erdos_Renyi(n=1000, m=5000);
+    memberships = [];
+    for n_threads in [2, 4]:
+      partition = leidenalg.ModularityVertexPartition(G);
+      self.optimiser.set_rng_seed(0);
+      # Only the refinement then uses multiple threads
+      self.optimiser.optimise_routine = leidenalg.MERGE_NODES;
+      self.optimiser.n_threads = n_threads;
+      self.optimiser.optimise_partition(partition);
+      memberships.append(partition.membership);
+    self.assertListEqual(
+      memberships[0], memberships[1],
+      msg="Refining the partition using a different number of threads gave a different partition.");
+
+  def test_optimise_partition_multistart(self):
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.set_rng_seed(0);
+    diff, memberships = self.optimiser.optimise_partition_multistart(partition, n_starts=10, return_memberships=True);
+    best_quality = max(leidenalg.ModularityVertexPartition(G, m).quality() for m in memberships);
+    self.assertEqual(len(memberships), 10);
+    self.assertAlmostEqual(
+      partition.quality(), best_quality, places=10,
+      msg="Multistart optimisation did not keep the partition with the highest quality.");
+
+    partition_threads = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.set_rng_seed(0);
+    self.optimiser.n_threads = 4;
+    self.optimiser.optimise_partition_multistart(partition_threads, n_starts=10);
+    self.assertListEqual(
+      partition.membership, partition_threads.membership,
+      msg="Multistart optimisation using multiple threads differs from the one using a single thread.");
+
   def test_resolution_profile(self):
     G = ig.Graph.Famous('Zachary');
     profile = self.optimiser.resolution_profile(G, leidenalg.CPMVertexPartition, resolution_range=(0,1));
@@ -74,6 +117,229 @@ class OptimiserTest(unittest.TestCase):
       profile[-1].sizes(), [1]*G.vcount(),
       msg="Resolution profile incorrect: at resolution 1, not equal to a singleton partition for CPM.");
 
+  def test_resolution_profile_n_threads(self):
+    G = ig.Graph.Famous('Zachary');
+    self.optimiser.set_rng_seed(0);
+    profile = self.optimiser.resolution_profile(G, leidenalg.CPMVertexPartition, resolution_range=(0,1));
+    self.optimiser.set_rng_seed(0);
+    self.optimiser.n_threads = 4;
+    profile_threads = self.optimiser.resolution_profile(G, leidenalg.CPMVertexPartition, resolution_range=(0,1));
+    self.assertListEqual(
+      [(p.resolution_parameter, p.membership) for p in profile],
+      [(p.resolution_parameter, p.membership) for p in profile_threads],
+      msg="Resolution profile using multiple threads differs from the resolution profile using a single thread.");
+    bisect_values = [p.bisect_value() for p in profile];
+    self.assertListEqual(
+      bisect_values, sorted(set(bisect_values), reverse=True),
+      msg="Resolution profile incorrect: bisect values not strictly decreasing.");
+
+  def test_resolution_profile_qualities(self):
+    G = ig.Graph.Famous('Zachary');
+    resolutions = [0.0, 0.01, 0.1, 0.5, 1.0, 2.0];
+    for partition_type in [leidenalg.CPMVertexPartition,
+                           leidenalg.RBERVertexPartition,
+                           leidenalg.RBConfigurationVertexPartition]:
+      partition = partition_type(G, resolution_parameter=0.1);
+      self.optimiser.optimise_partition(partition);
+      qualities = partition.qualities(resolutions);
+      for res, q in zip(resolutions, qualities):
+        self.assertAlmostEqual(
+          q, partition.quality(res), places=10,
+          msg="Quality for resolution {0} of {1} not equal to quality determined separately.".format(
+            res, partition_type.__name__));
+
+  def test_optimiser_stats(self):
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.ModularityVertexPartition(G);
+    q = partition.quality();
+    diff = self.optimiser.optimise_partition(partition, n_iterations=2);
+    stats = self.optimiser.stats;
+    self.assertEqual(stats[0]['iteration'], 0);
+    self.assertEqual(stats[-1]['iteration'], 1);
+    self.assertEqual(stats[0]['n_nodes'], G.vcount());
+    self.assertEqual(stats[0]['n_edges'], G.ecount());
+    self.assertGreaterEqual(stats[0]['move']['node_visits'], G.vcount());
+    self.assertAlmostEqual(
+      sum(level['move']['improvement'] for level in stats), diff, places=5,
+      msg="Improvement in optimiser stats not equal to improvement of optimise_partition.");
+    self.assertAlmostEqual(
+      partition.quality() - q, diff, places=5,
+      msg="Improvement of optimise_partition not equal to difference in quality.");
+
+  def test_optimiser_visit_order(self):
+    G = ig.Graph.Barabasi(n=1000, m=3);
+    for visit_order in [leidenalg.FIFO_ORDER, leidenalg.GAIN_ORDER,
+                        leidenalg.DEGREE_ORDER, leidenalg.BOUNDED_ORDER]:
+      partition = leidenalg.ModularityVertexPartition(G);
+      self.optimiser.visit_order = visit_order;
+      self.assertEqual(self.optimiser.visit_order, visit_order);
+      diff = self.optimiser.optimise_partition(partition);
+      stats = self.optimiser.stats;
+      self.assertGreaterEqual(stats[0]['move']['node_visits'], G.vcount());
+      self.assertAlmostEqual(
+        sum(level['move']['improvement'] for level in stats), diff, places=5,
+        msg="Improvement in optimiser stats not equal to improvement of optimise_partition for visit order {0}.".format(visit_order));
+      if visit_order != leidenalg.BOUNDED_ORDER:
+        self.assertEqual(stats[0]['move']['skipped_insertions'], 0);
+
+    self.optimiser.max_unproductive_visits = 1;
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.optimise_partition(partition);
+    # Each node is visited at most once without moving it.
+    stats = self.optimiser.stats[0]['move'];
+    self.assertLessEqual(stats['node_visits'], G.vcount() + stats['moves']);
+    with self.assertRaises(ValueError):
+      self.optimiser.visit_order = 0;
+    with self.assertRaises(ValueError):
+      self.optimiser.max_unproductive_visits = 0;
+
+  def test_optimiser_relabel_nodes(self):
+    G = ig.Graph.Full(10) + ig.Graph.Full(5) + ig.Graph.Full(8);
+    G.permute_vertices(list(range(G.vcount()))[::-1]);
+    cliques = set(frozenset(G.neighbors(v) + [v]) for v in range(G.vcount()));
+    for relabel_nodes in [leidenalg.NO_RELABEL, leidenalg.RCM_RELABEL,
+                          leidenalg.DEGREE_RELABEL]:
+      partition = leidenalg.ModularityVertexPartition(G);
+      self.optimiser.relabel_nodes = relabel_nodes;
+      self.assertEqual(self.optimiser.relabel_nodes, relabel_nodes);
+      diff = self.optimiser.optimise_partition(partition);
+      self.assertEqual(
+        set(frozenset(community) for community in partition), cliques,
+        msg="Communities are not the cliques when relabelling nodes in order {0}.".format(relabel_nodes));
+      self.assertAlmostEqual(
+        partition.quality() - leidenalg.ModularityVertexPartition(G).quality(), diff, places=5,
+        msg="Improvement of optimise_partition not equal to difference in quality for relabelling nodes in order {0}.".format(relabel_nodes));
+    with self.assertRaises(ValueError):
+      self.optimiser.relabel_nodes = 0;
+
+  def test_optimiser_max_levels(self):
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.max_levels = 1;
+    self.optimiser.optimise_partition(partition, n_iterations=3);
+    self.assertListEqual(
+      [level['iteration'] for level in self.optimiser.stats], [0, 1, 2],
+      msg="Optimiser used more aggregation levels than max_levels.");
+
+  def test_optimiser_max_time(self):
+    G = ig.Graph.Erdos_Renyi(10000, p=10./10000);
+    partition = leidenalg.ModularityVertexPartition(G);
+    q = partition.quality();
+    self.optimiser.optimise_partition(partition, n_iterations=-1, max_time=1e-4);
+    self.assertTrue(
+      self.optimiser.timed_out,
+      msg="Optimiser did not time out.");
+    self.assertGreaterEqual(
+      partition.quality(), q,
+      msg="Quality decreased after running out of time.");
+    self.optimiser.optimise_partition(partition, n_iterations=-1, tolerance=1e-2);
+    self.assertFalse(
+      self.optimiser.timed_out,
+      msg="Optimiser timed out without a maximum time.");
+
+  @unittest.skipIf(not PY3, "Hierarchy views require Python 3")
+  def test_optimiser_hierarchy(self):
+    G = ig.Graph.Erdos_Renyi(1000, p=10./1000);
+    self.assertEqual(
+      len(self.optimiser.hierarchy), 0,
+      msg="Optimiser recorded a hierarchy without record_hierarchy.");
+    self.optimiser.record_hierarchy = True;
+    for relabel_nodes in [leidenalg.NO_RELABEL, leidenalg.RCM_RELABEL]:
+      self.optimiser.relabel_nodes = relabel_nodes;
+      partition = leidenalg.ModularityVertexPartition(G);
+      self.optimiser.optimise_partition(partition);
+      hierarchy = self.optimiser.hierarchy;
+      self.assertEqual(
+        len(hierarchy[0]), G.vcount(),
+        msg="First level of hierarchy does not contain all nodes.");
+      for k in range(1, len(hierarchy)):
+        self.assertEqual(
+          len(hierarchy[k]), max(hierarchy[k - 1]) + 1,
+          msg="Level of hierarchy does not map to all nodes of the next level.");
+      self.assertListEqual(
+        hierarchy.membership(-1), partition.membership,
+        msg="Last level of hierarchy does not give the membership (relabel_nodes={0}).".format(relabel_nodes));
+
+  def test_optimise_partition_async(self):
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.ModularityVertexPartition(G);
+    q = partition.quality();
+    progress = [];
+    handle = self.optimiser.optimise_partition_async(partition, callback=progress.append, interval=1e-3);
+    diff = handle.result();
+    self.assertTrue(
+      handle.done(),
+      msg="Asynchronous optimisation not done after its result.");
+    self.assertAlmostEqual(
+      partition.quality() - q, diff,
+      msg="Improvement of asynchronous optimisation incorrect.");
+    self.assertAlmostEqual(
+      handle.progress['quality'], partition.quality(),
+      msg="Quality in progress of asynchronous optimisation incorrect.");
+    self.assertGreater(
+      handle.progress['nodes_processed'], 0,
+      msg="No nodes processed in progress of asynchronous optimisation.");
+
+  def test_optimise_partition_async_cancel(self):
+    G = ig.Graph.Erdos_Renyi(10000, p=10./10000);
+    partition = leidenalg.ModularityVertexPartition(G);
+    q = partition.quality();
+    handle = self.optimiser.optimise_partition_async(partition, n_iterations=-1);
+    handle.cancel();
+    diff = handle.result();
+    self.assertTrue(
+      handle.progress['cancelled'],
+      msg="Asynchronous optimisation not cancelled.");
+    self.assertGreaterEqual(
+      partition.quality(), q,
+      msg="Quality decreased after cancelling.");
+    self.assertAlmostEqual(
+      partition.quality() - q, diff,
+      msg="Improvement of cancelled optimisation incorrect.");
+
+  def test_optimise_partition_async_callback_error(self):
+    G = ig.Graph.Erdos_Renyi(10000, p=10./10000);
+    partition = leidenalg.ModularityVertexPartition(G);
+    def callback(progress):
+      raise RuntimeError("Callback failed.");
+    handle = self.optimiser.optimise_partition_async(partition, n_iterations=-1, callback=callback, interval=1e-3);
+    with self.assertRaises(RuntimeError):
+      handle.result();
+    self.assertTrue(
+      handle.progress['cancelled'],
+      msg="Asynchronous optimisation not cancelled after the callback failed.");
+
+  @unittest.skipIf(not PY3, "asyncio requires Python 3")
+  def test_optimise_partition_await(self):
+    import asyncio
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.ModularityVertexPartition(G);
+    q = partition.quality();
+    loop = asyncio.new_event_loop();
+    try:
+      diff = loop.run_until_complete(self.optimiser.optimise_partition_async(partition));
+    finally:
+      loop.close();
+    self.assertAlmostEqual(
+      partition.quality() - q, diff,
+      msg="Improvement of awaited optimisation incorrect.");
+
+  def test_graph_n_threads(self):
+    # Sufficiently large to construct the graph using multiple threads
+    G = ig.Graph.Erdos_Renyi(n=100000, m=200000);
+    G.add_edges([(0, 0), (1, 1)]);
+    memberships = [];
+    self.addCleanup(leidenalg.set_graph_n_threads, 1);
+    for n_threads in [1, 4]:
+      leidenalg.set_graph_n_threads(n_threads);
+      partition = leidenalg.ModularityVertexPartition(G);
+      self.optimiser.set_rng_seed(0);
+      self.optimiser.optimise_partition(partition);
+      memberships.append(partition.membership);
+    self.assertListEqual(
+      memberships[0], memberships[1],
+      msg="Constructing graphs using multiple threads gave a different partition.");
+
 #%%
 if __name__ == '__main__':
   #%%
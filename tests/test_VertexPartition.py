@@ -2,6 +2,10 @@ import unittest
 import igraph as ig
 import leidenalg
 import random
+import array
+import os
+import tempfile
+import pickle
 
 from ddt import ddt, data, unpack
 
@@ -77,6 +81,22 @@ class BaseTest:
     def setUp(self):
       self.optimiser = leidenalg.Optimiser();
 
+    # Whether the partition uses the weights of graph, which is not supported
+    # by SignificanceVertexPartition.
+    def _is_weighted(self, graph):
+      return 'weight' in graph.es.attributes() and self.partition_type != leidenalg.SignificanceVertexPartition;
+
+    # Optimised partition of graph, with its weights if they are used. If
+    # buffer_weights is set, the weights are passed as a buffer.
+    def _optimised_partition(self, graph, buffer_weights=False):
+      if self._is_weighted(graph):
+        weights = array.array('d', graph.es['weight']) if buffer_weights else 'weight';
+        partition = self.partition_type(graph, weights=weights);
+      else:
+        partition = self.partition_type(graph);
+      self.optimiser.optimise_partition(partition);
+      return partition;
+
     @data(*graphs)
     def test_move_nodes(self, graph):
       if 'weight' in graph.es.attributes() and self.partition_type == leidenalg.SignificanceVertexPartition:
@@ -137,6 +157,188 @@ class BaseTest:
           s, partition.total_weight_in_all_comms())
         );
 
+    @data(*graphs)
+    def test_communities(self, graph):
+      partition = self.partition_type(graph);
+      self.optimiser.move_nodes(partition);
+      for v in range(0, graph.vcount(), 3):
+        partition.move_node(v, partition.membership[(v + 1) % graph.vcount()]);
+      partition.renumber_communities();
+      for c in range(len(partition)):
+        self.assertListEqual(
+          partition[c],
+          [v for v, comm in enumerate(partition.membership) if comm == c],
+          msg='Nodes of community {0} not equal to nodes with that membership.'.format(c));
+      sizes = [len(community) for community in partition];
+      self.assertListEqual(sizes, sorted(sizes, reverse=True),
+        msg='Renumbered communities are not in decreasing size.');
+      with self.assertRaises(IndexError):
+        partition[len(partition)];
+
+    @data(*graphs)
+    def test_clone(self, graph):
+      partition = self.partition_type(graph);
+      self.optimiser.optimise_partition(partition);
+      clone = partition.clone();
+      self.assertListEqual(clone.membership, partition.membership,
+        msg='Membership of clone not equal to original membership.');
+      self.assertEqual(clone.quality(), partition.quality(),
+        msg='Quality of clone not equal to original quality.');
+      state = partition.checkpoint();
+      for v in range(graph.vcount()):
+        clone.move_node(v, 0);
+      self.assertEqual(partition.checkpoint(), state,
+        msg='Changing the clone changed the original partition.');
+      clone.restore(state);
+      self.assertListEqual(clone.membership, partition.membership,
+        msg='Restored membership not equal to original membership.');
+      self.assertAlmostEqual(clone.quality(), partition.quality(), places=10,
+        msg='Restored quality not equal to original quality.');
+
+    @data(*graphs)
+    def test_pickle(self, graph):
+      partition = self.partition_type(graph);
+      self.optimiser.optimise_partition(partition);
+      new_partition = pickle.loads(pickle.dumps(partition));
+      self.assertIsInstance(new_partition, self.partition_type);
+      self.assertListEqual(new_partition.membership, partition.membership,
+        msg='Membership of unpickled partition not equal to original membership.');
+      self.assertEqual(new_partition.checkpoint(), partition.checkpoint(),
+        msg='State of unpickled partition not equal to original state.');
+      other = ig.Graph.Full(graph.vcount() + 1);
+      with self.assertRaises(ValueError):
+        self.partition_type(other).restore(partition.checkpoint());
+
+    @data(*graphs)
+    def test_buffer_membership(self, graph):
+      partition = self._optimised_partition(graph, buffer_weights=True);
+      membership = array.array('l', partition.membership);
+      new_partition = self.partition_type(graph, initial_membership=membership);
+      self.assertListEqual(
+        new_partition.membership,
+        partition.membership,
+        msg='Membership read from a buffer not equal to original membership.');
+      if PY3:
+        self.assertListEqual(
+          partition.membership_view().tolist(),
+          partition.membership,
+          msg='Membership view not equal to membership.');
+        # Views remain valid when the partition is changed afterwards
+        view = partition.membership_view();
+        other_view = partition.membership_view()[1:];
+        state = partition.checkpoint();
+        partition.set_membership(list(range(graph.vcount())));
+        partition.restore(state);
+        self.assertEqual(len(view), graph.vcount());
+        self.assertListEqual(
+          view.tolist(),
+          partition.membership,
+          msg='Membership view not equal to membership after restoring the partition.');
+        self.assertEqual(len(other_view), graph.vcount() - 1);
+
+    @data(*graphs)
+    def test_edge_changes(self, graph):
+      weighted = self._is_weighted(graph);
+      partition = self._optimised_partition(graph);
+      H = graph.copy();
+      n = H.vcount();
+      edges = [tuple(random.sample(range(n), 2)) for i in range(5)];
+      weights = [random.random() if weighted else 1.0 for e in edges];
+      H.add_edges(edges);
+      if weighted:
+        H.es[graph.ecount():]['weight'] = weights;
+      partition.add_edges(edges, weights);
+      deleted = [e.index for e in H.es[:3] if not e.is_loop()];
+      H.delete_edges(deleted);
+      partition.delete_edges(deleted);
+      if weighted:
+        H.es[0]['weight'] = 0.5;
+        partition.set_edge_weights([0], [0.5]);
+      if weighted:
+        new_partition = self.partition_type(H, initial_membership=partition.membership, weights='weight');
+      else:
+        new_partition = self.partition_type(H, initial_membership=partition.membership);
+      self.assertAlmostEqual(
+        partition.quality(),
+        new_partition.quality(),
+        places=5,
+        msg='Quality after changing edges not equal to quality of partition on changed graph.');
+      nodes = partition.set_edge_weights([0], [1.0]);
+      q = partition.quality();
+      self.optimiser.move_nodes(partition, nodes=nodes);
+      self.assertGreaterEqual(
+        partition.quality(),
+        q - 1e-5,
+        msg='Quality decreased after moving affected nodes.');
+
+    @data(*graphs)
+    def test_save_load_graph(self, graph):
+      weighted = self._is_weighted(graph);
+      partition = self._optimised_partition(graph);
+      f = tempfile.NamedTemporaryFile(delete=False);
+      f.close();
+      try:
+        if weighted:
+          leidenalg.save_graph(graph, f.name, weights='weight');
+        else:
+          leidenalg.save_graph(graph, f.name);
+        loaded_partition = self.partition_type.FromFile(f.name, initial_membership=partition.membership);
+        self.assertAlmostEqual(
+          partition.quality(),
+          loaded_partition.quality(),
+          places=5,
+          msg='Quality of partition on loaded graph not equal to quality on original graph.');
+        self.assertListEqual(
+          loaded_partition.graph.get_edgelist(),
+          graph.get_edgelist(),
+          msg='Edges of graph of loaded partition not equal to edges of original graph.');
+        self.assertAlmostEqual(
+          partition.modularity,
+          loaded_partition.modularity,
+          places=5,
+          msg='Modularity of partition on loaded graph not equal to modularity on original graph.');
+        del loaded_partition;
+      finally:
+        os.remove(f.name);
+
+    def test_load_corrupted_graph(self):
+      graph = ig.Graph.Famous('Zachary');
+      f = tempfile.NamedTemporaryFile(delete=False);
+      f.close();
+      try:
+        leidenalg.save_graph(graph, f.name);
+        # Overwrite the first neighbour, which follows the header and the
+        # offsets, by a node that does not exist.
+        with open(f.name, 'r+b') as graph_file:
+          graph_file.seek(80 + (2*graph.vcount() + 1)*8);
+          graph_file.write(b'\xff'*4);
+        with self.assertRaises(ValueError):
+          self.partition_type.FromFile(f.name);
+      finally:
+        os.remove(f.name);
+
+    @data(*graphs)
+    def test_stream_edges(self, graph):
+      weighted = self._is_weighted(graph);
+      partition = self._optimised_partition(graph);
+      edges = graph.get_edgelist();
+      m = len(edges);
+      def chunks():
+        for i in range(0, m, 10):
+          chunk = ([e[0] for e in edges[i:i+10]], [e[1] for e in edges[i:i+10]]);
+          if weighted:
+            chunk += (graph.es[i:i+10]['weight'],);
+          yield chunk;
+      streamed_partition = self.partition_type.FromEdges(chunks,
+                                                        n=graph.vcount(),
+                                                        directed=graph.is_directed(),
+                                                        initial_membership=partition.membership);
+      self.assertAlmostEqual(
+        partition.quality(),
+        streamed_partition.quality(),
+        places=5,
+        msg='Quality of partition on streamed graph not equal to quality on original graph.');
+
 #class ModularityVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
 #  def setUp(self):
 #    super(ModularityVertexPartitionTest, self).setUp();
@@ -167,6 +369,75 @@ class SignificanceVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
     super(SignificanceVertexPartitionTest, self).setUp();
     self.partition_type = leidenalg.SignificanceVertexPartition;
 
+@ddt
+class MultisliceVertexPartitionTest(unittest.TestCase):
+
+  def setUp(self):
+    self.optimiser = leidenalg.Optimiser();
+    self.slices = [ig.Graph.Erdos_Renyi(30, p=0.2) for t in range(4)];
+    for H in self.slices:
+      H.vs['id'] = range(H.vcount());
+      H.es['weight'] = [random.random() for e in H.es];
+
+  @data((leidenalg.RBConfigurationVertexPartition, 'configuration'),
+        (leidenalg.CPMVertexPartition, 'CPM'))
+  @unpack
+  def test_quality_equals_layers(self, partition_type, null_model):
+    layers, interslice_layer, G = leidenalg.time_slices_to_layers(self.slices, interslice_weight=0.5);
+    partition = leidenalg.MultisliceVertexPartition(G, G.vs['slice'], null_model=null_model,
+                                                    weights='weight', resolution_parameter=0.1);
+    self.optimiser.optimise_partition(partition);
+    arg_dict = {'weights': 'weight', 'resolution_parameter': 0.1,
+                'initial_membership': partition.membership};
+    if partition_type == leidenalg.CPMVertexPartition:
+      arg_dict['node_sizes'] = 'node_size';
+    layer_quality = sum(partition_type(H, **arg_dict).quality() for H in layers);
+    layer_quality += leidenalg.CPMVertexPartition(interslice_layer, resolution_parameter=0,
+                                                  node_sizes='node_size', weights='weight',
+                                                  initial_membership=partition.membership).quality();
+    self.assertAlmostEqual(
+      partition.quality(),
+      layer_quality,
+      places=5,
+      msg='Quality of multislice partition not equal to quality of layers.');
+    aggregate_partition = partition.aggregate_partition();
+    self.assertAlmostEqual(
+      partition.quality(),
+      aggregate_partition.quality(),
+      places=5,
+      msg='Quality not equal for aggregate partition.');
+
+  @data('configuration', 'CPM')
+  def test_pickle(self, null_model):
+    layers, interslice_layer, G = leidenalg.time_slices_to_layers(self.slices, interslice_weight=0.5);
+    partition = leidenalg.MultisliceVertexPartition(G, 'slice', null_model=null_model,
+                                                    weights='weight', resolution_parameter=0.1);
+    self.optimiser.optimise_partition(partition);
+    new_partition = pickle.loads(pickle.dumps(partition));
+    self.assertListEqual(new_partition.membership, partition.membership,
+      msg='Membership of unpickled partition not equal to original membership.');
+    self.assertAlmostEqual(new_partition.quality(), partition.quality(), places=10,
+      msg='Quality of unpickled partition not equal to original quality.');
+
+  @data('configuration', 'CPM')
+  def test_move_nodes(self, null_model):
+    layers, interslice_layer, G = leidenalg.time_slices_to_layers(self.slices, interslice_weight=0.5);
+    partition = leidenalg.MultisliceVertexPartition(G, 'slice', null_model=null_model,
+                                                    weights='weight', resolution_parameter=0.1);
+    for v in range(G.vcount()):
+      if G.degree(v) >= 1:
+        u = G.neighbors(v)[0];
+        diff = partition.diff_move(v, partition.membership[u]);
+        q1 = partition.quality();
+        partition.move_node(v, partition.membership[u]);
+        q2 = partition.quality();
+        self.assertAlmostEqual(
+            q2 - q1,
+            diff,
+            places=5,
+            msg="Difference in quality ({0}) not equal to calculated difference ({1})".format(
+            q2 - q1, diff));
+
 #%%
 if __name__ == '__main__':
   #%%